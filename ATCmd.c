@@ -0,0 +1,146 @@
+/**
+ @file     ATCmd.c
+ @brief    This file contains the AT command descriptor table generated
+           from AT_CMD_TABLE, the send routine that uses the precomputed
+           lengths (no strlen/concatenation for fixed commands), and the
+           per-command statistics.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "Transport.h"
+
+#include "ESP8266.h"			// ESP_AP_SSID, ESP_AP_PWD
+#include "ATCmd.h"
+
+
+#define AT_CMD_DESC(Id, Text, Term, Args, Expect, Tmo)					\
+    [AT_##Id] = {														\
+        (Args) ? Text : Text Term,										\
+        Term,															\
+        Expect,															\
+        (Args) ? sizeof(Text) - 1 : sizeof(Text Term) - 1,				\
+        sizeof(Term) - 1,												\
+        sizeof(Expect) - 1,												\
+        Args,															\
+        Tmo																\
+    },
+
+const ATCmd_Desc ATCmd_Table[AT_CMD_COUNT] =
+{
+    AT_CMD_TABLE(AT_CMD_DESC)
+};
+
+#undef AT_CMD_DESC
+
+const uint32_t ATCmd_TimeoutMs[AT_TMO_COUNT] =
+{
+    [AT_TMO_SHORT]  = AT_TMO_SHORT_MS,
+    [AT_TMO_MEDIUM] = AT_TMO_MEDIUM_MS,
+    [AT_TMO_LONG]   = AT_TMO_LONG_MS,
+    [AT_TMO_SMS]    = AT_TMO_SMS_MS,
+    [AT_TMO_BEARER] = AT_TMO_BEARER_MS,
+};
+
+// Upper edges of the latency bins, around the timeout classes
+const uint16_t ATCmd_HistMs[ATCMD_HIST_BINS - 1] =
+{
+    20, 100, 1000, 5000, 15000
+};
+
+static ATCmd_Stat ATCmd_Stats[AT_CMD_COUNT];
+
+
+/**
+ * @name    ATCmd_Send
+ * @brief   The function sends a command from the table
+ *
+ * @author  Mehdi
+ *
+ * @param	USARTx: the USART of the module
+ * @param	Id: the command (AT_xxx)
+ * @param	Args: the arguments of an AT_ARGS command (ignored otherwise)
+ */
+
+void ATCmd_Send(USART_TypeDef* USARTx, uint8_t Id, const char* Args)
+{
+    const ATCmd_Desc* Cmd = &ATCmd_Table[Id];
+
+    AT_Send(USARTx,(uint8_t*)Cmd->Text,Cmd->Len);
+
+    if (Cmd->Args == AT_ARGS)
+    {
+        if (Args != NULL)
+            AT_Puts(USARTx,(char*)Args);
+        AT_Send(USARTx,(uint8_t*)Cmd->Term,Cmd->TermLen);
+    }
+}
+
+
+/**
+ * @name    ATCmd_Timeout
+ * @brief   The function returns the timeout (ms) of a command
+ *
+ * @author  Mehdi
+ */
+
+uint32_t ATCmd_Timeout(uint8_t Id)
+{
+    return ATCmd_TimeoutMs[ATCmd_Table[Id].Timeout];
+}
+
+
+/**
+ * @name    ATCmd_Record
+ * @brief   The function records the result and duration of a command
+ *
+ * @author  Mehdi
+ *
+ * @param	Id: the command (AT_xxx)
+ * @param	Result: ATCMD_OK, ATCMD_TIMEOUT or any failure code
+ * @param	Ms: time from sending the command to its final response
+ */
+
+void ATCmd_Record(uint8_t Id, int8_t Result, uint32_t Ms)
+{
+    ATCmd_Stat* Stat;
+    uint8_t Bin;
+
+    if (Id >= AT_CMD_COUNT)
+        return;
+
+    Stat = &ATCmd_Stats[Id];
+
+    Stat->Count++;
+    Stat->TotalMs += Ms;
+    if (Ms > Stat->MaxMs)
+        Stat->MaxMs = Ms;
+
+    for (Bin = 0; Bin < ATCMD_HIST_BINS - 1 && Ms > ATCmd_HistMs[Bin]; Bin++)
+        ;
+    Stat->Hist[Bin]++;
+
+    if (Result == ATCMD_TIMEOUT)
+        Stat->Timeout++;
+    else if (Result != ATCMD_OK)
+        Stat->Fail++;
+}
+
+
+/**
+ * @name    ATCmd_GetStat
+ * @brief   The function returns the statistics of a command
+ *
+ * @author  Mehdi
+ */
+
+const ATCmd_Stat* ATCmd_GetStat(uint8_t Id)
+{
+    return (Id < AT_CMD_COUNT) ? &ATCmd_Stats[Id] : NULL;
+}
@@ -0,0 +1,146 @@
+/**
+ @file     ATCmd.h
+ @brief    Descriptor table of the AT commands used by the ESP8266 and
+           SIM900 drivers. Every command is declared once with its text,
+           terminator, expected final response and timeout class; the
+           table is const (flash resident) and indexed by command ID.
+
+ @author   Mehdi
+
+*/
+
+#ifndef ATCMD_H_
+#define ATCMD_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+// Result codes (same values as ESP8266_xxx and SIM900_xxx)
+#define ATCMD_OK					 1
+#define ATCMD_FAIL					-2
+#define ATCMD_TIMEOUT				-3
+
+// Timeout Classes
+#define AT_TMO_SHORT				0		// 1 s
+#define AT_TMO_MEDIUM				1		// 5 s
+#define AT_TMO_LONG					2		// 15 s
+#define AT_TMO_SMS					3		// 60 s
+#define AT_TMO_BEARER				4		// 90 s: AT+SAPBR=1,1 takes up to 85 s
+#define AT_TMO_COUNT				5
+
+#define AT_TMO_SHORT_MS				1000
+#define AT_TMO_MEDIUM_MS			5000
+#define AT_TMO_LONG_MS				15000
+#define AT_TMO_SMS_MS				60000
+#define AT_TMO_BEARER_MS			90000
+
+// Terminators
+#define AT_CRLF						"\r\n"	// ESP8266
+#define AT_CR						"\r"	// SIM900
+
+// Arguments
+#define AT_NOARGS					0		// Fixed text
+#define AT_ARGS						1		// Text is a prefix, arguments follow
+
+// Latency Histogram: bin i counts the commands that took <= ATCmd_HistMs[i]; the last bin is the rest
+#define ATCMD_HIST_BINS				6
+
+/*
+ * X(ID, Text, Terminator, Arguments, Expected final response, Timeout class)
+ */
+#define AT_CMD_TABLE(X)																		\
+    /* ESP8266 */																			\
+    X(ESP_AT,				"AT",					AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CWMODE_Q,			"AT+CWMODE?",			AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CWMODE_STA,		"AT+CWMODE=1",			AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CWJAP_Q,			"AT+CWJAP?",			AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CWJAP,			"AT+CWJAP=\"" ESP_AP_SSID "\",\"" ESP_AP_PWD "\"",				\
+                                                    AT_CRLF, AT_NOARGS, "OK",		AT_TMO_LONG)	\
+    X(ESP_CWJAP_CUR,		"AT+CWJAP_CUR=",		AT_CRLF, AT_ARGS,   "OK",		AT_TMO_LONG)	\
+    X(ESP_CWJAP_CUR_Q,		"AT+CWJAP_CUR?",		AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPSTA_CUR,		"AT+CIPSTA_CUR=",		AT_CRLF, AT_ARGS,   "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPSTA_CUR_Q,		"AT+CIPSTA_CUR?",		AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CWDHCP_CUR_ON,	"AT+CWDHCP_CUR=1,1",	AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CWLAP,			"AT+CWLAP=",				AT_CRLF, AT_ARGS,   "OK",		AT_TMO_MEDIUM)	\
+    X(ESP_PING,				"AT+PING=",				AT_CRLF, AT_ARGS,   "OK",		AT_TMO_MEDIUM)	\
+    X(ESP_CIFSR,			"AT+CIFSR",				AT_CRLF, AT_NOARGS, "OK",		AT_TMO_MEDIUM)	\
+    X(ESP_CIPSTATUS,		"AT+CIPSTATUS",			AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPMUX_Q,			"AT+CIPMUX?",			AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPMUX_ON,		"AT+CIPMUX=1",			AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPSERVER_Q,		"AT+CIPSERVER?",		AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPSERVER_ON,		"AT+CIPSERVER=1,80",	AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPSERVER_OFF,	"AT+CIPSERVER=0",		AT_CRLF, AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPSTART,			"AT+CIPSTART=",			AT_CRLF, AT_ARGS,   "OK",		AT_TMO_MEDIUM)	\
+    X(ESP_CIPSEND,			"AT+CIPSEND=",			AT_CRLF, AT_ARGS,   "OK",		AT_TMO_SHORT)	\
+    X(ESP_CIPCLOSE,			"AT+CIPCLOSE=",			AT_CRLF, AT_ARGS,   "OK",		AT_TMO_SHORT)	\
+    X(ESP_UART_CUR,			"AT+UART_CUR=",			AT_CRLF, AT_ARGS,   "OK",		AT_TMO_SHORT)	\
+    /* SIM900 */																			\
+    X(SIM_AT,				"AT",					AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_CREG_Q,			"AT+CREG?",				AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_CREG_URC,			"AT+CREG=2",			AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_CGREG_Q,			"AT+CGREG?",			AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_CGREG_URC,		"AT+CGREG=2",			AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_CMGF_PDU,			"AT+CMGF=0",			AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_CNMI_REPORT,		"AT+CNMI=2,1,0,1,0",	AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_CMGD,				"AT+CMGD=",				AT_CR,   AT_ARGS,   "OK",		AT_TMO_MEDIUM)	\
+    X(SIM_CMGR,				"AT+CMGR=",				AT_CR,   AT_ARGS,   "OK",		AT_TMO_MEDIUM)	\
+    X(SIM_CMGS,				"AT+CMGS=",				AT_CR,   AT_ARGS,   ">",		AT_TMO_MEDIUM)	\
+    X(SIM_SAPBR,			"AT+SAPBR=",			AT_CR,   AT_ARGS,   "OK",		AT_TMO_BEARER)	\
+    X(SIM_HTTPINIT,			"AT+HTTPINIT",			AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_HTTPTERM,			"AT+HTTPTERM",			AT_CR,   AT_NOARGS, "OK",		AT_TMO_SHORT)	\
+    X(SIM_HTTPPARA,			"AT+HTTPPARA=",			AT_CR,   AT_ARGS,   "OK",		AT_TMO_SHORT)	\
+    X(SIM_HTTPDATA,			"AT+HTTPDATA=",			AT_CR,   AT_ARGS,   "DOWNLOAD",	AT_TMO_MEDIUM)	\
+    X(SIM_HTTPACTION,		"AT+HTTPACTION=",		AT_CR,   AT_ARGS,   "OK",		AT_TMO_SHORT)	\
+    X(SIM_HTTPREAD,			"AT+HTTPREAD=",			AT_CR,   AT_ARGS,   "OK",		AT_TMO_MEDIUM)
+
+// Command IDs
+#define AT_CMD_ID(Id, Text, Term, Args, Expect, Tmo)	AT_##Id,
+typedef enum
+{
+    AT_CMD_TABLE(AT_CMD_ID)
+    AT_CMD_COUNT
+} ATCmd_Id;
+#undef AT_CMD_ID
+
+typedef struct
+{
+    const char *Text;		// Command text; includes the terminator if it takes no arguments
+    const char *Term;		// Terminator sent after the arguments
+    const char *Expect;		// Final response of a successful command
+    uint8_t     Len;		// strlen(Text)
+    uint8_t     TermLen;
+    uint8_t     ExpectLen;
+    uint8_t     Args;		// AT_ARGS / AT_NOARGS
+    uint8_t     Timeout;	// AT_TMO_xxx
+} ATCmd_Desc;
+
+typedef struct
+{
+    uint32_t Count;
+    uint32_t Fail;
+    uint32_t Timeout;
+    uint32_t TotalMs;
+    uint32_t MaxMs;
+    uint32_t Hist[ATCMD_HIST_BINS];		// Latency histogram (not cumulative), sums to Count
+} ATCmd_Stat;
+
+extern const ATCmd_Desc ATCmd_Table[AT_CMD_COUNT];
+extern const uint32_t   ATCmd_TimeoutMs[AT_TMO_COUNT];
+extern const uint16_t   ATCmd_HistMs[ATCMD_HIST_BINS - 1];
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void ATCmd_Send(USART_TypeDef* USARTx, uint8_t Id, const char* Args);
+
+uint32_t ATCmd_Timeout(uint8_t Id);
+
+void ATCmd_Record(uint8_t Id, int8_t Result, uint32_t Ms);
+
+const ATCmd_Stat* ATCmd_GetStat(uint8_t Id);
+
+
+#endif /* ATCMD_H_ */
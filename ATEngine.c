@@ -0,0 +1,315 @@
+/**
+ @file     ATEngine.c
+ @brief    This file contains the shared AT engine: command transmit,
+           line framing, result code matching, prompt detection and
+           routing of the unsolicited lines.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "Transport.h"
+
+#include "ATEngine.h"
+#include "ATCmd.h"
+#include "TimeBase.h"
+
+
+
+/**
+ * @name    ATEngine_Init
+ * @brief   The function binds an engine to the USART of a module
+ *
+ * @author  Mehdi
+ *
+ * @param	USARTx: the USART of the module
+ * @param	Line: buffer of the replies no collector is given for; the
+ *              final line of ATEngine_Wait is left in it
+ * @param	Size: size of Line
+ * @param	Urc: handler of the unsolicited lines (may be NULL)
+ */
+
+void ATEngine_Init(ATEngine* Eng, USART_TypeDef* USARTx, char* Line, uint16_t Size, ATEngine_URCHandler Urc)
+{
+    Eng->USARTx = USARTx;
+    Eng->Line = Line;
+    Eng->Size = Size;
+    Eng->Urc = Urc;
+    Eng->Frame = NULL;
+    Eng->Overflows = 0;
+
+    if (Size != 0)
+        Line[0] = '\0';
+}
+
+
+/**
+ * @name    ATEngine_SetFrameHandler
+ * @brief   The function sets the handler of the raw data sent behind a
+ *              header (see ATEngine_FrameHandler)
+ *
+ * @author  Mehdi
+ *
+ * @param	Frame: the handler (NULL: none)
+ */
+
+void ATEngine_SetFrameHandler(ATEngine* Eng, ATEngine_FrameHandler Frame)
+{
+    Eng->Frame = Frame;
+}
+
+
+/**
+ * @name    ATEngine_Frame
+ * @brief   The function hands the line in progress to the frame handler
+ *              when it is a header: it starts with '+' and the byte just
+ *              stored is a ':'. The header is dropped if the handler read
+ *              the data.
+ *
+ * @author  Mehdi
+ *
+ * @param	Resp: the collector of the line
+ * @param	c: the byte just fed
+ * @return	1 if the handler read a frame, 0 otherwise
+ */
+
+static uint8_t ATEngine_Frame(ATEngine* Eng, ATResp* Resp, char c)
+{
+    char* Head = Resp->Buf + Resp->Start;
+
+    if (c != ':' || Eng->Frame == NULL || Resp->Len == Resp->Start || Head[0] != '+' ||
+        Resp->Buf[Resp->Len - 1] != ':')
+        return 0;
+
+    Resp->Buf[Resp->Len] = '\0';
+
+    if (!Eng->Frame(Head))
+        return 0;
+
+    Resp->Len = Resp->Start;
+    Head[0] = '\0';
+
+    return 1;
+}
+
+
+/**
+ * @name    ATEngine_Collect
+ * @brief   The function reads the module until the end of a reply. The
+ *              echo of the commands is dropped; the other lines that do
+ *              not end the reply go to the URC handler, and are kept in
+ *              the collector if the handler does not use them.
+ *
+ * @author  Mehdi
+ *
+ * @param	Expect: the final line of a successful reply; NULL to stop at
+ *              the first line (it is not given to the URC handler)
+ * @param	ExpectLen: strlen(Expect)
+ * @param	Resp: the collector (NULL: the engine line buffer, nothing kept)
+ * @param	Prompt: 1 to stop at the "> " prompt instead
+ * @param	Timeout: time (ms) to wait
+ * @return	ATENGINE_OK, ATENGINE_TOO_LONG, ATENGINE_FAIL, ATENGINE_BUSY or ATENGINE_TIMEOUT
+ */
+
+static int8_t ATEngine_Collect(ATEngine* Eng, const char* Expect, uint16_t ExpectLen, ATResp* Resp, uint8_t Prompt, uint32_t Timeout)
+{
+    uint64_t Deadline = TimeBase_Deadline(TIMEBASE_MS(Timeout));
+    uint8_t Keep = (Resp != NULL);
+    ATResp Own;
+    const char* Line;
+    int8_t res;
+    char c;
+
+    if (!Keep)
+    {
+        ATResp_Init(&Own,Eng->Line,Eng->Size);
+        Resp = &Own;
+    }
+
+    while (1)
+    {
+        /* Checked on every byte: a module that keeps talking (a data
+           stream, a flood of reports) must not hold the caller */
+        if (TimeBase_Expired(Deadline))
+            return ATENGINE_TIMEOUT;
+
+        if (AT_BufferEmpty(Eng->USARTx))
+            continue;
+
+        c = AT_Getc(Eng->USARTx);
+
+        /* At the start of a line: the prompt, or the space after it */
+        if (Resp->Len == Resp->Start)
+        {
+            if (c == '>' && Prompt)
+                return ATENGINE_OK;
+            if (c == ' ')
+                continue;
+        }
+
+        if ((Line = ATResp_Feed(Resp,c)) == NULL)
+        {
+            ATEngine_Frame(Eng,Resp,c);
+            continue;
+        }
+
+        if (ATENGINE_ECHO(Line))
+        {
+            ATResp_Drop(Resp,Line);
+            continue;
+        }
+
+        if (Expect == NULL && !Prompt)
+            return ATENGINE_OK;
+
+        if ((res = ATEngine_Final(Line,Expect,ExpectLen)) != 0)
+        {
+            if (Keep && Resp->Overflow)
+            {
+                Eng->Overflows++;
+                if (res == ATENGINE_OK)
+                    res = ATENGINE_TOO_LONG;
+            }
+            return res;
+        }
+
+        if ((Eng->Urc != NULL && Eng->Urc(Line)) || !Keep)
+        {
+            ATResp_Drop(Resp,Line);
+            if (!Keep && Own.Overflow)
+            {
+                Eng->Overflows++;
+                Own.Overflow = 0;
+            }
+        }
+    }
+}
+
+
+/**
+ * @name    ATEngine_Send
+ * @brief   The function hands the complete lines already received to the
+ *              URC handler, then sends a command of the descriptor table
+ *
+ * @author  Mehdi
+ *
+ * @param	Id: the command (AT_xxx)
+ * @param	Args: the arguments of an AT_ARGS command (NULL otherwise)
+ */
+
+void ATEngine_Send(ATEngine* Eng, uint8_t Id, const char* Args)
+{
+    ATEngine_Poll(Eng);
+
+    ATCmd_Send(Eng->USARTx,Id,Args);
+}
+
+
+/**
+ * @name    ATEngine_Wait
+ * @brief   The function waits for the end of a reply (see ATEngine_Collect)
+ *
+ * @author  Mehdi
+ *
+ * @param	Expect: the final line of a successful reply; NULL to take the
+ *              first line, whatever it is
+ * @param	Resp: the collector of the lines (ATResp_Init'ed), or NULL to
+ *              keep the final line only, in the engine line buffer
+ * @param	Timeout: time (ms) to wait
+ * @return	ATENGINE_OK, ATENGINE_TOO_LONG, ATENGINE_FAIL, ATENGINE_BUSY or ATENGINE_TIMEOUT
+ */
+
+int8_t ATEngine_Wait(ATEngine* Eng, const char* Expect, ATResp* Resp, uint32_t Timeout)
+{
+    return ATEngine_Collect(Eng,Expect,(Expect != NULL) ? strlen(Expect) : 0,Resp,0,Timeout);
+}
+
+
+/**
+ * @name    ATEngine_Prompt
+ * @brief   The function waits for the "> " prompt of a command that takes
+ *              data (AT+CIPSEND, AT+CMGS). The prompt is consumed.
+ *
+ * @author  Mehdi
+ *
+ * @param	Timeout: time (ms) to wait
+ * @return	ATENGINE_OK, ATENGINE_FAIL, ATENGINE_BUSY or ATENGINE_TIMEOUT
+ */
+
+int8_t ATEngine_Prompt(ATEngine* Eng, uint32_t Timeout)
+{
+    return ATEngine_Collect(Eng,NULL,0,NULL,1,Timeout);
+}
+
+
+/**
+ * @name    ATEngine_Run
+ * @brief   The function sends a command of the descriptor table and waits
+ *              for its expected final response within its timeout class.
+ *              The result and duration are recorded in the command statistics.
+ *
+ * @author  Mehdi
+ *
+ * @param	Id: the command (AT_xxx)
+ * @param	Args: the arguments of an AT_ARGS command (NULL otherwise)
+ * @param	Resp: the collector of the reply lines, or NULL
+ * @return	ATENGINE_OK, ATENGINE_TOO_LONG, ATENGINE_FAIL, ATENGINE_BUSY or ATENGINE_TIMEOUT
+ */
+
+int8_t ATEngine_Run(ATEngine* Eng, uint8_t Id, const char* Args, ATResp* Resp)
+{
+    const ATCmd_Desc* Cmd = &ATCmd_Table[Id];
+    uint32_t start = TimeBase_Ms();
+    int8_t res;
+
+    ATEngine_Send(Eng,Id,Args);
+
+    res = ATEngine_Collect(Eng,Cmd->Expect,Cmd->ExpectLen,Resp,0,ATCmd_Timeout(Id));
+
+    ATCmd_Record(Id,res,TimeBase_Ms() - start);
+
+    return res;
+}
+
+
+/**
+ * @name    ATEngine_Poll
+ * @brief   The function hands the complete lines received to the URC
+ *              handler, and the frames to the frame handler, without
+ *              waiting; ATENGINE_POLL_MAX bytes at most, the rest is left
+ *              to the next call. It should be called from the main loop
+ *              when nothing else reads the module.
+ *
+ * @author  Mehdi
+ */
+
+void ATEngine_Poll(ATEngine* Eng)
+{
+    uint16_t Taken = 0;
+    ATResp Own;
+    const char* Line;
+    char c;
+
+    while (Taken < ATENGINE_POLL_MAX && AT_FindCharacter(Eng->USARTx,'\n') >= 0)
+    {
+        ATResp_Init(&Own,Eng->Line,Eng->Size);
+
+        do
+        {
+            c = AT_Getc(Eng->USARTx);
+            Line = ATResp_Feed(&Own,c);
+            Taken++;
+        } while (c != '\n' && !ATEngine_Frame(Eng,&Own,c));
+
+        if (Own.Overflow)
+            Eng->Overflows++;
+
+        if (Line != NULL && !ATENGINE_ECHO(Line) && Eng->Urc != NULL)
+            Eng->Urc(Line);
+    }
+}
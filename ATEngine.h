@@ -0,0 +1,129 @@
+/**
+ @file     ATEngine.h
+ @brief    Shared core of the modem drivers. An engine owns the USART of
+           one module: it sends the commands of the descriptor table
+           (ATCmd.h), frames the received bytes into lines, matches the
+           final result codes and the "> " prompt within a deadline,
+           drops the echo of the commands and routes the unsolicited
+           lines to the handler of the driver. The ESP8266 and SIM900
+           drivers are command-set layers on top of it.
+
+           A reply is read byte by byte into an ATResp collector, so a
+           long line (a PDU) is never cut by a line buffer; the lines the
+           caller does not keep (echo, unsolicited reports) are removed
+           from the collector as soon as they are complete.
+
+           A module that sends raw data behind a header ("+IPD,<link>,
+           <len>:" of the ESP8266) gets a frame handler: it is called at
+           the ':' of a line that starts with '+', and reads the data
+           itself, so the data never reaches the collector, even in the
+           middle of a reply.
+
+ @author   Mehdi
+
+*/
+
+#ifndef ATENGINE_H_
+#define ATENGINE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ATResp.h"
+
+// Bytes ATEngine_Poll takes per call at most (it ends the line it is in):
+// a module that keeps talking must not hold the main loop
+#ifndef ATENGINE_POLL_MAX
+#define ATENGINE_POLL_MAX			512
+#endif
+
+// Results (same values as ESP8266_xxx and SIM900_xxx)
+#define ATENGINE_OK					 1
+#define ATENGINE_TOO_LONG			-1		// The reply did not fit the collector
+#define ATENGINE_FAIL				-2		// "ERROR", "+CME ERROR", "+CMS ERROR", "FAIL", "SEND FAIL"
+#define ATENGINE_TIMEOUT			-3
+#define ATENGINE_BUSY				-4		// "busy s..." / "busy p...": the command was not taken
+
+// The echo of a command, dropped from the replies
+#define ATENGINE_ECHO(l)			((l)[0] == 'A' && (l)[1] == 'T')
+
+// Gets a line that is not the end of the awaited reply; returns 1 if it used it
+// (only the reports it knows: the other lines stay in the reply)
+typedef uint8_t (*ATEngine_URCHandler)(const char* Line);
+
+// Gets the start of a line up to a ':' ("+IPD,0,12:"); returns 1 if it read the
+// data that follows (the start is then dropped), 0 if the line goes on as usual
+typedef uint8_t (*ATEngine_FrameHandler)(const char* Head);
+
+typedef struct
+{
+    USART_TypeDef*        USARTx;
+    ATEngine_URCHandler   Urc;		// NULL: the lines not kept are dropped
+    ATEngine_FrameHandler Frame;	// NULL: no raw data behind a header
+    char*                 Line;		// The lines of a reply no collector is given for
+    uint16_t              Size;
+    uint32_t              Overflows;	// Replies, reports and frames cut short by a full buffer
+} ATEngine;
+
+
+/***************************************************
+			M A T C H E R
+****************************************************/
+
+/**
+ * @name    ATEngine_Final
+ * @brief   The function tells whether a line ends a reply. The first char
+ *              rules out most lines without a string compare. Inline, as
+ *              the matcher of both ATEngine and Modem (Modem.hpp).
+ *
+ * @author  Mehdi
+ *
+ * @return	ATENGINE_OK (Expect), ATENGINE_FAIL, ATENGINE_BUSY, or 0 if the
+ *              reply goes on
+ */
+
+static inline int8_t ATEngine_Final(const char* Line, const char* Expect, uint16_t ExpectLen)
+{
+    if (Expect != NULL && Line[0] == Expect[0] && strncmp(Line,Expect,ExpectLen) == 0)
+        return ATENGINE_OK;
+
+    switch (Line[0])
+    {
+        case 'E':
+            return (strncmp(Line,"ERROR",5) == 0) ? ATENGINE_FAIL : 0;
+        case 'F':
+            return (strncmp(Line,"FAIL",4) == 0) ? ATENGINE_FAIL : 0;
+        case 'S':
+            return (strncmp(Line,"SEND FAIL",9) == 0) ? ATENGINE_FAIL : 0;
+        case '+':
+            return (strncmp(Line,"+CME ERROR",10) == 0 || strncmp(Line,"+CMS ERROR",10) == 0) ? ATENGINE_FAIL : 0;
+        case 'b':
+            return (strncmp(Line,"busy ",5) == 0) ? ATENGINE_BUSY : 0;
+        default:
+            return 0;
+    }
+}
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void ATEngine_Init(ATEngine* Eng, USART_TypeDef* USARTx, char* Line, uint16_t Size, ATEngine_URCHandler Urc);
+
+void ATEngine_SetFrameHandler(ATEngine* Eng, ATEngine_FrameHandler Frame);
+
+void ATEngine_Send(ATEngine* Eng, uint8_t Id, const char* Args);
+
+int8_t ATEngine_Wait(ATEngine* Eng, const char* Expect, ATResp* Resp, uint32_t Timeout);
+
+int8_t ATEngine_Prompt(ATEngine* Eng, uint32_t Timeout);
+
+int8_t ATEngine_Run(ATEngine* Eng, uint8_t Id, const char* Args, ATResp* Resp);
+
+void ATEngine_Poll(ATEngine* Eng);
+
+
+#endif /* ATENGINE_H_ */
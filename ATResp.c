@@ -0,0 +1,343 @@
+/**
+ @file     ATResp.c
+ @brief    This file contains the collector of multi-line AT replies and
+           the field extractors of its lines.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ATResp.h"
+
+
+/**
+ * @name    ATResp_Init
+ * @brief   The function empties a collector and sets its buffer
+ *
+ * @author  Mehdi
+ *
+ * @param	Buf: the buffer the reply is kept in (e.g. a BufPool block)
+ * @param	Size: size of Buf
+ */
+
+void ATResp_Init(ATResp* Resp, char* Buf, uint16_t Size)
+{
+    Resp->Buf = Buf;
+    Resp->Size = Size;
+    Resp->Len = Resp->Start = 0;
+    Resp->Lines = 0;
+    Resp->Overflow = 0;
+
+    if (Size != 0)
+        Buf[0] = '\0';
+}
+
+
+/**
+ * @name    ATResp_Feed
+ * @brief   The function adds a received byte. On LF the line is closed:
+ *              its CR is dropped, it is NUL terminated and indexed.
+ *              Empty lines are not kept.
+ *
+ * @author  Mehdi
+ *
+ * @return	the line completed by the byte, NULL otherwise
+ */
+
+const char* ATResp_Feed(ATResp* Resp, char c)
+{
+    uint16_t End;
+    const char* Line;
+
+    if (c != '\n')
+    {
+        if (Resp->Len + 1 < Resp->Size)
+            Resp->Buf[Resp->Len++] = c;
+        else
+            Resp->Overflow = 1;
+        return NULL;
+    }
+
+    End = Resp->Len;
+    if (End > Resp->Start && Resp->Buf[End - 1] == '\r')
+        End--;
+
+    if (End == Resp->Start)
+    {
+        Resp->Len = Resp->Start;
+        return NULL;
+    }
+
+    Resp->Buf[End] = '\0';
+    Line = Resp->Buf + Resp->Start;
+
+    if (Resp->Lines < ATRESP_MAX_LINES)
+    {
+        Resp->Line[Resp->Lines].Off = Resp->Start;
+        Resp->Line[Resp->Lines].Len = End - Resp->Start;
+        Resp->Lines++;
+        Resp->Len = Resp->Start = End + 1;
+    } else
+    {
+        /* Not indexed: the room is reused by the next line */
+        Resp->Overflow = 1;
+        Resp->Len = Resp->Start;
+    }
+
+    return Line;
+}
+
+
+/**
+ * @name    ATResp_Drop
+ * @brief   The function removes the line just completed by ATResp_Feed
+ *              (an echo or an unsolicited line); its room is reused
+ *
+ * @author  Mehdi
+ *
+ * @param	Line: the line ATResp_Feed returned
+ */
+
+void ATResp_Drop(ATResp* Resp, const char* Line)
+{
+    uint16_t Off = Line - Resp->Buf;
+
+    if (Resp->Lines != 0 && Resp->Line[Resp->Lines - 1].Off == Off)
+        Resp->Lines--;
+
+    Resp->Len = Resp->Start = Off;
+    Resp->Buf[Off] = '\0';
+}
+
+
+/**
+ * @name    ATResp_Join
+ * @brief   The function joins the lines into one text, each line ended by
+ *              LF, for the callers that search the whole reply. The index
+ *              still gives the lines, but they are no longer NUL terminated.
+ *
+ * @author  Mehdi
+ *
+ * @return	the text
+ */
+
+char* ATResp_Join(ATResp* Resp)
+{
+    uint8_t i;
+
+    if (Resp->Size == 0)
+        return Resp->Buf;
+
+    for (i = 0; i < Resp->Lines; i++)
+        Resp->Buf[Resp->Line[i].Off + Resp->Line[i].Len] = '\n';
+
+    /* Drop a line in progress (a reply cut by the timeout) */
+    Resp->Buf[Resp->Start] = '\0';
+
+    return Resp->Buf;
+}
+
+
+/**
+ * @name    ATResp_GetLine
+ * @brief   The function returns a line of the reply, NUL terminated
+ *
+ * @author  Mehdi
+ *
+ * @return	the line, "" if Line is out of range
+ */
+
+const char* ATResp_GetLine(const ATResp* Resp, uint8_t Line)
+{
+    return (Line < Resp->Lines) ? Resp->Buf + Resp->Line[Line].Off : "";
+}
+
+
+uint16_t ATResp_LineLen(const ATResp* Resp, uint8_t Line)
+{
+    return (Line < Resp->Lines) ? Resp->Line[Line].Len : 0;
+}
+
+
+/**
+ * @name    ATResp_Find
+ * @brief   The function finds the first line, from From on, that starts with Prefix
+ *
+ * @author  Mehdi
+ *
+ * @return	the index of the line, -1 if none
+ */
+
+int8_t ATResp_Find(const ATResp* Resp, const char* Prefix, uint8_t From)
+{
+    uint16_t n = strlen(Prefix);
+    uint8_t i;
+
+    for (i = From; i < Resp->Lines; i++)
+        if (Resp->Line[i].Len >= n && strncmp(Resp->Buf + Resp->Line[i].Off, Prefix, n) == 0)
+            return i;
+
+    return -1;
+}
+
+
+/**
+ * @name    ATResp_Field
+ * @brief   The function locates a field of a line. The fields are separated
+ *              by commas and start after the "+CMD:" of an information
+ *              response; the quotes of a quoted field are not part of it.
+ *
+ * @author  Mehdi
+ *
+ * @param	Line: index of the line
+ * @param	Field: index of the field, from 0
+ * @param	Start (Out): first char of the field (not NUL terminated)
+ * @param	Len (Out): length of the field
+ * @return	1 if the field exists, 0 otherwise
+ */
+
+uint8_t ATResp_Field(const ATResp* Resp, uint8_t Line, uint8_t Field, const char** Start, uint16_t* Len)
+{
+    const char *p, *q;
+
+    if (Line >= Resp->Lines)
+        return 0;
+
+    p = Resp->Buf + Resp->Line[Line].Off;
+    if (*p == '+' && (q = strchr(p, ':')) != NULL)
+        p = q + 1;
+
+    while (1)
+    {
+        while (*p == ' ')
+            p++;
+
+        if (*p == '"')
+        {
+            q = strchr(p + 1, '"');
+            if (q == NULL)
+                return 0;
+            if (Field == 0)
+            {
+                *Start = p + 1;
+                *Len = q - p - 1;
+                return 1;
+            }
+            p = q + 1;
+        } else
+        {
+            q = p + strcspn(p, ",");
+            if (Field == 0)
+            {
+                *Start = p;
+                *Len = q - p;
+                return 1;
+            }
+            p = q;
+        }
+
+        /* The next field */
+        if ((p = strchr(p, ',')) == NULL)
+            return 0;
+        p++;
+        Field--;
+    }
+}
+
+
+/**
+ * @name    ATResp_Int
+ * @brief   The function reads a decimal field
+ *
+ * @author  Mehdi
+ *
+ * @return	1 if the field exists and is a number, 0 otherwise
+ */
+
+uint8_t ATResp_Int(const ATResp* Resp, uint8_t Line, uint8_t Field, int32_t* Value)
+{
+    const char* Start;
+    char* End;
+    uint16_t Len;
+
+    if (!ATResp_Field(Resp, Line, Field, &Start, &Len) || Len == 0)
+        return 0;
+
+    *Value = strtol(Start, &End, 10);
+
+    return End != Start;
+}
+
+
+/**
+ * @name    ATResp_Str
+ * @brief   The function copies a field, without its quotes, NUL terminated
+ *
+ * @author  Mehdi
+ *
+ * @return	1 if the field exists and fits Out, 0 otherwise
+ */
+
+uint8_t ATResp_Str(const ATResp* Resp, uint8_t Line, uint8_t Field, char* Out, uint16_t Size)
+{
+    const char* Start;
+    uint16_t Len;
+
+    if (!ATResp_Field(Resp, Line, Field, &Start, &Len) || Len >= Size)
+        return 0;
+
+    memcpy(Out, Start, Len);
+    Out[Len] = '\0';
+
+    return 1;
+}
+
+
+/**
+ * @name    ATResp_IP
+ * @brief   The function reads a dotted IPv4 address field ("a.b.c.d")
+ *
+ * @author  Mehdi
+ *
+ * @param	Ip (Out): the address, a in the most significant byte
+ * @return	1 if the field is an address, 0 otherwise
+ */
+
+uint8_t ATResp_IP(const ATResp* Resp, uint8_t Line, uint8_t Field, uint32_t* Ip)
+{
+    const char *Start, *End;
+    uint16_t Len, Part = 0;
+    uint8_t Dots = 0, Digits = 0;
+    uint32_t Value = 0;
+
+    if (!ATResp_Field(Resp, Line, Field, &Start, &Len))
+        return 0;
+
+    for (End = Start + Len; Start < End; Start++)
+    {
+        if (*Start >= '0' && *Start <= '9' && Digits < 3)
+        {
+            Part = Part * 10 + (*Start - '0');
+            Digits++;
+        } else if (*Start == '.' && Digits != 0 && Dots < 3)
+        {
+            if (Part > 255)
+                return 0;
+            Value = (Value << 8) | Part;
+            Part = Digits = 0;
+            Dots++;
+        } else
+            return 0;
+    }
+
+    if (Dots != 3 || Digits == 0 || Part > 255)
+        return 0;
+
+    *Ip = (Value << 8) | Part;
+
+    return 1;
+}
@@ -0,0 +1,69 @@
+/**
+ @file     ATResp.h
+ @brief    Collector of multi-line AT replies. The bytes up to the final
+           result code are stored in one buffer given by the caller, and
+           an index of the lines is built as they arrive: each line is
+           NUL terminated in place (its CR LF dropped) and its offset and
+           length recorded. Lines can then be read in any order, and the
+           fields of an information response ("+CMD: a,"b",c") extracted
+           from the buffer without copying it or scanning it again.
+
+ @author   Mehdi
+
+*/
+
+#ifndef ATRESP_H_
+#define ATRESP_H_
+
+#include <stdint.h>
+
+#ifndef ATRESP_MAX_LINES
+#define ATRESP_MAX_LINES			8		// Lines indexed per reply
+#endif
+
+typedef struct
+{
+    uint16_t Off;
+    uint16_t Len;
+} ATResp_Line;
+
+typedef struct
+{
+    char*       Buf;
+    uint16_t    Size;
+    uint16_t    Len;			// Bytes used, including the line in progress
+    uint16_t    Start;			// Offset of the line in progress
+    uint8_t     Lines;
+    uint8_t     Overflow;
+    ATResp_Line Line[ATRESP_MAX_LINES];
+} ATResp;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void ATResp_Init(ATResp* Resp, char* Buf, uint16_t Size);
+
+const char* ATResp_Feed(ATResp* Resp, char c);
+
+void ATResp_Drop(ATResp* Resp, const char* Line);
+
+char* ATResp_Join(ATResp* Resp);
+
+const char* ATResp_GetLine(const ATResp* Resp, uint8_t Line);
+
+uint16_t ATResp_LineLen(const ATResp* Resp, uint8_t Line);
+
+int8_t ATResp_Find(const ATResp* Resp, const char* Prefix, uint8_t From);
+
+uint8_t ATResp_Field(const ATResp* Resp, uint8_t Line, uint8_t Field, const char** Start, uint16_t* Len);
+
+uint8_t ATResp_Int(const ATResp* Resp, uint8_t Line, uint8_t Field, int32_t* Value);
+
+uint8_t ATResp_Str(const ATResp* Resp, uint8_t Line, uint8_t Field, char* Out, uint16_t Size);
+
+uint8_t ATResp_IP(const ATResp* Resp, uint8_t Line, uint8_t Field, uint32_t* Ip);
+
+
+#endif /* ATRESP_H_ */
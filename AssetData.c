@@ -0,0 +1,119 @@
+/**
+ @file     AssetData.c
+ @brief    Static assets of the HTTP server (see Assets.h), generated by
+           tools/mkassets.py from web/. Do not edit: change the pages
+           and run the script again.
+
+           2 assets, 2805 bytes, 1334 bytes stored.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+
+#include "Assets.h"
+
+// /app.js: 1939 bytes, gzip 834
+static const uint8_t Asset_0[834] =
+{
+    0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x85,0x55,0x6d,0x6f,0xd3,0x30,
+    0x10,0xfe,0xbe,0x5f,0x71,0x58,0x02,0x39,0xa2,0x74,0x05,0xc6,0x84,0x98,0x00,0x51,
+    0x28,0x6f,0xea,0x06,0xea,0x8a,0x40,0xaa,0xaa,0xca,0x4b,0x2e,0x6d,0x84,0x63,0x07,
+    0xc7,0xe9,0x36,0x4d,0xfd,0xef,0x9c,0xed,0x34,0xc9,0xda,0x22,0x3e,0xa4,0xf2,0xbd,
+    0x3d,0x77,0xbe,0x7b,0xce,0x3d,0x3e,0x86,0xef,0x5a,0xca,0x12,0x8e,0x4b,0x2b,0x6c,
+    0x55,0x82,0x50,0x09,0xa4,0x99,0xd3,0xd8,0x15,0x82,0x15,0x57,0x12,0x41,0xa7,0x5e,
+    0x88,0xb5,0xb2,0x46,0x4b,0x28,0xc4,0x12,0xfb,0x47,0x3c,0xad,0x54,0x6c,0x33,0xad,
+    0x80,0x47,0x70,0x77,0x04,0xc0,0xaa,0x12,0xa1,0xb4,0x26,0x8b,0x2d,0x3b,0x3b,0x22,
+    0xc5,0x5a,0x18,0xf8,0x3e,0x9a,0x7c,0xf9,0xf6,0x61,0x71,0x7e,0x09,0xaf,0xe1,0xc5,
+    0x60,0x30,0x68,0x0c,0xe3,0x77,0xc3,0xd1,0xd8,0x69,0x67,0xa4,0x00,0x98,0xb1,0xaa,
+    0xb0,0x59,0x8e,0x8b,0x92,0xf5,0x80,0xfd,0xf0,0x67,0x3a,0x05,0xe5,0xbc,0x57,0xfb,
+    0x98,0xb2,0xcc,0x16,0xc9,0x55,0xee,0x7c,0x7e,0x66,0x4f,0x3e,0x66,0x50,0x66,0x4b,
+    0x25,0x24,0xc9,0x6d,0x35,0x6b,0x2a,0x07,0x0c,0xda,0xca,0x28,0x58,0xc3,0x63,0x60,
+    0x90,0x0c,0x73,0x76,0x06,0x9b,0x06,0x26,0xd6,0x79,0x4e,0xf7,0xf4,0xa9,0xde,0x4d,
+    0xa1,0x23,0x5e,0x52,0xf9,0x6a,0xd9,0x38,0xa6,0x22,0x93,0x95,0x41,0xef,0xf8,0x91,
+    0xce,0x98,0xec,0x3b,0xf7,0xc0,0x9a,0xaa,0x2d,0xd1,0xd5,0xab,0x2b,0xeb,0x43,0xa6,
+    0x74,0x4e,0x80,0xa4,0xff,0x46,0x99,0x9b,0x85,0x5e,0xa3,0x49,0xa5,0xbe,0xf6,0x91,
+    0x93,0x5f,0xd0,0x95,0x0f,0xc7,0x60,0xec,0x7c,0xb2,0x50,0xde,0x38,0x53,0xbf,0xe1,
+    0x9e,0x6a,0xe7,0x2e,0xd4,0x91,0xad,0xef,0x24,0xb8,0xdd,0x42,0xab,0x3b,0x98,0x61,
+    0x99,0xad,0xb1,0x2a,0xba,0x21,0xe4,0x0c,0x4e,0xab,0x68,0x32,0xff,0x8a,0x2a,0xb4,
+    0x96,0x8b,0x02,0xc5,0x6f,0x17,0x37,0xac,0xd2,0x14,0x0d,0x38,0x1d,0xd4,0xba,0x9d,
+    0xba,0xbc,0x7b,0xea,0x9b,0xbb,0x1b,0xd0,0x69,0xff,0xbd,0x4c,0x14,0x39,0xf7,0x44,
+    0x6a,0x86,0x1e,0x78,0xc2,0xcb,0xc0,0xc4,0xc0,0xb0,0x84,0xc8,0x75,0x2e,0xec,0xaa,
+    0x4f,0x5d,0xd4,0x86,0x13,0xc5,0xe1,0xe5,0xe9,0xc9,0x60,0x10,0xf5,0x60,0xb5,0x6f,
+    0x7a,0x7e,0x4a,0x16,0x78,0x08,0xcf,0x4e,0x7a,0x90,0xef,0x9b,0x4f,0xbd,0xf1,0x94,
+    0xf8,0xeb,0xe0,0x6b,0x76,0xf1,0x04,0xde,0x52,0x1a,0x4f,0x31,0xfa,0x5e,0x01,0x63,
+    0x11,0x49,0x2b,0xaf,0x59,0xd1,0xf7,0x98,0xa0,0xdc,0x39,0xcf,0x14,0x73,0x91,0x9b,
+    0x7b,0x45,0x1b,0x54,0x09,0x12,0xbc,0x5f,0xbc,0x6e,0xe5,0x61,0xeb,0x5e,0x43,0xa2,
+    0xe3,0x2a,0x47,0x65,0xfb,0x4b,0xb4,0x23,0x89,0xee,0x38,0xbc,0xfd,0x92,0x70,0x16,
+    0x42,0x58,0x14,0xaa,0xf1,0xee,0x7d,0x8b,0x37,0xf6,0x3d,0x6d,0x28,0x39,0x51,0x28,
+    0x0b,0x2b,0x08,0xf5,0x9e,0xf5,0x53,0x6d,0x46,0x22,0x5e,0x75,0x96,0x56,0x6e,0x33,
+    0x02,0x64,0x29,0xf0,0x07,0x5c,0xce,0x06,0x73,0xc8,0x14,0xd4,0xf5,0x44,0xb5,0x71,
+    0x7b,0xdb,0xb3,0x5a,0x76,0x05,0x1a,0x7d,0x4d,0x39,0x42,0xde,0x4c,0x95,0x68,0xec,
+    0x44,0x5f,0x73,0x6a,0xec,0x5a,0xc8,0xca,0x55,0x4e,0x0e,0xb5,0xe1,0x3d,0x4a,0xc9,
+    0x9f,0x46,0xdb,0xe8,0x1d,0xc3,0x20,0xda,0xa9,0x5b,0xce,0x9e,0xce,0xdb,0x4c,0x04,
+    0xb6,0x67,0x7f,0x36,0xaf,0x3b,0x36,0x73,0x05,0xcf,0x1b,0x64,0x77,0x09,0x39,0x7b,
+    0x3e,0x87,0x47,0x8f,0xa0,0xeb,0x00,0x6f,0x60,0xd0,0xde,0x25,0x60,0xc6,0x52,0x94,
+    0xe5,0x85,0xc8,0x5d,0xa9,0xec,0x4a,0x24,0x2c,0x80,0x6c,0xa2,0xfd,0x21,0x15,0xf4,
+    0x3a,0xf2,0xee,0x70,0x1c,0xf6,0x7f,0x87,0x83,0xdb,0xd9,0xb8,0x88,0x9b,0x95,0x21,
+    0x7f,0x85,0xd7,0xf0,0xeb,0x7c,0xfc,0xd9,0xda,0x62,0x82,0x7f,0x2a,0x2c,0x2d,0x8f,
+    0xea,0x19,0x91,0x43,0x5f,0x17,0xa8,0x38,0xfb,0x34,0x9a,0xba,0x25,0x38,0xbe,0x3f,
+    0x60,0x67,0xaf,0xdf,0x15,0x02,0x6a,0x9e,0xd4,0xd6,0xa8,0x95,0xd4,0xc2,0xf1,0x7d,
+    0xf7,0x4d,0xf6,0xf4,0xa0,0x45,0xbf,0xeb,0x0c,0xd3,0x93,0xee,0xeb,0xe5,0xb7,0x8b,
+    0x7e,0x21,0x4c,0x89,0xdc,0x01,0xd0,0x92,0x15,0x9a,0xc6,0x32,0xa5,0x66,0x47,0x4d,
+    0x4b,0x21,0x5c,0x76,0x97,0x5a,0x3f,0x8a,0x84,0xb4,0x89,0xe7,0xb7,0xbb,0xd5,0x07,
+    0x92,0x38,0x0d,0x52,0x8f,0x75,0x2c,0x24,0xba,0x57,0x2f,0xac,0x2b,0x6f,0x90,0x36,
+    0x10,0x0b,0x1b,0xaf,0x80,0x63,0xd4,0xa9,0xe5,0x20,0xfa,0x90,0x2e,0x62,0xb0,0x90,
+    0xb7,0x90,0x1a,0x9d,0xfb,0x3f,0x1e,0xa5,0x13,0x64,0x0d,0x54,0x18,0x55,0xf7,0xf2,
+    0x68,0x8c,0x76,0x2d,0x0e,0x52,0xdb,0xa9,0x43,0xdd,0x38,0x98,0xf3,0x82,0x12,0x50,
+    0x16,0x4b,0x89,0x69,0x49,0x1c,0xad,0xb7,0x8c,0xd8,0xed,0x31,0x75,0xef,0x5f,0xc0,
+    0x68,0xa7,0x21,0x33,0x77,0x9c,0xe9,0xb5,0x73,0x8a,0xf6,0xb0,0x4a,0x82,0xe1,0x2d,
+    0xd9,0x02,0xc7,0xce,0x8e,0x36,0x91,0xfb,0xfd,0x0b,0x05,0x31,0x99,0xb7,0x93,0x07,
+    0x00,0x00,
+};
+
+// /index.html: 866 bytes, gzip 500
+static const uint8_t Asset_1[500] =
+{
+    0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x6d,0x93,0xcb,0xb2,0xd3,0x30,
+    0x0c,0x86,0xf7,0x7d,0x0a,0x91,0x6e,0xc9,0xa5,0x85,0x96,0x43,0x2e,0xdd,0x00,0x3b,
+    0x06,0xce,0x82,0x0d,0x4b,0x25,0x76,0x12,0x83,0x63,0x67,0x6c,0xa7,0x3d,0x85,0xe1,
+    0xdd,0x91,0xd2,0xa4,0x53,0x66,0x98,0x2c,0x94,0xfc,0xd6,0xf7,0x5b,0x96,0x95,0xf2,
+    0xd5,0xc7,0xaf,0x1f,0xbe,0x7d,0x7f,0xfe,0x04,0x7d,0x18,0xf4,0x69,0x53,0x72,0x00,
+    0x8d,0xa6,0xab,0x22,0x69,0x22,0x16,0x24,0x0a,0x0a,0x83,0x0c,0x08,0x4d,0x8f,0xce,
+    0xcb,0x50,0x45,0x53,0x68,0xe3,0xa7,0x68,0x95,0x0d,0x0e,0xb2,0x8a,0xce,0x4a,0x5e,
+    0x46,0xeb,0x42,0x04,0x8d,0x35,0x41,0x1a,0x4a,0xbb,0x28,0x11,0xfa,0x4a,0xc8,0xb3,
+    0x6a,0x64,0x3c,0x7f,0xbc,0x06,0x65,0x54,0x50,0xa8,0x63,0xdf,0xa0,0x96,0xd5,0x8e,
+    0x4d,0x82,0x0a,0x5a,0x9e,0xbe,0x58,0x21,0xc1,0x07,0x0c,0x93,0x2f,0xd3,0x9b,0xb4,
+    0x29,0x7d,0xb8,0x72,0x04,0xa8,0xad,0xb8,0xc2,0x6f,0x68,0xc9,0x3a,0x6e,0x71,0x50,
+    0xfa,0x9a,0x83,0x47,0xe3,0x63,0x2f,0x9d,0x6a,0x0b,0x18,0xd0,0x75,0xca,0xe4,0xb0,
+    0x4b,0x0e,0x72,0x28,0xa8,0x04,0x6d,0x5d,0x0e,0xdb,0xfd,0x7e,0x5f,0x40,0x8d,0xcd,
+    0xcf,0xce,0xd9,0xc9,0x08,0x52,0x5a,0xe4,0xa7,0x80,0x3f,0x64,0xda,0xef,0x56,0x4b,
+    0xaf,0x7e,0x49,0x86,0xdf,0x32,0x7c,0xf3,0x8a,0x6b,0x1b,0x82,0x1d,0x72,0xc8,0x92,
+    0x3d,0xab,0x0c,0x6c,0xb9,0x3e,0x49,0xd0,0xea,0x7f,0x3c,0x1e,0x8b,0x47,0x87,0x2c,
+    0x79,0xff,0x1f,0x87,0xdd,0xca,0x07,0xac,0x35,0xe3,0xb5,0x75,0x42,0xba,0x98,0x5c,
+    0x34,0x8e,0x9e,0xb8,0xf5,0x8d,0x50,0xe2,0xe6,0x56,0x11,0xf6,0x74,0xe7,0x04,0x41,
+    0x23,0x0a,0xa1,0x4c,0xc7,0x9b,0xbc,0xa1,0x43,0x52,0x98,0xd7,0x17,0xaf,0xfb,0x5e,
+    0xe3,0x0b,0x78,0xab,0x95,0x80,0xad,0x10,0x62,0xc5,0xf3,0x56,0x39,0x1f,0xe2,0xa6,
+    0x57,0x5a,0x3c,0x94,0x7f,0x38,0x1c,0xee,0x19,0x1a,0x1f,0x12,0x82,0x7c,0x09,0x31,
+    0x6a,0xd5,0x51,0x4b,0x9d,0xea,0xfa,0xb0,0x9c,0xf2,0x8c,0x4e,0x21,0x45,0x33,0x0d,
+    0xd4,0xf7,0x26,0xe7,0x13,0x4d,0x1a,0x1d,0x0b,0xfe,0x66,0x95,0xd4,0xf8,0xb8,0x45,
+    0x9d,0x65,0xd9,0x3e,0x5b,0xf0,0x8b,0x64,0xaf,0x9c,0x6a,0xd6,0x4b,0x69,0xf8,0x90,
+    0x9a,0xd5,0x87,0x77,0x22,0x63,0xbd,0x4c,0x97,0x8b,0x2f,0xd3,0x65,0xfe,0xf8,0xfe,
+    0x79,0x1a,0x77,0xff,0xce,0x09,0x7d,0x6f,0x4a,0xa1,0xce,0xa0,0x44,0x15,0xcd,0x97,
+    0x13,0x9d,0x3e,0x5b,0xe4,0x3e,0x25,0x49,0x52,0xa6,0xb4,0xc4,0x03,0x36,0xb7,0x7d,
+    0x4d,0x99,0x7c,0x74,0xa2,0x09,0x63,0x8d,0xd6,0xc6,0x53,0x89,0xd0,0x3b,0xd9,0x56,
+    0x51,0x4a,0xd3,0x4c,0x87,0xa2,0xe5,0x67,0x67,0xe9,0xbd,0x97,0x93,0x87,0x45,0x2b,
+    0x53,0x24,0x68,0xe4,0x91,0x6c,0x9c,0x1a,0x03,0x78,0xd7,0x10,0x81,0xe3,0x98,0xfc,
+    0x98,0xfd,0x6e,0x32,0x57,0xbc,0x94,0x9a,0xde,0xfe,0xa8,0xbf,0xfe,0xef,0x53,0xf0,
+    0x62,0x03,0x00,0x00,
+};
+
+const Asset Asset_Table[] =
+{
+    { "/app.js", "application/javascript", "\"100a58ba248f\"", Asset_0, 834, 1939, 1 },
+    { "/index.html", "text/html; charset=utf-8", "\"dc919c4ae88c\"", Asset_1, 500, 866, 1 },
+};
+
+const uint8_t Asset_Count = sizeof(Asset_Table) / sizeof(Asset_Table[0]);
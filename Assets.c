@@ -0,0 +1,235 @@
+/**
+ @file     Assets.c
+ @brief    This file contains the serving path of the static assets. The
+           header and the first part of the body go out in one AT+CIPSEND
+           from a buffer pool block; the rest of the body is sent straight
+           from flash in windows of ESP_SEND_MAX bytes, without a copy.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "Assets.h"
+#include "ESP8266.h"
+#include "BufPool.h"
+
+
+#define ASSET_BLOCK_LEN		BUFPOOL_LARGE_SIZE
+
+#define ASSET_HEADER_200	"HTTP/1.1 200 OK\r\n"							\
+                            "Content-Type: %s\r\n"							\
+                            "%s"											\
+                            "Content-Length: %lu\r\n"						\
+                            "ETag: %s\r\n"									\
+                            "Cache-Control: no-cache\r\n"					\
+                            "Connection: close\r\n\r\n"
+
+#define ASSET_HEADER_304	"HTTP/1.1 304 Not Modified\r\n"					\
+                            "ETag: %s\r\n"									\
+                            "Cache-Control: no-cache\r\n"					\
+                            "Connection: close\r\n\r\n"
+
+
+/**
+ * @name    Asset_Header
+ * @brief   The function finds a header of a request (the name is not
+ *              case sensitive)
+ *
+ * @author  Mehdi
+ *
+ * @param	Name: the header name, without the colon
+ * @param	Value (Out): start of the value, leading spaces skipped
+ * @return  Length of the value, or -1 if the request does not carry it
+ */
+
+static int16_t Asset_Header(const char* Request, uint16_t Len, const char* Name, const char** Value)
+{
+    const char* End = Request + Len;
+    const char *p = Request, *Eol;
+    uint16_t n = strlen(Name), i;
+
+    while (p < End)
+    {
+        /* The next line */
+        for (Eol = p; Eol < End && *Eol != '\r' && *Eol != '\n'; Eol++)
+            ;
+
+        if (Eol - p > n && p[n] == ':')
+        {
+            for (i = 0; i < n && tolower((unsigned char)p[i]) == tolower((unsigned char)Name[i]); i++)
+                ;
+            if (i == n)
+            {
+                for (p += n + 1; p < Eol && *p == ' '; p++)
+                    ;
+                *Value = p;
+                return Eol - p;
+            }
+        }
+
+        for (p = Eol; p < End && (*p == '\r' || *p == '\n'); p++)
+            ;
+    }
+
+    return -1;
+}
+
+
+/**
+ * @name    Asset_Match
+ * @brief   The function tells whether If-None-Match names the ETag: "*",
+ *              or the ETag in the list, weak (W/"...") or not
+ *
+ * @author  Mehdi
+ */
+
+static uint8_t Asset_Match(const char* Request, uint16_t Len, const char* ETag)
+{
+    const char* Value;
+    int16_t n = Asset_Header(Request,Len,"If-None-Match",&Value);
+    uint16_t e = strlen(ETag), i;
+
+    if (n == 1 && Value[0] == '*')
+        return 1;
+
+    for (i = 0; n >= e && i <= n - e; i++)
+        if (memcmp(Value + i,ETag,e) == 0)
+            return 1;
+
+    return 0;
+}
+
+
+/**
+ * @name    Asset_Find
+ * @brief   The function finds the asset of a path ("/" is ASSET_INDEX)
+ *
+ * @author  Mehdi
+ *
+ * @param	Path: the path, not NUL terminated
+ * @param	Len: its length
+ * @return  The asset, or NULL
+ */
+
+const Asset* Asset_Find(const char* Path, uint16_t Len)
+{
+    uint8_t i;
+
+    if (Len == 1 && Path[0] == '/')
+    {
+        Path = ASSET_INDEX;
+        Len = sizeof(ASSET_INDEX) - 1;
+    }
+
+    for (i = 0; i < Asset_Count; i++)
+    {
+        if (strlen(Asset_Table[i].Path) == Len && memcmp(Asset_Table[i].Path,Path,Len) == 0)
+            return &Asset_Table[i];
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @name    Asset_Send
+ * @brief   The function answers a request with an asset, or with 304 Not
+ *              Modified when the client holds it, then closes the link
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link of the request
+ * @param	A: the asset
+ * @param	Request: the request (its headers are searched for If-None-Match)
+ * @param	Len: length of Request
+ * @return  ESP8266_OK or ESP8266_FAIL
+ */
+
+int8_t Asset_Send(uint8_t Link, const Asset* A, const char* Request, uint16_t Len)
+{
+    char Id[4];
+    char* Buf;
+    uint32_t Body, Off;
+    uint16_t Head, n;
+    int8_t res;
+
+    if ((Buf = BufPool_Get(ASSET_BLOCK_LEN,BUFPOOL_ESP)) == NULL)
+        return ESP8266_FAIL;
+
+    if (Asset_Match(Request,Len,A->ETag))
+    {
+        Head = snprintf(Buf,ASSET_BLOCK_LEN,ASSET_HEADER_304,A->ETag);
+        Body = 0;
+    } else
+    {
+        Head = snprintf(Buf,ASSET_BLOCK_LEN,ASSET_HEADER_200,A->Type,
+                        A->Gzip ? "Content-Encoding: gzip\r\n" : "",(unsigned long)A->Len,A->ETag);
+        Body = A->Len;
+    }
+
+    if (Head >= ASSET_BLOCK_LEN)
+    {
+        BufPool_Put(Buf);
+        return ESP8266_FAIL;
+    }
+
+    // The first part of the body joins the header: one CIPSEND less
+    n = ASSET_BLOCK_LEN - Head;
+    if (Body < n)
+        n = Body;
+    memcpy(Buf + Head,A->Data,n);
+    res = ESP_SendData(Link,(const uint8_t*)Buf,Head + n);
+    BufPool_Put(Buf);
+
+    // The rest straight from flash
+    for (Off = n; res == ESP8266_OK && Off < Body; Off += n)
+    {
+        n = (Body - Off < ESP_SEND_MAX) ? Body - Off : ESP_SEND_MAX;
+        res = ESP_SendData(Link,A->Data + Off,n);
+    }
+
+    if (res != ESP8266_OK)
+        return ESP8266_FAIL;
+
+    snprintf(Id,sizeof(Id),"%u",Link);
+
+    return ESP_SendCloseCommand(Id);
+}
+
+
+/**
+ * @name    Asset_Serve
+ * @brief   The function answers a GET request for a static asset
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link of the request (+IPD,<link>)
+ * @param	Request: the data of the request
+ * @param	Len: length of Request
+ * @return  0 if no asset has the path, otherwise ESP8266_OK or ESP8266_FAIL
+ */
+
+int8_t Asset_Serve(uint8_t Link, const char* Request, uint16_t Len)
+{
+    const Asset* A;
+    uint16_t n;
+
+    if (Len < 5 || memcmp(Request,"GET ",4) != 0)
+        return 0;
+
+    // The path ends at the query or at the protocol
+    for (n = 4; n < Len && Request[n] != ' ' && Request[n] != '?' && Request[n] != '\r'; n++)
+        ;
+
+    if ((A = Asset_Find(Request + 4,n - 4)) == NULL)
+        return 0;
+
+    return Asset_Send(Link,A,Request,Len);
+}
@@ -0,0 +1,58 @@
+/**
+ @file     Assets.h
+ @brief    Static assets of the ESP8266 HTTP server (control page, scripts)
+           kept in flash gzip-compressed. tools/mkassets.py builds the
+           table (AssetData.c) from the web directory: each body is gzipped
+           once at build time and stored with its length and an ETag, so
+           serving a page costs no RAM copy and no compression at run time,
+           and the UART carries the compressed body only.
+
+           A request whose If-None-Match holds the ETag of the asset is
+           answered with 304 Not Modified and no body. The assets are sent
+           with Cache-Control: no-cache, so a client revalidates each load
+           and a page changed by a firmware update is fetched again.
+
+           The bodies are sent with Content-Encoding: gzip whatever the
+           Accept-Encoding of the request: the firmware has no inflater.
+
+ @author   Mehdi
+
+*/
+
+#ifndef ASSETS_H_
+#define ASSETS_H_
+
+#include <stdint.h>
+
+// Configuration
+#ifndef ASSET_INDEX
+#define ASSET_INDEX					"/index.html"	// Asset of "/"
+#endif
+
+typedef struct
+{
+    const char*    Path;			// "/index.html"
+    const char*    Type;			// Content-Type
+    const char*    ETag;			// Quoted: "\"<hash>\""
+    const uint8_t* Data;			// The body as sent
+    uint32_t       Len;
+    uint32_t       RawLen;			// Length before compression
+    uint8_t        Gzip;			// 0: stored as is (compression did not pay)
+} Asset;
+
+extern const Asset   Asset_Table[];
+extern const uint8_t Asset_Count;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+const Asset* Asset_Find(const char* Path, uint16_t Len);
+
+int8_t Asset_Send(uint8_t Link, const Asset* A, const char* Request, uint16_t Len);
+
+int8_t Asset_Serve(uint8_t Link, const char* Request, uint16_t Len);
+
+
+#endif /* ASSETS_H_ */
@@ -13,7 +13,7 @@
 
 #include "AuxLib.h"
 #include "tm_stm32_hd44780.h"
-#include "tm_stm32_delay.h"
+#include "stm32f4xx_hal.h"
 
 
 /**
@@ -120,13 +120,10 @@ char* Concat(char* str1, char* str2)
 
 void Halt(void)
 {
-	volatile int j;
-
 	TM_HD44780_Clear();
 	TM_HD44780_Puts(5,1,"E R R O R");
+
+	/* Sleep between the interrupts instead of spinning */
 	while(1)
-	{
-		Delayms(3000);
-		j++;
-	}
+		__WFI();
 }
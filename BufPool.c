@@ -0,0 +1,209 @@
+/**
+ @file     BufPool.c
+ @brief    This file contains the static buffer pool. The blocks of a
+           class are found by a linear scan of its owner tags; with a
+           handful of blocks this is cheaper than a free list and keeps
+           the tags usable for leak checks.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stddef.h>
+
+#include "BufPool.h"
+
+
+typedef char BufPool_FitsBudget[(BUFPOOL_BYTES <= BUFPOOL_BUDGET) ? 1 : -1];
+
+typedef struct
+{
+    uint8_t* Mem;
+    uint8_t* Owner;
+    uint16_t Size;
+    uint8_t  Count;
+} BufPool_Class;
+
+static uint8_t BufPool_SmallMem[BUFPOOL_SMALL_COUNT][BUFPOOL_SMALL_SIZE];
+static uint8_t BufPool_LargeMem[BUFPOOL_LARGE_COUNT][BUFPOOL_LARGE_SIZE];
+static uint8_t BufPool_SmallOwner[BUFPOOL_SMALL_COUNT];
+static uint8_t BufPool_LargeOwner[BUFPOOL_LARGE_COUNT];
+
+static const BufPool_Class BufPool_Classes[BUFPOOL_CLASSES] =
+{
+    { &BufPool_SmallMem[0][0], BufPool_SmallOwner, BUFPOOL_SMALL_SIZE, BUFPOOL_SMALL_COUNT },
+    { &BufPool_LargeMem[0][0], BufPool_LargeOwner, BUFPOOL_LARGE_SIZE, BUFPOOL_LARGE_COUNT },
+};
+
+static BufPool_Stat BufPool_Stats[BUFPOOL_CLASSES];
+
+
+/**
+ * @name    BufPool_Find
+ * @brief   The function finds the class and index of a block
+ *
+ * @author  Mehdi
+ *
+ * @return	the class, or NULL if Buf is not a block of the pool
+ */
+
+static const BufPool_Class* BufPool_Find(const void* Buf, uint8_t* Index)
+{
+    const uint8_t* p = (const uint8_t*)Buf;
+    uint8_t c;
+
+    for (c = 0; c < BUFPOOL_CLASSES; c++)
+    {
+        const BufPool_Class* Class = &BufPool_Classes[c];
+
+        if (p >= Class->Mem && p < Class->Mem + (uint32_t)Class->Size * Class->Count)
+        {
+            *Index = (p - Class->Mem) / Class->Size;
+            return Class;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @name    BufPool_Get
+ * @brief   The function takes the smallest free block of at least Size bytes
+ *
+ * @author  Mehdi
+ *
+ * @param	Size: bytes needed
+ * @param	Owner: tag of the new owner (BUFPOOL_xxx)
+ * @return	the block, or NULL if none is free
+ */
+
+void* BufPool_Get(uint16_t Size, uint8_t Owner)
+{
+    uint8_t c, i, first = BUFPOOL_CLASSES;
+
+    for (c = 0; c < BUFPOOL_CLASSES; c++)
+    {
+        const BufPool_Class* Class = &BufPool_Classes[c];
+        BufPool_Stat* Stat = &BufPool_Stats[c];
+
+        if (Size > Class->Size)
+            continue;
+
+        if (first == BUFPOOL_CLASSES)
+            first = c;
+
+        /* When the class is full a larger one may still have a block */
+        for (i = 0; i < Class->Count; i++)
+        {
+            if (Class->Owner[i] == BUFPOOL_FREE)
+            {
+                Class->Owner[i] = Owner;
+                Stat->Gets++;
+                if (++Stat->InUse > Stat->Peak)
+                    Stat->Peak = Stat->InUse;
+
+                return Class->Mem + (uint32_t)i * Class->Size;
+            }
+        }
+    }
+
+    BufPool_Stats[(first < BUFPOOL_CLASSES) ? first : BUFPOOL_CLASSES - 1].Failed++;
+
+    return NULL;
+}
+
+
+/**
+ * @name    BufPool_Put
+ * @brief   The function returns a block to the pool (NULL is ignored)
+ *
+ * @author  Mehdi
+ */
+
+void BufPool_Put(void* Buf)
+{
+    const BufPool_Class* Class;
+    uint8_t i;
+
+    if (Buf == NULL || (Class = BufPool_Find(Buf, &i)) == NULL || Class->Owner[i] == BUFPOOL_FREE)
+        return;
+
+    Class->Owner[i] = BUFPOOL_FREE;
+    BufPool_Stats[Class - BufPool_Classes].InUse--;
+}
+
+
+/**
+ * @name    BufPool_Give
+ * @brief   The function hands a block to another owner, e.g. a reply read
+ *              by a driver to the parser that releases it
+ *
+ * @author  Mehdi
+ */
+
+void BufPool_Give(void* Buf, uint8_t Owner)
+{
+    const BufPool_Class* Class;
+    uint8_t i;
+
+    if (Buf != NULL && Owner != BUFPOOL_FREE && (Class = BufPool_Find(Buf, &i)) != NULL &&
+        Class->Owner[i] != BUFPOOL_FREE)
+        Class->Owner[i] = Owner;
+}
+
+
+/**
+ * @name    BufPool_Owner
+ * @brief   The function returns the owner of a block
+ *
+ * @author  Mehdi
+ *
+ * @return	BUFPOOL_xxx, BUFPOOL_FREE if Buf is free or not a block
+ */
+
+uint8_t BufPool_Owner(const void* Buf)
+{
+    const BufPool_Class* Class;
+    uint8_t i;
+
+    if (Buf == NULL || (Class = BufPool_Find(Buf, &i)) == NULL)
+        return BUFPOOL_FREE;
+
+    return Class->Owner[i];
+}
+
+
+/**
+ * @name    BufPool_Size
+ * @brief   The function returns the usable size of a block
+ *
+ * @author  Mehdi
+ */
+
+uint16_t BufPool_Size(const void* Buf)
+{
+    const BufPool_Class* Class;
+    uint8_t i;
+
+    if (Buf == NULL || (Class = BufPool_Find(Buf, &i)) == NULL)
+        return 0;
+
+    return Class->Size;
+}
+
+
+/**
+ * @name    BufPool_GetStat
+ * @brief   The function returns the counters of a class
+ *
+ * @author  Mehdi
+ *
+ * @param	Class: BUFPOOL_SMALL or BUFPOOL_LARGE
+ */
+
+const BufPool_Stat* BufPool_GetStat(uint8_t Class)
+{
+    return &BufPool_Stats[(Class < BUFPOOL_CLASSES) ? Class : 0];
+}
@@ -0,0 +1,84 @@
+/**
+ @file     BufPool.h
+ @brief    Static pool of the transient buffers of the drivers (replies,
+           PDUs, formatted commands). Blocks of two fixed sizes are
+           allocated at compile time; a request takes the smallest free
+           block that fits. Each block carries the tag of its owner so a
+           buffer filled by the RX side can be handed to a parser with
+           BufPool_Give, and the owner of a leaked block can be found.
+
+           The sizes and counts can be set from the build; the pool must
+           fit BUFPOOL_BUDGET or the build fails.
+
+ @author   Mehdi
+
+*/
+
+#ifndef BUFPOOL_H_
+#define BUFPOOL_H_
+
+#include <stdint.h>
+
+// Configuration
+#ifndef BUFPOOL_SMALL_SIZE
+#define BUFPOOL_SMALL_SIZE			128		// A reply line, a formatted command
+#endif
+
+#ifndef BUFPOOL_SMALL_COUNT
+#define BUFPOOL_SMALL_COUNT			4
+#endif
+
+#ifndef BUFPOOL_LARGE_SIZE
+#define BUFPOOL_LARGE_SIZE			384		// A multi-line reply, an SMS PDU
+#endif
+
+#ifndef BUFPOOL_LARGE_COUNT
+#define BUFPOOL_LARGE_COUNT			2
+#endif
+
+#ifndef BUFPOOL_BUDGET
+#define BUFPOOL_BUDGET				2048	// Bytes of RAM the pool may take
+#endif
+
+#define BUFPOOL_BYTES				(BUFPOOL_SMALL_SIZE * BUFPOOL_SMALL_COUNT + BUFPOOL_LARGE_SIZE * BUFPOOL_LARGE_COUNT)
+
+// Owners
+#define BUFPOOL_FREE				0
+#define BUFPOOL_ESP					1		// ESP8266 driver
+#define BUFPOOL_FASTJOIN			2
+#define BUFPOOL_SIM					3		// SIM900 driver
+#define BUFPOOL_SMS					4		// SMS queue and reassembly
+#define BUFPOOL_APP					5
+
+// Classes
+#define BUFPOOL_SMALL				0
+#define BUFPOOL_LARGE				1
+#define BUFPOOL_CLASSES				2
+
+typedef struct
+{
+    uint16_t Gets;
+    uint16_t Failed;			// Requests that found no free block
+    uint8_t  InUse;
+    uint8_t  Peak;				// Most blocks in use at the same time
+} BufPool_Stat;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void* BufPool_Get(uint16_t Size, uint8_t Owner);
+
+void BufPool_Put(void* Buf);
+
+void BufPool_Give(void* Buf, uint8_t Owner);
+
+uint8_t BufPool_Owner(const void* Buf);
+
+uint16_t BufPool_Size(const void* Buf);
+
+const BufPool_Stat* BufPool_GetStat(uint8_t Class);
+
+
+#endif /* BUFPOOL_H_ */
@@ -10,110 +10,537 @@
 */
 
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 #include "stm32f4xx_hal.h"
 
-#include "tm_stm32_usart.h"
-#include "tm_stm32_hd44780.h"
-#include "tm_stm32_delay.h"
+#include "Transport.h"
 
 #include "ESP8266.h"
 #include "AuxLib.h"
+#include "StatusSink.h"
+#include "LinkSup.h"
+#include "FastJoin.h"
+#include "ATCmd.h"
+#include "ATEngine.h"
+#include "BufPool.h"
+#include "TimeBase.h"
 
 
 
 USART_TypeDef* USART_ESP;
+uint8_t ESP_LastFault;      // Class of the last failure, see LinkSup.h
+static uint32_t ESP_BootMs;  // Duration of the last ESP_SET
+
+#define ESP_RX_MASK						(ESP_RX_BUF - 1)
+#define ESP_RX_CLOSED					0x80	// Link byte of a "<link>,CLOSED" record
+#define ESP_NO_LINK						0xFF
+
+static ATEngine ESP_Eng;
+static char ESP_Line[ESP_LINE_LEN];     // Final line of the replies not kept
+
+static uint8_t ESP_Rx[ESP_RX_BUF];      // Frames received during a command (see ESP_RX_BUF)
+static uint16_t ESP_RxHead, ESP_RxTail; // Free running
+static uint8_t ESP_Closing = ESP_NO_LINK;   // Link of the AT+CIPCLOSE under way
+
+
+/**
+ * @name    ESP_ParseIPD
+ * @brief   The function reads the header of a frame:
+ *              +IPD,<link>,<len>, or +IPD,<len> when AT+CIPMUX=0
+ *
+ * @author  Mehdi
+ *
+ * @param	Head: the header, up to the ':' (excluded or not)
+ * @param	Link (Out): the link
+ * @param	Len (Out): the length of the data
+ * @return  1, or 0 if Head is not a +IPD header
+ */
+
+static uint8_t ESP_ParseIPD(const char* Head, uint8_t* Link, uint16_t* Len)
+{
+    const char* p;
+
+    if (strncmp(Head,"+IPD,",5) != 0)
+        return 0;
+
+    if ((p = strchr(Head + 5,',')) != NULL)
+    {
+        *Link = atoi(Head + 5);
+        *Len = atoi(p + 1);
+    } else
+    {
+        *Link = 0;
+        *Len = atoi(Head + 5);
+    }
+
+    return 1;
+}
+
+
+/**
+ * @name    ESP_ClosedLink
+ * @brief   The function tells whether a line is a link close: "<link>,CLOSED"
+ *
+ * @author  Mehdi
+ *
+ * @return  The link, or -1
+ */
+
+static int16_t ESP_ClosedLink(const char* Line)
+{
+    const char* p;
+
+    if (!isdigit((unsigned char)Line[0]) || (p = strchr(Line,',')) == NULL || strcmp(p,",CLOSED") != 0)
+        return -1;
+
+    return atoi(Line);
+}
+
+
+static uint16_t ESP_RxFree(void)
+{
+    return ESP_RX_BUF - (uint16_t)(ESP_RxHead - ESP_RxTail);
+}
+
+
+/**
+ * @name    ESP_RxCommit
+ * @brief   The function ends a record of the frame buffer: its header is
+ *              written in front of the data already stored behind ESP_RxHead
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: the link, with ESP_RX_CLOSED for a close
+ * @param	Len: length of the data
+ */
+
+static void ESP_RxCommit(uint8_t Link, uint16_t Len)
+{
+    ESP_Rx[ESP_RxHead & ESP_RX_MASK] = Link;
+    ESP_Rx[(ESP_RxHead + 1) & ESP_RX_MASK] = Len & 0xFF;
+    ESP_Rx[(ESP_RxHead + 2) & ESP_RX_MASK] = Len >> 8;
+
+    ESP_RxHead += 3 + Len;
+}
+
+
+static uint16_t ESP_RxLen(uint16_t Off)
+{
+    return ESP_Rx[(Off + 1) & ESP_RX_MASK] | (ESP_Rx[(Off + 2) & ESP_RX_MASK] << 8);
+}
+
+
+/**
+ * @name    ESP_RxPurge
+ * @brief   The function removes the records of a link from the frame
+ *              buffer; the others keep their order
+ *
+ * @author  Mehdi
+ */
+
+static void ESP_RxPurge(uint8_t Link)
+{
+    uint16_t From = ESP_RxTail, To = ESP_RxTail, Len, i;
+
+    while (From != ESP_RxHead)
+    {
+        Len = 3 + ESP_RxLen(From);
+
+        if ((ESP_Rx[From & ESP_RX_MASK] & ~ESP_RX_CLOSED) != Link)
+        {
+            for (i = 0; i < Len && To != From; i++)
+                ESP_Rx[(To + i) & ESP_RX_MASK] = ESP_Rx[(From + i) & ESP_RX_MASK];
+            To += Len;
+        }
+        From += Len;
+    }
+
+    ESP_RxHead = To;
+}
+
+
+/**
+ * @name    ESP_ReadData
+ * @brief   The function reads the data of a frame whose header was read
+ *
+ * @author  Mehdi
+ *
+ * @param	Data (Out): the data; the bytes beyond Size are dropped (may be NULL)
+ * @param	Size: size of Data
+ * @param	Len: length of the data
+ * @param	Deadline: time (TimeBase) the data must have arrived by
+ * @return  1, or 0 if the module fell silent
+ */
+
+static uint8_t ESP_ReadData(uint8_t* Data, uint16_t Size, uint16_t Len, uint64_t Deadline)
+{
+    uint16_t i;
+    uint8_t c;
+
+    for (i = 0; i < Len; i++)
+    {
+        /* The deadline is only checked when the module is silent */
+        while (AT_BufferEmpty(USART_ESP))
+        {
+            if (TimeBase_Expired(Deadline))
+                return 0;
+        }
+
+        c = AT_Getc(USART_ESP);
+        if (i < Size)
+            Data[i] = c;
+    }
+
+    return 1;
+}
+
+
+/**
+ * @name    ESP_Frame
+ * @brief   The frame handler of the engine: the data of a +IPD that
+ *              arrives while a command runs is read into the frame buffer,
+ *              for ESP_ReadIPD. A frame that does not fit is dropped.
+ *
+ * @author  Mehdi
+ *
+ * @param	Head: the line up to the ':'
+ * @return  1 if it was a +IPD
+ */
+
+static uint8_t ESP_Frame(const char* Head)
+{
+    uint64_t Deadline = TimeBase_Deadline(TIMEBASE_MS(ESP_FRAME_MS));
+    uint16_t Len, Off, n;
+    uint8_t Link;
+
+    if (!ESP_ParseIPD(Head,&Link,&Len))
+        return 0;
+
+    if (ESP_RxFree() < 3 + (uint32_t)Len)
+    {
+        ESP_ReadData(NULL,0,Len,Deadline);
+        ESP_Eng.Overflows++;
+        return 1;
+    }
+
+    /* The data goes behind the record header, in up to two parts */
+    Off = (ESP_RxHead + 3) & ESP_RX_MASK;
+    n = (Len < ESP_RX_BUF - Off) ? Len : ESP_RX_BUF - Off;
+
+    if (ESP_ReadData(ESP_Rx + Off,n,n,Deadline) && ESP_ReadData(ESP_Rx,Len - n,Len - n,Deadline))
+        ESP_RxCommit(Link,Len);
+    else
+        ESP_Eng.Overflows++;
+
+    return 1;
+}
+
+
+/**
+ * @name    ESP_Urc
+ * @brief   The URC handler of the engine: a "<link>,CLOSED" that arrives
+ *              while a command runs is kept in the frame buffer, for
+ *              ESP_ReadIPD; the close asked by ESP_Close is not
+ *
+ * @author  Mehdi
+ *
+ * @return  1 if it was a link close
+ */
+
+static uint8_t ESP_Urc(const char* Line)
+{
+    int16_t Link = ESP_ClosedLink(Line);
+
+    if (Link < 0)
+        return 0;
+
+    if (Link == ESP_Closing)
+        return 1;
+
+    if (ESP_RxFree() >= 3)
+        ESP_RxCommit(Link | ESP_RX_CLOSED,0);
+    else
+        ESP_Eng.Overflows++;
+
+    return 1;
+}
+
+
+/**
+ * @name    ESP_Engine
+ * @brief   The function returns the AT engine of the module, bound to
+ *              USART_ESP (which the application may set directly)
+ *
+ * @author  Mehdi
+ */
+
+static ATEngine* ESP_Engine(void)
+{
+    if (ESP_Eng.USARTx != USART_ESP)
+    {
+        ATEngine_Init(&ESP_Eng,USART_ESP,ESP_Line,sizeof(ESP_Line),ESP_Urc);
+        ATEngine_SetFrameHandler(&ESP_Eng,ESP_Frame);
+    }
+
+    return &ESP_Eng;
+}
+
+
+/**
+ * @name    ESP_Result
+ * @brief   The function records the class of a failure from the reply
+ *              and converts the result of the engine
+ *
+ * @author  Mehdi
+ *
+ * @param	res: result of the engine (ATENGINE_xxx)
+ * @param	Reply: the reply received ("" if nothing arrived)
+ * @return  ESP8266_OK, ESP8266_BUSY, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+static int8_t ESP_Result(int8_t res, const char* Reply)
+{
+    if (res == ATENGINE_OK)
+    {
+        ESP_LastFault = LINK_FAULT_NONE;
+        return ESP8266_OK;
+    }
+
+    ESP_LastFault = LinkSup_Classify(Reply);
+
+    return (res == ATENGINE_TOO_LONG) ? ESP8266_FAIL : res;
+}
+
+
+/**
+ * @name    ESP_Run
+ * @brief   The function sends a command of the descriptor table and waits
+ *              for its expected final response within its timeout class
+ *              (see ATEngine_Run).
+ *
+ * @author  Mehdi
+ *
+ * @param	Id: the command (AT_ESP_xxx)
+ * @param	Args: arguments of an AT_ARGS command (NULL otherwise)
+ * @param	Reply (Out): the lines received, each ended by LF, NUL
+ *              terminated; cut to Size (may be NULL)
+ * @param	Size: size of Reply
+ * @return  ESP8266_OK, ESP8266_BUSY, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+int8_t ESP_Run(uint8_t Id, const char* Args, char* Reply, uint16_t Size)
+{
+    ATResp Resp;
+    int8_t res;
+
+    if (Reply == NULL || Size == 0)
+    {
+        res = ATEngine_Run(ESP_Engine(),Id,Args,NULL);
+        return ESP_Result(res,(res == ATENGINE_TIMEOUT) ? "" : ESP_Line);
+    }
+
+    ATResp_Init(&Resp,Reply,Size);
+
+    res = ATEngine_Run(ESP_Engine(),Id,Args,&Resp);
+    ATResp_Join(&Resp);
+
+    // A reply cut to the size of Reply is still a success
+    return ESP_Result((res == ATENGINE_TOO_LONG) ? ATENGINE_OK : res,Reply);
+}
+
+
+/**
+ * @name    ESP_RunResp
+ * @brief   The function sends a command of the descriptor table like ESP_Run
+ *              and collects its reply with a line index (see ATResp.h)
+ *
+ * @author  Mehdi
+ *
+ * @param	Id: the command (AT_ESP_xxx)
+ * @param	Args: arguments of an AT_ARGS command (NULL otherwise)
+ * @param	Resp (Out): the collector, ATResp_Init'ed by the caller
+ * @return  ESP8266_OK, ESP8266_BUSY, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+int8_t ESP_RunResp(uint8_t Id, const char* Args, ATResp* Resp)
+{
+    int8_t res = ATEngine_Run(ESP_Engine(),Id,Args,Resp);
+
+    return ESP_Result(res,(res != ATENGINE_OK && Resp->Lines != 0) ? ATResp_GetLine(Resp,Resp->Lines - 1) : "");
+}
+
+
+/**
+ * @name    ESP_QueryState
+ * @brief   The function reads the current configuration of the module
+ *
+ * @author  Mehdi
+ *
+ * @param	State (Out): the configuration found
+ * @return  ESP8266_OK if the module answered the queries
+ */
+
+int8_t ESP_QueryState(ESP_State* State)
+{
+    char *Reply, *p;
+    int8_t res = ESP8266_FAIL;
+
+    memset(State,0,sizeof(ESP_State));
+
+    if ((Reply = BufPool_Get(ESP_REPLY_LEN,BUFPOOL_ESP)) == NULL)
+        return ESP8266_FAIL;
+
+    do
+    {
+        // +CWMODE:<mode>
+        if (ESP_Run(AT_ESP_CWMODE_Q,NULL,Reply,ESP_REPLY_LEN) != ESP8266_OK)
+            break;
+        if ((p = strstr(Reply,"+CWMODE:")) != NULL)
+            State->Mode = atoi(p + 8);
+
+        // STATUS:<stat>  2: got IP, 3: connected, 4: disconnected, 5: no AP
+        if (ESP_Run(AT_ESP_CIPSTATUS,NULL,Reply,ESP_REPLY_LEN) != ESP8266_OK)
+            break;
+        if ((p = strstr(Reply,"STATUS:")) != NULL)
+            State->Status = atoi(p + 7);
+
+        // +CWJAP:"<ssid>",... or "No AP"
+        if (ESP_Run(AT_ESP_CWJAP_Q,NULL,Reply,ESP_REPLY_LEN) != ESP8266_OK)
+            break;
+        State->Joined = (strstr(Reply,"+CWJAP:\"" ESP_AP_SSID "\"") != NULL) &&
+                        State->Status >= 2 && State->Status <= 4;
+
+        // +CIPMUX:<mode>
+        if (ESP_Run(AT_ESP_CIPMUX_Q,NULL,Reply,ESP_REPLY_LEN) != ESP8266_OK)
+            break;
+        if ((p = strstr(Reply,"+CIPMUX:")) != NULL)
+            State->Mux = atoi(p + 8);
+
+        // +CIPSERVER:<mode>[,<port>]; older firmware does not know the query
+        if (ESP_Run(AT_ESP_CIPSERVER_Q,NULL,Reply,ESP_REPLY_LEN) == ESP8266_OK &&
+            strstr(Reply,"+CIPSERVER:1") != NULL)
+            State->Server = 1;
+
+        res = ESP8266_OK;
+    } while (0);
+
+    BufPool_Put(Reply);
+
+    return res;
+}
+
 
 /**
  * @name    ESP_SET
  * @brief   The function send AT commands to ESP to configure it
- *          as access point, multichannel, and serevr on port 80
+ *          as access point, multichannel, and serevr on port 80.
+ *          The current configuration is queried first and only the
+ *          commands needed to reach the desired one are sent, so a warm
+ *          restart of the uC keeps the link of the module.
+ *          A failed step is recovered by the link supervisor; the
+ *          function gives up when the supervisor does (LINKSUP_MAX_ATTEMPTS),
+ *          so the application can fall back to another uplink.
  *
  * @author  Mehdi
+ *
+ * @return  ESP8266_OK, or ESP8266_FAIL if the supervisor gave up
 */
 
-void ESP_SET(USART_TypeDef* USARTx)
+int8_t ESP_SET(USART_TypeDef* USARTx)
 {
 
-    char *Response;
-    uint8_t CheckRes;
-    uint8_t Rec_Status;
+    ESP_State State;
+    uint32_t start = TimeBase_Ms();
 
     USART_ESP = USARTx;
 
-    TM_HD44780_Clear();
-
-    // Disconnect from the router
-    TM_HD44780_Puts(0,0,"DISCONNECT FROM AP");
-    Rec_Status = ESP_SendCommand("AT+CWQAP\r\n",1);
-    Response = ESP_GetResponse(Rec_Status,1);    // Read serial Data
-    CheckRes = ESP_CheckResponse(Response,"WIFI DISCONNECT");  // Check the response and send back a feedback.
-    ActAcorToRes(CheckRes);
-    TM_USART_ClearBuffer(USART_ESP);
-    Delayms(2000);
-    TM_HD44780_Clear();
+    while (ESP_QueryState(&State) != ESP8266_OK)
+        if (LinkSup_Recover(ESP_LastFault) != ESP8266_OK)
+            return ESP8266_FAIL;
 
     // Configure as access point
-    TM_HD44780_Puts(0,0,"SET as ACCESS POINT");
-    Rec_Status = ESP_SendCommand("AT+CWMODE=1\r\n",1);
-    Response = ESP_GetResponse(Rec_Status,3);
-    CheckRes = ESP_CheckResponse(Response,"OK");
-    ActAcorToRes(CheckRes);
-    TM_USART_ClearBuffer(USART_ESP);
-    Delayms(2000);
-    TM_HD44780_Clear();
+    if (State.Mode != 1)
+    {
+        Status_Post(STATUS_ESP_SET_STATION,0);
+        while (ESP_Run(AT_ESP_CWMODE_STA,NULL,NULL,0) != ESP8266_OK)
+            if (LinkSup_Recover(ESP_LastFault) != ESP8266_OK)
+                return ESP8266_FAIL;
+    }
 
     // Establish connection to the Router
-    TM_HD44780_Puts(0,0,"CONNECT to ROUTER");
-    ESP_ConnectToRouter();
-    Delayms(2000);
-    TM_HD44780_Clear();
+    if (!State.Joined)
+    {
+        Status_Post(STATUS_ESP_CONNECT_ROUTER,0);
+        while (FastJoin_Connect() != ESP8266_OK)
+            if (LinkSup_Recover(ESP_LastFault) != ESP8266_OK)
+                return ESP8266_FAIL;
+    }
 
     // Get the Static IP assigned by Router
-    TM_HD44780_Puts(0,0,"GET the STATIC IP");
-    ESP_GetIP();
-    Delayms(2000);
-    TM_HD44780_Clear();
-
-    // Configure for multiple connections
-    TM_HD44780_Puts(0,0,"CONFIG for MPL CONN.");
-    Rec_Status = ESP_SendCommand("AT+CIPMUX=1\r\n",1);
-    Response = ESP_GetResponse(Rec_Status,3);
-    CheckRes = ESP_CheckResponse(Response,"OK");
-    ActAcorToRes(CheckRes);
-    TM_USART_ClearBuffer(USART_ESP);
-    Delayms(2000);
-    TM_HD44780_Clear();
+    Status_Post(STATUS_ESP_GET_IP,0);
+    while (ESP_GetIP() != ESP8266_OK)
+        if (LinkSup_Recover(ESP_LastFault) != ESP8266_OK)
+            return ESP8266_FAIL;
+
+    // Configure for multiple connections (the server has to be off to change it)
+    if (State.Mux != 1)
+    {
+        Status_Post(STATUS_ESP_CONFIG_MUX,0);
+        if (State.Server)
+        {
+            ESP_Run(AT_ESP_CIPSERVER_OFF,NULL,NULL,0);
+            State.Server = 0;
+        }
+        while (ESP_EnableMux() != ESP8266_OK)
+            if (LinkSup_Recover(ESP_LastFault) != ESP8266_OK)
+                return ESP8266_FAIL;
+    }
 
     // Turn on server on port 80
-    TM_HD44780_Puts(0,0,"TURN on SERVER&P.80");
-    Rec_Status = ESP_SendCommand("AT+CIPSERVER=1,80\r\n",1);
-    Response = ESP_GetResponse(Rec_Status,3);
-    CheckRes = ESP_CheckResponse(Response,"OK");
-    ActAcorToRes(CheckRes);
-    TM_USART_ClearBuffer(USART_ESP);
-    Delayms(2000);
-    TM_HD44780_Clear();
+    if (!State.Server)
+    {
+        Status_Post(STATUS_ESP_SERVER_ON,0);
+        while (ESP_EnableServer() != ESP8266_OK)
+            if (LinkSup_Recover(ESP_LastFault) != ESP8266_OK)
+                return ESP8266_FAIL;
+    }
 
+    ESP_BootMs = TimeBase_Ms() - start;
+
+    return ESP8266_OK;
+}
+
+
+/**
+ * @name    ESP_GetBootTime
+ * @brief   The function returns the time (ms) the last ESP_SET took
+ *
+ * @author  Mehdi
+ */
+
+uint32_t ESP_GetBootTime(void)
+{
+    return ESP_BootMs;
 }
 
 
 /**
  * @name    ESP_Init
- * @brief   The function send command "AT" to initialize the module.
+ * @brief   The function send command "AT" to initialize the module; a
+ *              module that does not answer is recovered (LinkSup_Recover).
  *
  * @author  Mehdi
+ *
+ * @return  ESP8266_OK, or ESP8266_FAIL if the recovery gave up
  */
 
- void ESP_Init(void)
+ int8_t ESP_Init(void)
  {
 
-    char CheckRes;
-    char* CmdRes;
-    uint8_t Rec_Status;
-
         // Reset the ESP
 /*    LCDWriteStringXY(0,0,"RESET the MODULE");
     Rec_Status = ESP_SendCommand("AT+RST\r\n",2);
@@ -122,14 +549,92 @@ void ESP_SET(USART_TypeDef* USARTx)
     LCDClear();*/
 
     // Initialize the module
-    TM_HD44780_Puts(0,0,"INITIALIZATION");
-    Rec_Status = ESP_SendCommand("AT\r\n",1);
-    CmdRes = ESP_GetResponse(Rec_Status,1);    // Read serial Data
-    CheckRes = ESP_CheckResponse(CmdRes,"OK");  // Check the response and send back a feedback.
-    ActAcorToRes(CheckRes);
-
-    TM_USART_ClearBuffer(USART_ESP);;
-    Delayms(2000);
+    Status_Post(STATUS_ESP_INIT,0);
+    if (ESP_Probe() != ESP8266_OK && LinkSup_Recover(ESP_LastFault) != ESP8266_OK)
+        return ESP8266_FAIL;
+
+    TimeBase_Delay(TIMEBASE_MS(2000));
+
+    return ESP8266_OK;
+ }
+
+ /**
+ * @name    ESP_Probe
+ * @brief   The function checks the module answers "AT" with "OK"
+ *
+ * @author  Mehdi
+ *
+ * @return  ESP8266_OK if the module answers
+ */
+
+ int8_t ESP_Probe(void)
+ {
+    return ESP_Run(AT_ESP_AT,NULL,NULL,0);
+ }
+
+ /**
+ * @name    ESP_EnableMux
+ * @brief   The function configures the module for multiple connections
+ *
+ * @author  Mehdi
+ */
+
+ int8_t ESP_EnableMux(void)
+ {
+    return ESP_Run(AT_ESP_CIPMUX_ON,NULL,NULL,0);
+ }
+
+ /**
+ * @name    ESP_EnableServer
+ * @brief   The function turns on the server on port 80
+ *
+ * @author  Mehdi
+ */
+
+ int8_t ESP_EnableServer(void)
+ {
+    return ESP_Run(AT_ESP_CIPSERVER_ON,NULL,NULL,0);
+ }
+
+ /**
+ * @name    ESP_GetLastFault
+ * @brief   The function returns the class of the last failure (LINK_FAULT_xxx)
+ *
+ * @author  Mehdi
+ */
+
+ uint8_t ESP_GetLastFault(void)
+ {
+    return ESP_LastFault;
+ }
+
+ /**
+ * @name    ESP_Recover
+ * @brief   The function recovers the link after a failed send or close
+ *              (those return at once and leave the recovery to the caller,
+ *              which runs it when it can afford the wait)
+ *
+ * @author  Mehdi
+ *
+ * @return  ESP8266_OK, or ESP8266_FAIL if the recovery gave up
+ */
+
+ int8_t ESP_Recover(void)
+ {
+    return LinkSup_Recover(ESP_LastFault);
+ }
+
+ /**
+ * @name    ESP_GetOverflows
+ * @brief   The function returns the number of replies, reports and +IPD
+ *              data cut short because they did not fit their buffer
+ *
+ * @author  Mehdi
+ */
+
+ uint32_t ESP_GetOverflows(void)
+ {
+    return ESP_Eng.Overflows;
  }
 
  /**
@@ -139,188 +644,233 @@ void ESP_SET(USART_TypeDef* USARTx)
  * @author  Mehdi
  */
 
- void ESP_ConnectToRouter(void)
+ int8_t ESP_ConnectToRouter(void)
  {
 
-    char *Response = "";
-    uint8_t Rec_Status;
+    char *Response;
+    int8_t Result = ESP8266_OK;
 
-    Rec_Status = ESP_SendCommand("AT+CWJAP=\"Ciel\",\"1703198328\"\r\n",3);
-    Delayms(10000);
+    if ((Response = BufPool_Get(ESP_REPLY_LEN,BUFPOOL_ESP)) == NULL)
+        return ESP8266_FAIL;
 
-    Response = ESP_GetResponse(Rec_Status,1);
+    // Wait for the result of the join instead of a fixed delay
+    ESP_Run(AT_ESP_CWJAP,NULL,Response,ESP_REPLY_LEN);
 
     if ((strstr(Response,"WIFI CONNECTED") != NULL) && (strstr(Response,"WIFI GOT IP") != NULL))     // Search to find specific String in the response
     {
-    	TM_HD44780_Puts(0,2,"> ESTABLISHED");
+    	Status_Post(STATUS_AP_ESTABLISHED,0);
+    	ESP_LastFault = LINK_FAULT_NONE;
     }else
     {
-    	TM_HD44780_Puts(0,2,"> NOT ESTABLISHED");
-    	Delayms(3000);
-        Halt();
+    	Status_Post(STATUS_AP_NOT_ESTABLISHED,0);
+    	ESP_LastFault = LinkSup_Classify(Response);
+    	if (ESP_LastFault != LINK_FAULT_TIMEOUT && ESP_LastFault != LINK_FAULT_MODULE_RESET)
+    	    ESP_LastFault = LINK_FAULT_WIFI_DROP;
+    	Result = ESP8266_FAIL;
     }
 
-    TM_USART_ClearBuffer(USART_ESP);
+    BufPool_Put(Response);
+
+    return Result;
 
  }
 
  /**
  * @name    ESP_GetIP
  * @brief   The function Get the Static IP from the module
- *              assigned by the router connected to and print it on LCD.
+ *              assigned by the router connected to and post it to the status sink.
  *
  * @author  Mehdi
+ *
+ * @return  ESP8266_OK if the module reported a station IP
  */
 
- void ESP_GetIP(void)
+ int8_t ESP_GetIP(void)
  {
 
-    char *tmp = "";
-    char *Static_IP = "";
-    char *Response = "";
-    uint8_t Rec_Status;
+    ATResp Resp;
+    char *Response;
+    uint32_t Ip;
+    int8_t Line, Result = ESP8266_FAIL;
 
-    Rec_Status = ESP_SendCommand("AT+CIFSR\r\n",1);	// Get IP address
-    Response = ESP_GetResponse(Rec_Status,5);
+    if ((Response = BufPool_Get(ESP_REPLY_LEN,BUFPOOL_ESP)) == NULL)
+        return ESP8266_FAIL;
 
-    if (strstr(Response,"STAIP") != NULL)
-    {
-        tmp = strstr(Response,"STAIP");
-        strncpy(Static_IP,tmp,17);        // Copy data after "STAIP."<IP>"" in a string in order to print in LCD
+    ATResp_Init(&Resp,Response,ESP_REPLY_LEN);
 
-        TM_HD44780_Puts(0,2,Static_IP);
+    // +CIFSR:APIP,"<IP>" ... +CIFSR:STAIP,"<IP>" ... OK
+    if (ESP_RunResp(AT_ESP_CIFSR,NULL,&Resp) == ESP8266_OK &&
+        (Line = ATResp_Find(&Resp,"+CIFSR:STAIP,",0)) >= 0 &&
+        ATResp_IP(&Resp,Line,1,&Ip) && Ip != 0)
+    {
+        Status_Post(STATUS_IP_ACQUIRED,Ip);
+        Result = ESP8266_OK;
     } else
     {
-    	TM_HD44780_Puts(0,2,"Unable to Get IP!");
-    	Delayms(3000);
-        Halt();
+    	Status_Post(STATUS_IP_UNAVAILABLE,0);
+    	if (ESP_LastFault == LINK_FAULT_NONE)
+    	    ESP_LastFault = LINK_FAULT_WIFI_DROP;
     }
-    TM_USART_ClearBuffer(USART_ESP);
+    BufPool_Put(Response);
+
+    return Result;
 
  }
 
 
 /**
- * @name    ESP_SendCommand
- * @brief   The function send AT commands to ESP to
- *              configure it and receive the response
+ * @name    ESP_GetRssi
+ * @brief   The function reads the signal strength of the access point
+ *              joined: +CWJAP:"<ssid>","<bssid>",<channel>,<rssi>
  *
  * @author  Mehdi
  *
- * @param	Command: AT command
- * @param	delayTime: delay time
- * @param	Conf_Status: the results of sending commands
+ * @param	Rssi (Out): the signal strength (dBm)
+ * @return  ESP8266_OK, or ESP8266_FAIL if the module is not joined
  */
 
-uint8_t ESP_SendCommand (char* Command , uint8_t delayTime)
+int8_t ESP_GetRssi(int8_t* Rssi)
 {
+    ATResp Resp;
+    char *Response;
+    int32_t Value;
+    int8_t Line, Result = ESP8266_FAIL;
 
-    char counter;
-    uint8_t Rec_Status = 0;
-    char Response[256];
+    if ((Response = BufPool_Get(ESP_REPLY_LEN,BUFPOOL_ESP)) == NULL)
+        return ESP8266_FAIL;
 
-    TM_USART_Puts(USART2,Command);
+    ATResp_Init(&Resp,Response,ESP_REPLY_LEN);
 
-    for (counter = 0; counter < 10;counter++)
+    if (ESP_RunResp(AT_ESP_CWJAP_Q,NULL,&Resp) == ESP8266_OK &&
+        (Line = ATResp_Find(&Resp,"+CWJAP:",0)) >= 0 &&
+        ATResp_Int(&Resp,Line,3,&Value))
     {
-        if (TM_USART_Gets(USART_ESP,Response,256) != 0)
-        {
-            Rec_Status = 1;
-            break;
-        }
+        *Rssi = (int8_t)Value;
+        Result = ESP8266_OK;
     }
+    BufPool_Put(Response);
 
-    return Rec_Status;
+    return Result;
 }
 
 
 /**
- * @name    ESP_GetResponse
- * @brief   The function gets the response from UART
- *              buffer and send it back to function calls it
+ * @name    ESP_SetUart
+ * @brief   The function sets the UART of the module for this session:
+ *              AT+UART_CUR=<baud>,8,1,0,<flow control>. With
+ *              ESP_FLOW_RTS_CTS the RTS/CTS flow control of USART_ESP is
+ *              enabled too, so the data of AT+CIPSEND can be sent at full
+ *              baud: the module holds CTS while its buffer drains. The
+ *              RTS/CTS pins must be in their alternate function, and a new
+ *              baud rate must be set on USART_ESP by the caller once this
+ *              returns.
  *
  * @author  Mehdi
  *
- * @param	Rec_Status: Receiving status 1: Data Received   0: Data Not Received
- * @param	delayTime: delay uC waits for receiving the reply.
- * @return  Response: Data received through UART
+ * @param	Baud: baud rate
+ * @param	Flow: ESP_FLOW_xxx
+ * @return  ESP8266_OK, ESP8266_FAIL or ESP8266_TIMEOUT
  */
 
-char * ESP_GetResponse (uint8_t Rec_Status, uint8_t delayTime)
+int8_t ESP_SetUart(uint32_t Baud, uint8_t Flow)
 {
+    char Args[24];
+    int8_t res;
 
-    char Response [256];
+    sprintf(Args,"%lu,8,1,0,%u",(unsigned long)Baud,Flow & ESP_FLOW_RTS_CTS);
 
-    if ((Rec_Status == 0))
-    {
-        Response = "";
-    } else if (Rec_Status == 1)
-    {
-        TM_USART_Gets(USART_ESP,Response,256);
-    }
+    if ((res = ESP_Run(AT_ESP_UART_CUR,Args,NULL,0)) != ESP8266_OK)
+        return res;
 
-    return Response;
+    USART_ESP->CR3 &= ~(USART_CR3_RTSE | USART_CR3_CTSE);
+    // The RTS of the module is the CTS of the USART and vice versa
+    if (Flow & ESP_FLOW_RTS)
+        USART_ESP->CR3 |= USART_CR3_CTSE;
+    if (Flow & ESP_FLOW_CTS)
+        USART_ESP->CR3 |= USART_CR3_RTSE;
+
+    return ESP8266_OK;
 }
 
 
 /**
- * @name    ESPCheckResponse
- * @brief   The function check the response received from module
- *              and return back appropriate feedback.
- *              it first echoes the cmd sent by uC and then the appropriate response
+ * @name    ActAcorToRes
+ * @brief   The function posts appropriate status according
+ *              to the result of a command.
+ *              Failures are left to the caller and the link supervisor.
  *
  * @author  Mehdi
  *
- * @param	response: the response get from module and check by the function
- * @param   check: the word with witch "response" is compared
- * @return  ESP8266_INVALID_RESPONSE: if two first or two last char of response are not "\r\n"
- * @return  ESP8266_FAIL: if "response" does not match "check"
- * @return  ESP8266_OK: if the response matches check
-*/
+ * @param   Res: the response get from module and check by the function
+ * @return  Res
+ */
 
-char ESP_CheckResponse(const char *response, const char *check)
+char ActAcorToRes(char Res)
 {
 
-    if (strcmp(response,"NULL") == 1)
+    if (Res == ESP8266_INVALID_RESPONSE)
     {
-        return ESP8266_FAIL;
-    }else if (strstr(response,check) == NULL)
+    	Status_Post(STATUS_RES_INVALID,0);
+    }else if (Res == ESP8266_FAIL)
     {
-        return ESP8266_INVALID_RESPONSE;
-    } else if (strstr(response,check) != NULL)
+    	Status_Post(STATUS_RES_NO_MATCH,0);
+    }else if (Res == ESP8266_OK)
     {
-        return ESP8266_OK;
+    	Status_Post(STATUS_RES_OK,0);
     }
+
+    return Res;
 }
 
 
 /**
- * @name    ActAcorToRes
- * @brief   The function print appropriate text on LCD according
- *              to the response given from ESP_CheckResponse
+ * @name    ESP_CipSend
+ * @brief   The function sends data with AT+CIPSEND under flow control:
+ *              the data is written only on the "> " prompt, so no byte
+ *              reaches the module while it is still parsing the command,
+ *              and a command refused with "busy s..." (the module is still
+ *              sending) or "busy p..." (still processing) is sent again
+ *              after a backoff that doubles each time. The function then
+ *              waits for "SEND OK".
  *
  * @author  Mehdi
  *
- * @param   Res: the response get from module and check by the function
+ * @param	Args: "<link>,<length>"
+ * @param	Data: the parts of the data, written in order on the prompt
+ * @param	Len: their lengths (ESP_SEND_MAX at most in all)
+ * @param	Count: number of parts
+ * @return  ESP8266_OK, ESP8266_BUSY, ESP8266_FAIL or ESP8266_TIMEOUT
  */
 
-void ActAcorToRes(char Res)
+static int8_t ESP_CipSend(const char* Args, const uint8_t* const* Data, const uint16_t* Len, uint8_t Count)
 {
+    ATEngine* Eng = ESP_Engine();
+    uint32_t start = TimeBase_Ms(), Backoff = ESP_BUSY_BACKOFF_MS;
+    uint8_t Retry = 0, i;
+    int8_t res;
 
-    if (Res == ESP8266_INVALID_RESPONSE)
+    while (1)
     {
-    	TM_HD44780_Puts(0,2,"> INVALID RESPONSE");
-    	Delayms(3000);
-        Halt();
-    }else if (Res == ESP8266_FAIL)
-    {
-    	TM_HD44780_Puts(0,2,"> NO MATCH RESPONSE");
-    	Delayms(3000);
-        Halt();
-    }else if (Res == ESP8266_OK)
+        ATEngine_Send(Eng,AT_ESP_CIPSEND,Args);
+
+        res = ATEngine_Prompt(Eng,ATCmd_Timeout(AT_ESP_CIPSEND));
+        if (res != ATENGINE_BUSY || Retry++ == ESP_BUSY_RETRIES)
+            break;
+
+        TimeBase_Delay(TIMEBASE_MS(Backoff));
+        Backoff *= 2;
+    }
+
+    if (res == ATENGINE_OK)
     {
-    	TM_HD44780_Puts(0,2,"> RESPONSE OK");
+        for (i = 0; i < Count; i++)
+            AT_Send(USART_ESP,Data[i],Len[i]);
+        res = ATEngine_Wait(Eng,"SEND OK",NULL,ATCmd_Timeout(AT_ESP_CIPSEND));
     }
+
+    ATCmd_Record(AT_ESP_CIPSEND,res,TimeBase_Ms() - start);
+
+    return ESP_Result(res,(res == ATENGINE_TIMEOUT) ? "" : ESP_Line);
 }
 
 
@@ -332,16 +882,17 @@ void ActAcorToRes(char Res)
  *
  * @param	ConnectionID: the connection ID sent by android device
  * @param	Response: the data created by uC based on the arbitrary action
+ * @return  The result of ESP_SendCIPData
 */
 
-void ESP_SendHTTPResponse(char* ConnectionID, char* Response)
+int8_t ESP_SendHTTPResponse(char* ConnectionID, char* Response)
 {
 	// build HTTP response
     char* HttpResponse = "";
 
     HttpResponse = Response;	// Append the main message (e.g. Light 1 in ON) created by uC to HTTP Header
 
-    ESP_SendCIPData(ConnectionID,HttpResponse);
+    return ESP_SendCIPData(ConnectionID,HttpResponse);
 }
 
 
@@ -355,46 +906,102 @@ void ESP_SendHTTPResponse(char* ConnectionID, char* Response)
  *
  * @param	ConnectionID: the connection ID sent by android device
  * @param	HttpResponse: The Statement prepared by the "SendHTTPResponse" function
+ * @return  ESP8266_OK if the module reported "SEND OK", ESP8266_BUSY if it
+ *              stayed busy (the link is sound, the caller may retry later)
+ *              or ESP8266_FAIL (the caller then runs ESP_Recover)
 */
 
-void ESP_SendCIPData(char* ConnectionID, char* HttpResponse)
+int8_t ESP_SendCIPData(char* ConnectionID, char* HttpResponse)
+{
+    char Args[12];
+    const uint8_t* Data = (const uint8_t*)HttpResponse;
+    uint16_t Len = strlen(HttpResponse);
+    int8_t res;
+
+    // "<Connection ID>,<Number of Char>"
+    snprintf(Args,sizeof(Args),"%s,%u",ConnectionID,Len);
+
+    // "AT+CIPSEND=<Connection ID>,<Number of Char>", the message on the prompt
+    if ((res = ESP_CipSend(Args,&Data,&Len,1)) == ESP8266_BUSY)
+        return ESP8266_BUSY;
+
+    if (res != ESP8266_OK)
+        return ESP8266_FAIL;
+
+    Status_Post(STATUS_DATA_SENT,atoi(ConnectionID));
+
+    return ESP8266_OK;
+}
+
+
+/**
+ * @name    ESP_SendData
+ * @brief   The function sends binary data on a link with one AT+CIPSEND
+ *              (see ESP_CipSend); unlike ESP_SendCIPData the data may hold
+ *              NUL bytes. After a failure the caller runs ESP_Recover.
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link ID
+ * @param	Data: the data
+ * @param	Len: its length (ESP_SEND_MAX at most)
+ * @return  ESP8266_OK, ESP8266_BUSY or ESP8266_FAIL
+ */
+
+int8_t ESP_SendData(uint8_t Link, const uint8_t* Data, uint16_t Len)
 {
-    char strdata[4];
-    char CheckRes;
-    char* CmdRes;
-    uint8_t Rec_Status;
-    char* CIPSendCmd = "AT+CIPSEND=";
+    char Args[12];
+    int8_t res;
 
-//    itoa(strlen(HttpResponse),strdata,10);		// Get the length of a char and convert it to string
-    sprintf(strdata,"%d",strlen(HttpResponse));    // Get length of data and convert it into string
+    sprintf(Args,"%u,%u",Link,Len);
 
-    CIPSendCmd = Concat(CIPSendCmd,ConnectionID);
-    CIPSendCmd = Concat(CIPSendCmd,",");
+    if ((res = ESP_CipSend(Args,&Data,&Len,1)) == ESP8266_BUSY)
+        return ESP8266_BUSY;
 
-    CIPSendCmd = Concat(CIPSendCmd,strdata);
-    CIPSendCmd = Concat(CIPSendCmd,"\r\n");
+    if (res != ESP8266_OK)
+        return ESP8266_FAIL;
 
-    // Send "AT+CIPSEND=<Connection ID>,<Number of Char>"
-    ESP_SendCommand(CIPSendCmd,1);
-    CmdRes = ESP_GetResponse(Rec_Status,1);    // Read serial Data
+    Status_Post(STATUS_DATA_SENT,Link);
 
-    CheckRes = ESP_CheckResponse(CmdRes,"OK");  // Check the response and send back a feedback.
+    return ESP8266_OK;
+}
 
-    ActAcorToRes(CheckRes);
 
-    TM_USART_ClearBuffer(USART_ESP);
+/**
+ * @name    ESP_SendParts
+ * @brief   The function sends data held in several parts (e.g. a header
+ *              and the two halves of a ring) with one AT+CIPSEND, without
+ *              copying it together. Like ESP_UdpSend it does not start a
+ *              link recovery: a closed link is the caller's to reopen.
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link ID
+ * @param	Data: the parts
+ * @param	Len: their lengths (ESP_SEND_MAX at most in all)
+ * @param	Count: number of parts
+ * @return  ESP8266_OK, ESP8266_BUSY, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+int8_t ESP_SendParts(uint8_t Link, const uint8_t* const* Data, const uint16_t* Len, uint8_t Count)
+{
+    char Args[12];
+    uint32_t Total = 0;
+    uint8_t i;
+    int8_t res;
 
-    // Send the messageTM_USART_ClearBuffer
-    ESP_SendCommand(HttpResponse,1);
-    CmdRes = ESP_GetResponse(Rec_Status,1);    // Read serial Data
+    for (i = 0; i < Count; i++)
+        Total += Len[i];
 
-    CheckRes = ESP_CheckResponse(CmdRes,"SEND OK");  // Check the response and send back a feedback.
+    if (Total == 0 || Total > ESP_SEND_MAX)
+        return ESP8266_FAIL;
 
-    ActAcorToRes(CheckRes);
+    sprintf(Args,"%u,%lu",Link,(unsigned long)Total);
 
-    TM_USART_ClearBuffer(USART_ESP);
+    if ((res = ESP_CipSend(Args,Data,Len,Count)) == ESP8266_OK)
+        Status_Post(STATUS_DATA_SENT,Link);
 
-    TM_HD44780_Clear();
+    return res;
 }
 
 /**
@@ -407,29 +1014,239 @@ void ESP_SendCIPData(char* ConnectionID, char* HttpResponse)
  * @param	ConnectionID: the connection ID sent by android device
 */
 
-void ESP_SendCloseCommand (char* ConnectionID)
+int8_t ESP_SendCloseCommand (char* ConnectionID)
 {
-    char* CloseCommand;
-    char CheckRes;
-    char* CmdRes;
-    uint8_t Rec_Status;
+    // Send AT+CIPCLOSE=<Connection ID> to Close the Connection
+    if (ESP_Close(atoi(ConnectionID)) != ESP8266_OK)
+        return ESP8266_FAIL;
 
-    // Create close command
-    CloseCommand = "AT+CIPCLOSE=";
-    CloseCommand = Concat(CloseCommand,ConnectionID); // Append Connection ID
+    Status_Post(STATUS_CONN_CLOSED,atoi(ConnectionID));
 
-    CloseCommand = Concat(CloseCommand,"\r\n");
+    return ESP8266_OK;
+}
 
-    // Send AT+CIPCLOSE=<Connection ID> to Close the Connection
-    ESP_SendCommand(CloseCommand,1);
 
-    CmdRes = ESP_GetResponse(Rec_Status,1);    // Read serial Data
 
-    CheckRes = ESP_CheckResponse(CmdRes,"CLOSED");  // Check the response and send back a feedback.
+/**
+ * @name    ESP_TcpOpen
+ * @brief   The function opens an outgoing TCP link:
+ *              AT+CIPSTART=<link>,"TCP","<host>",<port>,<keep alive>
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link ID (0..4, AT+CIPMUX=1); the server takes the
+ *              incoming links from 0, so a client link is best taken from 4
+ * @param	Host: remote address or name
+ * @param	Port: remote port
+ * @return  ESP8266_OK, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+int8_t ESP_TcpOpen(uint8_t Link, const char* Host, uint16_t Port)
+{
+    char Args[ESP_LINE_LEN];
+
+    if (snprintf(Args,sizeof(Args),"%u,\"TCP\",\"%s\",%u,%u",Link,Host,Port,ESP_TCP_KEEPALIVE) >= (int)sizeof(Args))
+        return ESP8266_FAIL;
+
+    return ESP_Run(AT_ESP_CIPSTART,Args,NULL,0);
+}
+
+
+/**
+ * @name    ESP_UdpOpen
+ * @brief   The function opens a UDP link:
+ *              AT+CIPSTART=<link>,"UDP","<host>",<remote port>,<local port>,<mode>
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link ID (0..4, AT+CIPMUX=1)
+ * @param	Host: remote address
+ * @param	RemotePort: remote port
+ * @param	LocalPort: local port (0: chosen by the module)
+ * @param	Mode: ESP_UDP_PEER_FIXED or ESP_UDP_PEER_CHANGES
+ * @return  ESP8266_OK, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+int8_t ESP_UdpOpen(uint8_t Link, const char* Host, uint16_t RemotePort, uint16_t LocalPort, uint8_t Mode)
+{
+    char Args[ESP_LINE_LEN];
+
+    if (snprintf(Args,sizeof(Args),"%u,\"UDP\",\"%s\",%u,%u,%u",Link,Host,RemotePort,LocalPort,Mode) >= (int)sizeof(Args))
+        return ESP8266_FAIL;
+
+    return ESP_Run(AT_ESP_CIPSTART,Args,NULL,0);
+}
+
+
+/**
+ * @name    ESP_UdpListen
+ * @brief   The function opens a UDP link that takes datagrams from any
+ *              sender on a local port and answers the last sender
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link ID (0..4, AT+CIPMUX=1)
+ * @param	LocalPort: the port to listen on
+ * @return  ESP8266_OK, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+int8_t ESP_UdpListen(uint8_t Link, uint16_t LocalPort)
+{
+    return ESP_UdpOpen(Link,"0.0.0.0",0,LocalPort,ESP_UDP_PEER_CHANGES);
+}
+
+
+/**
+ * @name    ESP_UdpSend
+ * @brief   The function sends one datagram with a single AT+CIPSEND
+ *              (see ESP_CipSend). A lost datagram is not retried and does not
+ *              start a link recovery; the caller decides.
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link ID
+ * @param	Data: the datagram
+ * @param	Len: its length (up to 2048)
+ * @return  ESP8266_OK, ESP8266_BUSY, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+int8_t ESP_UdpSend(uint8_t Link, const uint8_t* Data, uint16_t Len)
+{
+    char Args[12];
+
+    sprintf(Args,"%u,%u",Link,Len);
+
+    return ESP_CipSend(Args,&Data,&Len,1);
+}
+
+
+/**
+ * @name    ESP_Close
+ * @brief   The function closes a link: AT+CIPCLOSE=<link> (UDP or TCP).
+ *              The data of the link not read yet is dropped, and its
+ *              "<link>,CLOSED" is not reported by ESP_ReadIPD.
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link ID
+ * @return  ESP8266_OK, ESP8266_FAIL or ESP8266_TIMEOUT
+ */
+
+int8_t ESP_Close(uint8_t Link)
+{
+    char Args[4];
+    int8_t res;
+
+    sprintf(Args,"%u",Link);
+
+    ESP_Closing = Link;
+    res = ESP_Run(AT_ESP_CIPCLOSE,Args,NULL,0);
+    ESP_Closing = ESP_NO_LINK;
 
-    ActAcorToRes(CheckRes);
-    TM_USART_ClearBuffer(USART_ESP);
+    ESP_RxPurge(Link);
 
-    TM_HD44780_Clear();
+    return res;
 }
 
+
+/**
+ * @name    ESP_ReadIPD
+ * @brief   The function reads the next received datagram (or TCP segment):
+ *              +IPD,<link>,<len>:<data>
+ *              The frames that arrived while a command ran come first, from
+ *              the frame buffer. On the wire the bytes before "+IPD" are
+ *              dropped, except "<link>,CLOSED": the function then returns
+ *              ESP8266_CLOSED with the link, so the owner of a client link
+ *              can reconnect.
+ *
+ * @author  Mehdi
+ *
+ * @param	Link (Out): link the data came from
+ * @param	Data (Out): the data; the bytes beyond Size are dropped
+ * @param	Size: size of Data
+ * @param	Timeout: time (ms) to wait for a frame to begin; the rest of it
+ *              is then waited for ESP_FRAME_MS at most
+ * @return  Number of bytes stored, ESP8266_CLOSED, ESP8266_INVALID_RESPONSE
+ *              or ESP8266_TIMEOUT
+ */
+
+int16_t ESP_ReadIPD(uint8_t* Link, uint8_t* Data, uint16_t Size, uint32_t Timeout)
+{
+    char Hdr[24];
+    uint64_t Deadline = TimeBase_Deadline(TIMEBASE_MS(Timeout)), LineEnd = 0;
+    uint16_t n = 0, Len, i;
+    int16_t Closed;
+    uint8_t c;
+
+    if (ESP_RxHead != ESP_RxTail)
+    {
+        c = ESP_Rx[ESP_RxTail & ESP_RX_MASK];
+        Len = ESP_RxLen(ESP_RxTail);
+
+        *Link = c & ~ESP_RX_CLOSED;
+        for (i = 0; i < Len && i < Size; i++)
+            Data[i] = ESP_Rx[(ESP_RxTail + 3 + i) & ESP_RX_MASK];
+        ESP_RxTail += 3 + Len;
+
+        if (c & ESP_RX_CLOSED)
+            return ESP8266_CLOSED;
+
+        if (Len > Size)
+            ESP_Eng.Overflows++;
+
+        return i;
+    }
+
+    while (1)
+    {
+        /* A line begun is waited for ESP_FRAME_MS from its first byte */
+        if (TimeBase_Expired((n == 0) ? Deadline : LineEnd))
+            return ESP8266_TIMEOUT;
+
+        if (AT_BufferEmpty(USART_ESP))
+            continue;
+
+        Hdr[n] = AT_Getc(USART_ESP);
+
+        if (n == 0)
+        {
+            if (Hdr[0] != '+' && !isdigit((unsigned char)Hdr[0]))
+                continue;
+            LineEnd = TimeBase_Deadline(TIMEBASE_MS(ESP_FRAME_MS));
+        }
+
+        if (Hdr[n] == ':' && Hdr[0] == '+')
+        {
+            Hdr[n] = '\0';
+            break;
+        }
+
+        /* A line: "<link>,CLOSED", or one of no interest */
+        if (Hdr[n] == '\r' || Hdr[n] == '\n')
+        {
+            Hdr[n] = '\0';
+            if ((Closed = ESP_ClosedLink(Hdr)) >= 0)
+            {
+                *Link = Closed;
+                return ESP8266_CLOSED;
+            }
+            n = 0;
+            continue;
+        }
+
+        if (++n == sizeof(Hdr) - 1)
+            n = 0;
+    }
+
+    if (!ESP_ParseIPD(Hdr,Link,&Len))
+        return ESP8266_INVALID_RESPONSE;
+
+    /* The frame has begun: its data is waited for ESP_FRAME_MS more */
+    if (!ESP_ReadData(Data,Size,Len,TimeBase_Deadline(TIMEBASE_MS(ESP_FRAME_MS))))
+        return ESP8266_TIMEOUT;
+
+    if (Len > Size)
+        ESP_Engine()->Overflows++;
+
+    return (Len < Size) ? Len : Size;
+}
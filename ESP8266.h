@@ -7,6 +7,7 @@
 #include "AuxLib.h"
 
 #include "stm32f4xx_hal.h"
+#include "ATResp.h"
 
 //************************************************
 
@@ -15,34 +16,133 @@
 #define ESP8266_INVALID_RESPONSE		-1
 #define ESP8266_FAIL					-2
 #define ESP8266_TIMEOUT				    -3
+#define ESP8266_BUSY				    -4		// "busy s..."/"busy p..." after every retry
+#define ESP8266_CLOSED				    -5		// ESP_ReadIPD: "<link>,CLOSED" arrived
+
+// Access point the module joins
+#ifndef ESP_AP_SSID
+#define ESP_AP_SSID						"Ciel"
+#endif
+
+#ifndef ESP_AP_PWD
+#define ESP_AP_PWD						"1703198328"
+#endif
+
+#ifndef ESP_LINE_LEN
+#define ESP_LINE_LEN					128		// One reply line
+#endif
+#define ESP_REPLY_LEN					(ESP_LINE_LEN * 2)	// The lines of a reply (buffer pool block)
+
+// AT+CIPSEND: retries of a command refused with "busy", the first
+// backoff doubling at each retry
+#ifndef ESP_BUSY_RETRIES
+#define ESP_BUSY_RETRIES				5
+#endif
+
+#ifndef ESP_BUSY_BACKOFF_MS
+#define ESP_BUSY_BACKOFF_MS				10
+#endif
+
+// Hardware flow control (AT+UART_CUR=...,<flow control>)
+#define ESP_FLOW_NONE					0
+#define ESP_FLOW_RTS					1		// The module holds its RTS (our CTS) while its buffer is full
+#define ESP_FLOW_CTS					2		// The module sends only while our RTS is active
+#define ESP_FLOW_RTS_CTS				3
+
+// UDP modes (AT+CIPSTART=<id>,"UDP",...)
+#define ESP_UDP_PEER_FIXED				0		// Datagrams go to the given remote
+#define ESP_UDP_PEER_CHANGES			2		// Replies go to the sender of the last datagram
+
+#define ESP_SEND_MAX					2048	// Largest data of one AT+CIPSEND
+
+// TCP keepalive of the outgoing links (AT+CIPSTART=...,<keep alive>), s; 0: off
+#ifndef ESP_TCP_KEEPALIVE
+#define ESP_TCP_KEEPALIVE				60
+#endif
+
+// +IPD data and link closes that arrive while a command runs wait here for
+// ESP_ReadIPD; <link> <length, 2 bytes> <data> per frame
+#ifndef ESP_RX_BUF
+#define ESP_RX_BUF						512		// Power of 2
+#endif
+
+#ifndef ESP_FRAME_MS
+#define ESP_FRAME_MS					1000	// Longest wait for the data of a +IPD
+#endif
+
+#if (ESP_RX_BUF & (ESP_RX_BUF - 1)) != 0 || ESP_RX_BUF > 32768
+#error "ESP_RX_BUF must be a power of 2, 32768 at most"
+#endif
+
+// Configuration of the module as read back by ESP_QueryState
+typedef struct
+{
+    uint8_t Mode;		// AT+CWMODE?    1: station, 2: AP, 3: both
+    uint8_t Joined;		// AT+CWJAP?     associated to ESP_AP_SSID
+    uint8_t Mux;		// AT+CIPMUX?
+    uint8_t Status;		// AT+CIPSTATUS  STATUS:<n>
+    uint8_t Server;		// AT+CIPSERVER? (0 when unknown)
+} ESP_State;
 
 
 /***************************************************
 			F U N C T I O N S
 ****************************************************/
 
-void ESP_SET(USART_TypeDef* USARTx);
+int8_t ESP_SET(USART_TypeDef* USARTx);
 
-uint8_t ESP_SendCommand (char* Command , uint8_t delayTime);
+int8_t ESP_QueryState(ESP_State* State);
 
+uint32_t ESP_GetBootTime(void);
 
-void ESP_Init(void);
+int8_t ESP_Run(uint8_t Id, const char* Args, char* Reply, uint16_t Size);
+int8_t ESP_RunResp(uint8_t Id, const char* Args, ATResp* Resp);
 
-void ESP_ConnectToRouter(void);
 
-void ESP_GetIP(void);
+int8_t ESP_Init(void);
 
-char * ESP_GetResponse (uint8_t Rec_Status, uint8_t delayTime);
+int8_t ESP_Probe(void);
 
-char ESP_CheckResponse(const char *response, const char *check);
+int8_t ESP_ConnectToRouter(void);
 
-void ActAcorToRes(char Res);
+int8_t ESP_GetIP(void);
 
-void ESP_SendHTTPResponse(char* ConnectionID, char* Response);
+int8_t ESP_GetRssi(int8_t* Rssi);
 
-void ESP_SendCIPData(char* ConnectionID, char* HttpResponse);
+int8_t ESP_SetUart(uint32_t Baud, uint8_t Flow);
 
-void ESP_SendCloseCommand (char* ConnectionID);
+int8_t ESP_EnableMux(void);
+
+int8_t ESP_EnableServer(void);
+
+uint8_t ESP_GetLastFault(void);
+int8_t ESP_Recover(void);
+
+uint32_t ESP_GetOverflows(void);
+
+char ActAcorToRes(char Res);
+
+int8_t ESP_SendHTTPResponse(char* ConnectionID, char* Response);
+
+int8_t ESP_SendCIPData(char* ConnectionID, char* HttpResponse);
+
+int8_t ESP_SendData(uint8_t Link, const uint8_t* Data, uint16_t Len);
+
+int8_t ESP_SendParts(uint8_t Link, const uint8_t* const* Data, const uint16_t* Len, uint8_t Count);
+
+int8_t ESP_SendCloseCommand (char* ConnectionID);
+
+int8_t ESP_TcpOpen(uint8_t Link, const char* Host, uint16_t Port);
+
+int8_t ESP_UdpOpen(uint8_t Link, const char* Host, uint16_t RemotePort, uint16_t LocalPort, uint8_t Mode);
+
+int8_t ESP_UdpListen(uint8_t Link, uint16_t LocalPort);
+
+int8_t ESP_UdpSend(uint8_t Link, const uint8_t* Data, uint16_t Len);
+
+int8_t ESP_Close(uint8_t Link);
+
+int16_t ESP_ReadIPD(uint8_t* Link, uint8_t* Data, uint16_t Size, uint32_t Timeout);
 
 
 #endif /* _ESP8266_H */
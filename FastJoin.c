@@ -0,0 +1,399 @@
+/**
+ @file     FastJoin.c
+ @brief    This file contains the fast reconnect of the ESP8266.
+           After a successful join the BSSID, channel and IP configuration
+           are stored in a small flash record. The next join scans the
+           cached channel only for the cached BSSID (AT+CWLAP), applies
+           the cached address with AT+CIPSTA_CUR (no DHCP exchange), joins
+           the cached BSSID with AT+CWJAP_CUR and pings the cached gateway,
+           which resolves it with ARP. If the record is missing, its lease
+           is too old, the AP is not on its channel, the join fails or the
+           gateway does not answer, it falls back to a full join with DHCP
+           and learns the new parameters.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ESP8266.h"
+#include "FastJoin.h"
+#include "ATCmd.h"
+#include "StatusSink.h"
+#include "BufPool.h"
+#include "TimeBase.h"
+
+
+static FastJoin_Timing FJ_Timing;
+static uint32_t FJ_LeaseStart;		// Tick the cached lease counts from
+static uint8_t  FJ_LeaseKnown;		// FJ_LeaseStart set
+static uint8_t  FJ_Static;			// DHCP turned off by AT+CIPSTA_CUR
+
+
+/**
+ * @name    FastJoin_Check
+ * @brief   The function computes the check word (FNV-1a) of a record
+ *
+ * @author  Mehdi
+ */
+
+static uint32_t FastJoin_Check(const FastJoin_Record* Rec)
+{
+    const uint8_t *p = (const uint8_t*)Rec;
+    uint32_t hash = 2166136261UL;
+    uint16_t i;
+
+    for (i = 0; i < offsetof(FastJoin_Record, Check); i++)
+    {
+        hash ^= p[i];
+        hash *= 16777619UL;
+    }
+
+    return hash;
+}
+
+
+/**
+ * @name    FastJoin_Load
+ * @brief   The function reads the record from flash
+ *
+ * @author  Mehdi
+ *
+ * @param	Rec (Out): the record
+ * @return  1 if the record is valid, belongs to ESP_AP_SSID and its
+ *              gateway is on its subnet, else 0
+ */
+
+static uint8_t FastJoin_Load(FastJoin_Record* Rec)
+{
+    memcpy(Rec, (const void*)FASTJOIN_FLASH_ADDR, sizeof(FastJoin_Record));
+
+    return Rec->Magic == FASTJOIN_MAGIC &&
+           Rec->Check == FastJoin_Check(Rec) &&
+           strcmp(Rec->Ssid, ESP_AP_SSID) == 0 &&
+           Rec->Channel >= 1 && Rec->Channel <= 14 &&
+           Rec->Gateway != 0 && Rec->Gateway != Rec->Ip &&
+           ((Rec->Ip ^ Rec->Gateway) & Rec->Netmask) == 0;
+}
+
+
+/**
+ * @name    FastJoin_LeaseOk
+ * @brief   The function tells whether the cached lease may still be applied
+ *              (see FASTJOIN_LEASE_MS)
+ *
+ * @author  Mehdi
+ */
+
+static uint8_t FastJoin_LeaseOk(void)
+{
+    if (!FJ_LeaseKnown)
+    {
+        FJ_LeaseStart = TimeBase_Ms();
+        FJ_LeaseKnown = 1;
+    }
+
+    return (TimeBase_Ms() - FJ_LeaseStart) < FASTJOIN_LEASE_MS;
+}
+
+
+/**
+ * @name    FastJoin_Save
+ * @brief   The function writes the record to flash. The sector is only
+ *              erased when the stored record differs.
+ *
+ * @author  Mehdi
+ *
+ * @param	Rec: the record (Magic and Check are filled in)
+ */
+
+static int8_t FastJoin_Save(FastJoin_Record* Rec)
+{
+    FLASH_EraseInitTypeDef Erase;
+    uint32_t Words[(sizeof(FastJoin_Record) + 3) / 4];
+    uint32_t SectorError;
+    uint16_t i;
+    int8_t res = ESP8266_OK;
+
+    Rec->Magic = FASTJOIN_MAGIC;
+    Rec->Check = FastJoin_Check(Rec);
+
+    if (memcmp(Rec, (const void*)FASTJOIN_FLASH_ADDR, sizeof(FastJoin_Record)) == 0)
+        return ESP8266_OK;
+
+    memset(Words, 0xFF, sizeof(Words));
+    memcpy(Words, Rec, sizeof(FastJoin_Record));
+
+    Erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    Erase.Sector = FASTJOIN_FLASH_SECTOR;
+    Erase.NbSectors = 1;
+    Erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    HAL_FLASH_Unlock();
+
+    if (HAL_FLASHEx_Erase(&Erase, &SectorError) != HAL_OK)
+        res = ESP8266_FAIL;
+
+    for (i = 0; res == ESP8266_OK && i < sizeof(Words) / 4; i++)
+    {
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, FASTJOIN_FLASH_ADDR + 4 * i, Words[i]) != HAL_OK)
+            res = ESP8266_FAIL;
+    }
+
+    HAL_FLASH_Lock();
+
+    return res;
+}
+
+
+/**
+ * @name    FastJoin_ParseIP
+ * @brief   The function converts a dotted quad into a 32 bit address
+ *
+ * @author  Mehdi
+ */
+
+static uint32_t FastJoin_ParseIP(const char* Text)
+{
+    unsigned int ip[4];
+
+    if (Text == NULL || sscanf(Text,"%u.%u.%u.%u",&ip[0],&ip[1],&ip[2],&ip[3]) != 4)
+        return 0;
+
+    return ((uint32_t)ip[0] << 24) | (ip[1] << 16) | (ip[2] << 8) | ip[3];
+}
+
+
+/**
+ * @name    FastJoin_FormatIP
+ * @brief   The function converts a 32 bit address into a dotted quad
+ *
+ * @author  Mehdi
+ */
+
+static void FastJoin_FormatIP(char* Text, uint32_t Ip)
+{
+    sprintf(Text,"%u.%u.%u.%u",(unsigned)(Ip >> 24),(unsigned)((Ip >> 16) & 0xFF),
+            (unsigned)((Ip >> 8) & 0xFF),(unsigned)(Ip & 0xFF));
+}
+
+
+/**
+ * @name    FastJoin_Learn
+ * @brief   The function queries the AP and IP parameters of the current link
+ *              +CWJAP_CUR:"<ssid>","<bssid>",<channel>,<rssi>
+ *              +CIPSTA_CUR:ip:"<ip>" / gateway:"<gw>" / netmask:"<mask>"
+ *
+ * @author  Mehdi
+ *
+ * @param	Rec (Out): the parameters of the link
+ * @return  ESP8266_OK if all the parameters were read
+ */
+
+static int8_t FastJoin_Learn(FastJoin_Record* Rec)
+{
+    unsigned int mac[6], ch;
+    char *Reply, *p;
+    uint8_t i;
+    int8_t res = ESP8266_FAIL;
+
+    memset(Rec, 0, sizeof(FastJoin_Record));
+
+    if ((Reply = BufPool_Get(FASTJOIN_REPLY_LEN,BUFPOOL_FASTJOIN)) == NULL)
+        return ESP8266_FAIL;
+
+    if (ESP_Run(AT_ESP_CWJAP_CUR_Q,NULL,Reply,FASTJOIN_REPLY_LEN) == ESP8266_OK &&
+        (p = strstr(Reply,"+CWJAP_CUR:\"")) != NULL &&
+        sscanf(p,"+CWJAP_CUR:\"%32[^\"]\",\"%x:%x:%x:%x:%x:%x\",%u",Rec->Ssid,
+               &mac[0],&mac[1],&mac[2],&mac[3],&mac[4],&mac[5],&ch) == 8)
+    {
+        for (i = 0; i < 6; i++)
+            Rec->Bssid[i] = mac[i];
+        Rec->Channel = ch;
+
+        if (ESP_Run(AT_ESP_CIPSTA_CUR_Q,NULL,Reply,FASTJOIN_REPLY_LEN) == ESP8266_OK)
+        {
+            if ((p = strstr(Reply,"ip:\"")) != NULL)
+                Rec->Ip = FastJoin_ParseIP(p + 4);
+            if ((p = strstr(Reply,"gateway:\"")) != NULL)
+                Rec->Gateway = FastJoin_ParseIP(p + 9);
+            if ((p = strstr(Reply,"netmask:\"")) != NULL)
+                Rec->Netmask = FastJoin_ParseIP(p + 9);
+            res = ESP8266_OK;
+        }
+    }
+
+    BufPool_Put(Reply);
+
+    if (res != ESP8266_OK)
+        return res;
+
+    return (Rec->Ip != 0 && Rec->Netmask != 0) ? ESP8266_OK : ESP8266_FAIL;
+}
+
+
+/**
+ * @name    FastJoin_Connect
+ * @brief   The function joins ESP_AP_SSID, with the cached parameters if
+ *              possible, and falls back to a full join otherwise.
+ *              The time of each phase is kept in FastJoin_GetTiming().
+ *
+ * @author  Mehdi
+ *
+ * @return  ESP8266_OK when the link is up
+ */
+
+int8_t FastJoin_Connect(void)
+{
+    FastJoin_Record Rec, Seen;
+    char *Args, *Found;
+    char Ip[16], Gw[16], Mask[16], Bssid[18];
+    uint32_t start, t;
+    int8_t res = ESP8266_FAIL;
+
+    memset(&FJ_Timing, 0, sizeof(FJ_Timing));
+    start = t = TimeBase_Ms();
+
+    // The formatted commands; the fast path is skipped if the pool is empty
+    Args = BufPool_Get(FASTJOIN_ARGS_LEN,BUFPOOL_FASTJOIN);
+
+    if (Args == NULL || !FastJoin_Load(&Rec))
+        FJ_Timing.Fallback = FASTJOIN_FALLBACK_RECORD;
+    else if (!FastJoin_LeaseOk())
+        FJ_Timing.Fallback = FASTJOIN_FALLBACK_LEASE;
+
+    if (FJ_Timing.Fallback == FASTJOIN_FALLBACK_NONE)
+    {
+        FJ_Timing.Mode = FASTJOIN_MODE_FAST;
+        FJ_Timing.LoadMs = TimeBase_Ms() - t;
+
+        // The cached AP must be on its channel: scan that channel only
+        t = TimeBase_Ms();
+        snprintf(Bssid,sizeof(Bssid),"%02x:%02x:%02x:%02x:%02x:%02x",Rec.Bssid[0],Rec.Bssid[1],
+                 Rec.Bssid[2],Rec.Bssid[3],Rec.Bssid[4],Rec.Bssid[5]);
+        snprintf(Args,FASTJOIN_ARGS_LEN,"\"%s\",\"%s\",%u",ESP_AP_SSID,Bssid,Rec.Channel);
+        if ((Found = BufPool_Get(ESP_LINE_LEN,BUFPOOL_FASTJOIN)) == NULL ||
+            ESP_Run(AT_ESP_CWLAP,Args,Found,ESP_LINE_LEN) != ESP8266_OK || strstr(Found,"+CWLAP:") == NULL)
+            FJ_Timing.Fallback = FASTJOIN_FALLBACK_SCAN;
+        BufPool_Put(Found);
+        FJ_Timing.ScanMs = TimeBase_Ms() - t;
+    }
+
+    if (FJ_Timing.Fallback == FASTJOIN_FALLBACK_NONE)
+    {
+        // Apply the address of the last lease, so the join skips DHCP
+        t = TimeBase_Ms();
+        FastJoin_FormatIP(Ip,Rec.Ip);
+        FastJoin_FormatIP(Gw,Rec.Gateway);
+        FastJoin_FormatIP(Mask,Rec.Netmask);
+        snprintf(Args,FASTJOIN_ARGS_LEN,"\"%s\",\"%s\",\"%s\"",Ip,Gw,Mask);
+        res = ESP_Run(AT_ESP_CIPSTA_CUR,Args,NULL,0);
+        FJ_Static |= (res == ESP8266_OK);
+        FJ_Timing.StaticIpMs = TimeBase_Ms() - t;
+
+        // Join the cached BSSID
+        if (res == ESP8266_OK)
+        {
+            t = TimeBase_Ms();
+            snprintf(Args,FASTJOIN_ARGS_LEN,"\"%s\",\"%s\",\"%s\"",ESP_AP_SSID,ESP_AP_PWD,Bssid);
+            res = ESP_Run(AT_ESP_CWJAP_CUR,Args,NULL,0);
+            FJ_Timing.AssocMs = TimeBase_Ms() - t;
+        }
+
+        if (res != ESP8266_OK)
+            FJ_Timing.Fallback = FASTJOIN_FALLBACK_JOIN;
+    }
+
+    if (FJ_Timing.Fallback == FASTJOIN_FALLBACK_NONE)
+    {
+        // The gateway answers: the subnet is right and ARP resolves it
+        t = TimeBase_Ms();
+        snprintf(Args,FASTJOIN_ARGS_LEN,"\"%s\"",Gw);
+        if (ESP_Run(AT_ESP_PING,Args,NULL,0) != ESP8266_OK)
+            FJ_Timing.Fallback = FASTJOIN_FALLBACK_GATEWAY;
+        FJ_Timing.CheckMs = TimeBase_Ms() - t;
+    }
+
+    if (FJ_Timing.Fallback == FASTJOIN_FALLBACK_NONE)
+    {
+        // Refresh the record if the AP moved to another channel/BSSID
+        t = TimeBase_Ms();
+        if (FastJoin_Learn(&Seen) == ESP8266_OK &&
+            (memcmp(Seen.Bssid,Rec.Bssid,6) != 0 || Seen.Channel != Rec.Channel))
+            FastJoin_Save(&Seen);
+        FJ_Timing.LearnMs = TimeBase_Ms() - t;
+        FJ_Timing.TotalMs = TimeBase_Ms() - start;
+
+        Status_Post(STATUS_AP_ESTABLISHED,0);
+        BufPool_Put(Args);
+        return ESP8266_OK;
+    }
+
+    if (FJ_Timing.Mode != FASTJOIN_MODE_FAST)
+        FJ_Timing.LoadMs = TimeBase_Ms() - t;
+
+    BufPool_Put(Args);
+
+    // Cached parameters no longer apply: back to DHCP and a full join
+    if (FJ_Static && ESP_Run(AT_ESP_CWDHCP_CUR_ON,NULL,NULL,0) == ESP8266_OK)
+        FJ_Static = 0;
+
+    FJ_Timing.Mode = FASTJOIN_MODE_FULL;
+
+    t = TimeBase_Ms();
+    res = ESP_ConnectToRouter();
+    FJ_Timing.AssocMs = TimeBase_Ms() - t;
+
+    if (res == ESP8266_OK)
+    {
+        t = TimeBase_Ms();
+        if (FastJoin_Learn(&Seen) == ESP8266_OK && FastJoin_Save(&Seen) == ESP8266_OK)
+        {
+            // A new lease
+            FJ_LeaseStart = TimeBase_Ms();
+            FJ_LeaseKnown = 1;
+        }
+        FJ_Timing.LearnMs = TimeBase_Ms() - t;
+    }
+
+    FJ_Timing.TotalMs = TimeBase_Ms() - start;
+
+    return res;
+}
+
+
+/**
+ * @name    FastJoin_Invalidate
+ * @brief   The function drops the cached record (e.g. after a change of AP),
+ *              so the next join is a full join
+ *
+ * @author  Mehdi
+ */
+
+void FastJoin_Invalidate(void)
+{
+    FastJoin_Record Rec;
+
+    // An empty SSID never matches ESP_AP_SSID
+    memset(&Rec, 0, sizeof(Rec));
+    FastJoin_Save(&Rec);
+}
+
+
+/**
+ * @name    FastJoin_GetTiming
+ * @brief   The function returns the time spent in each phase of the last join
+ *
+ * @author  Mehdi
+ */
+
+const FastJoin_Timing* FastJoin_GetTiming(void)
+{
+    return &FJ_Timing;
+}
@@ -0,0 +1,88 @@
+/**
+ @file     FastJoin.h
+ @brief    Fast reconnect of the ESP8266 using the AP parameters and the
+           IP configuration of the last successful join, kept in flash.
+
+ @author   Mehdi
+
+*/
+
+#ifndef FASTJOIN_H_
+#define FASTJOIN_H_
+
+#include <stdint.h>
+
+// Flash sector the record is kept in (last 128 KB sector of a 1 MB STM32F4);
+// the address and the sector are set together
+#ifndef FASTJOIN_FLASH_ADDR
+#define FASTJOIN_FLASH_ADDR			0x080E0000UL
+#endif
+
+#ifndef FASTJOIN_FLASH_SECTOR
+#define FASTJOIN_FLASH_SECTOR		FLASH_SECTOR_11
+#endif
+
+#define FASTJOIN_MAGIC				0x464A4F31UL	// "FJO1"
+
+// Uptime (ms) a cached lease is applied for before a full join renews it
+// with DHCP; half a lease of 24 h, as DHCP renews (T1). The module does
+// not report the lease time and the board has no clock, so a lease found
+// in flash at boot counts from the boot.
+#ifndef FASTJOIN_LEASE_MS
+#define FASTJOIN_LEASE_MS			(12UL * 3600UL * 1000UL)
+#endif
+
+#define FASTJOIN_ARGS_LEN			144		// Arguments of AT+CWJAP_CUR (buffer pool block)
+#define FASTJOIN_REPLY_LEN			(ESP_LINE_LEN * 3)	// Reply of AT+CIPSTA_CUR? (buffer pool block)
+
+// Join Mode
+#define FASTJOIN_MODE_FAST			1		// Cached BSSID and static IP
+#define FASTJOIN_MODE_FULL			2		// Scan, association and DHCP
+
+// Reason of a full join
+#define FASTJOIN_FALLBACK_NONE		0
+#define FASTJOIN_FALLBACK_RECORD	1		// No valid record, or no buffer
+#define FASTJOIN_FALLBACK_LEASE		2		// Lease older than FASTJOIN_LEASE_MS
+#define FASTJOIN_FALLBACK_SCAN		3		// AP not on its cached channel
+#define FASTJOIN_FALLBACK_JOIN		4		// Static IP or association refused
+#define FASTJOIN_FALLBACK_GATEWAY	5		// Cached gateway does not answer
+
+typedef struct
+{
+    uint32_t Magic;
+    char     Ssid[33];
+    uint8_t  Bssid[6];
+    uint8_t  Channel;
+    uint32_t Ip;				// First octet in the MSB
+    uint32_t Gateway;
+    uint32_t Netmask;
+    uint32_t Check;				// FNV-1a of the fields above
+} FastJoin_Record;
+
+// Time spent in each phase of the last join (ms)
+typedef struct
+{
+    uint8_t  Mode;
+    uint32_t LoadMs;			// Read and check the record
+    uint32_t ScanMs;			// AT+CWLAP on the cached channel
+    uint32_t StaticIpMs;		// AT+CIPSTA_CUR
+    uint32_t AssocMs;			// AT+CWJAP_CUR (includes DHCP on a full join)
+    uint32_t CheckMs;			// AT+PING of the cached gateway
+    uint32_t LearnMs;			// Query and store the new parameters
+    uint32_t TotalMs;
+    uint8_t  Fallback;			// Why the fast join was left (FASTJOIN_FALLBACK_xxx)
+} FastJoin_Timing;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+int8_t FastJoin_Connect(void);
+
+void FastJoin_Invalidate(void);
+
+const FastJoin_Timing* FastJoin_GetTiming(void);
+
+
+#endif /* FASTJOIN_H_ */
@@ -0,0 +1,460 @@
+/**
+ @file     HttpPush.c
+ @brief    This file contains the upstream HTTP client of the telemetry
+           samples. It does not block on the server: HttpPush_Put and
+           HttpPush_Poll send when a threshold is reached and return, and
+           the responses are parsed as HttpPush_Input gets them, so
+           HttpPush_Poll should be called from the main loop to honour
+           MaxAgeMs and to reopen the link.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "HttpPush.h"
+#include "ESP8266.h"
+#include "LinkSup.h"
+#include "Uplink.h"
+#include "TimeBase.h"
+
+
+#define HTTPPUSH_MASK				(HTTPPUSH_RING_SIZE - 1)
+
+#if HTTPPUSH_LINK == UPLINK_WIFI_LINK
+#error "HTTPPUSH_LINK and UPLINK_WIFI_LINK must be different links"
+#endif
+
+#define HTTPPUSH_HEADER				"POST %s HTTP/1.1\r\n"							\
+                                    "Host: %s\r\n"									\
+                                    "Content-Type: " HTTPPUSH_TYPE "\r\n"			\
+                                    "Content-Length: %u\r\n\r\n"
+
+// States of the response parser
+#define HTTPPUSH_RX_STATUS			0
+#define HTTPPUSH_RX_HEADERS			1
+#define HTTPPUSH_RX_BODY			2
+
+
+/**
+ * @name    HttpPush_Init
+ * @brief   The function sets up a client; the link is opened with the
+ *              first request
+ *
+ * @author  Mehdi
+ *
+ * @param	Push: the client
+ * @param	Ops: the operations on the link
+ * @param	Host: the server (AT+CIPSTART and the Host header)
+ * @param	Port: its port
+ * @param	Path: the path the samples are posted to
+ * @param	MaxBytes: unsent bytes that trigger a request (up to HTTPPUSH_RING_SIZE)
+ * @param	MaxAgeMs: age of the oldest unsent sample that triggers a request
+ */
+
+void HttpPush_Init(HttpPush* Push, const HttpPush_Ops* Ops, const char* Host, uint16_t Port, const char* Path,
+                   uint16_t MaxBytes, uint16_t MaxAgeMs)
+{
+    memset(Push, 0, sizeof(HttpPush));
+
+    Push->Ops = Ops;
+    Push->Host = Host;
+    Push->Port = Port;
+    Push->Path = Path;
+    Push->MaxBytes = (MaxBytes == 0 || MaxBytes > HTTPPUSH_RING_SIZE) ? HTTPPUSH_RING_SIZE : MaxBytes;
+    Push->MaxAgeMs = MaxAgeMs;
+}
+
+
+/**
+ * @name    HttpPush_Drop
+ * @brief   The function closes the link. The requests not answered go
+ *              back to the unsent samples, to be sent again once the link
+ *              is open.
+ *
+ * @author  Mehdi
+ *
+ * @param	Backoff: 1 to wait before the next open (the link failed)
+ */
+
+static void HttpPush_Drop(HttpPush* Push, uint8_t Backoff)
+{
+    uint8_t i;
+
+    if (Push->Up)
+        Push->Ops->Close(HTTPPUSH_LINK);
+
+    if (Push->Pending != 0)
+    {
+        Push->Stat.Resent += Push->Pending;
+        Push->First = Push->Flight[0].First;
+        for (i = 0; i < Push->Pending; i++)
+            Push->Queued += Push->Flight[i].Samples;
+    }
+
+    Push->Sent = Push->Tail;
+    Push->Pending = 0;
+    Push->Up = 0;
+    Push->RxState = HTTPPUSH_RX_STATUS;
+    Push->RxLen = 0;
+
+    if (Backoff)
+    {
+        if (Push->Attempt < 255)
+            Push->Attempt++;
+        Push->RetryAt = TimeBase_Ms() + LinkSup_Backoff(Push->Attempt);
+    }
+}
+
+
+/**
+ * @name    HttpPush_Connect
+ * @brief   The function opens the link unless it is open or the backoff
+ *              of the last failure is not over
+ *
+ * @author  Mehdi
+ *
+ * @return	HTTPPUSH_OK or HTTPPUSH_FAIL
+ */
+
+static int8_t HttpPush_Connect(HttpPush* Push)
+{
+    if (Push->Up)
+        return HTTPPUSH_OK;
+
+    if (Push->Attempt != 0 && (int32_t)(TimeBase_Ms() - Push->RetryAt) < 0)
+        return HTTPPUSH_FAIL;
+
+    if (Push->Ops->Open(HTTPPUSH_LINK, Push->Host, Push->Port) != ESP8266_OK)
+    {
+        Push->Stat.ConnectFails++;
+        HttpPush_Drop(Push, 1);
+        return HTTPPUSH_FAIL;
+    }
+
+    Push->Stat.Connects++;
+    Push->Up = 1;
+
+    return HTTPPUSH_OK;
+}
+
+
+/**
+ * @name    HttpPush_Flush
+ * @brief   The function sends the unsent samples as one request, if any.
+ *              With HTTPPUSH_PIPELINE requests waiting for their response
+ *              the samples wait for the next one to come.
+ *
+ * @author  Mehdi
+ *
+ * @return	HTTPPUSH_OK (sent, or waiting for a response) or HTTPPUSH_FAIL
+ */
+
+int8_t HttpPush_Flush(HttpPush* Push)
+{
+    char Head[HTTPPUSH_HEAD_LEN];
+    const uint8_t* Data[3];
+    uint16_t Len[3], Body = Push->Head - Push->Sent, Off = Push->Sent & HTTPPUSH_MASK;
+    HttpPush_Request* Req;
+    int8_t res;
+    int n;
+
+    if (Body == 0 || Push->Pending == HTTPPUSH_PIPELINE)
+        return HTTPPUSH_OK;
+
+    if (HttpPush_Connect(Push) != HTTPPUSH_OK)
+        return HTTPPUSH_FAIL;
+
+    n = snprintf(Head, sizeof(Head), HTTPPUSH_HEADER, Push->Path, Push->Host, Body);
+    if (n >= (int)sizeof(Head))
+        return HTTPPUSH_FAIL;
+
+    // The header and the body, which may wrap around the ring
+    Data[0] = (const uint8_t*)Head;
+    Len[0] = n;
+    Data[1] = Push->Ring + Off;
+    Len[1] = (Body < HTTPPUSH_RING_SIZE - Off) ? Body : HTTPPUSH_RING_SIZE - Off;
+    Data[2] = Push->Ring;
+    Len[2] = Body - Len[1];
+
+    if ((res = Push->Ops->Send(HTTPPUSH_LINK, Data, Len, (Len[2] != 0) ? 3 : 2)) != ESP8266_OK)
+    {
+        /* Busy: the link is sound, the samples go with the next try */
+        if (res != ESP8266_BUSY)
+            HttpPush_Drop(Push, 1);
+        return HTTPPUSH_FAIL;
+    }
+
+    Req = &Push->Flight[Push->Pending++];
+    Req->Bytes = Body;
+    Req->Samples = Push->Queued;
+    Req->First = Push->First;
+    Req->SentAt = TimeBase_Ms();
+
+    Push->Sent = Push->Head;
+    Push->Queued = 0;
+    Push->Stat.Requests++;
+    Push->Stat.Bytes += Body;
+
+    return HTTPPUSH_OK;
+}
+
+
+/**
+ * @name    HttpPush_Trigger
+ * @brief   The function sends the unsent samples if they reached MaxBytes
+ *              or the oldest is MaxAgeMs old
+ *
+ * @author  Mehdi
+ *
+ * @return	HTTPPUSH_OK or HTTPPUSH_FAIL
+ */
+
+static int8_t HttpPush_Trigger(HttpPush* Push)
+{
+    uint16_t Unsent = Push->Head - Push->Sent;
+    uint32_t* Count;
+    int8_t res;
+
+    if (Unsent == 0 || Push->Pending == HTTPPUSH_PIPELINE)
+        return HTTPPUSH_OK;
+
+    if (Unsent >= Push->MaxBytes)
+        Count = &Push->Stat.BySize;
+    else if ((TimeBase_Ms() - Push->First) >= Push->MaxAgeMs)
+        Count = &Push->Stat.ByAge;
+    else
+        return HTTPPUSH_OK;
+
+    if ((res = HttpPush_Flush(Push)) == HTTPPUSH_OK)
+        (*Count)++;
+
+    return res;
+}
+
+
+/**
+ * @name    HttpPush_Put
+ * @brief   The function appends a sample. The unsent samples are sent when
+ *              they reach MaxBytes or when MaxAgeMs is 0.
+ *
+ * @author  Mehdi
+ *
+ * @return	HTTPPUSH_OK, HTTPPUSH_TOO_LONG, HTTPPUSH_FULL or HTTPPUSH_FAIL
+ *              (the sample is kept)
+ */
+
+int8_t HttpPush_Put(HttpPush* Push, const void* Sample, uint16_t Len)
+{
+    uint16_t Off = Push->Head & HTTPPUSH_MASK, n;
+
+    if (Len > Push->MaxBytes)
+        return HTTPPUSH_TOO_LONG;
+
+    if ((uint16_t)(Push->Head - Push->Tail) + Len > HTTPPUSH_RING_SIZE)
+    {
+        Push->Stat.Dropped++;
+        return HTTPPUSH_FULL;
+    }
+
+    n = (Len < HTTPPUSH_RING_SIZE - Off) ? Len : HTTPPUSH_RING_SIZE - Off;
+    memcpy(Push->Ring + Off, Sample, n);
+    memcpy(Push->Ring, (const uint8_t*)Sample + n, Len - n);
+
+    if (Push->Queued++ == 0)
+        Push->First = TimeBase_Ms();
+
+    Push->Head += Len;
+    Push->Stat.Samples++;
+
+    return HttpPush_Trigger(Push);
+}
+
+
+/**
+ * @name    HttpPush_Poll
+ * @brief   The function sends the unsent samples once the oldest one is
+ *              MaxAgeMs old; samples of a closed link are sent again once
+ *              its backoff is over. A link whose oldest request waits for
+ *              its response for HTTPPUSH_RESPONSE_MS is closed, so that
+ *              the requests are sent again on a new one.
+ *
+ * @author  Mehdi
+ *
+ * @return	HTTPPUSH_OK or HTTPPUSH_FAIL
+ */
+
+int8_t HttpPush_Poll(HttpPush* Push)
+{
+    if (Push->Pending != 0 && (TimeBase_Ms() - Push->Flight[0].SentAt) >= HTTPPUSH_RESPONSE_MS)
+    {
+        Push->Stat.Timeouts++;
+        HttpPush_Drop(Push, 1);
+    }
+
+    return HttpPush_Trigger(Push);
+}
+
+
+/**
+ * @name    HttpPush_Done
+ * @brief   The function ends the response of the oldest request: 2xx
+ *              acknowledges its samples, 3xx and 4xx drop them, 5xx closes
+ *              the link so that they are sent again. An interim response
+ *              (1xx) is skipped.
+ *
+ * @author  Mehdi
+ */
+
+static void HttpPush_Done(HttpPush* Push)
+{
+    HttpPush_Request Req = Push->Flight[0];
+    uint32_t Latency;
+
+    Push->RxState = HTTPPUSH_RX_STATUS;
+
+    if (Push->RxStatus < 200)
+        return;
+
+    if (Push->RxStatus >= 500)
+    {
+        HttpPush_Drop(Push, 1);
+        return;
+    }
+
+    Push->Pending--;
+    memmove(Push->Flight, Push->Flight + 1, Push->Pending * sizeof(HttpPush_Request));
+    Push->Tail += Req.Bytes;
+
+    if (Push->RxStatus < 300)
+    {
+        Push->Stat.Acked += Req.Samples;
+        Push->Attempt = 0;
+
+        Latency = TimeBase_Ms() - Req.First;
+        if (Latency > Push->Stat.MaxLatencyMs)
+            Push->Stat.MaxLatencyMs = Latency;
+    } else
+        Push->Stat.Rejected += Req.Samples;
+
+    if (Push->RxClose)
+        HttpPush_Drop(Push, 0);
+    else
+        HttpPush_Trigger(Push);
+}
+
+
+/**
+ * @name    HttpPush_Line
+ * @brief   The function takes a line of the status or the headers of a
+ *              response
+ *
+ * @author  Mehdi
+ */
+
+static void HttpPush_Line(HttpPush* Push)
+{
+    const char* Line = Push->RxLine;
+    const char* p;
+
+    if (Push->RxState == HTTPPUSH_RX_STATUS)
+    {
+        /* HTTP/1.1 200 OK; a 1.0 server closes after the response */
+        if (strncmp(Line, "HTTP/1.", 7) == 0 && Push->RxLen >= 12)
+        {
+            Push->RxStatus = atoi(Line + 9);
+            Push->RxClose = (Line[7] == '0');
+            Push->RxBody = 0;
+            Push->RxState = HTTPPUSH_RX_HEADERS;
+        }
+        return;
+    }
+
+    if (Push->RxLen == 0)
+    {
+        if (Push->RxBody == 0)
+            HttpPush_Done(Push);
+        else
+            Push->RxState = HTTPPUSH_RX_BODY;
+    } else if (strncasecmp(Line, "Content-Length:", 15) == 0)
+    {
+        Push->RxBody = strtoul(Line + 15, NULL, 10);
+    } else if (strncasecmp(Line, "Connection:", 11) == 0)
+    {
+        for (p = Line + 11; *p == ' '; p++)
+            ;
+        Push->RxClose = (strncasecmp(p, "close", 5) == 0);
+    }
+}
+
+
+/**
+ * @name    HttpPush_Input
+ * @brief   The function takes data received on the link (+IPD,<link>):
+ *              the responses to the requests, in order
+ *
+ * @author  Mehdi
+ *
+ * @param	Data: the data
+ * @param	Len: its length
+ */
+
+void HttpPush_Input(HttpPush* Push, const uint8_t* Data, uint16_t Len)
+{
+    uint32_t n;
+    char c;
+
+    while (Len != 0 && Push->Pending != 0)
+    {
+        if (Push->RxState == HTTPPUSH_RX_BODY)
+        {
+            n = (Len < Push->RxBody) ? Len : Push->RxBody;
+            Data += n;
+            Len -= n;
+            if ((Push->RxBody -= n) == 0)
+                HttpPush_Done(Push);
+            continue;
+        }
+
+        c = *Data++;
+        Len--;
+
+        if (c != '\n')
+        {
+            if (c != '\r' && Push->RxLen < sizeof(Push->RxLine) - 1)
+                Push->RxLine[Push->RxLen++] = c;
+            continue;
+        }
+
+        Push->RxLine[Push->RxLen] = '\0';
+        HttpPush_Line(Push);
+        Push->RxLen = 0;
+    }
+}
+
+
+/**
+ * @name    HttpPush_Closed
+ * @brief   The function takes the close of the link ("<link>,CLOSED"):
+ *              the requests not answered are sent again on the next link
+ *
+ * @author  Mehdi
+ */
+
+void HttpPush_Closed(HttpPush* Push)
+{
+    if (!Push->Up)
+        return;
+
+    /* Nothing to close any more */
+    Push->Up = 0;
+
+    HttpPush_Drop(Push, Push->Pending != 0);
+}
@@ -0,0 +1,159 @@
+/**
+ @file     HttpPush.h
+ @brief    HTTP client of the ESP8266 that pushes telemetry samples
+           upstream over one persistent TCP link. Samples wait in a ring
+           and leave as the body of one POST when the unsent bytes reach
+           MaxBytes or the oldest unsent sample is MaxAgeMs old, so the
+           TCP handshake is paid once per connection, not once per sample.
+
+           Up to HTTPPUSH_PIPELINE requests are sent before the first
+           response arrives (HTTP/1.1 pipelining); a sample leaves the
+           ring only when the server answered its request with 2xx. When
+           the link closes (or a request fails, or the server answers 5xx)
+           the link is opened again after a backoff and the requests not
+           answered are sent again, in order. A request not answered
+           within HTTPPUSH_RESPONSE_MS is taken as a dead link the same
+           way (the module may never report the close of a half-open
+           TCP connection).
+
+           The responses come through the server loop of the application:
+               n = ESP_ReadIPD(&Link,Buf,sizeof(Buf),Timeout);
+               if (Link == HTTPPUSH_LINK && n > 0)
+                   HttpPush_Input(&Push,Buf,n);
+               else if (Link == HTTPPUSH_LINK && n == ESP8266_CLOSED)
+                   HttpPush_Closed(&Push);
+           The server must answer with a Content-Length (or no body).
+
+           Samples are concatenated as given: use one line per sample
+           (e.g. one JSON object per line).
+
+ @author   Mehdi
+
+*/
+
+#ifndef HTTPPUSH_H_
+#define HTTPPUSH_H_
+
+#include <stdint.h>
+
+// Configuration
+#ifndef HTTPPUSH_RING_SIZE
+#define HTTPPUSH_RING_SIZE			512		// Samples not yet acknowledged (power of 2)
+#endif
+
+#ifndef HTTPPUSH_LINK
+#define HTTPPUSH_LINK				3		// Reserved link: the server takes the incoming links from 0, the uplink 4
+#endif
+
+#ifndef HTTPPUSH_PIPELINE
+#define HTTPPUSH_PIPELINE			2		// Requests sent and not yet answered
+#endif
+
+#ifndef HTTPPUSH_RESPONSE_MS
+#define HTTPPUSH_RESPONSE_MS		10000	// Longest wait for the response of a request
+#endif
+
+#ifndef HTTPPUSH_TYPE
+#define HTTPPUSH_TYPE				"application/x-ndjson"
+#endif
+
+#define HTTPPUSH_HEAD_LEN			160		// Header of a request: the path and the host must fit
+#define HTTPPUSH_LINE_LEN			48		// The part of a response line kept
+
+#if (HTTPPUSH_RING_SIZE & (HTTPPUSH_RING_SIZE - 1)) != 0 || HTTPPUSH_RING_SIZE + HTTPPUSH_HEAD_LEN > 2048
+#error "HTTPPUSH_RING_SIZE must be a power of 2 and a request must fit one AT+CIPSEND"
+#endif
+
+// Results
+#define HTTPPUSH_OK					 1
+#define HTTPPUSH_TOO_LONG			-1		// Sample larger than MaxBytes
+#define HTTPPUSH_FAIL				-2		// Not sent now: the link is down (the samples wait)
+#define HTTPPUSH_FULL				-3		// The ring is full: the sample is dropped
+
+// Operations on the link; ESP_TcpOpen, ESP_SendParts and ESP_Close,
+// or wrappers of them (tools/PushBench.c times them).
+typedef struct
+{
+    int8_t (*Open)(uint8_t Link, const char* Host, uint16_t Port);
+    int8_t (*Send)(uint8_t Link, const uint8_t* const* Data, const uint16_t* Len, uint8_t Count);
+    int8_t (*Close)(uint8_t Link);
+} HttpPush_Ops;
+
+typedef struct
+{
+    uint16_t Bytes;				// Body of the request
+    uint16_t Samples;
+    uint32_t First;				// Time the oldest of its samples was put
+    uint32_t SentAt;			// Time it was sent (HTTPPUSH_RESPONSE_MS)
+} HttpPush_Request;
+
+typedef struct
+{
+    uint32_t Samples;
+    uint32_t Dropped;			// Samples refused: the ring was full
+    uint32_t Requests;
+    uint32_t Bytes;				// Body bytes sent
+    uint32_t BySize;			// Requests sent because MaxBytes was reached
+    uint32_t ByAge;				// Requests sent because MaxAgeMs elapsed
+    uint32_t Acked;				// Samples the server took (2xx)
+    uint32_t Rejected;			// Samples of the requests answered 4xx (dropped)
+    uint32_t Resent;			// Requests sent again after the link failed
+    uint32_t Timeouts;			// Links closed because a response was late
+    uint32_t Connects;
+    uint32_t ConnectFails;
+    uint32_t MaxLatencyMs;		// Longest time from the put of a sample to its 2xx
+} HttpPush_Stat;
+
+typedef struct
+{
+    const HttpPush_Ops* Ops;
+    const char*      Host;
+    const char*      Path;
+    uint16_t         Port;
+    uint16_t         MaxBytes;
+    uint16_t         MaxAgeMs;		// 0: every sample is sent at once
+
+    uint8_t          Up;			// The link is open
+    uint8_t          Attempt;		// Failed opens in a row
+    uint32_t         RetryAt;		// Time of the next open
+
+    uint8_t          Ring[HTTPPUSH_RING_SIZE];
+    uint16_t         Tail;			// Oldest sample not acknowledged (free running)
+    uint16_t         Sent;			// Oldest sample not sent
+    uint16_t         Head;
+    uint16_t         Queued;		// Samples not sent
+    uint32_t         First;			// Time the oldest sample not sent was put
+
+    HttpPush_Request Flight[HTTPPUSH_PIPELINE];
+    uint8_t          Pending;		// Requests sent and not answered
+
+    uint8_t          RxState;
+    uint8_t          RxClose;		// The server closes after the response
+    uint16_t         RxStatus;
+    uint32_t         RxBody;		// Body bytes of the response left
+    char             RxLine[HTTPPUSH_LINE_LEN];
+    uint8_t          RxLen;
+
+    HttpPush_Stat    Stat;
+} HttpPush;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void HttpPush_Init(HttpPush* Push, const HttpPush_Ops* Ops, const char* Host, uint16_t Port, const char* Path,
+                   uint16_t MaxBytes, uint16_t MaxAgeMs);
+
+int8_t HttpPush_Put(HttpPush* Push, const void* Sample, uint16_t Len);
+
+int8_t HttpPush_Poll(HttpPush* Push);
+
+int8_t HttpPush_Flush(HttpPush* Push);
+
+void HttpPush_Input(HttpPush* Push, const uint8_t* Data, uint16_t Len);
+
+void HttpPush_Closed(HttpPush* Push);
+
+
+#endif /* HTTPPUSH_H_ */
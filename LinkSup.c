@@ -0,0 +1,245 @@
+/**
+ @file     LinkSup.c
+ @brief    This file contains the link supervisor of the ESP8266.
+           A failed command is classified (timeout, ERROR, Wi-Fi drop,
+           module reset) and only the recovery steps needed for that
+           class are re-run, with bounded exponential backoff and jitter
+           between attempts.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "TimeBase.h"
+
+#include "ESP8266.h"
+#include "LinkSup.h"
+#include "FastJoin.h"
+#include "StatusSink.h"
+
+
+#if LINKSUP_MAX_ATTEMPTS > 255
+#error "LINKSUP_MAX_ATTEMPTS: 255 at most"
+#endif
+
+// Minimal recovery sequence of each fault class
+static const uint8_t LinkSup_Steps[LINK_FAULT_COUNT] =
+{
+    [LINK_FAULT_NONE]         = 0,
+    [LINK_FAULT_TIMEOUT]      = LINK_STEP_PROBE,
+    [LINK_FAULT_ERROR]        = LINK_STEP_PROBE,
+    [LINK_FAULT_WIFI_DROP]    = LINK_STEP_PROBE | LINK_STEP_JOIN,
+    [LINK_FAULT_MODULE_RESET] = LINK_STEP_PROBE | LINK_STEP_JOIN | LINK_STEP_MUX | LINK_STEP_SERVER,
+};
+
+static void LinkSup_Delay(uint32_t ms)
+{
+    TimeBase_Delay(TIMEBASE_MS(ms));
+}
+
+static uint32_t LinkSup_Now(void)
+{
+    return TimeBase_Ms();
+}
+
+static const LinkSup_Ops LinkSup_DefaultOps =
+{
+    ESP_Probe,
+    FastJoin_Connect,
+    ESP_EnableMux,
+    ESP_EnableServer,
+    ESP_GetLastFault,
+    LinkSup_Delay,
+    LinkSup_Now
+};
+
+static const LinkSup_Ops* LinkSup_Op = &LinkSup_DefaultOps;
+static LinkSup_Metrics LinkSup_Stat;
+static uint32_t LinkSup_Seed;
+
+
+/**
+ * @name    LinkSup_SetOps
+ * @brief   The function replaces the operations used by the supervisor
+ *
+ * @author  Mehdi
+ *
+ * @param	Ops: the operations (NULL restores the ESP8266 driver)
+ */
+
+void LinkSup_SetOps(const LinkSup_Ops* Ops)
+{
+    LinkSup_Op = (Ops != NULL) ? Ops : &LinkSup_DefaultOps;
+}
+
+
+/**
+ * @name    LinkSup_Classify
+ * @brief   The function classifies the reply of a failed command
+ *
+ * @author  Mehdi
+ *
+ * @param	Response: the reply received from the module ("" if nothing arrived)
+ * @return  one of LINK_FAULT_xxx
+ */
+
+uint8_t LinkSup_Classify(const char* Response)
+{
+    if (Response == NULL || Response[0] == '\0')
+        return LINK_FAULT_TIMEOUT;
+
+    // Boot banner of the module
+    if (strstr(Response,"ready") != NULL || strstr(Response,"rst cause") != NULL)
+        return LINK_FAULT_MODULE_RESET;
+
+    if (strstr(Response,"WIFI DISCONNECT") != NULL || strstr(Response,"No AP") != NULL ||
+        strstr(Response,"+CWJAP:") != NULL)
+        return LINK_FAULT_WIFI_DROP;
+
+    return LINK_FAULT_ERROR;
+}
+
+
+/**
+ * @name    LinkSup_Backoff
+ * @brief   The function computes the wait before a given attempt:
+ *              base * 2^(Attempt-1), bounded by LINKSUP_BACKOFF_MAX_MS,
+ *              of which the upper half is randomized
+ *
+ * @author  Mehdi
+ *
+ * @param	Attempt: number of the failed attempts so far (1..)
+ * @return  the wait time (ms)
+ */
+
+uint32_t LinkSup_Backoff(uint8_t Attempt)
+{
+    uint32_t delay = LINKSUP_BACKOFF_MAX_MS;
+
+    if (Attempt == 0)
+        return 0;
+
+    if (Attempt <= 16 && (LINKSUP_BACKOFF_BASE_MS << (Attempt - 1)) < LINKSUP_BACKOFF_MAX_MS)
+        delay = LINKSUP_BACKOFF_BASE_MS << (Attempt - 1);
+
+    // xorshift32, so two nodes losing the same AP do not retry in lock step
+    if (LinkSup_Seed == 0)
+        LinkSup_Seed = LinkSup_Op->Now() | 1;
+    LinkSup_Seed ^= LinkSup_Seed << 13;
+    LinkSup_Seed ^= LinkSup_Seed >> 17;
+    LinkSup_Seed ^= LinkSup_Seed << 5;
+
+    return delay / 2 + LinkSup_Seed % (delay / 2 + 1);
+}
+
+
+/**
+ * @name    LinkSup_RunSteps
+ * @brief   The function runs the given recovery steps in order
+ *
+ * @author  Mehdi
+ *
+ * @param	Steps: the LINK_STEP_xxx to run
+ * @return  LINK_FAULT_NONE if all steps passed, else the fault of the failed step
+ */
+
+static uint8_t LinkSup_RunSteps(uint8_t Steps)
+{
+    uint8_t fault;
+
+    if ((Steps & LINK_STEP_PROBE) && LinkSup_Op->Probe() != ESP8266_OK)
+        goto failed;
+    if ((Steps & LINK_STEP_JOIN) && LinkSup_Op->Join() != ESP8266_OK)
+        goto failed;
+    if ((Steps & LINK_STEP_MUX) && LinkSup_Op->EnableMux() != ESP8266_OK)
+        goto failed;
+    if ((Steps & LINK_STEP_SERVER) && LinkSup_Op->EnableServer() != ESP8266_OK)
+        goto failed;
+
+    return LINK_FAULT_NONE;
+
+failed:
+    fault = LinkSup_Op->LastFault();
+    return (fault != LINK_FAULT_NONE && fault < LINK_FAULT_COUNT) ? fault : LINK_FAULT_ERROR;
+}
+
+
+/**
+ * @name    LinkSup_Recover
+ * @brief   The function brings the link back after a failure. It runs the
+ *              minimal recovery sequence of the fault, adds the steps of
+ *              any further fault seen on the way, and escalates to the full
+ *              sequence after LINKSUP_ESCALATE_AFTER failed attempts.
+ *
+ * @author  Mehdi
+ *
+ * @param	Fault: the class of the failure (LINK_FAULT_xxx)
+ * @return  ESP8266_OK when recovered, ESP8266_FAIL if LINKSUP_MAX_ATTEMPTS is reached
+ */
+
+int8_t LinkSup_Recover(uint8_t Fault)
+{
+    uint32_t start, elapsed;
+    uint8_t steps, failed;
+    uint8_t attempt = 0;
+
+    if (Fault == LINK_FAULT_NONE || Fault >= LINK_FAULT_COUNT)
+        return ESP8266_OK;
+
+    LinkSup_Stat.Faults[Fault]++;
+    Status_Post(STATUS_LINK_RECOVERING,Fault);
+
+    start = LinkSup_Op->Now();
+    steps = LinkSup_Steps[Fault];
+
+    while ((failed = LinkSup_RunSteps(steps)) != LINK_FAULT_NONE)
+    {
+        if (attempt < UINT8_MAX)		// Saturates when it never gives up
+            attempt++;
+        LinkSup_Stat.Retries++;
+
+#if LINKSUP_MAX_ATTEMPTS != 0
+        if (attempt >= LINKSUP_MAX_ATTEMPTS)
+        {
+            LinkSup_Stat.GiveUps++;
+            return ESP8266_FAIL;
+        }
+#endif
+
+        steps |= LinkSup_Steps[failed];
+        if (attempt >= LINKSUP_ESCALATE_AFTER)
+            steps |= LinkSup_Steps[LINK_FAULT_MODULE_RESET];
+
+        LinkSup_Op->Wait(LinkSup_Backoff(attempt));
+    }
+
+    elapsed = LinkSup_Op->Now() - start;
+
+    LinkSup_Stat.Recoveries++;
+    LinkSup_Stat.LastRecoveryMs = elapsed;
+    LinkSup_Stat.TotalRecoveryMs += elapsed;
+    if (elapsed > LinkSup_Stat.MaxRecoveryMs)
+        LinkSup_Stat.MaxRecoveryMs = elapsed;
+
+    Status_Post(STATUS_LINK_RECOVERED,elapsed);
+
+    return ESP8266_OK;
+}
+
+
+/**
+ * @name    LinkSup_GetMetrics
+ * @brief   The function returns the fault and recovery time counters
+ *
+ * @author  Mehdi
+ */
+
+const LinkSup_Metrics* LinkSup_GetMetrics(void)
+{
+    return &LinkSup_Stat;
+}
@@ -0,0 +1,93 @@
+/**
+ @file     LinkSup.h
+ @brief    Link supervisor of the ESP8266. It classifies failures and
+           recovers the link with bounded exponential backoff instead
+           of halting the board.
+
+ @author   Mehdi
+
+*/
+
+#ifndef LINKSUP_H_
+#define LINKSUP_H_
+
+#include <stdint.h>
+
+#include "AuxLib.h"
+
+// Backoff configuration (ms)
+#ifndef LINKSUP_BACKOFF_BASE_MS
+#define LINKSUP_BACKOFF_BASE_MS		250
+#endif
+
+#ifndef LINKSUP_BACKOFF_MAX_MS
+#define LINKSUP_BACKOFF_MAX_MS		30000
+#endif
+
+// Number of failed attempts after which the full recovery sequence is run
+#ifndef LINKSUP_ESCALATE_AFTER
+#define LINKSUP_ESCALATE_AFTER		3
+#endif
+
+// Number of attempts before LinkSup_Recover gives up and returns the
+// failure to its caller (0: never give up). With the default the waits
+// add up to 32 s at most.
+#ifndef LINKSUP_MAX_ATTEMPTS
+#define LINKSUP_MAX_ATTEMPTS		8
+#endif
+
+// Fault Classes
+#define LINK_FAULT_NONE				0
+#define LINK_FAULT_TIMEOUT			1
+#define LINK_FAULT_ERROR			2
+#define LINK_FAULT_WIFI_DROP		3
+#define LINK_FAULT_MODULE_RESET		4
+#define LINK_FAULT_COUNT			5
+
+// Recovery Steps
+#define LINK_STEP_PROBE				BIT(0)		// "AT" answers
+#define LINK_STEP_JOIN				BIT(1)		// Rejoin the AP
+#define LINK_STEP_MUX				BIT(2)		// AT+CIPMUX=1
+#define LINK_STEP_SERVER			BIT(3)		// AT+CIPSERVER=1,80
+
+typedef struct
+{
+    uint32_t Faults[LINK_FAULT_COUNT];	// Number of faults per class
+    uint32_t Recoveries;				// Successful recoveries
+    uint32_t Retries;					// Failed recovery attempts
+    uint32_t GiveUps;					// Recoveries abandoned (LINKSUP_MAX_ATTEMPTS)
+    uint32_t LastRecoveryMs;
+    uint32_t MaxRecoveryMs;
+    uint32_t TotalRecoveryMs;
+} LinkSup_Metrics;
+
+// Operations used by the supervisor; replaced by a fault-injecting
+// stand-in when the supervisor runs against a host modem model.
+typedef struct
+{
+    int8_t   (*Probe)(void);
+    int8_t   (*Join)(void);
+    int8_t   (*EnableMux)(void);
+    int8_t   (*EnableServer)(void);
+    uint8_t  (*LastFault)(void);
+    void     (*Wait)(uint32_t ms);
+    uint32_t (*Now)(void);
+} LinkSup_Ops;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void LinkSup_SetOps(const LinkSup_Ops* Ops);
+
+uint8_t LinkSup_Classify(const char* Response);
+
+int8_t LinkSup_Recover(uint8_t Fault);
+
+uint32_t LinkSup_Backoff(uint8_t Attempt);
+
+const LinkSup_Metrics* LinkSup_GetMetrics(void);
+
+
+#endif /* LINKSUP_H_ */
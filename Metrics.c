@@ -0,0 +1,395 @@
+/**
+ @file     Metrics.c
+ @brief    This file contains the /metrics and /status endpoints. The
+           renderers write through Metrics_Put, which fills the payload of
+           one HTTP chunk in a buffer pool block and sends it with
+           AT+CIPSEND when it is full. The block keeps room for the chunk
+           size before the payload and for the chunk end after it; the
+           first one also carries the HTTP header, the last one the zero
+           chunk, so no CIPSEND is spent on framing alone.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "Metrics.h"
+#include "ESP8266.h"
+#include "ATCmd.h"
+#include "LinkSup.h"
+#include "BufPool.h"
+#include "TimeBase.h"
+
+
+#define METRICS_SIZE_LEN	6		// "XXXX\r\n" before the payload
+#define METRICS_END_LEN		8		// "\r\n", the zero chunk "0\r\n\r\n" and the NUL after it
+#define METRICS_LINE_LEN	96		// One formatted line
+
+#if METRICS_CHUNK_LEN > BUFPOOL_LARGE_SIZE
+#error "METRICS_CHUNK_LEN must fit a buffer pool block"
+#endif
+
+#define METRICS_HTTP_HEADER	"HTTP/1.1 200 OK\r\n"							\
+                            "Content-Type: %s\r\n"							\
+                            "Transfer-Encoding: chunked\r\n"				\
+                            "Connection: close\r\n\r\n"
+
+typedef struct
+{
+    char*    Buf;
+    uint16_t Base;				// Bytes before the chunk (the HTTP header of the first one)
+    uint16_t Len;				// Payload of the chunk
+    int8_t   Result;			// ESP8266_OK until a send fails
+    uint8_t  Next;				// JSON: a member was written, the next one needs a comma
+    char     Link[4];
+} Metrics_Out;
+
+// Per-command families, each one a group of lines as Prometheus wants
+typedef struct
+{
+    const char* Name;
+    const char* Type;
+    uint8_t     Offset;			// Field of ATCmd_Stat
+} Metrics_CmdFamily;
+
+static const Metrics_CmdFamily Metrics_CmdFamilies[] =
+{
+    { "at_commands_total",          "counter", offsetof(ATCmd_Stat,Count)   },
+    { "at_command_failures_total",  "counter", offsetof(ATCmd_Stat,Fail)    },
+    { "at_command_timeouts_total",  "counter", offsetof(ATCmd_Stat,Timeout) },
+    { "at_command_latency_max_ms",  "gauge",   offsetof(ATCmd_Stat,MaxMs)   },
+};
+
+#define METRICS_CMD_NAME(Id, Text, Term, Args, Expect, Tmo)	[AT_##Id] = #Id,
+static const char* const Metrics_CmdName[AT_CMD_COUNT] =
+{
+    AT_CMD_TABLE(METRICS_CMD_NAME)
+};
+#undef METRICS_CMD_NAME
+
+static const char* const Metrics_FaultName[LINK_FAULT_COUNT] =
+{
+    [LINK_FAULT_TIMEOUT]      = "timeout",
+    [LINK_FAULT_ERROR]        = "error",
+    [LINK_FAULT_WIFI_DROP]    = "wifi_drop",
+    [LINK_FAULT_MODULE_RESET] = "module_reset",
+};
+
+static const char* const Metrics_PoolName[BUFPOOL_CLASSES] =
+{
+    [BUFPOOL_SMALL] = "small",
+    [BUFPOOL_LARGE] = "large",
+};
+
+
+/**
+ * @name    Metrics_Flush
+ * @brief   The function frames the payload as a chunk and sends the block
+ *
+ * @author  Mehdi
+ *
+ * @param	Last: 1 to end the body with the zero chunk
+ */
+
+static void Metrics_Flush(Metrics_Out* Out, uint8_t Last)
+{
+    char* p = Out->Buf + Out->Base;
+
+    if (Out->Result != ESP8266_OK || (Out->Len == 0 && !Last))
+        return;
+
+    if (Out->Len != 0)
+    {
+        snprintf(p,5,"%04X",Out->Len);
+        p[4] = '\r';
+        p[5] = '\n';
+        p += METRICS_SIZE_LEN + Out->Len;
+        memcpy(p,"\r\n",2);
+        p += 2;
+    }
+
+    if (Last)
+    {
+        memcpy(p,"0\r\n\r\n",5);
+        p += 5;
+    }
+    *p = '\0';
+
+    Out->Result = ESP_SendCIPData(Out->Link,Out->Buf);
+    Out->Base = 0;
+    Out->Len = 0;
+}
+
+
+/**
+ * @name    Metrics_Put
+ * @brief   The function appends text to the body; a full chunk is sent
+ *
+ * @author  Mehdi
+ */
+
+static void Metrics_Put(Metrics_Out* Out, const char* Text, uint16_t Len)
+{
+    uint16_t Room, n;
+
+    while (Len != 0 && Out->Result == ESP8266_OK)
+    {
+        Room = METRICS_CHUNK_LEN - Out->Base - METRICS_SIZE_LEN - METRICS_END_LEN - Out->Len;
+        if (Room == 0)
+        {
+            Metrics_Flush(Out,0);
+            continue;
+        }
+
+        n = (Len < Room) ? Len : Room;
+        memcpy(Out->Buf + Out->Base + METRICS_SIZE_LEN + Out->Len,Text,n);
+        Out->Len += n;
+        Text += n;
+        Len -= n;
+    }
+}
+
+
+/**
+ * @name    Metrics_Printf
+ * @brief   The function appends a formatted line (METRICS_LINE_LEN at most)
+ *
+ * @author  Mehdi
+ */
+
+static void Metrics_Printf(Metrics_Out* Out, const char* Fmt, ...)
+{
+    char Line[METRICS_LINE_LEN];
+    va_list Ap;
+    int n;
+
+    va_start(Ap,Fmt);
+    n = vsnprintf(Line,sizeof(Line),Fmt,Ap);
+    va_end(Ap);
+
+    if (n < 0)
+        return;
+    if (n >= (int)sizeof(Line))
+        n = sizeof(Line) - 1;
+
+    Metrics_Put(Out,Line,n);
+}
+
+
+/**
+ * @name    Metrics_Prom
+ * @brief   The function renders the Prometheus text format (version 0.0.4).
+ *              Only the commands that were sent are listed.
+ *
+ * @author  Mehdi
+ *
+ * @param	Rssi: signal strength, or a positive value when unknown
+ */
+
+static void Metrics_Prom(Metrics_Out* Out, int8_t Rssi)
+{
+    const LinkSup_Metrics* Link = LinkSup_GetMetrics();
+    const ATCmd_Stat* Stat;
+    uint32_t Cum;
+    uint8_t f, Id, Bin;
+
+    Metrics_Printf(Out,"# TYPE uptime_seconds counter\nuptime_seconds %lu\n",
+                   (unsigned long)(TimeBase_Now() / 1000000));
+
+    for (f = 0; f < sizeof(Metrics_CmdFamilies) / sizeof(Metrics_CmdFamilies[0]); f++)
+    {
+        Metrics_Printf(Out,"# TYPE %s %s\n",Metrics_CmdFamilies[f].Name,Metrics_CmdFamilies[f].Type);
+        for (Id = 0; Id < AT_CMD_COUNT; Id++)
+        {
+            Stat = ATCmd_GetStat(Id);
+            if (Stat->Count != 0)
+                Metrics_Printf(Out,"%s{cmd=\"%s\"} %lu\n",Metrics_CmdFamilies[f].Name,Metrics_CmdName[Id],
+                               (unsigned long)*(const uint32_t*)((const uint8_t*)Stat + Metrics_CmdFamilies[f].Offset));
+        }
+    }
+
+    Metrics_Printf(Out,"# TYPE at_command_latency_ms histogram\n");
+    for (Id = 0; Id < AT_CMD_COUNT; Id++)
+    {
+        Stat = ATCmd_GetStat(Id);
+        if (Stat->Count == 0)
+            continue;
+
+        for (Bin = 0, Cum = 0; Bin < ATCMD_HIST_BINS; Bin++)
+        {
+            Cum += Stat->Hist[Bin];
+            if (Bin < ATCMD_HIST_BINS - 1)
+                Metrics_Printf(Out,"at_command_latency_ms_bucket{cmd=\"%s\",le=\"%u\"} %lu\n",
+                               Metrics_CmdName[Id],ATCmd_HistMs[Bin],(unsigned long)Cum);
+            else
+                Metrics_Printf(Out,"at_command_latency_ms_bucket{cmd=\"%s\",le=\"+Inf\"} %lu\n",
+                               Metrics_CmdName[Id],(unsigned long)Cum);
+        }
+        Metrics_Printf(Out,"at_command_latency_ms_sum{cmd=\"%s\"} %lu\n",Metrics_CmdName[Id],(unsigned long)Stat->TotalMs);
+        Metrics_Printf(Out,"at_command_latency_ms_count{cmd=\"%s\"} %lu\n",Metrics_CmdName[Id],(unsigned long)Stat->Count);
+    }
+
+    Metrics_Printf(Out,"# TYPE link_faults_total counter\n");
+    for (f = LINK_FAULT_NONE + 1; f < LINK_FAULT_COUNT; f++)
+        Metrics_Printf(Out,"link_faults_total{class=\"%s\"} %lu\n",Metrics_FaultName[f],(unsigned long)Link->Faults[f]);
+
+    Metrics_Printf(Out,"# TYPE link_recoveries_total counter\nlink_recoveries_total %lu\n",(unsigned long)Link->Recoveries);
+    Metrics_Printf(Out,"# TYPE link_retries_total counter\nlink_retries_total %lu\n",(unsigned long)Link->Retries);
+    Metrics_Printf(Out,"# TYPE link_giveups_total counter\nlink_giveups_total %lu\n",(unsigned long)Link->GiveUps);
+    Metrics_Printf(Out,"# TYPE link_recovery_max_ms gauge\nlink_recovery_max_ms %lu\n",(unsigned long)Link->MaxRecoveryMs);
+    Metrics_Printf(Out,"# TYPE rx_overflows_total counter\nrx_overflows_total %lu\n",(unsigned long)ESP_GetOverflows());
+
+    Metrics_Printf(Out,"# TYPE bufpool_in_use gauge\n");
+    for (f = 0; f < BUFPOOL_CLASSES; f++)
+        Metrics_Printf(Out,"bufpool_in_use{class=\"%s\"} %u\n",Metrics_PoolName[f],BufPool_GetStat(f)->InUse);
+    Metrics_Printf(Out,"# TYPE bufpool_peak gauge\n");
+    for (f = 0; f < BUFPOOL_CLASSES; f++)
+        Metrics_Printf(Out,"bufpool_peak{class=\"%s\"} %u\n",Metrics_PoolName[f],BufPool_GetStat(f)->Peak);
+    Metrics_Printf(Out,"# TYPE bufpool_failed_total counter\n");
+    for (f = 0; f < BUFPOOL_CLASSES; f++)
+        Metrics_Printf(Out,"bufpool_failed_total{class=\"%s\"} %u\n",Metrics_PoolName[f],BufPool_GetStat(f)->Failed);
+
+    if (Rssi <= 0)
+        Metrics_Printf(Out,"# TYPE wifi_rssi_dbm gauge\nwifi_rssi_dbm %d\n",Rssi);
+}
+
+
+/**
+ * @name    Metrics_Member
+ * @brief   The function appends a JSON member with an integer value
+ *
+ * @author  Mehdi
+ */
+
+static void Metrics_Member(Metrics_Out* Out, const char* Name, long Value)
+{
+    Metrics_Printf(Out,"%s\"%s\":%ld",Out->Next ? "," : "",Name,Value);
+    Out->Next = 1;
+}
+
+
+/**
+ * @name    Metrics_Json
+ * @brief   The function renders the JSON summary of /status
+ *
+ * @author  Mehdi
+ *
+ * @param	Rssi: signal strength, or a positive value when unknown
+ */
+
+static void Metrics_Json(Metrics_Out* Out, int8_t Rssi)
+{
+    const LinkSup_Metrics* Link = LinkSup_GetMetrics();
+    const ATCmd_Stat* Stat;
+    uint32_t Count = 0, Fail = 0, Timeout = 0;
+    uint8_t Id, Peak = 0;
+    uint16_t Failed = 0;
+
+    for (Id = 0; Id < AT_CMD_COUNT; Id++)
+    {
+        Stat = ATCmd_GetStat(Id);
+        Count += Stat->Count;
+        Fail += Stat->Fail;
+        Timeout += Stat->Timeout;
+    }
+
+    for (Id = 0; Id < BUFPOOL_CLASSES; Id++)
+    {
+        Peak += BufPool_GetStat(Id)->Peak;
+        Failed += BufPool_GetStat(Id)->Failed;
+    }
+
+    Metrics_Put(Out,"{",1);
+    Metrics_Member(Out,"uptime_s",(long)(TimeBase_Now() / 1000000));
+    if (Rssi <= 0)
+        Metrics_Member(Out,"rssi_dbm",Rssi);
+    Metrics_Member(Out,"commands",Count);
+    Metrics_Member(Out,"failures",Fail);
+    Metrics_Member(Out,"timeouts",Timeout);
+    Metrics_Member(Out,"rx_overflows",ESP_GetOverflows());
+    Metrics_Member(Out,"recoveries",Link->Recoveries);
+    Metrics_Member(Out,"retries",Link->Retries);
+    Metrics_Member(Out,"giveups",Link->GiveUps);
+    Metrics_Member(Out,"pool_peak",Peak);
+    Metrics_Member(Out,"pool_failed",Failed);
+    Metrics_Put(Out,"}\n",2);
+}
+
+
+/**
+ * @name    Metrics_Path
+ * @brief   The function tells whether a request line is "GET <path>"
+ *
+ * @author  Mehdi
+ */
+
+static uint8_t Metrics_Path(const char* Request, uint16_t Len, const char* Path)
+{
+    uint16_t n = strlen(Path);
+
+    return Len > n + 4 && memcmp(Request,"GET ",4) == 0 && memcmp(Request + 4,Path,n) == 0 &&
+           (Request[n + 4] == ' ' || Request[n + 4] == '?' || Request[n + 4] == '\r');
+}
+
+
+/**
+ * @name    Metrics_Serve
+ * @brief   The function answers a GET /metrics or GET /status request
+ *              received on a link, then closes the link
+ *
+ * @author  Mehdi
+ *
+ * @param	Link: link of the request (+IPD,<link>)
+ * @param	Request: the data of the request
+ * @param	Len: length of Request
+ * @return  0 if the request is for another path, otherwise ESP8266_OK
+ *              or ESP8266_FAIL
+ */
+
+int8_t Metrics_Serve(uint8_t Link, const char* Request, uint16_t Len)
+{
+    Metrics_Out Out;
+    uint8_t Json;
+    int8_t Rssi;
+
+    if (Metrics_Path(Request,Len,"/metrics"))
+        Json = 0;
+    else if (Metrics_Path(Request,Len,"/status"))
+        Json = 1;
+    else
+        return 0;
+
+    // AT+CWJAP? before the block is taken: the reply takes one too
+    if (ESP_GetRssi(&Rssi) != ESP8266_OK)
+        Rssi = 1;
+
+    if ((Out.Buf = BufPool_Get(METRICS_CHUNK_LEN,BUFPOOL_ESP)) == NULL)
+        return ESP8266_FAIL;
+
+    snprintf(Out.Link,sizeof(Out.Link),"%u",Link);
+    Out.Base = snprintf(Out.Buf,METRICS_CHUNK_LEN,METRICS_HTTP_HEADER,
+                        Json ? "application/json" : "text/plain; version=0.0.4");
+    Out.Len = 0;
+    Out.Result = ESP8266_OK;
+    Out.Next = 0;
+
+    if (Json)
+        Metrics_Json(&Out,Rssi);
+    else
+        Metrics_Prom(&Out,Rssi);
+
+    Metrics_Flush(&Out,1);
+    BufPool_Put(Out.Buf);
+
+    if (Out.Result != ESP8266_OK)
+        return ESP8266_FAIL;
+
+    return ESP_SendCloseCommand(Out.Link);
+}
@@ -0,0 +1,39 @@
+/**
+ @file     Metrics.h
+ @brief    /metrics and /status endpoints of the ESP8266 HTTP server.
+           GET /metrics answers the Prometheus text format: per-command
+           counts, failures, timeouts and latency histograms, the link
+           supervisor counters, the buffer pool high-water marks, the RX
+           overflows, the uptime and the RSSI of the access point.
+           GET /status answers a short JSON summary of the same.
+
+           The document is rendered straight into the CIPSEND path: one
+           buffer pool block holds one HTTP chunk (Transfer-Encoding:
+           chunked), which is sent when full, so the document is never
+           held whole in RAM.
+
+ @author   Mehdi
+
+*/
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdint.h>
+
+#include "BufPool.h"
+
+// Configuration
+#ifndef METRICS_CHUNK_LEN
+#define METRICS_CHUNK_LEN			BUFPOOL_LARGE_SIZE	// One CIPSEND: chunk framing and payload
+#endif
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+int8_t Metrics_Serve(uint8_t Link, const char* Request, uint16_t Len);
+
+
+#endif /* METRICS_H_ */
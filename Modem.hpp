@@ -0,0 +1,433 @@
+/**
+ @file     Modem.hpp
+ @brief    Optional C++17 front-end of the modem drivers, header only.
+           Modem<Traits, Transport, BufSize> runs the commands of the
+           descriptor table (ATCmd.h) as ATEngine does, but what the C
+           engine looks up at run time is fixed at compile time:
+
+             - Transport is a class of static functions, so the USART is
+               a constant and the byte path is inlined; UsartTransport
+               maps to the macros of Transport.h (AT_TRACE included);
+             - the line buffer is a member array of BufSize bytes;
+             - Run<AT_xxx>() takes the text, lengths, final response and
+               timeout of the command from a constexpr copy of
+               AT_CMD_TABLE: only the texts of the commands used are
+               linked, and a command of the other modem does not compile
+               (the terminator of Traits).
+
+           Modem is a parallel engine, not a wrapper of ATEngine: it has
+           its own byte loop (Collect, Feed on the line buffer) so that
+           the transport inlines into it. What decides a reply is shared:
+           the matcher of final result codes (ATEngine_Final) and the echo
+           test (ATENGINE_ECHO) come from ATEngine.h, so both engines end
+           a reply on the same lines. The results are the ATENGINE_xxx
+           codes and the lines that do not end a reply go to Traits::Urc,
+           as with the C engine; the statistics go to ATCmd_Record. A
+           module is driven by its C driver or by a Modem, not both.
+
+               MODEM_PORT(EspPort, USART1);
+               Modem<Esp8266Traits, UsartTransport<EspPort>, 128> Esp;
+
+               if (Esp.Run<AT_ESP_CWMODE_STA>() == ATENGINE_OK) ...
+
+           tools/ModemBench.cpp checks it against the C engine and
+           compares their speed; tools/modemsize.sh their size.
+
+ @author   Mehdi
+
+*/
+
+#ifndef MODEM_HPP_
+#define MODEM_HPP_
+
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+#include "stm32f4xx_hal.h"
+#include "Transport.h"
+#include "ESP8266.h"			// ESP_AP_SSID, ESP_AP_PWD
+#include "ATCmd.h"
+#include "ATEngine.h"
+#include "ATResp.h"
+#include "TimeBase.h"
+}
+
+
+/***************************************************
+			C O M M A N D S
+****************************************************/
+
+namespace ModemCmd
+{
+
+struct Desc
+{
+    const char* Text;		// Includes the terminator if it takes no arguments
+    const char* Term;
+    const char* Expect;
+    uint8_t     Len;
+    uint8_t     TermLen;
+    uint8_t     ExpectLen;
+    uint8_t     Args;		// AT_ARGS / AT_NOARGS
+    uint32_t    TimeoutMs;
+};
+
+constexpr uint32_t TimeoutMs(uint8_t Class)
+{
+    return (Class == AT_TMO_SHORT)  ? AT_TMO_SHORT_MS  :
+           (Class == AT_TMO_MEDIUM) ? AT_TMO_MEDIUM_MS :
+           (Class == AT_TMO_LONG)   ? AT_TMO_LONG_MS   :
+           (Class == AT_TMO_SMS)    ? AT_TMO_SMS_MS    : AT_TMO_BEARER_MS;
+}
+
+// Same fields as ATCmd_Table, in the order of the IDs
+#define MODEM_CMD_DESC(Id, Text, Term, Args, Expect, Tmo)				\
+    Desc{																\
+        (Args) ? Text : Text Term,										\
+        Term,															\
+        Expect,															\
+        (Args) ? sizeof(Text) - 1 : sizeof(Text Term) - 1,				\
+        sizeof(Term) - 1,												\
+        sizeof(Expect) - 1,												\
+        Args,															\
+        TimeoutMs(Tmo)													\
+    },
+inline constexpr Desc Table[AT_CMD_COUNT] =
+{
+    AT_CMD_TABLE(MODEM_CMD_DESC)
+};
+#undef MODEM_CMD_DESC
+
+} // namespace ModemCmd
+
+
+/***************************************************
+			T R A I T S
+****************************************************/
+
+// The application derives from them to handle the unsolicited lines
+struct Esp8266Traits
+{
+    static constexpr uint8_t TermLen = sizeof(AT_CRLF) - 1;	// Of its commands
+    static constexpr bool    Stats = true;					// ATCmd_Record each Run
+
+    // Returns 1 if it used the line (see ATEngine_URCHandler)
+    static uint8_t Urc(const char* Line) { (void)Line; return 0; }
+};
+
+struct Sim900Traits
+{
+    static constexpr uint8_t TermLen = sizeof(AT_CR) - 1;
+    static constexpr bool    Stats = true;
+
+    static uint8_t Urc(const char* Line) { (void)Line; return 0; }
+};
+
+
+/***************************************************
+			T R A N S P O R T
+****************************************************/
+
+// A USART known at compile time: MODEM_PORT(EspPort, USART1);
+#define MODEM_PORT(Name, USARTx)										\
+    struct Name { static USART_TypeDef* Get() { return (USARTx); } }
+
+template <class Port>
+struct UsartTransport
+{
+    static void    Send(const char* Data, uint16_t Len) { AT_Send(Port::Get(),Data,Len); }
+    static void    Puts(const char* s)                  { AT_Puts(Port::Get(),s); }
+    static char    Getc()                               { return AT_Getc(Port::Get()); }
+    static uint8_t Empty()                              { return AT_BufferEmpty(Port::Get()); }
+    static int16_t Find(char c)                         { return AT_FindCharacter(Port::Get(),c); }
+};
+
+
+/***************************************************
+			M O D E M
+****************************************************/
+
+template <class Traits, class Transport, uint16_t BufSize>
+class Modem
+{
+    static_assert(BufSize >= 8, "the line buffer must hold a final result code");
+
+public:
+    char     Line[BufSize] = {};	// The final line of the last reply
+    uint32_t Overflows = 0;			// Lines cut short by a full buffer or collector
+
+
+    /**
+     * @name    Send
+     * @brief   The function hands the complete lines already received to
+     *              Traits::Urc, then sends a command (ATEngine_Send)
+     *
+     * @author  Mehdi
+     *
+     * @param	Args: the arguments of an AT_ARGS command (NULL otherwise)
+     */
+
+    template <uint8_t Id>
+    void Send(const char* Args = nullptr)
+    {
+        static_assert(Id < AT_CMD_COUNT, "no such command");
+        constexpr ModemCmd::Desc Cmd = ModemCmd::Table[Id];
+        static_assert(Cmd.TermLen == Traits::TermLen, "command of another modem");
+
+        Poll();
+
+        Transport::Send(Cmd.Text,Cmd.Len);
+
+        if constexpr (Cmd.Args == AT_ARGS)
+        {
+            if (Args != nullptr)
+                Transport::Puts(Args);
+            Transport::Send(Cmd.Term,Cmd.TermLen);
+        }
+    }
+
+
+    /**
+     * @name    Run
+     * @brief   The function sends a command and waits for its expected
+     *              final response within its timeout class (ATEngine_Run)
+     *
+     * @author  Mehdi
+     *
+     * @param	Args: the arguments of an AT_ARGS command (NULL otherwise)
+     * @param	Resp: the collector of the reply lines (ATResp_Init'ed);
+     *              without it the final line is left in Line
+     * @return	ATENGINE_OK, ATENGINE_TOO_LONG, ATENGINE_FAIL, ATENGINE_BUSY or ATENGINE_TIMEOUT
+     */
+
+    template <uint8_t Id>
+    int8_t Run(const char* Args = nullptr)
+    {
+        constexpr ModemCmd::Desc Cmd = ModemCmd::Table[Id];
+        uint32_t Start = Traits::Stats ? TimeBase_Ms() : 0;
+
+        Send<Id>(Args);
+
+        int8_t Res = Collect<false>(Cmd.Expect,Cmd.ExpectLen,nullptr,false,Cmd.TimeoutMs);
+
+        if constexpr (Traits::Stats)
+            ATCmd_Record(Id,Res,TimeBase_Ms() - Start);
+
+        return Res;
+    }
+
+    template <uint8_t Id>
+    int8_t Run(const char* Args, ATResp* Resp)
+    {
+        constexpr ModemCmd::Desc Cmd = ModemCmd::Table[Id];
+        uint32_t Start = Traits::Stats ? TimeBase_Ms() : 0;
+
+        Send<Id>(Args);
+
+        int8_t Res = Collect<true>(Cmd.Expect,Cmd.ExpectLen,Resp,false,Cmd.TimeoutMs);
+
+        if constexpr (Traits::Stats)
+            ATCmd_Record(Id,Res,TimeBase_Ms() - Start);
+
+        return Res;
+    }
+
+
+    /**
+     * @name    Wait
+     * @brief   The function waits for the end of a reply (ATEngine_Wait)
+     *
+     * @author  Mehdi
+     *
+     * @param	Expect: the final line of a successful reply; NULL to take
+     *              the first line, whatever it is
+     * @param	Timeout: time (ms) to wait
+     * @return	ATENGINE_OK, ATENGINE_FAIL, ATENGINE_BUSY or ATENGINE_TIMEOUT
+     */
+
+    int8_t Wait(const char* Expect, uint32_t Timeout)
+    {
+        return Collect<false>(Expect,(Expect != nullptr) ? strlen(Expect) : 0,nullptr,false,Timeout);
+    }
+
+    int8_t Wait(const char* Expect, ATResp* Resp, uint32_t Timeout)
+    {
+        return Collect<true>(Expect,(Expect != nullptr) ? strlen(Expect) : 0,Resp,false,Timeout);
+    }
+
+
+    /**
+     * @name    Prompt
+     * @brief   The function waits for the "> " prompt of a command that
+     *              takes data (ATEngine_Prompt); Data then sends it
+     *
+     * @author  Mehdi
+     */
+
+    int8_t Prompt(uint32_t Timeout)
+    {
+        return Collect<false>(nullptr,0,nullptr,true,Timeout);
+    }
+
+    void Data(const void* Data, uint16_t Len)
+    {
+        Transport::Send(static_cast<const char*>(Data),Len);
+    }
+
+
+    /**
+     * @name    Poll
+     * @brief   The function hands the complete lines received to
+     *              Traits::Urc, without waiting; ATENGINE_POLL_MAX bytes
+     *              at most (ATEngine_Poll)
+     *
+     * @author  Mehdi
+     */
+
+    void Poll()
+    {
+        const char* L;
+        uint16_t Len, Taken = 0;
+        char c;
+
+        while (Taken < ATENGINE_POLL_MAX && Transport::Find('\n') >= 0)
+        {
+            Len = 0;
+
+            do
+            {
+                c = Transport::Getc();
+                L = Feed(c,Len);
+                Taken++;
+            } while (c != '\n');
+
+            if (L != nullptr && !ATENGINE_ECHO(L))
+                Traits::Urc(L);
+        }
+    }
+
+
+private:
+    uint8_t Cut = 0;			// The line in progress did not fit
+
+
+    /* ATResp_Feed on the line buffer: the line completed by c, or NULL */
+    const char* Feed(char c, uint16_t& Len)
+    {
+        uint16_t End;
+
+        if (c != '\n')
+        {
+            if (Len + 1 < BufSize)
+                Line[Len++] = c;
+            else
+                Cut = 1;
+            return nullptr;
+        }
+
+        End = Len;
+        if (End > 0 && Line[End - 1] == '\r')
+            End--;
+        Len = 0;
+
+        if (Cut)
+        {
+            Overflows++;
+            Cut = 0;
+        }
+
+        if (End == 0)
+            return nullptr;
+
+        Line[End] = '\0';
+
+        return Line;
+    }
+
+
+    /**
+     * @name    Collect
+     * @brief   The function reads the module until the end of a reply
+     *              (ATEngine_Collect). Keep: the lines go to an ATResp
+     *              collector; otherwise to the line buffer, where only the
+     *              final line is left.
+     *
+     * @author  Mehdi
+     */
+
+    template <bool Keep>
+    int8_t Collect(const char* Expect, uint16_t ExpectLen, ATResp* Resp, bool Prompt, uint32_t Timeout)
+    {
+        uint64_t Deadline = TimeBase_Deadline(TIMEBASE_MS(Timeout));
+        const char* L;
+        uint16_t Len = 0;
+        int8_t Res;
+        char c;
+
+        while (true)
+        {
+            /* Checked on every byte, as in ATEngine_Collect */
+            if (TimeBase_Expired(Deadline))
+                return ATENGINE_TIMEOUT;
+
+            if (Transport::Empty())
+                continue;
+
+            c = Transport::Getc();
+
+            /* At the start of a line: the prompt, or the space after it */
+            if (Keep ? Resp->Len == Resp->Start : Len == 0)
+            {
+                if (c == '>' && Prompt)
+                    return ATENGINE_OK;
+                if (c == ' ')
+                    continue;
+            }
+
+            if constexpr (Keep)
+                L = ATResp_Feed(Resp,c);
+            else
+                L = Feed(c,Len);
+
+            if (L == nullptr)
+                continue;
+
+            if (ATENGINE_ECHO(L))
+            {
+                if constexpr (Keep)
+                    ATResp_Drop(Resp,L);
+                continue;
+            }
+
+            if (Expect == nullptr && !Prompt)
+                return ATENGINE_OK;
+
+            if ((Res = ATEngine_Final(L,Expect,ExpectLen)) != 0)
+            {
+                if constexpr (Keep)
+                {
+                    if (Resp->Overflow)
+                    {
+                        Overflows++;
+                        if (Res == ATENGINE_OK)
+                            Res = ATENGINE_TOO_LONG;
+                    }
+                }
+                return Res;
+            }
+
+            if constexpr (Keep)
+            {
+                if (Traits::Urc(L))
+                    ATResp_Drop(Resp,L);
+            } else
+            {
+                Traits::Urc(L);
+            }
+        }
+    }
+};
+
+
+#endif /* MODEM_HPP_ */
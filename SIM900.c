@@ -9,224 +9,357 @@
  *******************************************************************************************/
 
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "stm32f4xx_hal.h"
 
 #include "Gen_Def.h"
-#include "tm_stm32_usart.h"
+#include "Transport.h"
 #include "tm_stm32_hd44780.h"
-#include "tm_stm32_delay.h"
 
 #include "SIM900.h"
 #include "AuxLib.h"
+#include "ATCmd.h"
+#include "SMSPdu.h"
+#include "BufPool.h"
+#include "ATResp.h"
+#include "ATEngine.h"
+#include "TimeBase.h"
 
 
-char SIM900_buffer[128];    // A common buffer used to read response from SIM900
+// State of the last submission (SIM900SubmitPdu)
+#define SIM900_SUBMIT_IDLE		0
+#define SIM900_SUBMIT_WAIT		1		// PDU sent, "+CMGS: <mr>" or an error to come
+#define SIM900_SUBMIT_RESULT	2		// "+CMGS: <mr>" read, its "OK" to come
+
+
+char SIM900_buffer[SIM900_BUF_SIZE];    // A common buffer used to read response from SIM900
 USART_TypeDef* USART_SIM;
 
+static ATEngine SIM900_Eng;
+SIM900_URCHandler SIM900_URC;   // Handler of the unsolicited lines read while waiting
+
+static SIM900_NetReg SIM900_Reg = { SIM900_REG_NOT_REPORTED, SIM900_REG_NOT_REPORTED, 0, 0, 0, 0, 0 };
+static SIM900_NetRegHandler SIM900_RegHandler;
+
+static uint8_t  SIM900_Submit = SIM900_SUBMIT_IDLE;
+static uint64_t SIM900_SubmitEnd;	// Deadline of the result of the submission
+
 
 /**
- * @name	SIM900Init
- * @brief 	The function initializes the SIM900 module by sending
- *              "AT" command, get the response and check it out to see if module works fine
+ * @name	SIM900SetURCHandler
+ * @brief	The function sets the handler that gets the unsolicited lines
+ *              (e.g. "+CDS:") the driver reads while it waits for a reply
  *
  * @author	Mehdi
  *
- * @return	Messages indicates if the module works fine (SIM900_OK) or not (SIM900_TIMEOUT)
+ * @param	Handler     the handler (NULL drops those lines)
  */
 
-int8_t SIM900Init(USART_TypeDef* USARTx)
+void SIM900SetURCHandler(SIM900_URCHandler Handler)
 {
+    SIM900_URC = Handler;
+}
 
-	USART_SIM = USARTx; // Set the USART type
-
-	/* Send test command */
-	SIM900Cmd("AT");
 
-    uint16_t i = 0;
+/**
+ * @name	SIM900Unsolicited
+ * @brief	The function dispatches a line that is not the reply awaited
+ *              (the URC handler of the engine): registration reports update
+ *              the cached state, the other lines go to the URC handler
+ *
+ * @author	Mehdi
+ *
+ * @return	1 if the line was used
+ */
 
-    /* Check to see if any response sends back by the module and if so, check the response */
-    while(i < 10)
+static uint8_t SIM900Unsolicited(const char *line)
+{
+    /* The result of a submission ends with its own "OK" */
+    if (SIM900_Submit == SIM900_SUBMIT_RESULT && strncmp(line,"OK",2) == 0)
     {
-        /* Wait for response from module */
-    	if (TM_USART_Gets(USART_SIM,SIM900_buffer,128) == 0)
-        {
-            i++;
-            Delayms(10);
-        } else
-        {
-            /* We got a response that is 6 bytes long
-			 Now check it */
-            TM_USART_Gets(USART_SIM,SIM900_buffer,128);
+        SIM900_Submit = SIM900_SUBMIT_IDLE;
+        return 1;
+    }
 
-            /* Check the response from module */
-            return SIM900CheckResponse(SIM900_buffer,"OK",6);
-        }
+    if (SIM900_Submit == SIM900_SUBMIT_WAIT)
+    {
+        if (strncmp(line,"+CMGS:",6) == 0)
+            SIM900_Submit = SIM900_SUBMIT_RESULT;
+        else if (strncmp(line,"+CMS ERROR",10) == 0 || strncmp(line,"ERROR",5) == 0)
+            SIM900_Submit = SIM900_SUBMIT_IDLE;
     }
-    return SIM900_TIMEOUT;
+
+    if (SIM900NetRegLine(line))
+        return 1;
+
+    return (SIM900_URC != NULL) ? SIM900_URC(line) : 0;
 }
 
 
 /**
- * @name	SIM900Cmd
- * @brief	The function send the given command to the module and
- *              check if the uC receives any feedback from module within 100 ms
+ * @name	SIM900Bind
+ * @brief	The function returns the AT engine of the module, bound to USART_SIM
  *
- * @author  Mehdi
- *
- * @param	cmd    The command wanted to send to module
- * @return	Messages indicates if the module works fine (SIM900_OK) or not (SIM900_TIMEOUT)
+ * @author	Mehdi
  */
 
-int8_t SIM900Cmd(const char *cmd)
+static ATEngine *SIM900Bind(void)
 {
+    if (SIM900_Eng.USARTx != USART_SIM)
+        ATEngine_Init(&SIM900_Eng,USART_SIM,SIM900_buffer,sizeof(SIM900_buffer),SIM900Unsolicited);
 
-    uint16_t i = 0;
-
-	/* Send Command */
-	TM_USART_Puts(USART_SIM,cmd);
+    return &SIM900_Eng;
+}
 
-	/* Send CR (\r) */
-    TM_USART_Putc(USART_SIM,0x0D);
 
-    /* Get the length of the cmd sent to module */
-    uint8_t len = strlen(cmd);
+/**
+ * @name	SIM900Engine
+ * @brief	The function returns the AT engine of the module to send a
+ *              command. The result of a submission still coming (see
+ *              SIM900SubmitPdu) is read first, up to SIM900_CMGS_TIMEOUT
+ *              after the PDU: the module answers the commands in order,
+ *              and the "+CMGS: <mr>", "OK" or error of the message must
+ *              not be taken as the reply of the next command. Every
+ *              command goes through it, as do the layers above the
+ *              driver (SIM900Http).
+ *
+ * @author	Mehdi
+ */
 
-    /* Add 1 for trailing CR added to the cmd */
-    len++;
+ATEngine *SIM900Engine(void)
+{
+    ATEngine *eng = SIM900Bind();
 
-    /* After sending cmd, wait for the response from module */
-    while (i < 10 * len)
+    while (SIM900_Submit != SIM900_SUBMIT_IDLE)
     {
-        if(TM_USART_Gets(USART_SIM,SIM900_buffer,128) == 0)
-        {
-            i++;
-            Delayms(10);
-        } else
+        if (TimeBase_Expired(SIM900_SubmitEnd))
         {
-        	TM_USART_Gets(USART_SIM,SIM900_buffer,128);
-
-            return SIM900_OK;
+            SIM900_Submit = SIM900_SUBMIT_IDLE;
+            break;
         }
+        ATEngine_Poll(eng);
     }
 
-    return SIM900_TIMEOUT;
+    return eng;
 }
 
 
 /**
- * @name	SIM900CheckResponse
- * @brief	The function check the response received from module
- *              and return back appropriate feedback.
+ * @name	SIM900Init
+ * @brief 	The function initializes the SIM900 module by sending
+ *              "AT" command and waiting for its "OK"
  *
  * @author	Mehdi
  *
- * @param	response                 the response get from module and check by the function
- * @param   check                    the word with witch "response" is compared
- * @param   len                      length of "response" should be compare with "check"
- * @param   SIM900_INVALID_RESPONSE  if two first or two last char of response are not "\n"
- * @return  SIM900_FAIL              if "response" does not match "check"
+ * @return	SIM900_OK if the module works fine, SIM900_FAIL or SIM900_TIMEOUT
  */
 
-int8_t SIM900CheckResponse(const char *response, const char *check, uint8_t len)
+int8_t SIM900Init(USART_TypeDef* USARTx)
 {
-    len -= 2;
 
-    /* Check leading CR LF (\r\n) */
-    if (response[0] != 0x0D | response[1] != 0x0A)
-        return SIM900_INVALID_RESPONSE;
+	USART_SIM = USARTx; // Set the USART type
 
-    /* Check leading CR LF (\r\n) */
-    if (response[len] != 0x0D | response[len+1] != 0x0A)
-        return SIM900_INVALID_RESPONSE;
+	/* Send test command and check the response */
+	return SIM900Run(AT_SIM_AT,NULL);
+}
 
-    for (uint8_t i = 2; i < len; i++)
-    {
-        if(response[i] != check[i-2])
-            return SIM900_FAIL;
-    }
 
-    return SIM900_OK;
+/**
+ * @name	SIM900Run
+ * @brief	The function sends a command of the descriptor table and reads
+ *              the replies until its expected final response or "ERROR"
+ *              arrives, within the timeout class of the command (see
+ *              ATEngine_Run). Information responses and URCs go to the
+ *              unsolicited line handlers.
+ *
+ * @author  Mehdi
+ *
+ * @param	Id      The command (AT_SIM_xxx)
+ * @param	Args    The arguments of an AT_ARGS command (NULL otherwise)
+ * @return	SIM900_OK, SIM900_FAIL on "ERROR", or SIM900_TIMEOUT
+ */
+
+int8_t SIM900Run(uint8_t Id, const char *Args)
+{
+    return ATEngine_Run(SIM900Engine(),Id,Args,NULL);
 }
 
 
 /**
- * @name	SIM900WaitForResponse
- * @brief	The function add a given delay to receive response from module,
- *              and if receives any response, return number of char response
+ * @name	SIM900Poll
+ * @brief	The function handles the lines received from the module
+ *              without waiting: registration reports update the cached
+ *              state, the other lines go to the URC handler.
+ *              It should be called from the main loop when nothing else
+ *              reads the module (SMSQueue_Poll does).
  *
  * @author	Mehdi
+ */
+
+void SIM900Poll(void)
+{
+    ATEngine_Poll(SIM900Bind());
+}
+
+
+/**
+ * @name	SIM900NetRegLine
+ * @brief	The function updates the cached registration state from a line:
+ *              unsolicited "+CREG: <stat>[,"<lac>","<ci>"]" (AT+CREG=2),
+ *              the reply "+CREG: <n>,<stat>[,"<lac>","<ci>"]" to AT+CREG?,
+ *              and the same forms of +CGREG. The handler gets the changes.
  *
- * @param	timeout     the amount of time (milisec) uC waits
- * @return  Number of char of response
+ * @author	Mehdi
+ *
+ * @param	line    a line received from the module
+ * @return	1 if the line was a registration report, 0 otherwise
  */
 
-int8_t SIM900WaitForResponse(uint16_t timeout)
+uint8_t SIM900NetRegLine(const char *line)
 {
-    uint8_t i = 0;
-    uint16_t n = 0;
+    uint8_t *stat, n = 0, quoted = 0, o, changed;
+    unsigned long f[4];
+    const char *p;
+    char *end;
 
-    while(1)
+    if (strncmp(line,"+CREG:",6) == 0)
     {
-        while (TM_USART_Gets(USART_ESP,SIM900_buffer,128) == 0 && n < timeout)
-        {
-            n++;
-            Delayms(1);
-        }
+        stat = &SIM900_Reg.Stat;
+        p = line + 6;
+    } else if (strncmp(line,"+CGREG:",7) == 0)
+    {
+        stat = &SIM900_Reg.GprsStat;
+        p = line + 7;
+    } else
+        return 0;
 
-        if (n == timeout)
-            return 0;
-        else
+    /* Decimal fields, or hexadecimal ones between quotes */
+    while (n < 4)
+    {
+        p += strspn(p," ");
+        if (*p == '"')
         {
-        	/* Get the length of recieved char */
-        	i = LenString(SIM900_buffer);
-        	return i;
-        }
+            quoted |= 1 << n;
+            f[n] = strtoul(p + 1,&end,16);
+        } else
+            f[n] = strtoul(p,&end,10);
+
+        if (end == p)
+            break;
+        n++;
+
+        if ((p = strchr(end,',')) == NULL)
+            break;
+        p++;
     }
+
+    if (n == 0)
+        return 1;
+
+    /* The reply to the query starts with <n>; a report has <stat> first */
+    o = (n >= 2 && !(quoted & 0x02)) ? 1 : 0;
+    if (n <= o || f[o] > SIM900_REG_ROAMING)
+        return 1;
+
+    changed = (*stat != f[o]);
+    if (changed && stat == &SIM900_Reg.Stat)
+        SIM900_Reg.Since = TimeBase_Ms();
+    *stat = f[o];
+
+    if (n >= o + 3)
+    {
+        changed |= (SIM900_Reg.Lac != f[o + 1] || SIM900_Reg.Ci != f[o + 2]);
+        SIM900_Reg.Lac = f[o + 1];
+        SIM900_Reg.Ci = f[o + 2];
+    }
+
+    SIM900_Reg.Updated = TimeBase_Ms();
+
+    if (changed)
+    {
+        SIM900_Reg.Changes++;
+        if (SIM900_RegHandler != NULL)
+            SIM900_RegHandler(&SIM900_Reg);
+    }
+
+    return 1;
+}
+
+
+/**
+ * @name	SIM900NetRegInit
+ * @brief	The function enables the registration reports with location
+ *              (AT+CREG=2, AT+CGREG=2) and queries the current state once;
+ *              from then on the state follows the unsolicited reports
+ *              without any command.
+ *
+ * @author	Mehdi
+ *
+ * @param	Handler     called when the registration or the cell changes (may be NULL)
+ * @return	SIM900_OK, SIM900_FAIL or SIM900_TIMEOUT
+ */
+
+int8_t SIM900NetRegInit(SIM900_NetRegHandler Handler)
+{
+    int8_t res;
+
+    SIM900_RegHandler = Handler;
+
+    if ((res = SIM900Run(AT_SIM_CREG_URC,NULL)) != SIM900_OK)
+        return res;
+
+    if ((res = SIM900Run(AT_SIM_CGREG_URC,NULL)) != SIM900_OK)
+        return res;
+
+    if ((res = SIM900Run(AT_SIM_CREG_Q,NULL)) != SIM900_OK)
+        return res;
+
+    return SIM900Run(AT_SIM_CGREG_Q,NULL);
+}
+
+
+/**
+ * @name	SIM900GetNetReg
+ * @brief	The function returns the cached registration state
+ *
+ * @author	Mehdi
+ */
+
+const SIM900_NetReg *SIM900GetNetReg(void)
+{
+    return &SIM900_Reg;
 }
 
 
 /**
  * @name	SIM900GetNetStat
- * @brief	The function fetches network state.
+ * @brief	The function returns the network state from the cached
+ *              registration state. The module is queried only when no
+ *              report was received yet (SIM900NetRegInit not called).
  *
  * @author	Mehdi
  *
- * @return  SIM900_FAIL     if "response" does not match "check"
+ * @return  SIM900_NW_REGISTERED_HOME, SIM900_NW_SEARCHING, SIM900_NW_REGISTED_ROAMING,
+ *              SIM900_NW_ERROR, or the failure of the query
  */
 
 int8_t SIM900GetNetStat()
 {
-    SIM900Cmd("AT+CREG?");
+    int8_t res;
 
-    uint16_t i = 0;
+    if (SIM900_Reg.Stat == SIM900_REG_NOT_REPORTED && (res = SIM900Run(AT_SIM_CREG_Q,NULL)) != SIM900_OK)
+        return res;
 
-    /* Correct response is 20 byte long, So wait until we have got 20 bytes in buffer. */
-    while(i < 10)
+    switch (SIM900_Reg.Stat)
     {
-        /* Read the USART buffer */
-        TM_USART_Gets(USART_ESP,SIM900_buffer,128);
-
-        if (LenString(SIM900_buffer) < 20)
-        {
-            i++;
-            _delay_ms(10);
-        } else
-        {
-            if(SIM900_buffer[11] = '1')
-                return SIM900_NW_REGISTERED_HOME;
-            else if(SIM900_buffer[11] = '2')
-                return SIM900_NW_SEARCHING;
-            else if(SIM900_buffer[11] = '5')
-                return SIM900_NW_REGISTED_ROAMING;
-            else
-                return SIM900_NW_ERROR;
-        }
+        case SIM900_REG_HOME:       return SIM900_NW_REGISTERED_HOME;
+        case SIM900_REG_SEARCHING:  return SIM900_NW_SEARCHING;
+        case SIM900_REG_ROAMING:    return SIM900_NW_REGISTED_ROAMING;
+        default:                    return SIM900_NW_ERROR;
     }
-
-    /* We waited so long but got no response, So tell caller that we timed out */
-	return SIM900_TIMEOUT;
 }
 
 
@@ -243,28 +376,11 @@ int8_t SIM900GetNetStat()
 
 int8_t SIM900DeleteMsg(uint8_t msgNum)
 {
+    char arg[4];   // String for storing the argument of the command
 
-    /* Clear pending data in queue */
-    USART_RxBufferFlush();
-
-    char cmd[16];   // String for storing the command to be sent
+    sprintf(arg,"%d",msgNum);   // AT+CMGD=<n> in which "n" is No. of message
 
-    sprintf(cmd,"AT+CMGD=%d",msgNum);   // AT+CMGD=<n> in which "n" is No. of message
-
-    SIM900Cmd(cmd);
-
-    uint8_t len = SIM900WaitForResponse(1000);
-
-    if (len == 0)
-         return SIM900_TIMEOUT;
-
-    SIM900_buffer[len - 1] = '\0';      //!!!!!!! Check the ARM library to see if it is necessary
-
-    /* Check if the response is OK */
-    if (strcasecmp(SIM900_buffer+2,"OK") == 0)
-        return SIM900_OK;
-    else
-        return SIM900_FAIL;
+    return SIM900Run(AT_SIM_CMGD,arg);
 }
 
 
@@ -272,6 +388,7 @@ int8_t SIM900DeleteMsg(uint8_t msgNum)
  * @name	SIM900WaitForMsg
  * @brief	The function waits for the message, and when it is received by module,
  *          the function return the slot in SIM in which the incoming message stores.
+ *          A line that is not "+CMTI:" goes to the unsolicited line handlers.
  *
  * @author	Mehdi
  *
@@ -280,155 +397,256 @@ int8_t SIM900DeleteMsg(uint8_t msgNum)
 
 int8_t SIM900WaitForMsg(uint8_t *id)
 {
-    uint8_t len = SIM900WaitForResponse(250);   // Get the length of received response
+    ATResp Resp;
+    int32_t slot;
 
-    if (len == 0)
-        return SIM900_TIMEOUT;
+    ATResp_Init(&Resp,SIM900_buffer,sizeof(SIM900_buffer));
 
-    SIM900_buffer[len - 1] = '\0';  //!!!!!!! Check the ARM library to see if it is necessary
+    /* +CMTI: "SM",<index> */
+    if (ATEngine_Wait(SIM900Bind(),NULL,&Resp,250) == ATENGINE_TIMEOUT)
+        return SIM900_TIMEOUT;
 
-    if (strcasecmp(SIM900_buffer+2,"+CMTI:",6) == 0)
+    if (ATResp_Find(&Resp,"+CMTI:",0) == 0 && ATResp_Int(&Resp,0,1,&slot))
     {
-        char str_id[4];
-
-        char *start;
-
-        start = strchr(SIM900_buffer,',');  // Find the first "," in the string and put the following char in start
-        start++;
-
-        strcpy(str_id,start);
+        *id = slot;
+        return SIM900_OK;
+    }
 
-        *id = atoi(str_id);
+    SIM900Unsolicited(ATResp_GetLine(&Resp,0));
 
-        return SIM900_OK;
-    } else
-        return SIM900_FAIL;
+    return SIM900_FAIL;
 }
 
 
 /**
- * @name	SIM900ReadMsg
+ * @name	SIM900ReadDeliver
  * @brief	The reads the message its number given by the user.
- * 		    The command that is used to read a text message from any slot is AT+CMGR=<n>
+ * 		    The command that is used to read a message from any slot is AT+CMGR=<n>
  * 		    where <n> is an integer value indicating the sms slot to read. As I have already
  * 		    discussed that their are several slots to hold incoming messages.
  *
- * 		    The response is like this
+ * 		    In PDU mode (the default of the module, see SMSQueue_Init) the response is like this
  *
- *          +CMGR: "STATUS","OA",,"SCTS"<CR><LF>Message Body<CR><LF><CR><LF>OK<CR><LF>
+ *          +CMGR: <stat>,[<alpha>],<length><CR><LF><pdu><CR><LF><CR><LF>OK<CR><LF>
  *
- * 		    where STATUS indicate the status of message it could be REC UNREAD or REC READ
- *  	    OA is the Originating Address that means the mobile number of the sender.
- * 		    SCTS is the Service Center Time Stamp.
+ * 		    The SMS-DELIVER PDU holds the Originating Address, the Service Center Time Stamp,
+ * 		    the user data header of a segment (see SMSConcat_Add) and the body.
  *
  * @author	Mehdi
  *
- * @param	msgNum (In)     The data (char) get to Transmit to through USART
- * @param	msg (Out)       the message sent to the module
+ * @param	msgNum (In)     The slot to read
+ * @param	msg (Out)       The parsed message
  */
 
-int8_t SIM900ReadMsg(uint8_t msgNum, char *msg)
+int8_t SIM900ReadDeliver(uint8_t msgNum, SMSPdu_Deliver *msg)
 {
+    ATResp Resp;
+    char *buf, *hex;
+    int16_t len;
+    int8_t res, i;
+    char arg[4];
 
-    USART_RxBufferFlush();    // Clear pending data in queue
-
-    char cmd[16];
+    if ((buf = BufPool_Get(SIM900_CMGR_LEN,BUFPOOL_SIM)) == NULL)
+        return SIM900_FAIL;
 
-    // Build command string
-    sprintf(cmd,"AT+CMGR=%d",msgNum);
+    ATResp_Init(&Resp,buf,SIM900_CMGR_LEN);
 
-    /* Send the command to read the Msg */
-    SIM900Cmd(cmd);
+    // Build the argument of AT+CMGR=<n>
+    sprintf(arg,"%d",msgNum);
 
-    uint8_t len = SIM900WaitForResponse(1000);
+    /* Send the command to read the Msg and collect the whole reply; the
+       unsolicited lines in between go to their handlers */
+    res = ATEngine_Run(SIM900Engine(),AT_SIM_CMGR,arg,&Resp);
 
-    if (len == 0)
-        return SIM900_TIMEOUT;
+    i = ATResp_Find(&Resp,"+CMGR:",0);
 
-	/* Check of SIM NOT Ready error */
-    if (strcasecmp(SIM900_buffer+2,"+CMS ERROR: 517")==0)
+    if (res == ATENGINE_TIMEOUT)
+        res = SIM900_TIMEOUT;
+    else if (ATResp_Find(&Resp,"+CMS ERROR: 517",0) >= 0)
+        res = SIM900_SIM_NOT_READY;    // SIM NOT Ready
+    else if (res != ATENGINE_OK)
+        res = SIM900_FAIL;
+    else if (i < 0 || i + 1 >= Resp.Lines - 1)
+        res = SIM900_MSG_EMPTY;        // Msg Slot Empty: just "OK"
+    else
     {
-        return SIM900_SIM_NOT_READY;    // SIM NOT Ready
+        /* The PDU is decoded in place, the octets take half the room of the digits */
+        hex = (char*)ATResp_GetLine(&Resp,i + 1);
+
+        if ((len = SMSPdu_FromHex(hex,(uint8_t*)hex,ATResp_LineLen(&Resp,i + 1) / 2)) < 0 ||
+            SMSPdu_ParseDeliver((uint8_t*)hex,len,msg) != SMSPDU_OK)
+            res = SIM900_FAIL;
+        else
+            res = SIM900_OK;
     }
 
+    BufPool_Put(buf);
 
-    if (strcasecmp(SIM900_buffer+2,"OK")==0)    // Msg Slot Empty
-    {
-        return SIM900_MSG_EMPTY;
-    }
+    return res;
+}
 
-    /* Now read the actual msg text */
-    len = SIM900WaitForResponse(1000);
 
-    if (len == 0)
-        return SIM900_TIMEOUT;
+/**
+ * @name	SIM900ReadMsg
+ * @brief	The function reads a message (see SIM900ReadDeliver) and decodes
+ *              its body (GSM 7-bit, UCS-2 or 8-bit) to UTF-8. A segment of a
+ *              concatenated message gives its own part only.
+ *
+ * @author	Mehdi
+ *
+ * @param	msgNum (In)     The slot to read
+ * @param	msg (Out)       The body of the message, UTF-8 (SMSPDU_TEXT_LEN bytes hold any message)
+ * @param	size (In)       Size of msg
+ */
 
-    SIM900_buffer[len-1] = '\0';  //!!!!!!! Check the ARM library to see if it is necessary
-    strcpy(msg,SIM900_buffer+1); // +1 for removing trailing LF of prev line
+int8_t SIM900ReadMsg(uint8_t msgNum, char *msg, uint16_t size)
+{
+    static SMSPdu_Deliver Deliver;
+    int8_t res = SIM900ReadDeliver(msgNum,&Deliver);
 
-    return SIM900_OK;
+    if (res != SIM900_OK)
+        return res;
+
+    SMSPdu_Text(&Deliver,msg,size);
 
+    return SIM900_OK;
 }
 
 
 /**
- * @name	SIM900SendMsg
- * @brief	The function send a given message to given phone number via the module, then return message returned.
+ * @name	SIM900WaitForPrompt
+ * @brief	The function waits for the "> " prompt the module sends when it
+ *              is ready to take the body of a message (AT+CMGS)
  *
  * @author	Mehdi
  *
- * @param	num (In)        Phone number to which the message send ex "+919XXXXXXX"
- * @param 	msg (In)        Message Body ex "This a message body"
- * @param   msg_ref (Out)   After successful send, the function stores a unique message reference in this variable.
+ * @param	timeout     the amount of time (milisec) uC waits
+ * @return	SIM900_OK when the prompt arrived, SIM900_FAIL on "ERROR", else SIM900_TIMEOUT
  */
 
-int8_t SIM900SendMsg(const char *num, const char *msg, uint8_t *msg_ref)
+int8_t SIM900WaitForPrompt(uint16_t timeout)
 {
-    /* Clear pending data in queue */
-    USART_RxBufferFlush();
+    int8_t res = ATEngine_Prompt(SIM900Bind(),timeout);
 
-    char cmd[25];
+    return (res == ATENGINE_BUSY) ? SIM900_FAIL : res;
+}
 
-    /* Creating cmd AT+CMGS="+919XXXXXXX" */
-    sprintf(cmd,"AT+CMGS= %s",num);
 
-    cmd[8] = 0x22;  // Add " to cmd in 8th char
+/**
+ * @name	SIM900SubmitPdu
+ * @brief	The function hands an SMS-SUBMIT PDU to the module: it sends
+ *              AT+CMGS=<length>, waits for the prompt and sends the PDU in
+ *              hexadecimal terminated by Ctrl-Z. Without a prompt the
+ *              submission is cancelled (ESC) and may be tried again.
+ *              It does not wait for "+CMGS: <mr>"; the caller collects it
+ *              from the unsolicited lines, and the next command waits
+ *              for it and its "OK" (see SIM900Engine).
+ *
+ * @author	Mehdi
+ *
+ * @param	pdu (In)        The PDU, with its SCA octet (SMSPdu_Build)
+ * @param 	len (In)        Length of the PDU
+ * @return	SIM900_OK when the PDU is sent, SIM900_FAIL or SIM900_TIMEOUT otherwise
+ */
 
-    uint8_t n = strlen(cmd);
+int8_t SIM900SubmitPdu(const uint8_t *pdu, uint16_t len)
+{
+    char hex[2 * SIM900_HEX_CHUNK + 1];
+    char arg[4];
+    uint32_t start;
+    uint16_t i, n;
+    int8_t res;
+
+    /* The length excludes the SCA octet */
+    sprintf(arg,"%u",len - 1);
+
+    start = TimeBase_Ms();
+    ATEngine_Send(SIM900Engine(),AT_SIM_CMGS,arg);
+
+    res = SIM900WaitForPrompt(ATCmd_Timeout(AT_SIM_CMGS));
+    ATCmd_Record(AT_SIM_CMGS,res,TimeBase_Ms() - start);
+    if (res == SIM900_TIMEOUT)
+        AT_Putc(USART_SIM,0x1B);	// ESC: a late prompt must not take the next command as the PDU
+    if (res != SIM900_OK)
+        return res;
+
+    /* Send the PDU */
+    for (i = 0; i < len; i += n)
+    {
+        n = (len - i > SIM900_HEX_CHUNK) ? SIM900_HEX_CHUNK : len - i;
+        AT_Send(USART_SIM,hex,SMSPdu_ToHex(pdu + i,n,hex));
+    }
+    AT_Putc(USART_SIM,0x1A);
 
-    cmd[n] = 0x22;      // Add " to cmd last char
-    cmd[n+1] = '\0';
+    SIM900_Submit = SIM900_SUBMIT_WAIT;
+    SIM900_SubmitEnd = TimeBase_Deadline(TIMEBASE_MS(SIM900_CMGS_TIMEOUT));
 
-    /* Send the command to send the Msg */
-    SIM900Cmd(cmd);
+    return SIM900_OK;
+}
 
-    Delayms(100);
 
-    /* Send the Msg */
-    TM_USART_Puts(USART_SIM,msg);
+/**
+ * @name	SIM900SubmitMsg
+ * @brief	The function hands a text message to the module (see SIM900SubmitPdu).
+ *              The text is sent in the GSM alphabet when possible (160 chars),
+ *              in UCS-2 otherwise (70 chars); a status report is requested.
+ *
+ * @author	Mehdi
+ *
+ * @param	num (In)        Phone number to which the message send ex "+919XXXXXXX"
+ * @param 	msg (In)        Message Body, UTF-8 ex "This a message body"
+ * @return	SIM900_OK when the body is sent, SIM900_FAIL or SIM900_TIMEOUT otherwise
+ */
 
-    TM_USART_Puts(USART_SIM,0x1A);
+int8_t SIM900SubmitMsg(const char *num, const char *msg)
+{
+    uint8_t *pdu;
+    int16_t len;
+    int8_t res = SIM900_FAIL;
 
-    /* Wait until Msg is recieved completely */
-    while((TM_USART_Gets(USART_ESP,SIM900_buffer,128) == 0) && (LenString(SIM900_buffer) < (strlen(msg)+5)));
+    if ((pdu = BufPool_Get(SMSPDU_SUBMIT_LEN,BUFPOOL_SIM)) == NULL)
+        return SIM900_FAIL;
 
-    uint8_t len = SIM900WaitForResponse(6000);
+    if ((len = SMSPdu_BuildText(num,msg,1,pdu,SMSPDU_SUBMIT_LEN)) >= 0)
+        res = SIM900SubmitPdu(pdu,len);
 
-    if (len == 0)
-        return SIM900_TIMEOUT;
+    BufPool_Put(pdu);
 
-    SIM900_buffer[len-1] = '\0';    ///!!! Check the ARM library to see if it is necessary
+    return res;
+}
 
-    if(strcasecmp(SIM900_buffer+2,"CMGS:",5) == 0)
-    {
-        *msg_ref = atoi(SIM900_buffer+8);
 
-        TM_USART_ClearBuffer(USART_SIM);     // Clear pending data in queue
+/**
+ * @name	SIM900SendMsg
+ * @brief	The function send a given message to given phone number via the module, then return message returned.
+ *
+ * @author	Mehdi
+ *
+ * @param	num (In)        Phone number to which the message send ex "+919XXXXXXX"
+ * @param 	msg (In)        Message Body ex "This a message body"
+ * @param   msg_ref (Out)   After successful send, the function stores a unique message reference in this variable.
+ */
 
-        return SIM900_OK;
-    } else
+int8_t SIM900SendMsg(const char *num, const char *msg, uint8_t *msg_ref)
+{
+    int8_t res = SIM900SubmitMsg(num,msg);
+
+    if (res != SIM900_OK)
+        return res;
+
+    /* The echo of the body is skipped until the result of the submission
+       arrives; the final line is left in SIM900_buffer */
+    if ((res = ATEngine_Wait(SIM900Bind(),"+CMGS:",NULL,SIM900_CMGS_TIMEOUT)) != ATENGINE_OK)
     {
-    	TM_USART_ClearBuffer(USART_SIM);  // Clear pending data in queue
-        return SIM900_FAIL;
+        if (res != ATENGINE_TIMEOUT)
+            SIM900_Submit = SIM900_SUBMIT_IDLE;
+        return (res == ATENGINE_BUSY) ? SIM900_FAIL : res;
     }
+
+    *msg_ref = atoi(SIM900_buffer + 6);
+
+    /* Its "OK" is read with the next command */
+    SIM900_Submit = SIM900_SUBMIT_RESULT;
+
+    return SIM900_OK;
 }
@@ -5,6 +5,9 @@
 #ifndef SIM900_H_
 #define SIM900_H_
 
+#include "SMSPdu.h"
+#include "ATEngine.h"
+
 //Error List
 #define SIM900_OK					 1
 #define SIM900_INVALID_RESPONSE		-1
@@ -19,21 +22,63 @@
 #define SIM900_SIM_NOT_READY		100
 #define SIM900_MSG_EMPTY			101
 
+//Registration (<stat> of +CREG / +CGREG)
+#define SIM900_REG_NOT_SEARCHING	0
+#define SIM900_REG_HOME				1
+#define SIM900_REG_SEARCHING		2
+#define SIM900_REG_DENIED			3
+#define SIM900_REG_UNKNOWN			4
+#define SIM900_REG_ROAMING			5
+#define SIM900_REG_NOT_REPORTED		0xFF	// No report received yet
+
 #define SIM900_SIM_PRESENT			1
 #define SIM900_SIM_NOT_PRESENT		0
 
+//Buffers
+#ifndef SIM900_BUF_SIZE
+#define SIM900_BUF_SIZE				128		// Line buffer of the replies (SIM900_buffer)
+#endif
+#define SIM900_CMGR_LEN				(2 * SMSPDU_MAX_LEN + 32)	// Reply of AT+CMGR (buffer pool block)
+
+//Message Submission
+#define SIM900_CMGS_TIMEOUT			60000	// ms to wait for "+CMGS: <mr>"
+#define SIM900_HEX_CHUNK			16		// PDU octets converted per write
+
+typedef uint8_t (*SIM900_URCHandler)(const char *line);
+
+typedef struct
+{
+    uint8_t  Stat;			// GSM registration, SIM900_REG_xxx
+    uint8_t  GprsStat;		// GPRS registration, SIM900_REG_xxx
+    uint16_t Lac;			// Location area code of the serving cell
+    uint16_t Ci;			// Cell ID
+    uint32_t Since;			// Time (ms) Stat last changed
+    uint32_t Updated;		// Time (ms) of the last report
+    uint16_t Changes;		// Number of changes reported to the handler
+} SIM900_NetReg;
+
+typedef void (*SIM900_NetRegHandler)(const SIM900_NetReg *reg);
+
 //Low Level Functions
-int8_t SIM900Cmd(const char *cmd);
+int8_t SIM900Run(uint8_t Id, const char *Args);
+ATEngine *SIM900Engine(void);
 
 //Public Interface
 int8_t	SIM900Init();
-int8_t	SIM900CheckResponse(const char *response,const char *check,uint8_t len);
-int8_t	SIM900WaitForResponse(uint16_t timeout);
 int8_t	SIM900GetNetStat();
+int8_t	SIM900NetRegInit(SIM900_NetRegHandler Handler);
+const SIM900_NetReg *SIM900GetNetReg(void);
+uint8_t	SIM900NetRegLine(const char *line);
+void	SIM900Poll(void);
 int8_t	SIM900DeleteMsg(uint8_t i);
 int8_t	SIM900WaitForMsg(uint8_t *);
-int8_t	SIM900ReadMsg(uint8_t i, char *);
+int8_t	SIM900ReadMsg(uint8_t i, char *, uint16_t);
+int8_t	SIM900ReadDeliver(uint8_t i, SMSPdu_Deliver *);
 int8_t	SIM900SendMsg(const char *, const char *,uint8_t *);
+int8_t	SIM900WaitForPrompt(uint16_t timeout);
+int8_t	SIM900SubmitMsg(const char *, const char *);
+int8_t	SIM900SubmitPdu(const uint8_t *, uint16_t);
+void	SIM900SetURCHandler(SIM900_URCHandler Handler);
 
 
 
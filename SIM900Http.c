@@ -0,0 +1,358 @@
+/**
+ @file     SIM900Http.c
+ @brief    This file contains the HTTP client on the SIM900 stack. An
+           exchange is one session of the module: AT+HTTPINIT, the
+           parameters (bearer profile 1, URL, content type), the upload
+           (AT+HTTPDATA), AT+HTTPACTION and its +HTTPACTION report, the
+           reads of the response (AT+HTTPREAD), AT+HTTPTERM.
+
+           The data of AT+HTTPREAD is read raw, by its length: a body may
+           hold CR, LF or "OK" of its own. The unsolicited lines that come
+           between the commands go to the handlers of the driver.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "Transport.h"
+
+#include "SIM900.h"
+#include "SIM900Http.h"
+#include "ATCmd.h"
+#include "ATEngine.h"
+#include "ATResp.h"
+#include "BufPool.h"
+#include "TimeBase.h"
+
+
+#define SIM900_BEARER_UP			1		// <status> of +SAPBR: connected
+
+
+/**
+ * @name	SIM900HttpCode
+ * @brief	The function maps a result of the engine to the SIM900_xxx codes
+ *
+ * @author	Mehdi
+ */
+
+static int8_t SIM900HttpCode(int8_t res)
+{
+    return (res == ATENGINE_BUSY || res == ATENGINE_TOO_LONG) ? SIM900_FAIL : res;
+}
+
+
+/**
+ * @name	SIM900HttpBearer
+ * @brief	The function opens the GPRS bearer of profile 1 unless it is
+ *              already up: AT+SAPBR=2,1 (query), then AT+SAPBR=3,1,"Contype",
+ *              "GPRS", AT+SAPBR=3,1,"APN","<apn>" and AT+SAPBR=1,1
+ *
+ * @author	Mehdi
+ *
+ * @param	apn         the access point name of the operator
+ * @return	SIM900_OK when the bearer is up, SIM900_FAIL or SIM900_TIMEOUT
+ */
+
+int8_t SIM900HttpBearer(const char *apn)
+{
+    ATResp resp;
+    char *buf;
+    int32_t stat = 0;
+    int8_t res, i;
+
+    if ((buf = BufPool_Get(SIM900_BUF_SIZE,BUFPOOL_SIM)) == NULL)
+        return SIM900_FAIL;
+
+    // +SAPBR: <cid>,<status>,"<ip>"
+    ATResp_Init(&resp,buf,SIM900_BUF_SIZE);
+    res = ATEngine_Run(SIM900Engine(),AT_SIM_SAPBR,"2,1",&resp);
+    if (res == ATENGINE_OK && (i = ATResp_Find(&resp,"+SAPBR:",0)) >= 0)
+        ATResp_Int(&resp,i,1,&stat);
+
+    if (res == ATENGINE_OK && stat != SIM900_BEARER_UP)
+    {
+        if (snprintf(buf,SIM900_BUF_SIZE,"3,1,\"APN\",\"%s\"",apn) >= SIM900_BUF_SIZE)
+            res = SIM900_FAIL;
+        else if ((res = SIM900Run(AT_SIM_SAPBR,"3,1,\"Contype\",\"GPRS\"")) == SIM900_OK &&
+                 (res = SIM900Run(AT_SIM_SAPBR,buf)) == SIM900_OK)
+            res = SIM900Run(AT_SIM_SAPBR,"1,1");
+    }
+
+    BufPool_Put(buf);
+
+    return SIM900HttpCode(res);
+}
+
+
+/**
+ * @name	SIM900HttpOpen
+ * @brief	The function starts a session and sets its parameters
+ *
+ * @author	Mehdi
+ *
+ * @param	url         the URL, "http://host[:port]/path"
+ * @param	type        the Content-Type of the upload, or NULL
+ */
+
+static int8_t SIM900HttpOpen(const char *url, const char *type)
+{
+    uint16_t size = strlen(url) + 16;
+    char *arg;
+    int8_t res;
+
+    if (type != NULL && strlen(type) + 16 > size)
+        size = strlen(type) + 16;
+
+    if ((arg = BufPool_Get(size,BUFPOOL_SIM)) == NULL)
+        return SIM900_FAIL;
+
+    /* A session left by an aborted exchange makes AT+HTTPINIT fail */
+    if ((res = SIM900Run(AT_SIM_HTTPINIT,NULL)) == SIM900_FAIL && SIM900Run(AT_SIM_HTTPTERM,NULL) == SIM900_OK)
+        res = SIM900Run(AT_SIM_HTTPINIT,NULL);
+
+    if (res == SIM900_OK)
+        res = SIM900Run(AT_SIM_HTTPPARA,"\"CID\",1");
+
+    if (res == SIM900_OK)
+    {
+        sprintf(arg,"\"URL\",\"%s\"",url);
+        res = SIM900Run(AT_SIM_HTTPPARA,arg);
+    }
+
+    if (res == SIM900_OK && type != NULL)
+    {
+        sprintf(arg,"\"CONTENT\",\"%s\"",type);
+        res = SIM900Run(AT_SIM_HTTPPARA,arg);
+    }
+
+    BufPool_Put(arg);
+
+    return res;
+}
+
+
+/**
+ * @name	SIM900HttpUpload
+ * @brief	The function streams the body of a request to the module:
+ *              AT+HTTPDATA=<len>,<time>, "DOWNLOAD", the data, "OK"
+ *
+ * @author	Mehdi
+ *
+ * @param	len         length of the body
+ * @param	src         the source of the body
+ * @param	ctx         context of the source
+ */
+
+static int8_t SIM900HttpUpload(uint32_t len, SIM900_HttpSource src, void *ctx)
+{
+    ATEngine *eng = SIM900Engine();
+    uint8_t chunk[SIM900_HTTP_CHUNK];
+    char arg[24];
+    uint32_t sent = 0, start = TimeBase_Ms();
+    uint16_t n;
+    int8_t res;
+
+    sprintf(arg,"%lu,%u",(unsigned long)len,SIM900_HTTP_DATA_MS);
+    ATEngine_Send(eng,AT_SIM_HTTPDATA,arg);
+
+    if ((res = ATEngine_Wait(eng,"DOWNLOAD",NULL,ATCmd_Timeout(AT_SIM_HTTPDATA))) == ATENGINE_OK)
+    {
+        for (; sent < len; sent += n)
+        {
+            n = (len - sent < sizeof(chunk)) ? len - sent : sizeof(chunk);
+            if ((n = src(ctx,chunk,n)) == 0)
+                break;
+            AT_Send(eng->USARTx,chunk,n);
+        }
+
+        /* A source that ran dry leaves the module waiting for the rest
+           until <time> is over; it answers "OK" then too */
+        res = ATEngine_Wait(eng,"OK",NULL,SIM900_HTTP_DATA_MS + ATCmd_Timeout(AT_SIM_HTTPDATA));
+        if (res == ATENGINE_OK && sent < len)
+            res = SIM900_FAIL;
+    }
+
+    ATCmd_Record(AT_SIM_HTTPDATA,res,TimeBase_Ms() - start);
+
+    return res;
+}
+
+
+/**
+ * @name	SIM900HttpAction
+ * @brief	The function starts the exchange with the server and waits for
+ *              its report: +HTTPACTION: <method>,<status>,<length>
+ *
+ * @author	Mehdi
+ *
+ * @param	method      SIM900_HTTP_xxx
+ * @param	res (Out)   the status and the length of the response
+ */
+
+static int8_t SIM900HttpAction(uint8_t method, SIM900_HttpResult *res)
+{
+    ATEngine *eng = SIM900Engine();
+    const char *p;
+    char arg[4];
+    int8_t r;
+
+    sprintf(arg,"%u",method);
+    if ((r = SIM900Run(AT_SIM_HTTPACTION,arg)) != SIM900_OK)
+        return r;
+
+    if ((r = ATEngine_Wait(eng,"+HTTPACTION:",NULL,SIM900_HTTP_TIMEOUT)) != ATENGINE_OK)
+        return r;
+
+    if ((p = strchr(eng->Line,',')) == NULL)
+        return SIM900_INVALID_RESPONSE;
+    res->Status = atoi(p + 1);
+
+    if ((p = strchr(p + 1,',')) == NULL)
+        return SIM900_INVALID_RESPONSE;
+    res->Len = strtoul(p + 1,NULL,10);
+
+    return SIM900_OK;
+}
+
+
+/**
+ * @name	SIM900HttpRead
+ * @brief	The function reads the response body in windows:
+ *              AT+HTTPREAD=<offset>,<len>, "+HTTPREAD: <n>", <n> bytes, "OK".
+ *              The bytes go to the sink as they arrive; a window is read to
+ *              its end even when the sink refuses more.
+ *
+ * @author	Mehdi
+ *
+ * @param	sink        the sink of the body
+ * @param	ctx         context of the sink
+ * @param	res (In/Out) the length of the body; the bytes read
+ */
+
+static int8_t SIM900HttpRead(SIM900_HttpSink sink, void *ctx, SIM900_HttpResult *res)
+{
+    ATEngine *eng = SIM900Engine();
+    uint8_t chunk[SIM900_HTTP_CHUNK];
+    char arg[24];
+    uint64_t deadline;
+    uint32_t start, n, i;
+    uint16_t k;
+    int8_t r = SIM900_OK, taken = SIM900_OK;
+
+    while (res->Read < res->Len && r == SIM900_OK && taken == SIM900_OK)
+    {
+        sprintf(arg,"%lu,%u",(unsigned long)res->Read,SIM900_HTTP_WINDOW);
+
+        start = TimeBase_Ms();
+        deadline = TimeBase_Deadline(TIMEBASE_MS(ATCmd_Timeout(AT_SIM_HTTPREAD)));
+        ATEngine_Send(eng,AT_SIM_HTTPREAD,arg);
+
+        if ((r = ATEngine_Wait(eng,"+HTTPREAD:",NULL,ATCmd_Timeout(AT_SIM_HTTPREAD))) == ATENGINE_OK)
+        {
+            n = strtoul(eng->Line + 10,NULL,10);
+            if (n == 0 || n > SIM900_HTTP_WINDOW)
+                r = SIM900_INVALID_RESPONSE;
+        }
+
+        /* The data follows the line */
+        for (i = 0; r == ATENGINE_OK && i < n; i += k)
+        {
+            for (k = 0; k < sizeof(chunk) && i + k < n; )
+            {
+                if (!AT_BufferEmpty(eng->USARTx))
+                    chunk[k++] = AT_Getc(eng->USARTx);
+                else if (TimeBase_Expired(deadline))
+                {
+                    r = SIM900_TIMEOUT;
+                    break;
+                }
+            }
+
+            if (taken == SIM900_OK && k != 0)
+                taken = sink(ctx,chunk,k);
+            res->Read += k;
+        }
+
+        if (r == ATENGINE_OK)
+            r = ATEngine_Wait(eng,"OK",NULL,ATCmd_Timeout(AT_SIM_HTTPREAD));
+
+        ATCmd_Record(AT_SIM_HTTPREAD,r,TimeBase_Ms() - start);
+    }
+
+    return (r == SIM900_OK && taken != SIM900_OK) ? SIM900_FAIL : r;
+}
+
+
+/**
+ * @name	SIM900HttpGet
+ * @brief	The function fetches a URL and streams the body to a sink.
+ *              The bearer must be up (SIM900HttpBearer).
+ *
+ * @author	Mehdi
+ *
+ * @param	url         the URL, "http://host[:port]/path"
+ * @param	sink        the sink of the body
+ * @param	ctx         context of the sink
+ * @param	res (Out)   the status, the length of the body and the bytes read
+ * @return	SIM900_OK when the whole body was read (whatever the status),
+ *              SIM900_FAIL, SIM900_INVALID_RESPONSE or SIM900_TIMEOUT
+ */
+
+int8_t SIM900HttpGet(const char *url, SIM900_HttpSink sink, void *ctx, SIM900_HttpResult *res)
+{
+    int8_t r;
+
+    memset(res,0,sizeof(*res));
+
+    if ((r = SIM900HttpOpen(url,NULL)) == SIM900_OK &&
+        (r = SIM900HttpAction(SIM900_HTTP_GET,res)) == SIM900_OK)
+        r = SIM900HttpRead(sink,ctx,res);
+
+    SIM900Run(AT_SIM_HTTPTERM,NULL);
+
+    return SIM900HttpCode(r);
+}
+
+
+/**
+ * @name	SIM900HttpPost
+ * @brief	The function posts a body pulled from a source to a URL and
+ *              streams the response body to a sink.
+ *              The bearer must be up (SIM900HttpBearer).
+ *
+ * @author	Mehdi
+ *
+ * @param	url         the URL, "http://host[:port]/path"
+ * @param	type        the Content-Type of the body
+ * @param	len         length of the body
+ * @param	src         the source of the body
+ * @param	src_ctx     context of the source
+ * @param	sink        the sink of the response body, or NULL to leave it unread
+ * @param	ctx         context of the sink
+ * @param	res (Out)   the status, the length of the body and the bytes read
+ * @return	SIM900_OK, SIM900_FAIL, SIM900_INVALID_RESPONSE or SIM900_TIMEOUT
+ */
+
+int8_t SIM900HttpPost(const char *url, const char *type, uint32_t len, SIM900_HttpSource src, void *src_ctx,
+                      SIM900_HttpSink sink, void *ctx, SIM900_HttpResult *res)
+{
+    int8_t r;
+
+    memset(res,0,sizeof(*res));
+
+    if ((r = SIM900HttpOpen(url,type)) == SIM900_OK &&
+        (r = SIM900HttpUpload(len,src,src_ctx)) == SIM900_OK &&
+        (r = SIM900HttpAction(SIM900_HTTP_POST,res)) == SIM900_OK && sink != NULL)
+        r = SIM900HttpRead(sink,ctx,res);
+
+    SIM900Run(AT_SIM_HTTPTERM,NULL);
+
+    return SIM900HttpCode(r);
+}
@@ -0,0 +1,71 @@
+/**
+ @file     SIM900Http.h
+ @brief    HTTP client on the SIM900's own stack (AT+SAPBR, AT+HTTPINIT,
+           AT+HTTPPARA, AT+HTTPDATA, AT+HTTPACTION, AT+HTTPREAD), for the
+           sites that only have the cellular link.
+
+           The bodies are streamed: a response is read in windows of
+           SIM900_HTTP_WINDOW bytes (AT+HTTPREAD=<offset>,<len>) and handed
+           to a sink in pieces of SIM900_HTTP_CHUNK bytes, and an upload is
+           pulled from a source in pieces of the same size while the module
+           takes it (AT+HTTPDATA). A body of any length the module holds
+           (about 300 kB) never has to fit SIM900_buffer or the pool.
+
+ @author   Mehdi
+
+*/
+
+#ifndef SIM900HTTP_H_
+#define SIM900HTTP_H_
+
+#include <stdint.h>
+
+// Configuration
+#ifndef SIM900_HTTP_WINDOW
+#define SIM900_HTTP_WINDOW			512		// Bytes asked by one AT+HTTPREAD
+#endif
+
+#ifndef SIM900_HTTP_CHUNK
+#define SIM900_HTTP_CHUNK			64		// Bytes handed to a sink or taken from a source at a time (stack)
+#endif
+
+#ifndef SIM900_HTTP_TIMEOUT
+#define SIM900_HTTP_TIMEOUT			120000	// ms to wait for +HTTPACTION (the whole exchange with the server)
+#endif
+
+#ifndef SIM900_HTTP_DATA_MS
+#define SIM900_HTTP_DATA_MS			30000	// <time> of AT+HTTPDATA: the upload must be sent within it
+#endif
+
+// Methods (AT+HTTPACTION=<method>)
+#define SIM900_HTTP_GET				0
+#define SIM900_HTTP_POST			1
+#define SIM900_HTTP_HEAD			2
+
+// Takes a piece of a response body; returns SIM900_OK to go on
+typedef int8_t (*SIM900_HttpSink)(void *ctx, const uint8_t *data, uint16_t len);
+
+// Fills a piece of an upload; returns the bytes written (0: no more data)
+typedef uint16_t (*SIM900_HttpSource)(void *ctx, uint8_t *buf, uint16_t size);
+
+typedef struct
+{
+    uint16_t Status;		// HTTP status, or the 6xx code of the module (e.g. 601: network error)
+    uint32_t Len;			// Length of the response body
+    uint32_t Read;			// Bytes handed to the sink
+} SIM900_HttpResult;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+int8_t SIM900HttpBearer(const char *apn);
+
+int8_t SIM900HttpGet(const char *url, SIM900_HttpSink sink, void *ctx, SIM900_HttpResult *res);
+
+int8_t SIM900HttpPost(const char *url, const char *type, uint32_t len, SIM900_HttpSource src, void *src_ctx,
+                      SIM900_HttpSink sink, void *ctx, SIM900_HttpResult *res);
+
+
+#endif /* SIM900HTTP_H_ */
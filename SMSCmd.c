@@ -0,0 +1,317 @@
+/**
+ @file     SMSCmd.c
+ @brief    This file contains the dispatcher of the SMS commands. The body
+           is scanned once: the tokens are cut in place and the verb is
+           hashed (FNV-1a of its upper case bytes) as it is scanned. The
+           hash picks a bucket whose displacement, mixed with the hash,
+           gives the slot of the only verb it can be (SMSCmdHash.c); one
+           compare tells whether it is that verb.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "SMSCmd.h"
+
+
+#define SMSCMD_FNV_BASIS			2166136261UL
+#define SMSCMD_FNV_PRIME			16777619UL
+
+#define SMSCMD_UPPER(c)				((uint8_t)(((c) >= 'a' && (c) <= 'z') ? (c) - 'a' + 'A' : (c)))
+#define SMSCMD_SPACE(c)				((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+// "PIN", the PIN, the verb, the arguments
+#define SMSCMD_TOKENS				(3 + SMSCMD_MAX_ARGS)
+
+#define SMSCMD_DESC(Id, Verb, Min, Max)	{ Verb, sizeof(Verb) - 1, Min, Max },
+const SMSCmd_Desc SMSCmd_Table[SMSCMD_COUNT] =
+{
+    SMSCMD_TABLE(SMSCMD_DESC)
+};
+#undef SMSCMD_DESC
+
+typedef char SMSCmd_PinFits[(sizeof(SMSCMD_PIN) - 1 <= SMSCMD_PIN_MAX) ? 1 : -1];
+
+static SMSCmd_Handler SMSC_Handlers[SMSCMD_COUNT];
+static char           SMSC_Pin[SMSCMD_PIN_MAX] = SMSCMD_PIN;	// Zero padded
+static uint8_t        SMSC_PinLen = sizeof(SMSCMD_PIN) - 1;
+static uint8_t        SMSC_Tries;			// Wrong PINs in a row
+static uint8_t        SMSC_Locked;
+static uint32_t       SMSC_LockTime;
+static SMSCmd_Stat    SMSC_Stat;
+
+
+/**
+ * @name    SMSCmd_Mix
+ * @brief   The function spreads the bits of a hash (finalizer of MurmurHash3);
+ *              tools/mkcmdhash.py computes the same
+ *
+ * @author  Mehdi
+ */
+
+static uint32_t SMSCmd_Mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x85EBCA6BUL;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35UL;
+    x ^= x >> 16;
+
+    return x;
+}
+
+
+/**
+ * @name    SMSCmd_Lookup
+ * @brief   The function finds the command of a verb from its hash
+ *
+ * @author  Mehdi
+ *
+ * @param	Hash: FNV-1a of the verb in upper case
+ * @param	Verb: the verb, any case
+ * @param	Len: its length
+ * @return  The command (SMSCMD_xxx), or -1
+ */
+
+static int8_t SMSCmd_Lookup(uint32_t Hash, const char* Verb, uint8_t Len)
+{
+    const SMSCmd_Desc* Cmd;
+    uint8_t Id, i;
+
+    Id = SMSCmd_Slot[SMSCmd_Mix(Hash ^ SMSCmd_Disp[Hash % SMSCmd_Buckets]) % SMSCMD_COUNT];
+    Cmd = &SMSCmd_Table[Id];
+
+    /* Any word lands on some slot: it is that verb or none */
+    if (Cmd->Len != Len)
+        return -1;
+
+    for (i = 0; i < Len; i++)
+        if (SMSCMD_UPPER(Verb[i]) != Cmd->Verb[i])
+            return -1;
+
+    return Id;
+}
+
+
+/**
+ * @name    SMSCmd_Find
+ * @brief   The function finds the command of a verb
+ *
+ * @author  Mehdi
+ *
+ * @param	Verb: the verb, any case
+ * @param	Len: its length
+ * @return  The command (SMSCMD_xxx), or -1
+ */
+
+int8_t SMSCmd_Find(const char* Verb, uint8_t Len)
+{
+    uint32_t Hash = SMSCMD_FNV_BASIS;
+    uint8_t i;
+
+    for (i = 0; i < Len; i++)
+        Hash = (Hash ^ SMSCMD_UPPER(Verb[i])) * SMSCMD_FNV_PRIME;
+
+    return SMSCmd_Lookup(Hash, Verb, Len);
+}
+
+
+/**
+ * @name    SMSCmd_Register
+ * @brief   The function sets the handler of a command (NULL: none)
+ *
+ * @author  Mehdi
+ */
+
+void SMSCmd_Register(uint8_t Id, SMSCmd_Handler Handler)
+{
+    if (Id < SMSCMD_COUNT)
+        SMSC_Handlers[Id] = Handler;
+}
+
+
+/**
+ * @name    SMSCmd_SetPin
+ * @brief   The function changes the PIN (4 to SMSCMD_PIN_MAX digits)
+ *
+ * @author  Mehdi
+ *
+ * @return  SMSCMD_OK or SMSCMD_INVALID
+ */
+
+int8_t SMSCmd_SetPin(const char* Pin)
+{
+    uint8_t Len = 0;
+
+    while (Len <= SMSCMD_PIN_MAX && Pin[Len] >= '0' && Pin[Len] <= '9')
+        Len++;
+
+    if (Pin[Len] != '\0' || Len < 4 || Len > SMSCMD_PIN_MAX)
+        return SMSCMD_INVALID;
+
+    memset(SMSC_Pin, 0, sizeof(SMSC_Pin));
+    memcpy(SMSC_Pin, Pin, Len);
+    SMSC_PinLen = Len;
+
+    return SMSCMD_OK;
+}
+
+
+/**
+ * @name    SMSCmd_PinOk
+ * @brief   The function checks a PIN in constant time: every digit is
+ *              compared whatever the first difference, so the time taken
+ *              does not tell how much of the PIN was right
+ *
+ * @author  Mehdi
+ */
+
+static uint8_t SMSCmd_PinOk(const char* Pin, uint8_t Len)
+{
+    uint8_t Diff = (Len != SMSC_PinLen), i;
+
+    for (i = 0; i < SMSCMD_PIN_MAX; i++)
+        Diff |= (uint8_t)(((i < Len) ? Pin[i] : 0) ^ SMSC_Pin[i]);
+
+    return Diff == 0;
+}
+
+
+/**
+ * @name    SMSCmd_Dispatch
+ * @brief   The function runs the command of an SMS body:
+ *              PIN <pin> <VERB> [<arg> ...]
+ *              The tokens are separated by blanks; the verb and "PIN" may
+ *              be in any case.
+ *
+ * @author  Mehdi
+ *
+ * @param	Body: the body (SIM900ReadMsg); cut into tokens in place
+ * @param	Reply (Out): the answer of the handler, "" if none
+ * @param	Size: size of Reply
+ * @param	Now: time (ms), for the lock after wrong PINs
+ * @return  SMSCMD_OK, SMSCMD_INVALID, SMSCMD_FAIL, SMSCMD_DENIED or SMSCMD_UNKNOWN
+ */
+
+int8_t SMSCmd_Dispatch(char* Body, char* Reply, uint16_t Size, uint32_t Now)
+{
+    char* Tok[SMSCMD_TOKENS];
+    uint8_t Len[3], n = 0;
+    uint32_t Hash = SMSCMD_FNV_BASIS;
+    const SMSCmd_Desc* Cmd;
+    char* p = Body;
+    int8_t Id;
+
+    if (Size != 0)
+        Reply[0] = '\0';
+
+    if (SMSC_Locked)
+    {
+        if ((Now - SMSC_LockTime) < SMSCMD_LOCK_MS)
+        {
+            SMSC_Stat.Locked++;
+            return SMSCMD_DENIED;
+        }
+        SMSC_Locked = 0;
+        SMSC_Tries = 0;
+    }
+
+    /* One pass: the tokens are cut in place, the verb hashed as it goes */
+    while (*p != '\0')
+    {
+        if (SMSCMD_SPACE(*p))
+        {
+            p++;
+            continue;
+        }
+
+        if (n == SMSCMD_TOKENS)
+        {
+            SMSC_Stat.Invalid++;
+            return SMSCMD_INVALID;
+        }
+
+        Tok[n] = p;
+        if (n == 2)
+        {
+            for (; *p != '\0' && !SMSCMD_SPACE(*p); p++)
+                Hash = (Hash ^ SMSCMD_UPPER(*p)) * SMSCMD_FNV_PRIME;
+        } else
+        {
+            for (; *p != '\0' && !SMSCMD_SPACE(*p); p++)
+                ;
+        }
+
+        if (n < 3)
+        {
+            if (p - Tok[n] > 255)
+            {
+                SMSC_Stat.Invalid++;
+                return SMSCMD_INVALID;
+            }
+            Len[n] = p - Tok[n];
+        }
+
+        if (*p != '\0')
+            *p++ = '\0';
+        n++;
+    }
+
+    if (n < 3 || Len[0] != 3 || SMSCMD_UPPER(Tok[0][0]) != 'P' ||
+        SMSCMD_UPPER(Tok[0][1]) != 'I' || SMSCMD_UPPER(Tok[0][2]) != 'N')
+    {
+        SMSC_Stat.Invalid++;
+        return SMSCMD_INVALID;
+    }
+
+    if (!SMSCmd_PinOk(Tok[1], Len[1]))
+    {
+        SMSC_Stat.WrongPin++;
+        if (++SMSC_Tries >= SMSCMD_PIN_TRIES)
+        {
+            SMSC_Locked = 1;
+            SMSC_LockTime = Now;
+        }
+        return SMSCMD_DENIED;
+    }
+    SMSC_Tries = 0;
+
+    if ((Id = SMSCmd_Lookup(Hash, Tok[2], Len[2])) < 0 || SMSC_Handlers[Id] == NULL)
+    {
+        SMSC_Stat.Unknown++;
+        return SMSCMD_UNKNOWN;
+    }
+
+    Cmd = &SMSCmd_Table[Id];
+    if (n - 3 < Cmd->Min || n - 3 > Cmd->Max)
+    {
+        SMSC_Stat.Invalid++;
+        return SMSCMD_INVALID;
+    }
+
+    if (SMSC_Handlers[Id](n - 3, Tok + 3, Reply, Size) != SMSCMD_OK)
+    {
+        SMSC_Stat.Failed++;
+        return SMSCMD_FAIL;
+    }
+
+    SMSC_Stat.Dispatched++;
+
+    return SMSCMD_OK;
+}
+
+
+/**
+ * @name    SMSCmd_GetStat
+ * @brief   The function returns the counters of the dispatcher
+ *
+ * @author  Mehdi
+ */
+
+const SMSCmd_Stat* SMSCmd_GetStat(void)
+{
+    return &SMSC_Stat;
+}
@@ -0,0 +1,118 @@
+/**
+ @file     SMSCmd.h
+ @brief    Dispatcher of the remote control commands sent by SMS:
+               PIN <pin> <VERB> [<arg> ...]
+           e.g. "PIN 1234 LIGHT1 ON". The body is split into tokens in one
+           pass, in place; the verb (any case) is looked up with a minimal
+           perfect hash of SMSCMD_TABLE, generated at build time into
+           SMSCmdHash.c by tools/mkcmdhash.py, so a lookup costs one hash
+           and one compare however many commands the table declares. The
+           PIN is checked in constant time, and SMSCMD_PIN_TRIES wrong PINs
+           in a row lock the dispatcher for SMSCMD_LOCK_MS.
+
+           The handlers are registered by the application; a command
+           without a handler is unknown.
+
+ @author   Mehdi
+
+*/
+
+#ifndef SMSCMD_H_
+#define SMSCMD_H_
+
+#include <stdint.h>
+
+// Configuration
+#ifndef SMSCMD_PIN
+#define SMSCMD_PIN					"1234"	// PIN until SMSCmd_SetPin
+#endif
+
+#ifndef SMSCMD_PIN_TRIES
+#define SMSCMD_PIN_TRIES			5		// Wrong PINs in a row before the lock
+#endif
+
+#ifndef SMSCMD_LOCK_MS
+#define SMSCMD_LOCK_MS				(15UL * 60UL * 1000UL)
+#endif
+
+#define SMSCMD_PIN_MAX				8		// Digits of the longest PIN
+#define SMSCMD_MAX_ARGS				4
+
+/*
+ * X(ID, Verb (upper case), Fewest arguments, Most arguments)
+ * Run tools/mkcmdhash.py after a change.
+ */
+#define SMSCMD_TABLE(X)										\
+    X(LIGHT1,		"LIGHT1",		1, 1)	/* ON | OFF */	\
+    X(LIGHT2,		"LIGHT2",		1, 1)					\
+    X(LIGHT3,		"LIGHT3",		1, 1)					\
+    X(LIGHT4,		"LIGHT4",		1, 1)					\
+    X(ALL,			"ALL",			1, 1)					\
+    X(STATUS,		"STATUS",		0, 0)					\
+    X(REPORT,		"REPORT",		0, 1)	/* [number] */	\
+    X(INTERVAL,		"INTERVAL",		1, 1)	/* seconds */	\
+    X(SETPIN,		"SETPIN",		1, 1)					\
+    X(REBOOT,		"REBOOT",		0, 0)
+
+// Command IDs
+#define SMSCMD_ID(Id, Verb, Min, Max)	SMSCMD_##Id,
+typedef enum
+{
+    SMSCMD_TABLE(SMSCMD_ID)
+    SMSCMD_COUNT
+} SMSCmd_Id;
+#undef SMSCMD_ID
+
+// Results
+#define SMSCMD_OK					 1
+#define SMSCMD_INVALID				-1		// Not "PIN <pin> <VERB>", or the arguments do not fit the verb
+#define SMSCMD_FAIL					-2		// The handler failed
+#define SMSCMD_DENIED				-3		// Wrong PIN, or locked
+#define SMSCMD_UNKNOWN				-4		// No such verb, or no handler
+
+// Runs a command: Argv holds Argc arguments (NUL terminated, as sent).
+// Reply (Size bytes) may be filled with the answer to the sender.
+typedef int8_t (*SMSCmd_Handler)(uint8_t Argc, char** Argv, char* Reply, uint16_t Size);
+
+typedef struct
+{
+    const char* Verb;
+    uint8_t     Len;
+    uint8_t     Min;
+    uint8_t     Max;
+} SMSCmd_Desc;
+
+typedef struct
+{
+    uint32_t Dispatched;		// Handlers run
+    uint32_t Failed;
+    uint32_t Invalid;
+    uint32_t Unknown;
+    uint32_t WrongPin;
+    uint32_t Locked;			// Messages ignored while locked
+} SMSCmd_Stat;
+
+extern const SMSCmd_Desc SMSCmd_Table[SMSCMD_COUNT];
+
+// Generated (SMSCmdHash.c)
+extern const uint8_t  SMSCmd_Buckets;
+extern const uint16_t SMSCmd_Disp[];
+extern const uint8_t  SMSCmd_Slot[SMSCMD_COUNT];
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void SMSCmd_Register(uint8_t Id, SMSCmd_Handler Handler);
+
+int8_t SMSCmd_SetPin(const char* Pin);
+
+int8_t SMSCmd_Find(const char* Verb, uint8_t Len);
+
+int8_t SMSCmd_Dispatch(char* Body, char* Reply, uint16_t Size, uint32_t Now);
+
+const SMSCmd_Stat* SMSCmd_GetStat(void);
+
+
+#endif /* SMSCMD_H_ */
@@ -0,0 +1,43 @@
+/**
+ @file     SMSCmdHash.c
+ @brief    Minimal perfect hash of the SMS command verbs (SMSCMD_TABLE in
+           SMSCmd.h), generated by tools/mkcmdhash.py. Do not edit: change
+           the table and run the script again.
+
+           10 verbs, 5 buckets.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+
+#include "SMSCmd.h"
+
+
+// The table the hash was made for
+typedef char SMSCmd_HashIsCurrent[(SMSCMD_COUNT == 10) ? 1 : -1];
+
+const uint8_t SMSCmd_Buckets = 5;
+
+// Displacement of each bucket
+const uint16_t SMSCmd_Disp[5] =
+{
+    3, 28, 9, 13, 1
+};
+
+// Command of each slot
+const uint8_t SMSCmd_Slot[SMSCMD_COUNT] =
+{
+    SMSCMD_LIGHT1,          // LIGHT1
+    SMSCMD_SETPIN,          // SETPIN
+    SMSCMD_LIGHT4,          // LIGHT4
+    SMSCMD_ALL,             // ALL
+    SMSCMD_LIGHT2,          // LIGHT2
+    SMSCMD_INTERVAL,        // INTERVAL
+    SMSCMD_LIGHT3,          // LIGHT3
+    SMSCMD_STATUS,          // STATUS
+    SMSCMD_REBOOT,          // REBOOT
+    SMSCMD_REPORT,          // REPORT
+};
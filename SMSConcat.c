@@ -0,0 +1,213 @@
+/**
+ @file     SMSConcat.c
+ @brief    This file contains the reassembly table of concatenated SMS.
+           Each slot keeps the user data of the segments received so far
+           (SMSCONCAT_PARTS x 153 octets), so the memory used is fixed at
+           compile time. The text is decoded once, when the last segment
+           arrives.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "SMSPdu.h"
+#include "SMSConcat.h"
+
+
+typedef struct
+{
+    uint8_t  Used;
+    char     Number[SMSPDU_NUM_LEN + 2];
+    uint16_t Ref;
+    uint8_t  Total;
+    uint8_t  Dcs;
+    uint32_t Received;			// Bit n: segment n + 1
+    uint32_t Time;				// First segment
+    uint8_t  Len[SMSCONCAT_PARTS];
+    uint8_t  Ud[SMSCONCAT_PARTS][SMSPDU_CONCAT_SEPTETS];
+} SMSConcat_Slot;
+
+typedef char SMSConcat_PartsFitMask[(SMSCONCAT_PARTS < 32) ? 1 : -1];
+
+static SMSConcat_Slot     SMSC_Slots[SMSCONCAT_SLOTS];
+static SMSConcat_Stat     SMSC_Stat;
+static SMSConcat_Callback SMSC_Callback;
+static char               SMSC_Text[SMSCONCAT_TEXT_LEN];
+
+
+/**
+ * @name    SMSConcat_Init
+ * @brief   The function empties the table and sets the callback that gets
+ *              the complete messages
+ *
+ * @author  Mehdi
+ */
+
+void SMSConcat_Init(SMSConcat_Callback Callback)
+{
+    memset(SMSC_Slots, 0, sizeof(SMSC_Slots));
+    SMSC_Callback = Callback;
+}
+
+
+/**
+ * @name    SMSConcat_Decode
+ * @brief   The function appends the text of a user data to SMSC_Text
+ *
+ * @author  Mehdi
+ *
+ * @return	the new length of the text
+ */
+
+static uint16_t SMSConcat_Decode(uint16_t n, const uint8_t* Ud, uint8_t Len, uint8_t Dcs)
+{
+    int16_t w;
+
+    if (Dcs == SMSPDU_DCS_7BIT)
+        w = SMSPdu_GsmDecode(Ud, Len, SMSC_Text + n, sizeof(SMSC_Text) - n);
+    else if (Dcs == SMSPDU_DCS_UCS2)
+        w = SMSPdu_Ucs2Decode(Ud, Len, SMSC_Text + n, sizeof(SMSC_Text) - n);
+    else
+    {
+        /* 8-bit data is passed as is */
+        w = (Len < sizeof(SMSC_Text) - 1 - n) ? Len : sizeof(SMSC_Text) - 1 - n;
+        memcpy(SMSC_Text + n, Ud, w);
+        SMSC_Text[n + w] = '\0';
+    }
+
+    return (w < 0) ? (uint16_t)strlen(SMSC_Text) : n + w;
+}
+
+
+static void SMSConcat_Deliver(const char* Number)
+{
+    SMSC_Stat.Complete++;
+
+    if (SMSC_Callback != NULL)
+        SMSC_Callback(Number, SMSC_Text);
+}
+
+
+/**
+ * @name    SMSConcat_Add
+ * @brief   The function adds a received message to the table. A message
+ *              that is not a segment is delivered at once.
+ *
+ * @author  Mehdi
+ *
+ * @param	Msg: the message (SIM900ReadDeliver)
+ * @param	Now: the time (ms)
+ * @return	SMSCONCAT_COMPLETE, SMSCONCAT_STORED or SMSCONCAT_DROPPED
+ */
+
+int8_t SMSConcat_Add(const SMSPdu_Deliver* Msg, uint32_t Now)
+{
+    SMSConcat_Slot* Slot = NULL;
+    uint16_t Ref, n;
+    uint8_t Total, Seq, i;
+
+    if (!SMSPdu_GetConcat(Msg, &Ref, &Total, &Seq) || Total == 1)
+    {
+        SMSC_Text[0] = '\0';
+        SMSConcat_Decode(0, Msg->Ud, Msg->UdLen, Msg->Dcs);
+        SMSConcat_Deliver(Msg->Number);
+        return SMSCONCAT_COMPLETE;
+    }
+
+    if (Total > SMSCONCAT_PARTS || Msg->UdLen > SMSPDU_CONCAT_SEPTETS)
+    {
+        SMSC_Stat.Dropped++;
+        return SMSCONCAT_DROPPED;
+    }
+
+    SMSC_Stat.Segments++;
+
+    /* The slot of the message, else a free one, else the oldest */
+    for (i = 0; i < SMSCONCAT_SLOTS; i++)
+    {
+        SMSConcat_Slot* s = &SMSC_Slots[i];
+
+        if (s->Used && s->Ref == Ref && s->Total == Total && strcmp(s->Number, Msg->Number) == 0)
+        {
+            Slot = s;
+            break;
+        }
+        if (Slot == NULL || (Slot->Used && (!s->Used || (int32_t)(s->Time - Slot->Time) < 0)))
+            Slot = s;
+    }
+
+    if (!Slot->Used || Slot->Ref != Ref || Slot->Total != Total || strcmp(Slot->Number, Msg->Number) != 0)
+    {
+        if (Slot->Used)
+            SMSC_Stat.Evicted++;
+
+        Slot->Used = 1;
+        strcpy(Slot->Number, Msg->Number);
+        Slot->Ref = Ref;
+        Slot->Total = Total;
+        Slot->Dcs = Msg->Dcs;
+        Slot->Received = 0;
+        Slot->Time = Now;
+    }
+
+    if (Slot->Received & (1UL << (Seq - 1)))
+    {
+        SMSC_Stat.Duplicates++;
+        return SMSCONCAT_STORED;
+    }
+
+    Slot->Received |= 1UL << (Seq - 1);
+    Slot->Len[Seq - 1] = Msg->UdLen;
+    memcpy(Slot->Ud[Seq - 1], Msg->Ud, Msg->UdLen);
+
+    if (Slot->Received != (1UL << Total) - 1)
+        return SMSCONCAT_STORED;
+
+    /* Complete: decode the segments in order */
+    SMSC_Text[0] = '\0';
+    for (i = n = 0; i < Total; i++)
+        n = SMSConcat_Decode(n, Slot->Ud[i], Slot->Len[i], Slot->Dcs);
+
+    Slot->Used = 0;
+    SMSConcat_Deliver(Slot->Number);
+
+    return SMSCONCAT_COMPLETE;
+}
+
+
+/**
+ * @name    SMSConcat_Poll
+ * @brief   The function evicts the partial messages older than SMSCONCAT_MAX_AGE
+ *
+ * @author  Mehdi
+ */
+
+void SMSConcat_Poll(uint32_t Now)
+{
+    uint8_t i;
+
+    for (i = 0; i < SMSCONCAT_SLOTS; i++)
+    {
+        if (SMSC_Slots[i].Used && (Now - SMSC_Slots[i].Time) > SMSCONCAT_MAX_AGE)
+        {
+            SMSC_Slots[i].Used = 0;
+            SMSC_Stat.Evicted++;
+        }
+    }
+}
+
+
+/**
+ * @name    SMSConcat_GetStat
+ * @brief   The function returns the counters of the table
+ *
+ * @author  Mehdi
+ */
+
+const SMSConcat_Stat* SMSConcat_GetStat(void)
+{
+    return &SMSC_Stat;
+}
@@ -0,0 +1,64 @@
+/**
+ @file     SMSConcat.h
+ @brief    Reassembly of concatenated (multipart) SMS received by the
+           SIM900. Segments are collected by sender and reference in a
+           fixed table; a message is handed to the callback once all its
+           segments arrived. Partial messages are evicted by age.
+
+ @author   Mehdi
+
+*/
+
+#ifndef SMSCONCAT_H_
+#define SMSCONCAT_H_
+
+#include <stdint.h>
+
+#include "SMSPdu.h"
+
+// Configuration
+#ifndef SMSCONCAT_SLOTS
+#define SMSCONCAT_SLOTS				2		// Messages reassembled at the same time
+#endif
+
+#ifndef SMSCONCAT_PARTS
+#define SMSCONCAT_PARTS				4		// Segments of the longest message
+#endif
+
+#ifndef SMSCONCAT_MAX_AGE
+#define SMSCONCAT_MAX_AGE			(10UL * 60UL * 1000UL)	// ms a partial message is kept
+#endif
+
+#define SMSCONCAT_TEXT_LEN			(SMSCONCAT_PARTS * 2 * SMSPDU_CONCAT_SEPTETS + 1)
+
+// Results
+#define SMSCONCAT_COMPLETE			1		// The callback got the message
+#define SMSCONCAT_STORED			0		// Waiting for the other segments
+#define SMSCONCAT_DROPPED			-1		// Too many segments, or a full table
+
+typedef void (*SMSConcat_Callback)(const char* Number, const char* Text);
+
+typedef struct
+{
+    uint32_t Complete;
+    uint32_t Segments;
+    uint32_t Duplicates;
+    uint32_t Evicted;			// Partial messages dropped by age or for room
+    uint32_t Dropped;
+} SMSConcat_Stat;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void SMSConcat_Init(SMSConcat_Callback Callback);
+
+int8_t SMSConcat_Add(const SMSPdu_Deliver* Msg, uint32_t Now);
+
+void SMSConcat_Poll(uint32_t Now);
+
+const SMSConcat_Stat* SMSConcat_GetStat(void);
+
+
+#endif /* SMSCONCAT_H_ */
@@ -0,0 +1,1077 @@
+/**
+ @file     SMSPdu.c
+ @brief    This file contains the SMS PDU codec. The GSM 03.38 alphabet is
+           converted with lookup tables in both directions (septet to
+           Unicode, Latin-1 to septet); septets are packed and unpacked
+           with a bit accumulator, so a message costs one pass.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "SMSPdu.h"
+
+
+#define GSM_ESC						0x1B
+#define GSM_EXT						0x80	// Latin1ToGsm: escaped septet
+#define GSM_NONE					0xFF	// Latin1ToGsm: not in the alphabet
+
+#define SMSPDU_FO_SUBMIT			0x01
+#define SMSPDU_FO_VPF_RELATIVE		0x10
+#define SMSPDU_FO_SRR				0x20
+#define SMSPDU_FO_UDHI				0x40
+#define SMSPDU_MTI(fo)				((fo) & 0x03)
+#define SMSPDU_MTI_DELIVER			0
+#define SMSPDU_MTI_REPORT			2
+
+#define SMSPDU_TOA_INTERNATIONAL	0x91
+#define SMSPDU_TOA_NATIONAL			0x81
+#define SMSPDU_TOA_ALPHANUMERIC		0x50	// Type of number bits
+
+
+/* GSM 7-bit default alphabet, septet -> Unicode */
+static const uint16_t SMSPdu_GsmToUni[128] =
+{
+    0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
+    0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+    0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
+    0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+    0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027,
+    0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+    0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+    0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+    0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+    0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+    0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+    0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+    0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+    0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+    0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+    0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0,
+};
+
+/* Extension table, septet following the escape -> Unicode (0: not defined) */
+static const uint16_t SMSPdu_GsmExtToUni[128] =
+{
+    [0x0A] = 0x000C, [0x14] = 0x005E, [0x28] = 0x007B, [0x29] = 0x007D,
+    [0x2F] = 0x005C, [0x3C] = 0x005B, [0x3D] = 0x007E, [0x3E] = 0x005D,
+    [0x40] = 0x007C, [0x65] = 0x20AC,
+};
+
+/* Latin-1 -> septet; GSM_EXT set for the extension table, GSM_NONE if missing */
+static const uint8_t SMSPdu_Latin1ToGsm[256] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0A, 0xFF, 0x8A, 0x0D, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x20, 0x21, 0x22, 0x23, 0x02, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+    0x00, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+    0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0xBC, 0xAF, 0xBE, 0x94, 0x11,
+    0xFF, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0xA8, 0xC0, 0xA9, 0xBD, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x40, 0xFF, 0x01, 0x24, 0x03, 0xFF, 0x5F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x60,
+    0xFF, 0xFF, 0xFF, 0xFF, 0x5B, 0x0E, 0x1C, 0x09, 0xFF, 0x1F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x5D, 0xFF, 0xFF, 0xFF, 0xFF, 0x5C, 0xFF, 0x0B, 0xFF, 0xFF, 0xFF, 0x5E, 0xFF, 0xFF, 0x1E,
+    0x7F, 0xFF, 0xFF, 0xFF, 0x7B, 0x0F, 0x1D, 0xFF, 0x04, 0x05, 0xFF, 0xFF, 0x07, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x7D, 0x08, 0xFF, 0xFF, 0xFF, 0x7C, 0xFF, 0x0C, 0x06, 0xFF, 0xFF, 0x7E, 0xFF, 0xFF, 0xFF,
+};
+
+/* Greek capitals U+0393..U+03A9 -> septet (0 if missing) */
+static const uint8_t SMSPdu_GreekToGsm[0x03A9 - 0x0393 + 1] =
+{
+    [0x0393 - 0x0393] = 0x13, [0x0394 - 0x0393] = 0x10, [0x0398 - 0x0393] = 0x19,
+    [0x039B - 0x0393] = 0x14, [0x039E - 0x0393] = 0x1A, [0x03A0 - 0x0393] = 0x16,
+    [0x03A3 - 0x0393] = 0x18, [0x03A6 - 0x0393] = 0x12, [0x03A8 - 0x0393] = 0x17,
+    [0x03A9 - 0x0393] = 0x15,
+};
+
+static const char SMSPdu_HexDigit[16] = "0123456789ABCDEF";
+
+
+/***************************************************
+			U T F - 8
+****************************************************/
+
+/**
+ * @name    SMSPdu_Utf8Next
+ * @brief   The function decodes the next code point of a UTF-8 string
+ *
+ * @author  Mehdi
+ *
+ * @param	s: the string; advanced past the code point
+ * @return	the code point, U+FFFD for a malformed sequence
+ */
+
+static uint32_t SMSPdu_Utf8Next(const char** s)
+{
+    const uint8_t* p = (const uint8_t*)*s;
+    uint32_t cp;
+    uint8_t n, i;
+
+    if (p[0] < 0x80)
+    {
+        *s += 1;
+        return p[0];
+    }
+
+    if ((p[0] & 0xE0) == 0xC0)      { cp = p[0] & 0x1F; n = 1; }
+    else if ((p[0] & 0xF0) == 0xE0) { cp = p[0] & 0x0F; n = 2; }
+    else if ((p[0] & 0xF8) == 0xF0) { cp = p[0] & 0x07; n = 3; }
+    else
+    {
+        *s += 1;
+        return 0xFFFD;
+    }
+
+    for (i = 1; i <= n; i++)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+        {
+            *s += i;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+
+    *s += n + 1;
+    return cp;
+}
+
+
+/**
+ * @name    SMSPdu_Utf8Put
+ * @brief   The function appends a code point to a UTF-8 string
+ *
+ * @author  Mehdi
+ *
+ * @return	the number of bytes written, 0 if it does not fit
+ */
+
+static uint8_t SMSPdu_Utf8Put(uint32_t cp, char* Out, uint16_t Room)
+{
+    if (cp < 0x80 && Room >= 1)
+    {
+        Out[0] = cp;
+        return 1;
+    }
+    if (cp >= 0x80 && cp < 0x800 && Room >= 2)
+    {
+        Out[0] = 0xC0 | (cp >> 6);
+        Out[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    }
+    if (cp >= 0x800 && cp < 0x10000 && Room >= 3)
+    {
+        Out[0] = 0xE0 | (cp >> 12);
+        Out[1] = 0x80 | ((cp >> 6) & 0x3F);
+        Out[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    if (cp >= 0x10000 && Room >= 4)
+    {
+        Out[0] = 0xF0 | (cp >> 18);
+        Out[1] = 0x80 | ((cp >> 12) & 0x3F);
+        Out[2] = 0x80 | ((cp >> 6) & 0x3F);
+        Out[3] = 0x80 | (cp & 0x3F);
+        return 4;
+    }
+    return 0;
+}
+
+
+/***************************************************
+		G S M   7 - B I T   A L P H A B E T
+****************************************************/
+
+/**
+ * @name    SMSPdu_GsmEncode
+ * @brief   The function converts a UTF-8 text to septets of the GSM
+ *              default alphabet; characters of the extension table take
+ *              two septets (escape + septet)
+ *
+ * @author  Mehdi
+ *
+ * @param	Utf8: the text
+ * @param	Septets (Out): the septet values (unpacked)
+ * @param	Size: room in Septets
+ * @return	the number of septets, SMSPDU_INVALID if a character is not in
+ *              the alphabet (send it as UCS-2), SMSPDU_TOO_LONG
+ */
+
+int16_t SMSPdu_GsmEncode(const char* Utf8, uint8_t* Septets, uint16_t Size)
+{
+    uint16_t n = 0;
+    uint32_t cp;
+    uint8_t s;
+
+    while (*Utf8 != '\0')
+    {
+        cp = SMSPdu_Utf8Next(&Utf8);
+
+        if (cp < 0x100)
+            s = SMSPdu_Latin1ToGsm[cp];
+        else if (cp >= 0x0393 && cp <= 0x03A9 && SMSPdu_GreekToGsm[cp - 0x0393] != 0)
+            s = SMSPdu_GreekToGsm[cp - 0x0393];
+        else if (cp == 0x20AC)
+            s = GSM_EXT | 0x65;
+        else
+            s = GSM_NONE;
+
+        if (s == GSM_NONE)
+            return SMSPDU_INVALID;
+
+        if (s & GSM_EXT)
+        {
+            if (n + 2 > Size)
+                return SMSPDU_TOO_LONG;
+            Septets[n++] = GSM_ESC;
+            Septets[n++] = s & 0x7F;
+        } else
+        {
+            if (n + 1 > Size)
+                return SMSPDU_TOO_LONG;
+            Septets[n++] = s;
+        }
+    }
+
+    return n;
+}
+
+
+/**
+ * @name    SMSPdu_GsmDecode
+ * @brief   The function converts septets of the GSM default alphabet to a
+ *              UTF-8 text (null terminated)
+ *
+ * @author  Mehdi
+ *
+ * @param	Septets: the septet values (unpacked)
+ * @param	Count: number of septets
+ * @param	Utf8 (Out): the text
+ * @param	Size: size of Utf8
+ * @return	the length of the text, SMSPDU_TOO_LONG if it was truncated
+ */
+
+int16_t SMSPdu_GsmDecode(const uint8_t* Septets, uint16_t Count, char* Utf8, uint16_t Size)
+{
+    uint16_t i, n = 0;
+    uint16_t cp;
+    uint8_t w;
+
+    if (Size == 0)
+        return SMSPDU_TOO_LONG;
+
+    for (i = 0; i < Count; i++)
+    {
+        cp = SMSPdu_GsmToUni[Septets[i] & 0x7F];
+
+        if (Septets[i] == GSM_ESC && i + 1 < Count)
+        {
+            i++;
+            cp = SMSPdu_GsmExtToUni[Septets[i] & 0x7F];
+
+            /* Unknown extension: shown as the default character (23.038) */
+            if (cp == 0)
+                cp = SMSPdu_GsmToUni[Septets[i] & 0x7F];
+        }
+
+        if ((w = SMSPdu_Utf8Put(cp, Utf8 + n, Size - 1 - n)) == 0)
+        {
+            Utf8[n] = '\0';
+            return SMSPDU_TOO_LONG;
+        }
+        n += w;
+    }
+
+    Utf8[n] = '\0';
+    return n;
+}
+
+
+/**
+ * @name    SMSPdu_Pack7
+ * @brief   The function packs septets into octets (LSB first)
+ *
+ * @author  Mehdi
+ *
+ * @param	Septets: the septet values
+ * @param	Count: number of septets
+ * @param	Fill: fill bits before the first septet (user data header alignment)
+ * @param	Out: the octets; the Fill low bits of Out[0] are cleared
+ * @return	the number of octets written
+ */
+
+uint16_t SMSPdu_Pack7(const uint8_t* Septets, uint16_t Count, uint8_t Fill, uint8_t* Out)
+{
+    uint32_t acc = 0;
+    uint8_t bits = Fill;
+    uint16_t i, n = 0;
+
+    for (i = 0; i < Count; i++)
+    {
+        acc |= (uint32_t)(Septets[i] & 0x7F) << bits;
+        bits += 7;
+
+        if (bits >= 8)
+        {
+            Out[n++] = acc;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+
+    if (bits != 0)
+        Out[n++] = acc;
+
+    return n;
+}
+
+
+/**
+ * @name    SMSPdu_Unpack7
+ * @brief   The function unpacks septets from octets (LSB first)
+ *
+ * @author  Mehdi
+ *
+ * @param	In: the octets
+ * @param	Count: number of septets
+ * @param	Fill: fill bits before the first septet
+ * @param	Septets (Out): the septet values
+ */
+
+void SMSPdu_Unpack7(const uint8_t* In, uint16_t Count, uint8_t Fill, uint8_t* Septets)
+{
+    uint32_t acc;
+    uint8_t bits;
+    uint16_t i;
+
+    if (Count == 0)
+        return;
+
+    acc = *In++ >> Fill;
+    bits = 8 - Fill;
+
+    for (i = 0; i < Count; i++)
+    {
+        if (bits < 7)
+        {
+            acc |= (uint32_t)*In++ << bits;
+            bits += 8;
+        }
+
+        Septets[i] = acc & 0x7F;
+        acc >>= 7;
+        bits -= 7;
+    }
+}
+
+
+/***************************************************
+				U C S - 2
+****************************************************/
+
+/**
+ * @name    SMSPdu_Ucs2Encode
+ * @brief   The function converts a UTF-8 text to big endian UCS-2; code
+ *              points above U+FFFF become surrogate pairs
+ *
+ * @author  Mehdi
+ *
+ * @return	the number of octets, SMSPDU_TOO_LONG
+ */
+
+int16_t SMSPdu_Ucs2Encode(const char* Utf8, uint8_t* Out, uint16_t Size)
+{
+    uint16_t n = 0;
+    uint32_t cp;
+
+    while (*Utf8 != '\0')
+    {
+        cp = SMSPdu_Utf8Next(&Utf8);
+
+        if (cp >= 0x10000)
+        {
+            if (n + 4 > Size)
+                return SMSPDU_TOO_LONG;
+            cp -= 0x10000;
+            Out[n++] = 0xD8 | ((cp >> 18) & 0x03);
+            Out[n++] = cp >> 10;
+            Out[n++] = 0xDC | ((cp >> 8) & 0x03);
+            Out[n++] = cp;
+        } else
+        {
+            if (n + 2 > Size)
+                return SMSPDU_TOO_LONG;
+            Out[n++] = cp >> 8;
+            Out[n++] = cp;
+        }
+    }
+
+    return n;
+}
+
+
+/**
+ * @name    SMSPdu_Ucs2Decode
+ * @brief   The function converts big endian UCS-2 to a UTF-8 text (null terminated)
+ *
+ * @author  Mehdi
+ *
+ * @return	the length of the text, SMSPDU_TOO_LONG if it was truncated
+ */
+
+int16_t SMSPdu_Ucs2Decode(const uint8_t* In, uint16_t Len, char* Utf8, uint16_t Size)
+{
+    uint16_t i, n = 0;
+    uint32_t cp, lo;
+    uint8_t w;
+
+    if (Size == 0)
+        return SMSPDU_TOO_LONG;
+
+    for (i = 0; i + 1 < Len; i += 2)
+    {
+        cp = (In[i] << 8) | In[i + 1];
+
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 3 < Len)
+        {
+            lo = (In[i + 2] << 8) | In[i + 3];
+            if (lo >= 0xDC00 && lo < 0xE000)
+            {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                i += 2;
+            }
+        }
+
+        if ((w = SMSPdu_Utf8Put(cp, Utf8 + n, Size - 1 - n)) == 0)
+        {
+            Utf8[n] = '\0';
+            return SMSPDU_TOO_LONG;
+        }
+        n += w;
+    }
+
+    Utf8[n] = '\0';
+    return n;
+}
+
+
+/***************************************************
+			A D D R E S S E S
+****************************************************/
+
+/**
+ * @name    SMSPdu_PutAddress
+ * @brief   The function writes an address field: number of digits, type,
+ *              swapped semi-octets padded with F
+ *
+ * @author  Mehdi
+ *
+ * @return	the number of octets written, SMSPDU_INVALID
+ */
+
+static int16_t SMSPdu_PutAddress(const char* Number, uint8_t* Out)
+{
+    uint8_t Type = SMSPDU_TOA_NATIONAL;
+    uint8_t Digits = 0, d;
+
+    if (*Number == '+')
+    {
+        Type = SMSPDU_TOA_INTERNATIONAL;
+        Number++;
+    }
+
+    for (; *Number != '\0'; Number++)
+    {
+        if (*Number < '0' || *Number > '9' || Digits == SMSPDU_NUM_LEN)
+            return SMSPDU_INVALID;
+
+        d = *Number - '0';
+        if (Digits & 1)
+            Out[2 + Digits / 2] = (Out[2 + Digits / 2] & 0x0F) | (d << 4);
+        else
+            Out[2 + Digits / 2] = 0xF0 | d;
+        Digits++;
+    }
+
+    if (Digits == 0)
+        return SMSPDU_INVALID;
+
+    Out[0] = Digits;
+    Out[1] = Type;
+
+    return 2 + (Digits + 1) / 2;
+}
+
+
+/**
+ * @name    SMSPdu_GetAddress
+ * @brief   The function reads an address field into a string
+ *
+ * @author  Mehdi
+ *
+ * @return	the number of octets read, SMSPDU_INVALID
+ */
+
+static int16_t SMSPdu_GetAddress(const uint8_t* In, uint16_t Len, char* Number)
+{
+    uint8_t Digits, Octets, i, d, n = 0;
+    uint8_t Septets[SMSPDU_NUM_LEN];
+
+    if (Len < 2)
+        return SMSPDU_INVALID;
+
+    Digits = In[0];
+    Octets = (Digits + 1) / 2;
+
+    if (Digits > SMSPDU_NUM_LEN || 2 + Octets > Len)
+        return SMSPDU_INVALID;
+
+    /* Alphanumeric sender: 7-bit packed text, length in semi-octets */
+    if ((In[1] & 0x70) == SMSPDU_TOA_ALPHANUMERIC)
+    {
+        uint8_t Count = Octets * 8 / 7;
+
+        SMSPdu_Unpack7(In + 2, Count, 0, Septets);
+        SMSPdu_GsmDecode(Septets, Count, Number, SMSPDU_NUM_LEN + 2);
+        return 2 + Octets;
+    }
+
+    if ((In[1] & 0x70) == 0x10)
+        Number[n++] = '+';
+
+    for (i = 0; i < Digits; i++)
+    {
+        d = (i & 1) ? (In[2 + i / 2] >> 4) : (In[2 + i / 2] & 0x0F);
+        Number[n++] = SMSPdu_HexDigit[d];
+    }
+    Number[n] = '\0';
+
+    return 2 + Octets;
+}
+
+
+static uint8_t SMSPdu_Bcd(uint8_t b)
+{
+    return (b & 0x0F) * 10 + (b >> 4);
+}
+
+
+/**
+ * @name    SMSPdu_Alphabet
+ * @brief   The function returns the alphabet of a TP-DCS
+ *
+ * @author  Mehdi
+ *
+ * @return	SMSPDU_DCS_7BIT, _8BIT, _UCS2, or SMSPDU_INVALID (compressed, reserved)
+ */
+
+static int8_t SMSPdu_Alphabet(uint8_t Dcs)
+{
+    switch (Dcs >> 4)
+    {
+        case 0x0: case 0x1: case 0x4: case 0x5:		/* General data coding */
+            if (Dcs & 0x20)
+                return SMSPDU_INVALID;
+            return Dcs & 0x0C;
+        case 0x0C: case 0x0D:						/* Message waiting, 7-bit */
+            return SMSPDU_DCS_7BIT;
+        case 0x0E:									/* Message waiting, UCS-2 */
+            return SMSPDU_DCS_UCS2;
+        case 0x0F:									/* Data coding / message class */
+            return (Dcs & 0x04) ? SMSPDU_DCS_8BIT : SMSPDU_DCS_7BIT;
+        default:
+            return SMSPDU_INVALID;
+    }
+}
+
+
+/***************************************************
+			S M S - S U B M I T
+****************************************************/
+
+/**
+ * @name    SMSPdu_Build
+ * @brief   The function builds an SMS-SUBMIT PDU. The service centre
+ *              address is left empty (the one of the SIM is used) and the
+ *              message reference is set by the module.
+ *
+ * @author  Mehdi
+ *
+ * @param	Msg: the message
+ * @param	Pdu (Out): the PDU
+ * @param	Size: size of Pdu (SMSPDU_SUBMIT_LEN is always enough)
+ * @return	the length of the PDU; AT+CMGS takes this length minus one
+ *              (the SCA octet). SMSPDU_INVALID or SMSPDU_TOO_LONG.
+ */
+
+int16_t SMSPdu_Build(const SMSPdu_Submit* Msg, uint8_t* Pdu, uint16_t Size)
+{
+    uint8_t Da[2 + SMSPDU_NUM_LEN / 2];
+    uint16_t n = 0, Udl, UdOctets, Hdr = 0;
+    int16_t DaLen;
+    uint8_t Fill = 0;
+
+    if ((DaLen = SMSPdu_PutAddress(Msg->Number, Da)) < 0)
+        return DaLen;
+
+    if (Msg->Udh != NULL)
+        Hdr = 1 + Msg->UdhLen;
+
+    if (Msg->Dcs == SMSPDU_DCS_7BIT)
+    {
+        /* The header is padded to a septet boundary */
+        uint16_t HdrSeptets = (Hdr * 8 + 6) / 7;
+
+        Fill = HdrSeptets * 7 - Hdr * 8;
+        Udl = HdrSeptets + Msg->UdLen;
+        if (Udl > SMSPDU_UD_SEPTETS)
+            return SMSPDU_TOO_LONG;
+        UdOctets = (Udl * 7 + 7) / 8;
+    } else
+    {
+        Udl = UdOctets = Hdr + Msg->UdLen;
+        if (Udl > SMSPDU_UD_OCTETS)
+            return SMSPDU_TOO_LONG;
+    }
+
+    if (7 + DaLen + UdOctets > Size)
+        return SMSPDU_TOO_LONG;
+
+    Pdu[n++] = 0x00;		/* SCA: use the SIM setting */
+    Pdu[n++] = SMSPDU_FO_SUBMIT | SMSPDU_FO_VPF_RELATIVE
+             | (Msg->Report ? SMSPDU_FO_SRR : 0)
+             | (Hdr ? SMSPDU_FO_UDHI : 0);
+    Pdu[n++] = 0x00;		/* TP-MR: set by the module */
+    memcpy(Pdu + n, Da, DaLen);
+    n += DaLen;
+    Pdu[n++] = 0x00;		/* TP-PID */
+    Pdu[n++] = Msg->Dcs;
+    Pdu[n++] = Msg->Validity;
+    Pdu[n++] = Udl;
+
+    if (Hdr)
+    {
+        Pdu[n++] = Msg->UdhLen;
+        memcpy(Pdu + n, Msg->Udh, Msg->UdhLen);
+        n += Msg->UdhLen;
+    }
+
+    if (Msg->Dcs == SMSPDU_DCS_7BIT)
+    {
+        /* The fill bits are the low bits of the octet after the header */
+        n += SMSPdu_Pack7(Msg->Ud, Msg->UdLen, Fill, Pdu + n);
+    } else
+    {
+        memcpy(Pdu + n, Msg->Ud, Msg->UdLen);
+        n += Msg->UdLen;
+    }
+
+    return n;
+}
+
+
+/**
+ * @name    SMSPdu_BuildText
+ * @brief   The function builds an SMS-SUBMIT PDU of a text. The GSM
+ *              alphabet is used when every character is in it (160 chars),
+ *              UCS-2 otherwise (70 chars).
+ *
+ * @author  Mehdi
+ *
+ * @param	Number: the destination
+ * @param	Utf8: the text
+ * @param	Report: 1 to request a status report
+ * @param	Pdu (Out): the PDU
+ * @param	Size: size of Pdu
+ * @return	the length of the PDU, SMSPDU_INVALID or SMSPDU_TOO_LONG
+ */
+
+int16_t SMSPdu_BuildText(const char* Number, const char* Utf8, uint8_t Report, uint8_t* Pdu, uint16_t Size)
+{
+    uint8_t Ud[SMSPDU_UD_SEPTETS];
+    SMSPdu_Submit Msg;
+    int16_t Len;
+
+    Msg.Number = Number;
+    Msg.Report = Report;
+    Msg.Validity = SMSPDU_VP_24H;
+    Msg.Udh = NULL;
+    Msg.UdhLen = 0;
+    Msg.Ud = Ud;
+
+    if ((Len = SMSPdu_GsmEncode(Utf8, Ud, SMSPDU_UD_SEPTETS)) >= 0)
+        Msg.Dcs = SMSPDU_DCS_7BIT;
+    else if (Len == SMSPDU_INVALID && (Len = SMSPdu_Ucs2Encode(Utf8, Ud, SMSPDU_UD_OCTETS)) >= 0)
+        Msg.Dcs = SMSPDU_DCS_UCS2;
+    else
+        return Len;
+
+    Msg.UdLen = Len;
+
+    return SMSPdu_Build(&Msg, Pdu, Size);
+}
+
+
+/***************************************************
+		S M S - D E L I V E R  /  R E P O R T
+****************************************************/
+
+/**
+ * @name    SMSPdu_ParseDeliver
+ * @brief   The function parses an SMS-DELIVER PDU (with its SCA, as
+ *              returned by AT+CMGR in PDU mode). The user data is unpacked;
+ *              the user data header, if any, is copied to Msg->Udh.
+ *
+ * @author  Mehdi
+ *
+ * @param	Pdu: the PDU
+ * @param	Len: its length
+ * @param	Msg (Out): the message
+ * @return	SMSPDU_OK or SMSPDU_INVALID
+ */
+
+int8_t SMSPdu_ParseDeliver(const uint8_t* Pdu, uint16_t Len, SMSPdu_Deliver* Msg)
+{
+    const uint8_t* End = Pdu + Len;
+    uint8_t Fo, Udl, Hdr = 0;
+    int16_t n;
+    int8_t Alphabet;
+
+    if (Len < 1 || 1 + Pdu[0] + 1 > Len)
+        return SMSPDU_INVALID;
+
+    Pdu += 1 + Pdu[0];		/* SCA */
+    Fo = *Pdu++;
+
+    if (SMSPDU_MTI(Fo) != SMSPDU_MTI_DELIVER)
+        return SMSPDU_INVALID;
+
+    if ((n = SMSPdu_GetAddress(Pdu, End - Pdu, Msg->Number)) < 0)
+        return SMSPDU_INVALID;
+    Pdu += n;
+
+    /* PID, DCS, SCTS, UDL */
+    if (End - Pdu < 10)
+        return SMSPDU_INVALID;
+
+    Msg->Pid = Pdu[0];
+    if ((Alphabet = SMSPdu_Alphabet(Pdu[1])) < 0)
+        return SMSPDU_INVALID;
+    Msg->Dcs = Alphabet;
+
+    for (n = 0; n < 6; n++)
+        Msg->Scts[n] = SMSPdu_Bcd(Pdu[2 + n]);
+    Msg->Tz = SMSPdu_Bcd(Pdu[8] & 0xF7);
+    if (Pdu[8] & 0x08)
+        Msg->Tz = -Msg->Tz;
+
+    Udl = Pdu[9];
+    Pdu += 10;
+
+    Msg->UdhLen = 0;
+    if (Fo & SMSPDU_FO_UDHI)
+    {
+        if (Pdu >= End || Pdu[0] > SMSPDU_UDH_LEN || 1 + Pdu[0] > End - Pdu)
+            return SMSPDU_INVALID;
+        Msg->UdhLen = Pdu[0];
+        memcpy(Msg->Udh, Pdu + 1, Msg->UdhLen);
+        Hdr = 1 + Msg->UdhLen;
+    }
+
+    if (Msg->Dcs == SMSPDU_DCS_7BIT)
+    {
+        uint8_t HdrSeptets = (Hdr * 8 + 6) / 7;
+
+        if (Udl > SMSPDU_UD_SEPTETS || Udl < HdrSeptets || (Udl * 7 + 7) / 8 > End - Pdu)
+            return SMSPDU_INVALID;
+
+        Msg->UdLen = Udl - HdrSeptets;
+        SMSPdu_Unpack7(Pdu + Hdr, Msg->UdLen, HdrSeptets * 7 - Hdr * 8, Msg->Ud);
+    } else
+    {
+        if (Udl > SMSPDU_UD_OCTETS || Udl < Hdr || Udl > End - Pdu)
+            return SMSPDU_INVALID;
+
+        Msg->UdLen = Udl - Hdr;
+        memcpy(Msg->Ud, Pdu + Hdr, Msg->UdLen);
+    }
+
+    return SMSPDU_OK;
+}
+
+
+/**
+ * @name    SMSPdu_ParseReport
+ * @brief   The function parses an SMS-STATUS-REPORT PDU (with its SCA,
+ *              as routed by "+CDS: <length>" in PDU mode)
+ *
+ * @author  Mehdi
+ *
+ * @return	SMSPDU_OK or SMSPDU_INVALID
+ */
+
+int8_t SMSPdu_ParseReport(const uint8_t* Pdu, uint16_t Len, SMSPdu_Report* Report)
+{
+    const uint8_t* End = Pdu + Len;
+    int16_t n;
+
+    if (Len < 1 || 1 + Pdu[0] + 2 > Len)
+        return SMSPDU_INVALID;
+
+    Pdu += 1 + Pdu[0];		/* SCA */
+
+    if (SMSPDU_MTI(Pdu[0]) != SMSPDU_MTI_REPORT)
+        return SMSPDU_INVALID;
+
+    Report->MsgRef = Pdu[1];
+    Pdu += 2;
+
+    if ((n = SMSPdu_GetAddress(Pdu, End - Pdu, Report->Number)) < 0)
+        return SMSPDU_INVALID;
+    Pdu += n;
+
+    /* SCTS, DT, ST */
+    if (End - Pdu < 15)
+        return SMSPDU_INVALID;
+
+    Report->Status = Pdu[14];
+
+    return SMSPDU_OK;
+}
+
+
+/**
+ * @name    SMSPdu_Text
+ * @brief   The function converts the user data of a parsed message to a
+ *              UTF-8 text; 8-bit data is taken as Latin-1
+ *
+ * @author  Mehdi
+ *
+ * @param	Msg: the message (SMSPdu_ParseDeliver)
+ * @param	Utf8 (Out): the text (SMSPDU_TEXT_LEN is always enough)
+ * @param	Size: size of Utf8
+ * @return	the length of the text, SMSPDU_TOO_LONG if it was truncated
+ */
+
+int16_t SMSPdu_Text(const SMSPdu_Deliver* Msg, char* Utf8, uint16_t Size)
+{
+    uint16_t i, n = 0;
+    uint8_t w;
+
+    if (Msg->Dcs == SMSPDU_DCS_7BIT)
+        return SMSPdu_GsmDecode(Msg->Ud, Msg->UdLen, Utf8, Size);
+
+    if (Msg->Dcs == SMSPDU_DCS_UCS2)
+        return SMSPdu_Ucs2Decode(Msg->Ud, Msg->UdLen, Utf8, Size);
+
+    if (Size == 0)
+        return SMSPDU_TOO_LONG;
+
+    for (i = 0; i < Msg->UdLen; i++)
+    {
+        if ((w = SMSPdu_Utf8Put(Msg->Ud[i], Utf8 + n, Size - 1 - n)) == 0)
+        {
+            Utf8[n] = '\0';
+            return SMSPDU_TOO_LONG;
+        }
+        n += w;
+    }
+
+    Utf8[n] = '\0';
+    return n;
+}
+
+
+/***************************************************
+		C O N C A T E N A T E D   S M S
+****************************************************/
+
+/**
+ * @name    SMSPdu_ConcatUdh
+ * @brief   The function writes the user data header of a segment
+ *              (information element 0x00, 8-bit reference)
+ *
+ * @author  Mehdi
+ *
+ * @param	Udh (Out): SMSPDU_CONCAT_UDH_LEN octets, without the length octet
+ * @param	Ref: the reference shared by the segments of a message
+ * @param	Total: number of segments
+ * @param	Seq: number of this segment, from 1
+ * @return	SMSPDU_CONCAT_UDH_LEN
+ */
+
+uint8_t SMSPdu_ConcatUdh(uint8_t* Udh, uint8_t Ref, uint8_t Total, uint8_t Seq)
+{
+    Udh[0] = 0x00;
+    Udh[1] = 3;
+    Udh[2] = Ref;
+    Udh[3] = Total;
+    Udh[4] = Seq;
+
+    return SMSPDU_CONCAT_UDH_LEN;
+}
+
+
+/**
+ * @name    SMSPdu_GetConcat
+ * @brief   The function finds the concatenation element (8 or 16-bit
+ *              reference) in the user data header of a message
+ *
+ * @author  Mehdi
+ *
+ * @return	1 if the message is a segment, 0 otherwise
+ */
+
+uint8_t SMSPdu_GetConcat(const SMSPdu_Deliver* Msg, uint16_t* Ref, uint8_t* Total, uint8_t* Seq)
+{
+    uint8_t i = 0;
+
+    while (i + 2 <= Msg->UdhLen)
+    {
+        const uint8_t* Ie = Msg->Udh + i;
+
+        if (i + 2 + Ie[1] > Msg->UdhLen)
+            break;
+
+        if (Ie[0] == 0x00 && Ie[1] == 3)
+        {
+            *Ref = Ie[2];
+            *Total = Ie[3];
+            *Seq = Ie[4];
+            return *Total != 0 && *Seq != 0 && *Seq <= *Total;
+        }
+
+        if (Ie[0] == 0x08 && Ie[1] == 4)
+        {
+            *Ref = (Ie[2] << 8) | Ie[3];
+            *Total = Ie[4];
+            *Seq = Ie[5];
+            return *Total != 0 && *Seq != 0 && *Seq <= *Total;
+        }
+
+        i += 2 + Ie[1];
+    }
+
+    return 0;
+}
+
+
+/**
+ * @name    SMSPdu_Segment
+ * @brief   The function returns the length of the next segment of a user
+ *              data; an escape septet and its character, or a surrogate
+ *              pair, are never split
+ *
+ * @author  Mehdi
+ *
+ * @param	Ud: the remaining user data (septets or octets)
+ * @param	Len: its length
+ * @param	Dcs: SMSPDU_DCS_xxx
+ * @param	Max: room in the segment
+ * @return	the length of the segment
+ */
+
+uint16_t SMSPdu_Segment(const uint8_t* Ud, uint16_t Len, uint8_t Dcs, uint16_t Max)
+{
+    uint16_t i, n;
+
+    if (Len <= Max)
+        return Len;
+
+    if (Dcs == SMSPDU_DCS_7BIT)
+    {
+        /* Septets after the last one known to start a character */
+        for (i = n = 0; i < Max; i += (Ud[i] == GSM_ESC) ? 2 : 1)
+            n = i;
+        return (i == Max) ? Max : n;
+    }
+
+    if (Dcs == SMSPDU_DCS_UCS2)
+    {
+        Max &= ~1;
+        if (Ud[Max - 2] >= 0xD8 && Ud[Max - 2] < 0xDC)
+            Max -= 2;
+    }
+
+    return Max;
+}
+
+
+/***************************************************
+				H E X
+****************************************************/
+
+/**
+ * @name    SMSPdu_ToHex
+ * @brief   The function converts octets to the hexadecimal text the module
+ *              exchanges in PDU mode (null terminated)
+ *
+ * @author  Mehdi
+ *
+ * @param	Hex (Out): at least 2 * Len + 1 chars
+ * @return	the number of chars
+ */
+
+uint16_t SMSPdu_ToHex(const uint8_t* In, uint16_t Len, char* Hex)
+{
+    uint16_t i;
+
+    for (i = 0; i < Len; i++)
+    {
+        Hex[2 * i]     = SMSPdu_HexDigit[In[i] >> 4];
+        Hex[2 * i + 1] = SMSPdu_HexDigit[In[i] & 0x0F];
+    }
+    Hex[2 * Len] = '\0';
+
+    return 2 * Len;
+}
+
+
+static int8_t SMSPdu_Nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+
+/**
+ * @name    SMSPdu_FromHex
+ * @brief   The function converts hexadecimal text to octets; it stops at
+ *              the first char that is not a hex digit (e.g. CR)
+ *
+ * @author  Mehdi
+ *
+ * @return	the number of octets, SMSPDU_INVALID (odd number of digits)
+ *              or SMSPDU_TOO_LONG
+ */
+
+int16_t SMSPdu_FromHex(const char* Hex, uint8_t* Out, uint16_t Size)
+{
+    uint16_t n = 0;
+    int8_t hi, lo;
+
+    while ((hi = SMSPdu_Nibble(Hex[0])) >= 0)
+    {
+        if ((lo = SMSPdu_Nibble(Hex[1])) < 0)
+            return SMSPDU_INVALID;
+        if (n == Size)
+            return SMSPDU_TOO_LONG;
+
+        Out[n++] = (hi << 4) | lo;
+        Hex += 2;
+    }
+
+    return n;
+}
@@ -0,0 +1,113 @@
+/**
+ @file     SMSPdu.h
+ @brief    SMS PDU codec (3GPP TS 23.040 / 23.038) for the SIM900 in PDU
+           mode: GSM 7-bit default alphabet with its extension table,
+           UCS-2 from/to UTF-8, 8-bit data, SMS-SUBMIT build and
+           SMS-DELIVER / SMS-STATUS-REPORT parse. Fixed buffers, no heap.
+
+ @author   Mehdi
+
+*/
+
+#ifndef SMSPDU_H_
+#define SMSPDU_H_
+
+#include <stdint.h>
+
+// Results
+#define SMSPDU_OK					 1
+#define SMSPDU_INVALID				-1		// Malformed PDU, or text not representable in the alphabet
+#define SMSPDU_TOO_LONG				-2		// Does not fit the user data or the output buffer
+
+// Data Coding Schemes (TP-DCS, general data coding group, no class)
+#define SMSPDU_DCS_7BIT				0x00
+#define SMSPDU_DCS_8BIT				0x04
+#define SMSPDU_DCS_UCS2				0x08
+
+// Sizes
+#define SMSPDU_UD_OCTETS			140		// TP-UD of one message
+#define SMSPDU_UD_SEPTETS			160
+#define SMSPDU_NUM_LEN				20		// Digits of an address
+#define SMSPDU_UDH_LEN				32		// User data header kept by the parser
+#define SMSPDU_SUBMIT_LEN			(1 + 1 + 1 + 12 + 3 + 1 + SMSPDU_UD_OCTETS)	// SMS-SUBMIT, empty SCA
+#define SMSPDU_MAX_LEN				(12 + 1 + 12 + 2 + 7 + 1 + SMSPDU_UD_OCTETS)	// SMS-DELIVER, full SCA
+#define SMSPDU_TEXT_LEN				(2 * SMSPDU_UD_SEPTETS + 1)	// Longest UTF-8 text of one message
+
+#define SMSPDU_VP_24H				167		// TP-VP, relative format
+
+// Concatenated messages (user data header, 8-bit reference)
+#define SMSPDU_CONCAT_UDH_LEN		5
+#define SMSPDU_CONCAT_SEPTETS		153		// 7-bit user data of a segment
+#define SMSPDU_CONCAT_OCTETS		134		// 8-bit / UCS-2 user data of a segment
+
+typedef struct
+{
+    const char*    Number;		// "+<country><number>" (international) or national digits
+    uint8_t        Dcs;			// SMSPDU_DCS_xxx
+    uint8_t        Report;		// 1: request a status report (TP-SRR)
+    uint8_t        Validity;	// TP-VP, relative format
+    const uint8_t* Udh;			// User data header without its length octet, NULL if none
+    uint8_t        UdhLen;
+    const uint8_t* Ud;			// Septets (7-bit, see SMSPdu_GsmEncode) or octets
+    uint8_t        UdLen;
+} SMSPdu_Submit;
+
+typedef struct
+{
+    char     Number[SMSPDU_NUM_LEN + 2];	// Originating address ("+..." or alphanumeric)
+    uint8_t  Pid;
+    uint8_t  Dcs;				// SMSPDU_DCS_xxx (alphabet of Ud)
+    uint8_t  Scts[6];			// Service centre time stamp: YY MM DD hh mm ss
+    int8_t   Tz;				// Time zone, in quarters of an hour
+    uint8_t  UdhLen;			// 0 if no user data header
+    uint8_t  Udh[SMSPDU_UDH_LEN];
+    uint8_t  UdLen;				// Septets (7-bit) or octets, header excluded
+    uint8_t  Ud[SMSPDU_UD_SEPTETS];
+} SMSPdu_Deliver;
+
+typedef struct
+{
+    uint8_t  MsgRef;			// TP-MR of the submitted message
+    uint8_t  Status;			// TP-ST: < 0x20 delivered, 0x20..0x3F still trying, else failed
+    char     Number[SMSPDU_NUM_LEN + 2];
+} SMSPdu_Report;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+int16_t SMSPdu_GsmEncode(const char* Utf8, uint8_t* Septets, uint16_t Size);
+
+int16_t SMSPdu_GsmDecode(const uint8_t* Septets, uint16_t Count, char* Utf8, uint16_t Size);
+
+uint16_t SMSPdu_Pack7(const uint8_t* Septets, uint16_t Count, uint8_t Fill, uint8_t* Out);
+
+void SMSPdu_Unpack7(const uint8_t* In, uint16_t Count, uint8_t Fill, uint8_t* Septets);
+
+int16_t SMSPdu_Ucs2Encode(const char* Utf8, uint8_t* Out, uint16_t Size);
+
+int16_t SMSPdu_Ucs2Decode(const uint8_t* In, uint16_t Len, char* Utf8, uint16_t Size);
+
+int16_t SMSPdu_Build(const SMSPdu_Submit* Msg, uint8_t* Pdu, uint16_t Size);
+
+int16_t SMSPdu_BuildText(const char* Number, const char* Utf8, uint8_t Report, uint8_t* Pdu, uint16_t Size);
+
+int8_t SMSPdu_ParseDeliver(const uint8_t* Pdu, uint16_t Len, SMSPdu_Deliver* Msg);
+
+int8_t SMSPdu_ParseReport(const uint8_t* Pdu, uint16_t Len, SMSPdu_Report* Report);
+
+int16_t SMSPdu_Text(const SMSPdu_Deliver* Msg, char* Utf8, uint16_t Size);
+
+uint8_t SMSPdu_ConcatUdh(uint8_t* Udh, uint8_t Ref, uint8_t Total, uint8_t Seq);
+
+uint8_t SMSPdu_GetConcat(const SMSPdu_Deliver* Msg, uint16_t* Ref, uint8_t* Total, uint8_t* Seq);
+
+uint16_t SMSPdu_Segment(const uint8_t* Ud, uint16_t Len, uint8_t Dcs, uint16_t Max);
+
+uint16_t SMSPdu_ToHex(const uint8_t* In, uint16_t Len, char* Hex);
+
+int16_t SMSPdu_FromHex(const char* Hex, uint8_t* Out, uint16_t Size);
+
+
+#endif /* SMSPDU_H_ */
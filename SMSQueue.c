@@ -0,0 +1,542 @@
+/**
+ @file     SMSQueue.c
+ @brief    This file contains the outbound SMS queue of the SIM900.
+           Messages are submitted back to back: the next AT+CMGS goes out
+           as soon as the module returns "+CMGS: <mr>" for the previous one
+           (the driver reads its "OK" before any other command is sent),
+           and the body is sent on the "> " prompt instead of after a fixed
+           delay. Messages go out in PDU mode with a status report request
+           (TP-SRR); the "+CDS:" reports are routed to the uC (AT+CNMI) and
+           matched to the submitted segments by <mr>. A long text is
+           encoded once when it is posted, then submitted segment after
+           segment with a concatenation header; it is delivered when the
+           reports of all its segments arrived.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ATCmd.h"
+#include "SIM900.h"
+#include "SMSPdu.h"
+#include "SMSQueue.h"
+#include "BufPool.h"
+#include "TimeBase.h"
+
+
+#define SMSQ_IDLE			0
+#define SMSQ_WAIT_CMGS		1
+
+#define SMSQ_LINE_LEN		128
+
+#define SMSQ_NO_BUFFER		-4		// SMSQueue_Submit: the buffer pool is empty
+
+typedef struct
+{
+    char Num[SMSQUEUE_NUM_LEN + 1];
+    uint8_t Ud[SMSQUEUE_UD_LEN];	// Septets (7-bit) or UCS-2 octets of the whole text
+    uint16_t UdLen;
+    uint16_t Offset;				// Start of the segment being submitted
+    uint8_t SegLen;					// Length of the segment being submitted
+    uint8_t Dcs;
+    uint8_t Parts;
+    uint8_t Part;					// Segments submitted
+    uint8_t Ref;					// Concatenation reference
+    uint8_t Tries;					// Failed submissions of the segment
+    uint32_t RetryAt;				// Next submission (when Tries != 0)
+    SMSQueue_Callback Callback;
+    uint8_t Handle;
+} SMSQueue_Item;
+
+typedef struct
+{
+    uint8_t Used;
+    uint8_t Done;					// Status report: delivered
+    uint8_t MsgRef;
+    uint8_t Handle;
+    uint8_t Parts;
+    SMSQueue_Callback Callback;
+    uint32_t Time;
+} SMSQueue_Track;
+
+static SMSQueue_Item  SMSQ_Items[SMSQUEUE_DEPTH];
+static SMSQueue_Track SMSQ_Tracks[SMSQUEUE_TRACK];
+static SMSQueue_Stat  SMSQ_Stat;
+
+static uint8_t  SMSQ_Head;
+static uint8_t  SMSQ_Count;
+static uint8_t  SMSQ_NextHandle;
+static uint8_t  SMSQ_NextRef;
+static uint8_t  SMSQ_State = SMSQ_IDLE;
+static uint32_t SMSQ_Since;
+static uint8_t  SMSQ_CdsPending;     // "+CDS: <length>" read, the PDU line follows
+
+
+/**
+ * @name    SMSQueue_Notify
+ * @brief   The function updates the counters and calls the callback of a message
+ *
+ * @author  Mehdi
+ */
+
+static void SMSQueue_Notify(SMSQueue_Callback Callback, uint8_t Handle, uint8_t Status, uint8_t MsgRef)
+{
+    if (Status == SMSQUEUE_SUBMITTED)
+        SMSQ_Stat.Submitted++;
+    else if (Status == SMSQUEUE_DELIVERED)
+        SMSQ_Stat.Delivered++;
+    else if (Status == SMSQUEUE_FAILED)
+        SMSQ_Stat.Failed++;
+    else if (Status == SMSQUEUE_EXPIRED)
+        SMSQ_Stat.Expired++;
+
+    if (Callback != NULL)
+        Callback(Handle, Status, MsgRef);
+}
+
+
+/**
+ * @name    SMSQueue_Pop
+ * @brief   The function removes the head of the queue and returns to idle
+ *
+ * @author  Mehdi
+ */
+
+static void SMSQueue_Pop(void)
+{
+    SMSQ_Head = (SMSQ_Head + 1) % SMSQUEUE_DEPTH;
+    SMSQ_Count--;
+    SMSQ_State = SMSQ_IDLE;
+}
+
+
+/**
+ * @name    SMSQueue_Forget
+ * @brief   The function removes the segments of a message from the report
+ *              table and gives the final status of the message
+ *
+ * @author  Mehdi
+ */
+
+static void SMSQueue_Forget(const SMSQueue_Track* Track, uint8_t Status)
+{
+    SMSQueue_Callback Callback = Track->Callback;
+    uint8_t Handle = Track->Handle, MsgRef = Track->MsgRef;
+    uint8_t i;
+
+    for (i = 0; i < SMSQUEUE_TRACK; i++)
+        if (SMSQ_Tracks[i].Used && SMSQ_Tracks[i].Handle == Handle)
+            SMSQ_Tracks[i].Used = 0;
+
+    SMSQueue_Notify(Callback, Handle, Status, MsgRef);
+}
+
+
+/**
+ * @name    SMSQueue_TrackMsg
+ * @brief   The function stores a submitted segment in the report table.
+ *              If the table is full the message of the oldest entry is expired.
+ *
+ * @author  Mehdi
+ */
+
+static void SMSQueue_TrackMsg(const SMSQueue_Item* Item, uint8_t MsgRef, uint32_t Now)
+{
+    uint8_t i, slot = 0;
+
+    for (i = 0; i < SMSQUEUE_TRACK; i++)
+    {
+        if (!SMSQ_Tracks[i].Used)
+        {
+            slot = i;
+            break;
+        }
+        if ((int32_t)(SMSQ_Tracks[i].Time - SMSQ_Tracks[slot].Time) < 0)
+            slot = i;
+    }
+
+    if (SMSQ_Tracks[slot].Used)
+        SMSQueue_Forget(&SMSQ_Tracks[slot], SMSQUEUE_EXPIRED);
+
+    SMSQ_Tracks[slot].Used = 1;
+    SMSQ_Tracks[slot].Done = 0;
+    SMSQ_Tracks[slot].MsgRef = MsgRef;
+    SMSQ_Tracks[slot].Handle = Item->Handle;
+    SMSQ_Tracks[slot].Parts = Item->Parts;
+    SMSQ_Tracks[slot].Callback = Item->Callback;
+    SMSQ_Tracks[slot].Time = Now;
+}
+
+
+/**
+ * @name    SMSQueue_Fail
+ * @brief   The function drops the head of the queue after a failed
+ *              submission, with the segments it already submitted
+ *
+ * @author  Mehdi
+ */
+
+static void SMSQueue_Fail(SMSQueue_Item* Item)
+{
+    uint8_t i;
+
+    for (i = 0; i < SMSQUEUE_TRACK; i++)
+        if (SMSQ_Tracks[i].Used && SMSQ_Tracks[i].Handle == Item->Handle)
+            SMSQ_Tracks[i].Used = 0;
+
+    SMSQueue_Notify(Item->Callback, Item->Handle, SMSQUEUE_FAILED, 0);
+    SMSQueue_Pop();
+}
+
+
+/**
+ * @name    SMSQueue_Submit
+ * @brief   The function builds the PDU of the next segment of a message
+ *              and hands it to the module
+ *
+ * @author  Mehdi
+ *
+ * @return  SIM900_OK when the PDU is sent, SMSQ_NO_BUFFER, SIM900_FAIL
+ *              or SIM900_TIMEOUT otherwise
+ */
+
+static int8_t SMSQueue_Submit(SMSQueue_Item* Item)
+{
+    uint8_t Udh[SMSPDU_CONCAT_UDH_LEN];
+    uint8_t* Pdu;
+    SMSPdu_Submit Msg;
+    int16_t Len;
+    int8_t res = SIM900_FAIL;
+
+    Msg.Number = Item->Num;
+    Msg.Dcs = Item->Dcs;
+    Msg.Report = 1;
+    Msg.Validity = SMSPDU_VP_24H;
+    Msg.Ud = Item->Ud + Item->Offset;
+    Msg.Udh = NULL;
+    Msg.UdhLen = 0;
+
+    if (Item->Parts == 1)
+        Msg.UdLen = Item->UdLen;
+    else
+    {
+        Msg.UdLen = SMSPdu_Segment(Msg.Ud, Item->UdLen - Item->Offset, Item->Dcs,
+                                   (Item->Dcs == SMSPDU_DCS_7BIT) ? SMSPDU_CONCAT_SEPTETS : SMSPDU_CONCAT_OCTETS);
+        Msg.Udh = Udh;
+        Msg.UdhLen = SMSPdu_ConcatUdh(Udh, Item->Ref, Item->Parts, Item->Part + 1);
+    }
+
+    Item->SegLen = Msg.UdLen;
+
+    if ((Pdu = BufPool_Get(SMSPDU_SUBMIT_LEN, BUFPOOL_SMS)) == NULL)
+        return SMSQ_NO_BUFFER;
+
+    if ((Len = SMSPdu_Build(&Msg, Pdu, SMSPDU_SUBMIT_LEN)) >= 0)
+        res = SIM900SubmitPdu(Pdu, Len);
+
+    BufPool_Put(Pdu);
+
+    return res;
+}
+
+
+/**
+ * @name    SMSQueue_Report
+ * @brief   The function matches a status report PDU to a submitted message
+ *
+ * @author  Mehdi
+ *
+ * @param	Hex: the PDU line that follows "+CDS: <length>"
+ */
+
+static void SMSQueue_Report(const char* Hex)
+{
+    uint8_t Pdu[SMSQ_LINE_LEN / 2];
+    SMSPdu_Report Report;
+    int16_t Len;
+    uint8_t i, j, done;
+
+    if ((Len = SMSPdu_FromHex(Hex, Pdu, sizeof(Pdu))) < 0 ||
+        SMSPdu_ParseReport(Pdu, Len, &Report) != SMSPDU_OK)
+        return;
+
+    /* 0x20..0x3F: the network is still trying */
+    if (Report.Status >= 0x20 && Report.Status < 0x40)
+        return;
+
+    for (i = 0; i < SMSQUEUE_TRACK; i++)
+    {
+        if (SMSQ_Tracks[i].Used && !SMSQ_Tracks[i].Done && SMSQ_Tracks[i].MsgRef == Report.MsgRef)
+            break;
+    }
+
+    if (i == SMSQUEUE_TRACK)
+        return;
+
+    if (Report.Status >= 0x40)
+    {
+        SMSQueue_Forget(&SMSQ_Tracks[i], SMSQUEUE_FAILED);
+        return;
+    }
+
+    /* The message is delivered with its last segment */
+    SMSQ_Tracks[i].Done = 1;
+    for (j = done = 0; j < SMSQUEUE_TRACK; j++)
+        if (SMSQ_Tracks[j].Used && SMSQ_Tracks[j].Done && SMSQ_Tracks[j].Handle == SMSQ_Tracks[i].Handle)
+            done++;
+
+    if (done == SMSQ_Tracks[i].Parts)
+        SMSQueue_Forget(&SMSQ_Tracks[i], SMSQUEUE_DELIVERED);
+}
+
+
+/**
+ * @name    SMSQueue_Init
+ * @brief   The function selects PDU mode and routes the status reports
+ *              to the uC as "+CDS:" lines
+ *
+ * @author  Mehdi
+ *
+ * @return  SIM900_OK if the module accepted the configuration
+ */
+
+int8_t SMSQueue_Init(void)
+{
+    int8_t res;
+
+    SMSQ_Head = SMSQ_Count = 0;
+    SMSQ_State = SMSQ_IDLE;
+    SMSQ_CdsPending = 0;
+    memset(SMSQ_Tracks, 0, sizeof(SMSQ_Tracks));
+
+    SIM900SetURCHandler(SMSQueue_HandleLine);
+
+    /* Validity period and status report request are set in each PDU */
+    if ((res = SIM900Run(AT_SIM_CMGF_PDU,NULL)) != SIM900_OK)
+        return res;
+
+    /* Route status reports to the uC (+CDS) */
+    return SIM900Run(AT_SIM_CNMI_REPORT,NULL);
+}
+
+
+/**
+ * @name    SMSQueue_Post
+ * @brief   The function queues a message for submission; it does not block.
+ *
+ * @author  Mehdi
+ *
+ * @param	Num: Phone number ex "+919XXXXXXX"
+ * @param	Msg: Message Body, UTF-8; sent in the GSM alphabet when possible,
+ *              in UCS-2 otherwise, in up to SMSQUEUE_MAX_PARTS segments
+ * @param	Callback: called on submission, delivery or failure (may be NULL)
+ * @return  the handle of the message, SMSQUEUE_FULL, SMSQUEUE_TOO_LONG
+ *              or SMSQUEUE_INVALID
+ */
+
+int16_t SMSQueue_Post(const char* Num, const char* Msg, SMSQueue_Callback Callback)
+{
+    SMSQueue_Item* Item;
+    uint16_t Off, Single, Segment;
+    int16_t Len;
+
+    if (*Num == '\0' || strlen(Num) > SMSQUEUE_NUM_LEN)
+        return SMSQUEUE_INVALID;
+
+    if (SMSQ_Count == SMSQUEUE_DEPTH)
+        return SMSQUEUE_FULL;
+
+    Item = &SMSQ_Items[(SMSQ_Head + SMSQ_Count) % SMSQUEUE_DEPTH];
+
+    /* Encode once; the segments are cut from the encoded text */
+    if ((Len = SMSPdu_GsmEncode(Msg, Item->Ud, SMSQUEUE_UD_LEN)) >= 0)
+    {
+        Item->Dcs = SMSPDU_DCS_7BIT;
+        Single = SMSPDU_UD_SEPTETS;
+        Segment = SMSPDU_CONCAT_SEPTETS;
+    } else if (Len == SMSPDU_INVALID && (Len = SMSPdu_Ucs2Encode(Msg, Item->Ud, SMSQUEUE_UD_LEN)) >= 0)
+    {
+        Item->Dcs = SMSPDU_DCS_UCS2;
+        Single = SMSPDU_UD_OCTETS;
+        Segment = SMSPDU_CONCAT_OCTETS;
+    } else
+        return SMSQUEUE_TOO_LONG;
+
+    Item->UdLen = Len;
+    Item->Parts = 1;
+
+    if (Len > Single)
+    {
+        for (Off = 0, Item->Parts = 0; Off < Len; Item->Parts++)
+            Off += SMSPdu_Segment(Item->Ud + Off, Len - Off, Item->Dcs, Segment);
+
+        if (Item->Parts > SMSQUEUE_MAX_PARTS)
+            return SMSQUEUE_TOO_LONG;
+    }
+
+    strcpy(Item->Num, Num);
+    Item->Offset = 0;
+    Item->Part = 0;
+    Item->Ref = SMSQ_NextRef++;
+    Item->Tries = 0;
+    Item->Callback = Callback;
+    Item->Handle = SMSQ_NextHandle++;
+
+    SMSQ_Count++;
+    SMSQ_Stat.Posted++;
+
+    return Item->Handle;
+}
+
+
+/**
+ * @name    SMSQueue_HandleLine
+ * @brief   The function handles a line received from the module:
+ *              the result of the current submission and status reports
+ *
+ * @author  Mehdi
+ *
+ * @param	Line: the received line
+ * @return  1 if the line was consumed, 0 otherwise
+ */
+
+uint8_t SMSQueue_HandleLine(const char* Line)
+{
+    uint8_t ref;
+
+    while (*Line == '\r' || *Line == '\n')
+        Line++;
+
+    /* Result of the current submission */
+    if (SMSQ_State == SMSQ_WAIT_CMGS)
+    {
+        SMSQueue_Item* Item = &SMSQ_Items[SMSQ_Head];
+
+        if (strncmp(Line,"+CMGS:",6) == 0)
+        {
+            ref = atoi(Line + 6);
+            SMSQueue_TrackMsg(Item, ref, TimeBase_Ms());
+            SMSQ_Stat.Segments++;
+
+            Item->Offset += Item->SegLen;
+            Item->Tries = 0;
+            if (++Item->Part < Item->Parts)
+            {
+                /* The next segment goes out on the next poll */
+                SMSQ_State = SMSQ_IDLE;
+                return 1;
+            }
+
+            SMSQueue_Notify(Item->Callback, Item->Handle, SMSQUEUE_SUBMITTED, ref);
+            SMSQueue_Pop();
+            return 1;
+        }
+
+        if (strncmp(Line,"+CMS ERROR",10) == 0 || strncmp(Line,"ERROR",5) == 0)
+        {
+            SMSQueue_Fail(Item);
+            return 1;
+        }
+    }
+
+    /* Status report: +CDS: <length><CR><LF><pdu> */
+    if (strncmp(Line,"+CDS:",5) == 0)
+    {
+        SMSQ_CdsPending = 1;
+        return 1;
+    }
+
+    if (SMSQ_CdsPending && *Line != '\0')
+    {
+        SMSQ_CdsPending = 0;
+        SMSQueue_Report(Line);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @name    SMSQueue_Poll
+ * @brief   The function drives the queue: it handles the pending lines,
+ *              submits the next message when the module is free and
+ *              expires the messages whose report never came. A submission
+ *              that got no prompt or no buffer is tried again with backoff
+ *              (SMSQUEUE_RETRIES) before the message is failed.
+ *              It should be called from the main loop.
+ *
+ * @author  Mehdi
+ */
+
+void SMSQueue_Poll(void)
+{
+    uint32_t now;
+    uint8_t i;
+    int8_t res;
+
+    SIM900Poll();   // The pending lines reach SMSQueue_HandleLine
+
+    now = TimeBase_Ms();
+
+    if (SMSQ_State == SMSQ_IDLE && SMSQ_Count != 0 &&
+        (SMSQ_Items[SMSQ_Head].Tries == 0 || (int32_t)(now - SMSQ_Items[SMSQ_Head].RetryAt) >= 0))
+    {
+        SMSQueue_Item* Item = &SMSQ_Items[SMSQ_Head];
+
+        if ((res = SMSQueue_Submit(Item)) == SIM900_OK)
+        {
+            SMSQ_State = SMSQ_WAIT_CMGS;
+            SMSQ_Since = now;
+        } else if ((res == SIM900_TIMEOUT || res == SMSQ_NO_BUFFER) && Item->Tries < SMSQUEUE_RETRIES)
+        {
+            /* Nothing reached the network: the same segment goes again */
+            Item->RetryAt = TimeBase_Ms() + ((uint32_t)SMSQUEUE_RETRY_MS << Item->Tries);
+            Item->Tries++;
+            SMSQ_Stat.Retries++;
+        } else
+            SMSQueue_Fail(Item);
+    } else if (SMSQ_State == SMSQ_WAIT_CMGS && (now - SMSQ_Since) > SIM900_CMGS_TIMEOUT)
+    {
+        SMSQueue_Fail(&SMSQ_Items[SMSQ_Head]);
+    }
+
+    for (i = 0; i < SMSQUEUE_TRACK; i++)
+    {
+        if (SMSQ_Tracks[i].Used && (now - SMSQ_Tracks[i].Time) > SMSQUEUE_REPORT_TIMEOUT)
+            SMSQueue_Forget(&SMSQ_Tracks[i], SMSQUEUE_EXPIRED);
+    }
+}
+
+
+/**
+ * @name    SMSQueue_Pending
+ * @brief   The function returns the number of messages not yet submitted
+ *
+ * @author  Mehdi
+ */
+
+uint8_t SMSQueue_Pending(void)
+{
+    return SMSQ_Count;
+}
+
+
+/**
+ * @name    SMSQueue_GetStat
+ * @brief   The function returns the counters of the queue
+ *
+ * @author  Mehdi
+ */
+
+const SMSQueue_Stat* SMSQueue_GetStat(void)
+{
+    return &SMSQ_Stat;
+}
@@ -0,0 +1,89 @@
+/**
+ @file     SMSQueue.h
+ @brief    Bounded outbound SMS queue for the SIM900 with delivery-report
+           tracking by message reference. Texts longer than one SMS are
+           sent as concatenated segments (up to SMSQUEUE_MAX_PARTS).
+
+ @author   Mehdi
+
+*/
+
+#ifndef SMSQUEUE_H_
+#define SMSQUEUE_H_
+
+#include <stdint.h>
+
+#include "SMSPdu.h"
+
+// Configuration
+#ifndef SMSQUEUE_DEPTH
+#define SMSQUEUE_DEPTH				4		// Messages waiting for submission
+#endif
+
+#ifndef SMSQUEUE_TRACK
+#define SMSQUEUE_TRACK				8		// Submitted segments waiting for a report
+#endif
+
+#ifndef SMSQUEUE_MAX_PARTS
+#define SMSQUEUE_MAX_PARTS			3		// Segments of the longest message
+#endif
+
+#ifndef SMSQUEUE_REPORT_TIMEOUT
+#define SMSQUEUE_REPORT_TIMEOUT		(24UL * 3600UL * 1000UL)	// ms
+#endif
+
+// Submissions retried when the module gave no prompt or no PDU buffer
+// was free, after SMSQUEUE_RETRY_MS, then twice as long each time
+#ifndef SMSQUEUE_RETRIES
+#define SMSQUEUE_RETRIES			3
+#endif
+
+#ifndef SMSQUEUE_RETRY_MS
+#define SMSQUEUE_RETRY_MS			2000
+#endif
+
+#define SMSQUEUE_NUM_LEN			28
+#define SMSQUEUE_UD_LEN				(SMSQUEUE_MAX_PARTS * SMSPDU_CONCAT_SEPTETS)
+
+// Message Status (given to the callback)
+#define SMSQUEUE_SUBMITTED			1		// Module returned the message reference (of the last segment)
+#define SMSQUEUE_DELIVERED			2		// Status report: every segment received by the phone
+#define SMSQUEUE_FAILED				3		// Rejected by the module or the network
+#define SMSQUEUE_EXPIRED			4		// No status report within SMSQUEUE_REPORT_TIMEOUT
+
+#define SMSQUEUE_FULL				-1
+#define SMSQUEUE_TOO_LONG			-2		// More than SMSQUEUE_MAX_PARTS segments
+#define SMSQUEUE_INVALID			-3		// No number, or longer than SMSQUEUE_NUM_LEN
+
+typedef void (*SMSQueue_Callback)(uint8_t Handle, uint8_t Status, uint8_t MsgRef);
+
+typedef struct
+{
+    uint32_t Posted;
+    uint32_t Submitted;
+    uint32_t Segments;
+    uint32_t Delivered;
+    uint32_t Failed;
+    uint32_t Expired;
+    uint32_t Retries;				// Submissions tried again
+} SMSQueue_Stat;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+int8_t SMSQueue_Init(void);
+
+int16_t SMSQueue_Post(const char* Num, const char* Msg, SMSQueue_Callback Callback);
+
+void SMSQueue_Poll(void);
+
+uint8_t SMSQueue_HandleLine(const char* Line);
+
+uint8_t SMSQueue_Pending(void);
+
+const SMSQueue_Stat* SMSQueue_GetStat(void);
+
+
+#endif /* SMSQUEUE_H_ */
@@ -0,0 +1,209 @@
+/**
+ @file     Scheduler.c
+ @brief    This file contains the timer wheel. Slot n holds the timers
+           whose deadline tick is n modulo SCHEDULER_SLOTS, sorted by
+           deadline, where the deadline tick is the first tick boundary at
+           or after the deadline (a job never runs early), so the due timers of a slot are at its head and a
+           timer that is one or more turns away stays in place.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stddef.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "TimeBase.h"
+#include "Scheduler.h"
+
+
+typedef char Scheduler_SlotsPowerOf2[((SCHEDULER_SLOTS & (SCHEDULER_SLOTS - 1)) == 0) ? 1 : -1];
+
+#define SCHED_MASK					(SCHEDULER_SLOTS - 1)
+#define SCHED_TICK(us)				(((us) + SCHEDULER_TICK_US - 1) / SCHEDULER_TICK_US)
+
+static Scheduler_Timer* Sched_Slots[SCHEDULER_SLOTS];
+static uint64_t         Sched_Tick;		// Last tick processed
+static Scheduler_Stat   Sched_Stat;
+
+
+/**
+ * @name    Scheduler_Init
+ * @brief   The function empties the wheel; the time base must be running
+ *
+ * @author  Mehdi
+ */
+
+void Scheduler_Init(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < SCHEDULER_SLOTS; i++)
+        Sched_Slots[i] = NULL;
+
+    Sched_Tick = TimeBase_Now() / SCHEDULER_TICK_US;
+}
+
+
+/**
+ * @name    Scheduler_Insert
+ * @brief   The function links a timer in the slot of its deadline. A
+ *              deadline already passed goes to the next tick.
+ *
+ * @author  Mehdi
+ */
+
+static void Scheduler_Insert(Scheduler_Timer* Timer)
+{
+    uint64_t Tick = SCHED_TICK(Timer->Deadline);
+    Scheduler_Timer** p;
+
+    if (Tick <= Sched_Tick)
+        Tick = Sched_Tick + 1;
+
+    p = &Sched_Slots[Tick & SCHED_MASK];
+    while (*p != NULL && (*p)->Deadline <= Timer->Deadline)
+        p = &(*p)->Next;
+
+    Timer->Next = *p;
+    *p = Timer;
+    Timer->Active = 1;
+}
+
+
+/**
+ * @name    Scheduler_Start
+ * @brief   The function (re)starts a timer
+ *
+ * @author  Mehdi
+ *
+ * @param	Timer: the timer, owned by the caller until it is stopped
+ * @param	DelayUs: time to the first run
+ * @param	PeriodUs: time between the runs, 0 to run once
+ * @param	Job: the job, called from Scheduler_Poll
+ * @param	Arg: argument of the job
+ */
+
+void Scheduler_Start(Scheduler_Timer* Timer, uint32_t DelayUs, uint32_t PeriodUs, Scheduler_Job Job, void* Arg)
+{
+    Scheduler_Stop(Timer);
+
+    Timer->Deadline = TimeBase_Now() + DelayUs;
+    Timer->Period = (PeriodUs != 0 && PeriodUs < SCHEDULER_TICK_US) ? SCHEDULER_TICK_US : PeriodUs;
+    Timer->Job = Job;
+    Timer->Arg = Arg;
+
+    Scheduler_Insert(Timer);
+}
+
+
+/**
+ * @name    Scheduler_Stop
+ * @brief   The function stops a timer; stopping a stopped timer does nothing
+ *
+ * @author  Mehdi
+ */
+
+void Scheduler_Stop(Scheduler_Timer* Timer)
+{
+    uint64_t Tick;
+    Scheduler_Timer** p;
+    uint16_t i;
+
+    if (!Timer->Active)
+        return;
+
+    /* The slot of its deadline, else (a passed deadline) any slot */
+    Tick = SCHED_TICK(Timer->Deadline);
+    for (i = 0; i <= SCHEDULER_SLOTS; i++)
+    {
+        p = &Sched_Slots[((i == 0) ? Tick : Sched_Tick + i) & SCHED_MASK];
+        while (*p != NULL && *p != Timer)
+            p = &(*p)->Next;
+
+        if (*p == Timer)
+        {
+            *p = Timer->Next;
+            break;
+        }
+    }
+
+    Timer->Next = NULL;
+    Timer->Active = 0;
+}
+
+
+/**
+ * @name    Scheduler_Poll
+ * @brief   The function runs the jobs whose deadline passed, in deadline
+ *              order. A job may start or stop any timer, itself included.
+ *
+ * @author  Mehdi
+ */
+
+void Scheduler_Poll(void)
+{
+    uint64_t Now = TimeBase_Now(), Tick = Now / SCHEDULER_TICK_US;
+    Scheduler_Timer** Slot;
+    Scheduler_Timer* Timer;
+
+    while (Sched_Tick < Tick)
+    {
+        Sched_Tick++;
+        Slot = &Sched_Slots[Sched_Tick & SCHED_MASK];
+
+        while ((Timer = *Slot) != NULL && SCHED_TICK(Timer->Deadline) <= Sched_Tick)
+        {
+            *Slot = Timer->Next;
+            Timer->Next = NULL;
+            Timer->Active = 0;
+
+            if (Now - Timer->Deadline > Sched_Stat.MaxLateUs)
+                Sched_Stat.MaxLateUs = Now - Timer->Deadline;
+            Sched_Stat.Fired++;
+
+            /* Periodic: next deadline on the period grid, skipping missed runs */
+            if (Timer->Period != 0)
+            {
+                Timer->Deadline += Timer->Period;
+                while (Timer->Deadline <= Now)
+                {
+                    Timer->Deadline += Timer->Period;
+                    Sched_Stat.Overruns++;
+                }
+                Scheduler_Insert(Timer);
+            }
+
+            Timer->Job(Timer->Arg);
+        }
+    }
+}
+
+
+/**
+ * @name    Scheduler_Sleep
+ * @brief   The function sleeps until the next interrupt (SysTick, USART);
+ *              it should end each pass of the main loop
+ *
+ * @author  Mehdi
+ */
+
+void Scheduler_Sleep(void)
+{
+    __WFI();
+}
+
+
+/**
+ * @name    Scheduler_GetStat
+ * @brief   The function returns the counters of the scheduler
+ *
+ * @author  Mehdi
+ */
+
+const Scheduler_Stat* Scheduler_GetStat(void)
+{
+    return &Sched_Stat;
+}
@@ -0,0 +1,72 @@
+/**
+ @file     Scheduler.h
+ @brief    Cooperative scheduler of one-shot and periodic jobs on a timer
+           wheel. A timer is a caller-owned Scheduler_Timer (no heap);
+           starting and stopping one costs a few list operations and
+           Scheduler_Poll only visits the wheel slots of the ticks that
+           elapsed. The jobs run from Scheduler_Poll, in the order of
+           their deadlines, in the main loop:
+
+               while (1)
+               {
+                   Scheduler_Poll();
+                   ...
+                   Scheduler_Sleep();
+               }
+
+ @author   Mehdi
+
+*/
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+
+// Configuration
+#ifndef SCHEDULER_TICK_US
+#define SCHEDULER_TICK_US			1000	// Resolution of the deadlines
+#endif
+
+#ifndef SCHEDULER_SLOTS
+#define SCHEDULER_SLOTS				64		// Slots of the wheel, a power of 2
+#endif
+
+typedef void (*Scheduler_Job)(void* Arg);
+
+typedef struct Scheduler_Timer
+{
+    struct Scheduler_Timer* Next;
+    uint64_t      Deadline;		// us (TimeBase_Now)
+    uint32_t      Period;		// us, 0 for a one-shot timer
+    Scheduler_Job Job;
+    void*         Arg;
+    uint8_t       Active;
+} Scheduler_Timer;
+
+typedef struct
+{
+    uint32_t Fired;
+    uint32_t Overruns;			// Periods skipped because a poll came late
+    uint32_t MaxLateUs;			// Latest job, after its deadline
+} Scheduler_Stat;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void Scheduler_Init(void);
+
+void Scheduler_Start(Scheduler_Timer* Timer, uint32_t DelayUs, uint32_t PeriodUs, Scheduler_Job Job, void* Arg);
+
+void Scheduler_Stop(Scheduler_Timer* Timer);
+
+void Scheduler_Poll(void);
+
+void Scheduler_Sleep(void);
+
+const Scheduler_Stat* Scheduler_GetStat(void);
+
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,267 @@
+/**
+ @file     StatusSink.c
+ @brief    This file contains the status/log sink and its back ends.
+           Drivers only store an event code; the display back end
+           coalesces the events and refreshes the HD44780 at a bounded
+           rate from Status_Poll(), so no LCD transaction ever runs on
+           the request path.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef STATUS_HOST
+#include "stm32f4xx_hal.h"
+#include "tm_stm32_hd44780.h"
+#else
+#include <time.h>
+#endif
+
+#include "StatusSink.h"
+#include "TimeBase.h"
+
+
+#define STATUS_ROW_STAGE	0
+#define STATUS_ROW_RESULT	2
+
+typedef struct
+{
+    uint8_t row;
+    const char *text;
+} Status_Desc;
+
+static const Status_Desc Status_Table[STATUS_EVENT_COUNT] =
+{
+    [STATUS_NONE]               = {STATUS_ROW_RESULT, ""},
+
+    [STATUS_ESP_INIT]           = {STATUS_ROW_STAGE,  "INITIALIZATION"},
+    [STATUS_ESP_DISCONNECT_AP]  = {STATUS_ROW_STAGE,  "DISCONNECT FROM AP"},
+    [STATUS_ESP_SET_STATION]    = {STATUS_ROW_STAGE,  "SET as ACCESS POINT"},
+    [STATUS_ESP_CONNECT_ROUTER] = {STATUS_ROW_STAGE,  "CONNECT to ROUTER"},
+    [STATUS_ESP_GET_IP]         = {STATUS_ROW_STAGE,  "GET the STATIC IP"},
+    [STATUS_ESP_CONFIG_MUX]     = {STATUS_ROW_STAGE,  "CONFIG for MPL CONN."},
+    [STATUS_ESP_SERVER_ON]      = {STATUS_ROW_STAGE,  "TURN on SERVER&P.80"},
+
+    [STATUS_RES_OK]             = {STATUS_ROW_RESULT, "> RESPONSE OK"},
+    [STATUS_RES_INVALID]        = {STATUS_ROW_RESULT, "> INVALID RESPONSE"},
+    [STATUS_RES_NO_MATCH]       = {STATUS_ROW_RESULT, "> NO MATCH RESPONSE"},
+    [STATUS_AP_ESTABLISHED]     = {STATUS_ROW_RESULT, "> ESTABLISHED"},
+    [STATUS_AP_NOT_ESTABLISHED] = {STATUS_ROW_RESULT, "> NOT ESTABLISHED"},
+    [STATUS_IP_ACQUIRED]        = {STATUS_ROW_RESULT, "IP"},
+    [STATUS_IP_UNAVAILABLE]     = {STATUS_ROW_RESULT, "Unable to Get IP!"},
+    [STATUS_DATA_SENT]          = {STATUS_ROW_RESULT, "> SENT"},
+    [STATUS_CONN_CLOSED]        = {STATUS_ROW_RESULT, "> CLOSED"},
+    [STATUS_LINK_RECOVERING]    = {STATUS_ROW_RESULT, "> RECOVERING"},
+    [STATUS_LINK_RECOVERED]     = {STATUS_ROW_RESULT, "> RECOVERED"},
+};
+
+static const StatusSink_t* Status_Current = &StatusSink_Display;
+
+
+/**
+ * @name    Status_Text
+ * @brief   The function returns the text of a given event
+ *
+ * @author  Mehdi
+ *
+ * @param	Event: the event code
+ * @return  the text describing the event ("" for unknown codes)
+ */
+
+const char* Status_Text(uint8_t Event)
+{
+    if (Event >= STATUS_EVENT_COUNT)
+        return "";
+
+    return Status_Table[Event].text;
+}
+
+
+/**
+ * @name    Status_Format
+ * @brief   The function renders an event and its argument into a line
+ *
+ * @author  Mehdi
+ *
+ * @param	Line (Out): the buffer the text is written in
+ * @param	Size: size of Line
+ * @param	Event: the event code
+ * @param	Arg: the argument posted with the event
+ */
+
+static void Status_Format(char* Line, uint8_t Size, uint8_t Event, uint32_t Arg)
+{
+    if (Event == STATUS_IP_ACQUIRED)
+    {
+        snprintf(Line, Size, "IP %u.%u.%u.%u",
+                 (unsigned)((Arg >> 24) & 0xFF), (unsigned)((Arg >> 16) & 0xFF),
+                 (unsigned)((Arg >> 8) & 0xFF), (unsigned)(Arg & 0xFF));
+    } else if (Event == STATUS_DATA_SENT || Event == STATUS_CONN_CLOSED ||
+               Event == STATUS_LINK_RECOVERING)
+    {
+        snprintf(Line, Size, "%s %u", Status_Text(Event), (unsigned)Arg);
+    } else if (Event == STATUS_LINK_RECOVERED)
+    {
+        snprintf(Line, Size, "%s %lums", Status_Text(Event), (unsigned long)Arg);
+    } else
+    {
+        snprintf(Line, Size, "%s", Status_Text(Event));
+    }
+}
+
+
+/**
+ * @name    Status_SetSink
+ * @brief   The function selects the back end the events are posted to
+ *
+ * @author  Mehdi
+ *
+ * @param	Sink: the back end (NULL selects the null sink)
+ */
+
+void Status_SetSink(const StatusSink_t* Sink)
+{
+    Status_Current = (Sink != NULL) ? Sink : &StatusSink_Null;
+}
+
+
+/**
+ * @name    Status_Post
+ * @brief   The function posts an event to the current back end.
+ *              It never blocks and is safe to call on the data path.
+ *
+ * @author  Mehdi
+ *
+ * @param	Event: the event code
+ * @param	Arg: optional argument of the event
+ */
+
+void Status_Post(uint8_t Event, uint32_t Arg)
+{
+    if (Event >= STATUS_EVENT_COUNT)
+        return;
+
+    Status_Current->Post(Event, Arg);
+}
+
+
+/**
+ * @name    Status_Poll
+ * @brief   The function gives the back end a chance to do its slow work.
+ *              It should be called from the idle part of the main loop.
+ *
+ * @author  Mehdi
+ */
+
+void Status_Poll(void)
+{
+#ifndef STATUS_HOST
+    Status_Current->Idle(TimeBase_Ms());
+#else
+    Status_Current->Idle((uint32_t)(clock() / (CLOCKS_PER_SEC / 1000)));
+#endif
+}
+
+
+/***************************************************
+			N U L L   S I N K
+****************************************************/
+
+static void Null_Post(uint8_t event, uint32_t arg)
+{
+    (void)event;
+    (void)arg;
+}
+
+static void Null_Idle(uint32_t now)
+{
+    (void)now;
+}
+
+const StatusSink_t StatusSink_Null = {Null_Post, Null_Idle};
+
+
+/***************************************************
+			D I S P L A Y   S I N K
+****************************************************/
+
+#ifndef STATUS_HOST
+
+// Latest state of the display; only the newest event of each row is kept
+static volatile uint8_t  Disp_Stage = STATUS_NONE;
+static volatile uint8_t  Disp_Result = STATUS_NONE;
+static volatile uint32_t Disp_Arg;
+static volatile uint8_t  Disp_Dirty;
+static volatile uint8_t  Disp_Clear;
+static uint32_t Disp_LastRefresh;
+
+static void Display_Post(uint8_t event, uint32_t arg)
+{
+    if (Status_Table[event].row == STATUS_ROW_STAGE)
+    {
+        Disp_Stage = event;
+        Disp_Result = STATUS_NONE;
+        Disp_Clear = 1;
+    } else
+    {
+        Disp_Result = event;
+        Disp_Arg = arg;
+    }
+    Disp_Dirty = 1;
+}
+
+static void Display_Idle(uint32_t now)
+{
+    char Line[21];      // One row of a 20x4 display
+
+    if (!Disp_Dirty || (now - Disp_LastRefresh) < STATUS_LCD_PERIOD_MS)
+        return;
+
+    Disp_Dirty = 0;
+    Disp_LastRefresh = now;
+
+    if (Disp_Clear)
+    {
+        Disp_Clear = 0;
+        TM_HD44780_Clear();
+        TM_HD44780_Puts(0,STATUS_ROW_STAGE,(char*)Status_Text(Disp_Stage));
+    }
+
+    // Pad with blanks so a shorter text overwrites the previous one
+    Status_Format(Line, sizeof(Line), Disp_Result, Disp_Arg);
+    memset(Line + strlen(Line), ' ', sizeof(Line) - 1 - strlen(Line));
+    Line[sizeof(Line) - 1] = '\0';
+
+    TM_HD44780_Puts(0,STATUS_ROW_RESULT,Line);
+}
+
+const StatusSink_t StatusSink_Display = {Display_Post, Display_Idle};
+
+#else
+
+const StatusSink_t StatusSink_Display = {Null_Post, Null_Idle};
+
+#endif
+
+
+/***************************************************
+			S T D O U T   S I N K
+****************************************************/
+
+#ifdef STATUS_HOST
+
+static void Stdout_Post(uint8_t event, uint32_t arg)
+{
+    char Line[32];
+
+    Status_Format(Line, sizeof(Line), event, arg);
+    printf("[status] %s\n", Line);
+}
+
+const StatusSink_t StatusSink_Stdout = {Stdout_Post, Null_Idle};
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ @file     StatusSink.h
+ @brief    Status/log sink. Drivers post small event codes that never block;
+           the selected back end (LCD, null, host stdout) renders them later.
+
+ @author   Mehdi
+
+*/
+
+#ifndef STATUSSINK_H_
+#define STATUSSINK_H_
+
+#include <stdint.h>
+
+// Minimum time between two LCD refreshes (ms)
+#ifndef STATUS_LCD_PERIOD_MS
+#define STATUS_LCD_PERIOD_MS		250
+#endif
+
+// Status Events
+typedef enum
+{
+    STATUS_NONE = 0,
+
+    // Stage events (shown on the first line, clear the display)
+    STATUS_ESP_INIT,
+    STATUS_ESP_DISCONNECT_AP,
+    STATUS_ESP_SET_STATION,
+    STATUS_ESP_CONNECT_ROUTER,
+    STATUS_ESP_GET_IP,
+    STATUS_ESP_CONFIG_MUX,
+    STATUS_ESP_SERVER_ON,
+
+    // Result events (shown on the third line)
+    STATUS_RES_OK,
+    STATUS_RES_INVALID,
+    STATUS_RES_NO_MATCH,
+    STATUS_AP_ESTABLISHED,
+    STATUS_AP_NOT_ESTABLISHED,
+    STATUS_IP_ACQUIRED,             // arg: IPv4 address, first octet in the MSB
+    STATUS_IP_UNAVAILABLE,
+    STATUS_DATA_SENT,               // arg: connection ID
+    STATUS_CONN_CLOSED,             // arg: connection ID
+    STATUS_LINK_RECOVERING,         // arg: fault class (LINK_FAULT_xxx)
+    STATUS_LINK_RECOVERED,          // arg: recovery time (ms)
+
+    STATUS_EVENT_COUNT
+} Status_Event;
+
+// Sink back end; Post() is called on the data path and must not block,
+// Idle() is called from Status_Poll() when the application has spare time.
+typedef struct
+{
+    void (*Post)(uint8_t event, uint32_t arg);
+    void (*Idle)(uint32_t now);
+} StatusSink_t;
+
+extern const StatusSink_t StatusSink_Display;
+extern const StatusSink_t StatusSink_Null;
+#ifdef STATUS_HOST
+extern const StatusSink_t StatusSink_Stdout;
+#endif
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void Status_SetSink(const StatusSink_t* Sink);
+
+void Status_Post(uint8_t Event, uint32_t Arg);
+
+void Status_Poll(void);
+
+const char* Status_Text(uint8_t Event);
+
+
+#endif /* STATUSSINK_H_ */
@@ -0,0 +1,122 @@
+/**
+ @file     TimeBase.c
+ @brief    This file contains the monotonic microsecond clock. The 32-bit
+           DWT cycle counter is extended to 64 bits on each read; the
+           clock must be read from the main loop only, not from interrupts.
+
+ @author   Mehdi
+
+*/
+
+
+#include "stm32f4xx_hal.h"
+
+#include "TimeBase.h"
+
+#ifdef TIMEBASE_HOST
+
+#include <time.h>
+
+void TimeBase_Init(void)
+{
+}
+
+
+uint64_t TimeBase_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#else
+
+static uint32_t TB_LastCycle;
+static uint64_t TB_Cycles;			// Cycles since the clock started
+static uint8_t  TB_Started;
+
+
+/**
+ * @name    TimeBase_Start
+ * @brief   The function starts the DWT cycle counter (shared with Trace.c);
+ *              the clock goes on from where it was
+ *
+ * @author  Mehdi
+ */
+
+static void TimeBase_Start(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    TB_LastCycle = DWT->CYCCNT;
+    TB_Started = 1;
+}
+
+
+/**
+ * @name    TimeBase_Init
+ * @brief   The function starts the clock from 0. It is optional: the
+ *              first TimeBase_Now starts it.
+ *
+ * @author  Mehdi
+ */
+
+void TimeBase_Init(void)
+{
+    TimeBase_Start();
+    TB_Cycles = 0;
+}
+
+
+/**
+ * @name    TimeBase_Now
+ * @brief   The function returns the time since the clock started (its
+ *              first read)
+ *
+ * @author  Mehdi
+ *
+ * @return	microseconds
+ */
+
+uint64_t TimeBase_Now(void)
+{
+    uint32_t Cycle;
+
+    /* The counter is off at reset without a debugger, and a debugger
+       may stop it: a deadline would never expire */
+    if (!TB_Started || (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0)
+        TimeBase_Start();
+
+    Cycle = DWT->CYCCNT;
+
+    /* Unsigned difference: right across one wrap of the counter */
+    TB_Cycles += (uint32_t)(Cycle - TB_LastCycle);
+    TB_LastCycle = Cycle;
+
+    return TB_Cycles / (SystemCoreClock / 1000000);
+}
+
+#endif
+
+
+/**
+ * @name    TimeBase_Delay
+ * @brief   The function waits without spinning: the core sleeps (WFI)
+ *              until the next interrupt (SysTick at least every ms)
+ *              while the delay is not over
+ *
+ * @author  Mehdi
+ *
+ * @param	us: the delay
+ */
+
+void TimeBase_Delay(uint64_t us)
+{
+    uint64_t Deadline = TimeBase_Deadline(us);
+
+    while (!TimeBase_Expired(Deadline))
+        __WFI();
+}
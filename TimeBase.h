@@ -0,0 +1,49 @@
+/**
+ @file     TimeBase.h
+ @brief    Monotonic time base in microseconds, 64 bits (no wrap in the
+           life of the device). On the STM32 it extends the DWT cycle
+           counter, so TimeBase_Now must be called at least once per
+           wrap of the counter (25 s at 168 MHz); Scheduler_Poll does.
+           The counter is off at reset unless a debugger is attached: the
+           first read starts it (the clock counts from there), so no init
+           call is needed. Built with TIMEBASE_HOST it reads
+           clock_gettime.
+
+           It is the one clock of the library. Waits are written as
+           deadlines:
+
+               uint64_t Deadline = TimeBase_Deadline(TIMEBASE_MS(250));
+               while (!TimeBase_Expired(Deadline)) ...
+
+           Time stamps and ages kept in 32 bits use TimeBase_Ms, compared
+           by unsigned difference (it wraps after 49 days, as a tick).
+
+ @author   Mehdi
+
+*/
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include <stdint.h>
+
+#define TIMEBASE_MS(ms)				((uint64_t)(ms) * 1000)
+#define TIMEBASE_S(s)				((uint64_t)(s) * 1000000)
+
+#define TimeBase_Deadline(us)		(TimeBase_Now() + (us))
+#define TimeBase_Expired(d)			(TimeBase_Now() >= (d))
+#define TimeBase_Ms()				((uint32_t)(TimeBase_Now() / 1000))
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void TimeBase_Init(void);
+
+uint64_t TimeBase_Now(void);
+
+void TimeBase_Delay(uint64_t us);
+
+
+#endif /* TIMEBASE_H_ */
@@ -0,0 +1,404 @@
+/**
+ @file     Trace.c
+ @brief    This file contains the wire-level trace recorder. Every byte run
+           that crosses the transport layer is stored with the time (us)
+           since the previous run, read from TimeBase. When the
+           ring is full the oldest records are dropped. Bytes read one at
+           a time (Trace_Getc) are gathered into one RX run, closed at the
+           end of a line, when it is full, or by any other record.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "tm_stm32_usart.h"
+
+#include "TimeBase.h"
+#include "Trace.h"
+
+
+static uint8_t  Trace_Buf[TRACE_BUF_SIZE];
+static uint16_t Trace_Head;			// Next byte written
+static uint16_t Trace_Tail;			// First byte of the oldest record
+static uint16_t Trace_Used;
+static uint8_t  Trace_On;
+static uint64_t Trace_Last;			// TimeBase_Now of the previous record
+static Trace_Stat Trace_Stats;
+
+static uint8_t  Trace_Run[TRACE_RX_RUN];	// RX run of Trace_Getc not recorded yet
+static uint8_t  Trace_RunLen;
+static uint8_t  Trace_RunPort;
+static uint32_t Trace_RunDelta;			// us from the previous record to its first byte
+
+
+/**
+ * @name    Trace_Port
+ * @brief   The function returns the number of a USART (0 if unknown)
+ *
+ * @author  Mehdi
+ */
+
+static uint8_t Trace_Port(USART_TypeDef* USARTx)
+{
+    if (USARTx == USART1) return 1;
+    if (USARTx == USART2) return 2;
+    if (USARTx == USART3) return 3;
+#ifdef UART4
+    if (USARTx == UART4)  return 4;
+#endif
+#ifdef UART5
+    if (USARTx == UART5)  return 5;
+#endif
+    if (USARTx == USART6) return 6;
+    return 0;
+}
+
+
+/**
+ * @name    Trace_Elapsed
+ * @brief   The function returns the time (us) since the previous record,
+ *              saturated at TRACE_MAX_DELTA (a longer gap is recorded as
+ *              TRACE_MAX_DELTA; the next deltas are right)
+ *
+ * @author  Mehdi
+ */
+
+static uint32_t Trace_Elapsed(void)
+{
+    uint64_t Now = TimeBase_Now();
+    uint64_t us = Now - Trace_Last;
+
+    Trace_Last = Now;
+
+    return (us > TRACE_MAX_DELTA) ? TRACE_MAX_DELTA : (uint32_t)us;
+}
+
+
+static uint8_t Trace_Get(uint16_t i)
+{
+    return Trace_Buf[(Trace_Tail + i) % TRACE_BUF_SIZE];
+}
+
+
+/**
+ * @name    Trace_DropOldest
+ * @brief   The function removes the oldest record from the ring
+ *
+ * @author  Mehdi
+ */
+
+static void Trace_DropOldest(void)
+{
+    uint16_t i = 1;        // Skip flags
+    uint32_t len = 0;
+    uint8_t shift = 0, b;
+
+    while (Trace_Get(i++) & 0x80);      // Skip delta
+
+    do
+    {
+        b = Trace_Get(i++);
+        len |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    i += len;
+
+    Trace_Tail = (Trace_Tail + i) % TRACE_BUF_SIZE;
+    Trace_Used -= i;
+    Trace_Stats.Dropped++;
+}
+
+
+static void Trace_Put(uint8_t b)
+{
+    Trace_Buf[Trace_Head] = b;
+    Trace_Head = (Trace_Head + 1) % TRACE_BUF_SIZE;
+    Trace_Used++;
+}
+
+
+static uint8_t Trace_Varint(uint8_t* out, uint32_t v)
+{
+    uint8_t n = 0;
+
+    while (v >= 0x80)
+    {
+        out[n++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+
+    return n;
+}
+
+
+/**
+ * @name    Trace_Write
+ * @brief   The function appends a byte run to the ring, split in records
+ *              of TRACE_MAX_RUN bytes
+ *
+ * @author  Mehdi
+ *
+ * @param	Flags: the flags of the records, port included
+ * @param	Delta: the time (us) since the previous record
+ * @param	Data: the bytes
+ * @param	Len: number of bytes
+ */
+
+static void Trace_Write(uint8_t Flags, uint32_t Delta, const uint8_t* Data, uint16_t Len)
+{
+    uint8_t Hdr[1 + 5 + 2];
+    uint8_t n, run;
+
+    do
+    {
+        run = (Len > TRACE_MAX_RUN) ? TRACE_MAX_RUN : Len;
+
+        Hdr[0] = Flags;
+        n = 1 + Trace_Varint(Hdr + 1, Delta);
+        n += Trace_Varint(Hdr + n, run);
+
+        while (TRACE_BUF_SIZE - Trace_Used < n + run)
+            Trace_DropOldest();
+
+        for (uint8_t i = 0; i < n; i++)
+            Trace_Put(Hdr[i]);
+        for (uint8_t i = 0; i < run; i++)
+            Trace_Put(Data[i]);
+
+        Trace_Stats.Records++;
+        Data += run;
+        Len -= run;
+        if (Len != 0)
+            Delta = Trace_Elapsed();
+    } while (Len != 0);
+}
+
+
+/**
+ * @name    Trace_Flush
+ * @brief   The function records the pending RX run of Trace_Getc, if any
+ *
+ * @author  Mehdi
+ */
+
+static void Trace_Flush(void)
+{
+    uint8_t n = Trace_RunLen;
+
+    if (n == 0)
+        return;
+
+    Trace_RunLen = 0;
+    Trace_Write(TRACE_RX | (Trace_RunPort << 4), Trace_RunDelta, Trace_Run, n);
+}
+
+
+/**
+ * @name    Trace_Init
+ * @brief   The function clears the ring and starts the recording
+ *
+ * @author  Mehdi
+ */
+
+void Trace_Init(void)
+{
+    Trace_Clear();
+    Trace_On = 1;
+}
+
+
+/**
+ * @name    Trace_Enable
+ * @brief   The function pauses (0) or resumes (1) the recording
+ *
+ * @author  Mehdi
+ */
+
+void Trace_Enable(uint8_t On)
+{
+    if (!On && Trace_On)
+        Trace_Flush();
+
+    Trace_On = On;
+}
+
+
+/**
+ * @name    Trace_Clear
+ * @brief   The function empties the ring
+ *
+ * @author  Mehdi
+ */
+
+void Trace_Clear(void)
+{
+    Trace_Head = Trace_Tail = Trace_Used = 0;
+    Trace_RunLen = 0;
+    memset(&Trace_Stats, 0, sizeof(Trace_Stats));
+    Trace_Last = TimeBase_Now();
+}
+
+
+/**
+ * @name    Trace_Record
+ * @brief   The function appends a byte run to the ring
+ *
+ * @author  Mehdi
+ *
+ * @param	USARTx: the USART the bytes crossed
+ * @param	Flags: TRACE_RX, TRACE_DISCARDED
+ * @param	Data: the bytes
+ * @param	Len: number of bytes
+ */
+
+void Trace_Record(USART_TypeDef* USARTx, uint8_t Flags, const uint8_t* Data, uint16_t Len)
+{
+    if (!Trace_On)
+        return;
+
+    // The pending RX run came first
+    Trace_Flush();
+
+    Trace_Write((Flags & 0x0F) | (Trace_Port(USARTx) << 4), Trace_Elapsed(), Data, Len);
+}
+
+
+/**
+ * @name    Trace_Dump
+ * @brief   The function sends the header and the records over a debug USART
+ *
+ * @author  Mehdi
+ *
+ * @param	DebugUSART: the USART the dump is sent on
+ */
+
+void Trace_Dump(USART_TypeDef* DebugUSART)
+{
+    uint8_t Hdr[4 + 1 + 4 + 4];
+    uint16_t first;
+    uint8_t on = Trace_On;
+
+    if (on)
+        Trace_Flush();
+    Trace_On = 0;
+
+    memcpy(Hdr, TRACE_MAGIC, 4);
+    Hdr[4] = TRACE_VERSION;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        Hdr[5 + i] = Trace_Stats.Dropped >> (8 * i);
+        Hdr[9 + i] = (uint32_t)Trace_Used >> (8 * i);
+    }
+    TM_USART_Send(DebugUSART, Hdr, sizeof(Hdr));
+
+    first = TRACE_BUF_SIZE - Trace_Tail;
+    if (first > Trace_Used)
+        first = Trace_Used;
+
+    TM_USART_Send(DebugUSART, &Trace_Buf[Trace_Tail], first);
+    TM_USART_Send(DebugUSART, Trace_Buf, Trace_Used - first);
+
+    Trace_On = on;
+}
+
+
+/**
+ * @name    Trace_GetStat
+ * @brief   The function returns the counters of the recorder
+ *
+ * @author  Mehdi
+ */
+
+const Trace_Stat* Trace_GetStat(void)
+{
+    return &Trace_Stats;
+}
+
+
+/***************************************************
+		T R A N S P O R T   H O O K S
+****************************************************/
+
+void Trace_Putc(USART_TypeDef* USARTx, char c)
+{
+    Trace_Record(USARTx, 0, (const uint8_t*)&c, 1);
+    TM_USART_Putc(USARTx, c);
+}
+
+void Trace_Puts(USART_TypeDef* USARTx, const char* str)
+{
+    Trace_Record(USARTx, 0, (const uint8_t*)str, strlen(str));
+    TM_USART_Puts(USARTx, (char*)str);
+}
+
+void Trace_Send(USART_TypeDef* USARTx, const uint8_t* Data, uint16_t Count)
+{
+    Trace_Record(USARTx, 0, Data, Count);
+    TM_USART_Send(USARTx, (uint8_t*)Data, Count);
+}
+
+uint16_t Trace_Gets(USART_TypeDef* USARTx, char* buffer, uint16_t bufsize)
+{
+    uint16_t n = TM_USART_Gets(USARTx, buffer, bufsize);
+
+    if (n != 0)
+        Trace_Record(USARTx, TRACE_RX, (const uint8_t*)buffer, n);
+
+    return n;
+}
+
+uint8_t Trace_Getc(USART_TypeDef* USARTx)
+{
+    uint8_t c, Port;
+
+    if (TM_USART_BufferEmpty(USARTx))
+        return 0;
+
+    c = TM_USART_Getc(USARTx);
+
+    if (!Trace_On)
+        return c;
+
+    // One record per line instead of one per byte
+    Port = Trace_Port(USARTx);
+    if (Trace_RunLen != 0 && Port != Trace_RunPort)
+        Trace_Flush();
+    if (Trace_RunLen == 0)
+    {
+        Trace_RunDelta = Trace_Elapsed();
+        Trace_RunPort = Port;
+    }
+
+    Trace_Run[Trace_RunLen++] = c;
+    if (c == '\n' || Trace_RunLen == TRACE_RX_RUN)
+        Trace_Flush();
+
+    return c;
+}
+
+void Trace_ClearBuffer(USART_TypeDef* USARTx)
+{
+    uint8_t Run[32];
+    uint8_t n = 0;
+
+    // Record what the driver throws away, it matters on replay
+    while (!TM_USART_BufferEmpty(USARTx))
+    {
+        Run[n++] = TM_USART_Getc(USARTx);
+        if (n == sizeof(Run))
+        {
+            Trace_Record(USARTx, TRACE_RX | TRACE_DISCARDED, Run, n);
+            n = 0;
+        }
+    }
+
+    if (n != 0)
+        Trace_Record(USARTx, TRACE_RX | TRACE_DISCARDED, Run, n);
+}
@@ -0,0 +1,86 @@
+/**
+ @file     Trace.h
+ @brief    Wire-level trace recorder of the modem USARTs. TX and RX byte
+           runs are time stamped (us) and kept in a RAM ring, which can be
+           dumped over a debug USART and replayed on the host
+           (tools/TraceReplay.c). Bytes read one at a time are recorded
+           as one RX run per line (TRACE_RX_RUN bytes at most).
+
+           Dump format (little endian):
+               "ATTR" <version:u8> <dropped:u32> <length:u32> <records>
+           Record:
+               <flags:u8> <delta_us:varint> <len:varint> <bytes[len]>
+               delta_us: time since the previous record, saturated at
+                         TRACE_MAX_DELTA (71 min)
+               flags: bit0 RX, bit1 discarded by ClearBuffer,
+                      bits 4..7 USART number
+
+ @author   Mehdi
+
+*/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "AuxLib.h"
+
+#ifndef TRACE_BUF_SIZE
+#define TRACE_BUF_SIZE				4096
+#endif
+
+#define TRACE_MAGIC					"ATTR"
+#define TRACE_VERSION				1
+
+#define TRACE_MAX_RUN				255			// Longer runs are split
+#define TRACE_MAX_DELTA				0xFFFFFFFFUL	// us, longer gaps are recorded as this
+
+#ifndef TRACE_RX_RUN
+#define TRACE_RX_RUN				64			// Bytes of Trace_Getc gathered in one record
+#endif
+
+#if TRACE_RX_RUN > TRACE_MAX_RUN
+#error "TRACE_RX_RUN must not exceed TRACE_MAX_RUN"
+#endif
+
+// Record Flags
+#define TRACE_RX					BIT(0)
+#define TRACE_DISCARDED				BIT(1)
+#define TRACE_PORT(flags)			((flags) >> 4)
+
+typedef struct
+{
+    uint32_t Records;
+    uint32_t Dropped;			// Records overwritten because the ring was full
+} Trace_Stat;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void Trace_Init(void);
+
+void Trace_Enable(uint8_t On);
+
+void Trace_Clear(void);
+
+void Trace_Dump(USART_TypeDef* DebugUSART);
+
+const Trace_Stat* Trace_GetStat(void);
+
+void Trace_Record(USART_TypeDef* USARTx, uint8_t Flags, const uint8_t* Data, uint16_t Len);
+
+// Transport hooks (see Transport.h)
+void Trace_Putc(USART_TypeDef* USARTx, char c);
+void Trace_Puts(USART_TypeDef* USARTx, const char* str);
+void Trace_Send(USART_TypeDef* USARTx, const uint8_t* Data, uint16_t Count);
+uint16_t Trace_Gets(USART_TypeDef* USARTx, char* buffer, uint16_t bufsize);
+uint8_t Trace_Getc(USART_TypeDef* USARTx);
+void Trace_ClearBuffer(USART_TypeDef* USARTx);
+
+
+#endif /* TRACE_H_ */
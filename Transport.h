@@ -0,0 +1,42 @@
+/**
+ @file     Transport.h
+ @brief    Transport layer of the modem drivers. The drivers reach the USART
+           only through these macros; they map to the TM USART library, or
+           to the trace recorder when the library is built with AT_TRACE.
+
+ @author   Mehdi
+
+*/
+
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+#include "tm_stm32_usart.h"
+
+#ifdef AT_TRACE
+
+#include "Trace.h"
+
+#define AT_Putc(U,c)			Trace_Putc((U),(c))
+#define AT_Puts(U,s)			Trace_Puts((U),(s))
+#define AT_Send(U,d,n)			Trace_Send((U),(d),(n))
+#define AT_Gets(U,b,n)			Trace_Gets((U),(b),(n))
+#define AT_Getc(U)				Trace_Getc((U))
+#define AT_ClearBuffer(U)		Trace_ClearBuffer((U))
+
+#else
+
+#define AT_Putc(U,c)			TM_USART_Putc((U),(c))
+#define AT_Puts(U,s)			TM_USART_Puts((U),(char*)(s))
+#define AT_Send(U,d,n)			TM_USART_Send((U),(uint8_t*)(d),(n))
+#define AT_Gets(U,b,n)			TM_USART_Gets((U),(b),(n))
+#define AT_Getc(U)				TM_USART_Getc((U))
+#define AT_ClearBuffer(U)		TM_USART_ClearBuffer((U))
+
+#endif
+
+#define AT_FindCharacter(U,c)	TM_USART_FindCharacter((U),(c))
+#define AT_BufferEmpty(U)		TM_USART_BufferEmpty((U))
+
+
+#endif /* TRANSPORT_H_ */
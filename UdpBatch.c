@@ -0,0 +1,142 @@
+/**
+ @file     UdpBatch.c
+ @brief    This file contains the datagram batcher of the telemetry
+           samples. It does not block: UdpBatch_Put and UdpBatch_Poll only
+           send when a threshold is reached, so UdpBatch_Poll should be
+           called from the main loop to honour MaxAgeMs.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "UdpBatch.h"
+#include "TimeBase.h"
+
+
+/**
+ * @name    UdpBatch_Init
+ * @brief   The function sets up a batcher
+ *
+ * @author  Mehdi
+ *
+ * @param	Batch: the batcher
+ * @param	Send: sends a datagram on a link
+ * @param	Link: the link of the datagrams (ESP_UdpOpen)
+ * @param	MaxBytes: datagram size that triggers a send (up to UDPBATCH_BUF_SIZE)
+ * @param	MaxAgeMs: age of the oldest sample that triggers a send
+ */
+
+void UdpBatch_Init(UdpBatch* Batch, UdpBatch_Send Send, uint8_t Link, uint16_t MaxBytes, uint16_t MaxAgeMs)
+{
+    memset(Batch, 0, sizeof(UdpBatch));
+
+    Batch->Send = Send;
+    Batch->Link = Link;
+    Batch->MaxBytes = (MaxBytes == 0 || MaxBytes > UDPBATCH_BUF_SIZE) ? UDPBATCH_BUF_SIZE : MaxBytes;
+    Batch->MaxAgeMs = MaxAgeMs;
+}
+
+
+/**
+ * @name    UdpBatch_Flush
+ * @brief   The function sends the pending samples, if any
+ *
+ * @author  Mehdi
+ *
+ * @return	UDPBATCH_OK or UDPBATCH_FAIL
+ */
+
+int8_t UdpBatch_Flush(UdpBatch* Batch)
+{
+    uint32_t Age;
+    int8_t res;
+
+    if (Batch->Len == 0)
+        return UDPBATCH_OK;
+
+    Age = TimeBase_Ms() - Batch->First;
+    if (Age > Batch->Stat.MaxAgeMs)
+        Batch->Stat.MaxAgeMs = Age;
+
+    res = Batch->Send(Batch->Link, Batch->Buf, Batch->Len);
+
+    if (res > 0)
+    {
+        Batch->Stat.Datagrams++;
+        Batch->Stat.Bytes += Batch->Len;
+    } else
+        Batch->Stat.Failed++;
+
+    Batch->Len = 0;
+
+    return (res > 0) ? UDPBATCH_OK : UDPBATCH_FAIL;
+}
+
+
+/**
+ * @name    UdpBatch_Put
+ * @brief   The function appends a sample. The pending samples are sent
+ *              first if the sample does not fit, and the datagram is sent
+ *              when it reaches MaxBytes or when MaxAgeMs is 0.
+ *
+ * @author  Mehdi
+ *
+ * @return	UDPBATCH_OK, UDPBATCH_TOO_LONG or UDPBATCH_FAIL
+ */
+
+int8_t UdpBatch_Put(UdpBatch* Batch, const void* Sample, uint16_t Len)
+{
+    int8_t res = UDPBATCH_OK;
+
+    if (Len > Batch->MaxBytes)
+        return UDPBATCH_TOO_LONG;
+
+    if (Batch->Len + Len > Batch->MaxBytes)
+    {
+        Batch->Stat.BySize++;
+        res = UdpBatch_Flush(Batch);
+    }
+
+    if (Batch->Len == 0)
+        Batch->First = TimeBase_Ms();
+
+    memcpy(Batch->Buf + Batch->Len, Sample, Len);
+    Batch->Len += Len;
+    Batch->Stat.Samples++;
+
+    if (Batch->Len == Batch->MaxBytes || Batch->MaxAgeMs == 0)
+    {
+        if (Batch->MaxAgeMs != 0)
+            Batch->Stat.BySize++;
+        if (UdpBatch_Flush(Batch) != UDPBATCH_OK)
+            res = UDPBATCH_FAIL;
+    }
+
+    return res;
+}
+
+
+/**
+ * @name    UdpBatch_Poll
+ * @brief   The function sends the pending samples once the oldest one is
+ *              MaxAgeMs old
+ *
+ * @author  Mehdi
+ *
+ * @return	UDPBATCH_OK or UDPBATCH_FAIL
+ */
+
+int8_t UdpBatch_Poll(UdpBatch* Batch)
+{
+    if (Batch->Len == 0 || (TimeBase_Ms() - Batch->First) < Batch->MaxAgeMs)
+        return UDPBATCH_OK;
+
+    Batch->Stat.ByAge++;
+
+    return UdpBatch_Flush(Batch);
+}
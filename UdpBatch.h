@@ -0,0 +1,70 @@
+/**
+ @file     UdpBatch.h
+ @brief    Send-side batcher of small telemetry samples. Samples are
+           appended to a buffer and sent as one datagram (one AT+CIPSEND)
+           when the buffer reaches MaxBytes or its oldest sample is
+           MaxAgeMs old. MaxAgeMs bounds the added latency; MaxBytes sets
+           how many samples share a datagram, i.e. the packets per second.
+
+           Samples are concatenated as given: use fixed size records or a
+           self-delimited format (e.g. one line per sample).
+
+ @author   Mehdi
+
+*/
+
+#ifndef UDPBATCH_H_
+#define UDPBATCH_H_
+
+#include <stdint.h>
+
+#ifndef UDPBATCH_BUF_SIZE
+#define UDPBATCH_BUF_SIZE			512		// Largest datagram (the ESP8266 takes up to 2048)
+#endif
+
+// Results
+#define UDPBATCH_OK					 1
+#define UDPBATCH_TOO_LONG			-1		// Sample larger than MaxBytes
+#define UDPBATCH_FAIL				-2		// The datagram could not be sent (samples dropped)
+
+// Sends one datagram, e.g. ESP_UdpSend
+typedef int8_t (*UdpBatch_Send)(uint8_t Link, const uint8_t* Data, uint16_t Len);
+
+typedef struct
+{
+    uint32_t Samples;
+    uint32_t Datagrams;
+    uint32_t Bytes;
+    uint32_t BySize;			// Datagrams sent because MaxBytes was reached
+    uint32_t ByAge;				// Datagrams sent because MaxAgeMs elapsed
+    uint32_t Failed;			// Datagrams lost
+    uint32_t MaxAgeMs;			// Oldest sample ever sent
+} UdpBatch_Stat;
+
+typedef struct
+{
+    UdpBatch_Send Send;
+    uint8_t       Link;
+    uint16_t      MaxBytes;
+    uint16_t      MaxAgeMs;		// 0: every sample is sent at once
+    uint16_t      Len;
+    uint32_t      First;		// Time the oldest pending sample was put
+    uint8_t       Buf[UDPBATCH_BUF_SIZE];
+    UdpBatch_Stat Stat;
+} UdpBatch;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void UdpBatch_Init(UdpBatch* Batch, UdpBatch_Send Send, uint8_t Link, uint16_t MaxBytes, uint16_t MaxAgeMs);
+
+int8_t UdpBatch_Put(UdpBatch* Batch, const void* Sample, uint16_t Len);
+
+int8_t UdpBatch_Poll(UdpBatch* Batch);
+
+int8_t UdpBatch_Flush(UdpBatch* Batch);
+
+
+#endif /* UDPBATCH_H_ */
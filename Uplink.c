@@ -0,0 +1,537 @@
+/**
+ @file     Uplink.c
+ @brief    This file contains the uplink router. Uplink_Poll does one
+           step at a time: it probes a down path whose backoff elapsed,
+           expires the messages past their deadline and sends one message,
+           the most urgent that has a path. Probes follow their backoff
+           whatever the queue holds, so a path that is back is found even
+           while the traffic flows over another one. A send blocks for
+           the send timeout of the path at most, so a dead path costs
+           UPLINK_FAILS_DOWN timeouts before the traffic fails over.
+
+           The time of each send is smoothed per path (1/8 weight, as the
+           TCP SRTT); when the cheapest path would miss the deadline of a
+           message, the fastest allowed path takes it.
+
+ @author   Mehdi
+
+*/
+
+
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "Uplink.h"
+#include "ESP8266.h"
+#include "FastJoin.h"
+#include "LinkSup.h"
+#include "SIM900.h"
+#include "SMSQueue.h"
+#include "TimeBase.h"
+
+
+#define UPLINK_HOST_LEN		64
+
+typedef struct
+{
+    uint8_t  Used;
+    uint8_t  Priority;
+    uint8_t  Handle;
+    uint16_t Len;
+    uint32_t Queued;
+    uint32_t Deadline;			// 0: none
+    uint8_t  Data[UPLINK_MSG_LEN];
+} Uplink_Item;
+
+static Uplink_Item     Uplink_Items[UPLINK_DEPTH];
+static Uplink_Path     Uplink_Paths[UPLINK_PATHS];
+static uint32_t        Uplink_MinRtt[UPLINK_PATHS];
+static Uplink_Stat     Uplink_Stats;
+static Uplink_Callback Uplink_Cb;
+static uint8_t         Uplink_NextHandle;
+static uint8_t         Uplink_Count;
+
+static uint8_t         Uplink_Failing;		// A send failed, no delivery since
+static uint8_t         Uplink_FailPath;
+static uint32_t        Uplink_FailStart;
+
+static char            Uplink_WifiHost[UPLINK_HOST_LEN + 1];
+static uint16_t        Uplink_WifiRemote, Uplink_WifiLocal;
+static char            Uplink_SmsNum[SMSQUEUE_NUM_LEN + 1];
+
+
+/**
+ * @name    Uplink_Init
+ * @brief   The function empties the queue and removes the paths
+ *
+ * @author  Mehdi
+ *
+ * @param	Callback: called when a message is sent or expires (may be NULL)
+ */
+
+void Uplink_Init(Uplink_Callback Callback)
+{
+    memset(Uplink_Items, 0, sizeof(Uplink_Items));
+    memset(Uplink_Paths, 0, sizeof(Uplink_Paths));
+    memset(&Uplink_Stats, 0, sizeof(Uplink_Stats));
+
+    Uplink_Cb = Callback;
+    Uplink_Count = 0;
+    Uplink_Failing = 0;
+}
+
+
+/**
+ * @name    Uplink_Down
+ * @brief   The function takes a path down; it is probed after a backoff
+ *
+ * @author  Mehdi
+ */
+
+static void Uplink_Down(Uplink_Path* Path, uint32_t Now)
+{
+    Path->State = UPLINK_DOWN;
+    Path->DownSince = Now;
+    Path->Probes = 0;
+    Path->NextProbe = Now + LinkSup_Backoff(1);
+}
+
+
+/**
+ * @name    Uplink_SetPath
+ * @brief   The function sets the operations of a path. The path starts
+ *              down and is probed at the next Uplink_Poll.
+ *
+ * @author  Mehdi
+ *
+ * @param	Path: UPLINK_WIFI, UPLINK_GPRS or UPLINK_SMS
+ * @param	Ops: the operations (Uplink_WifiOps, Uplink_SmsOps, ...), NULL to remove the path
+ * @param	Cost: cost of a message
+ * @param	RttMs: the least time a message takes over the path; a floor
+ *              of the measured time, for a path whose send returns
+ *              before the delivery (SMS)
+ */
+
+void Uplink_SetPath(uint8_t Path, const Uplink_Ops* Ops, uint16_t Cost, uint32_t RttMs)
+{
+    Uplink_Path* P;
+
+    if (Path >= UPLINK_PATHS)
+        return;
+
+    P = &Uplink_Paths[Path];
+    memset(P, 0, sizeof(Uplink_Path));
+    Uplink_MinRtt[Path] = RttMs;
+
+    if (Ops == NULL)
+        return;
+
+    P->Ops = Ops;
+    P->Cost = Cost;
+    P->SrttMs = RttMs;
+
+    Uplink_Down(P, TimeBase_Ms());
+    P->NextProbe = P->DownSince;
+}
+
+
+/**
+ * @name    Uplink_Send
+ * @brief   The function queues a message; it does not block.
+ *
+ * @author  Mehdi
+ *
+ * @param	Msg: the message (text for the SMS path)
+ * @param	Len: its length, up to UPLINK_MSG_LEN
+ * @param	Priority: UPLINK_PRIO_xxx, the most expensive path allowed
+ * @param	DeadlineMs: time (ms) the message may wait; 0: no deadline
+ * @return  the handle of the message, UPLINK_FULL or UPLINK_TOO_LONG
+ */
+
+int16_t Uplink_Send(const void* Msg, uint16_t Len, uint8_t Priority, uint32_t DeadlineMs)
+{
+    Uplink_Item* Item;
+    uint8_t i;
+
+    if (Len > UPLINK_MSG_LEN)
+        return UPLINK_TOO_LONG;
+
+    for (i = 0; i < UPLINK_DEPTH && Uplink_Items[i].Used; i++)
+        ;
+
+    if (i == UPLINK_DEPTH)
+    {
+        Uplink_Stats.Full++;
+        return UPLINK_FULL;
+    }
+
+    Item = &Uplink_Items[i];
+    memcpy(Item->Data, Msg, Len);
+    Item->Len = Len;
+    Item->Priority = (Priority < UPLINK_PATHS) ? Priority : UPLINK_PATHS - 1;
+    Item->Queued = TimeBase_Ms();
+    Item->Deadline = (DeadlineMs != 0) ? (Item->Queued + DeadlineMs) | 1 : 0;
+    Item->Handle = Uplink_NextHandle++;
+    Item->Used = 1;
+
+    Uplink_Count++;
+    Uplink_Stats.Queued++;
+
+    return Item->Handle;
+}
+
+
+/**
+ * @name    Uplink_Done
+ * @brief   The function removes a message and calls the callback
+ *
+ * @author  Mehdi
+ */
+
+static void Uplink_Done(Uplink_Item* Item, uint8_t Status, uint8_t Path)
+{
+    Item->Used = 0;
+    Uplink_Count--;
+
+    if (Uplink_Cb != NULL)
+        Uplink_Cb(Item->Handle, Status, Path);
+}
+
+
+/* Time (ms) left before the deadline of a message */
+static int32_t Uplink_Slack(const Uplink_Item* Item, uint32_t Now)
+{
+    return (Item->Deadline != 0) ? (int32_t)(Item->Deadline - Now) : INT32_MAX;
+}
+
+
+/**
+ * @name    Uplink_Choose
+ * @brief   The function picks the path of a message: the cheapest up path
+ *              its priority allows, or the fastest of them if the cheapest
+ *              would miss the deadline. When the deadline is near, any path
+ *              is allowed, and a path whose last send failed is avoided if
+ *              another one is up.
+ *
+ * @author  Mehdi
+ *
+ * @return	the path, or -1 if none is up
+ */
+
+static int8_t Uplink_Choose(const Uplink_Item* Item, uint32_t Now)
+{
+    int32_t Slack = Uplink_Slack(Item, Now);
+    uint8_t Near = (Slack <= UPLINK_ESCALATE_MS);
+    uint8_t Max = Near ? UPLINK_PATHS - 1 : Item->Priority;
+    uint8_t Sound = 0;
+    int8_t Best = -1, Fast = -1;
+    uint8_t p;
+
+    for (p = 0; p <= Max; p++)
+        if (Uplink_Paths[p].State == UPLINK_UP && Uplink_Paths[p].Fails == 0)
+            Sound = 1;
+
+    for (p = 0; p <= Max; p++)
+    {
+        if (Uplink_Paths[p].State != UPLINK_UP || (Near && Sound && Uplink_Paths[p].Fails != 0))
+            continue;
+        if (Best < 0 || Uplink_Paths[p].Cost < Uplink_Paths[Best].Cost)
+            Best = p;
+        if (Fast < 0 || Uplink_Paths[p].SrttMs < Uplink_Paths[Fast].SrttMs)
+            Fast = p;
+    }
+
+    if (Best >= 0 && (int32_t)Uplink_Paths[Best].SrttMs > Slack)
+        return Fast;
+
+    return Best;
+}
+
+
+/**
+ * @name    Uplink_Transmit
+ * @brief   The function sends a message over a path and updates its health
+ *
+ * @author  Mehdi
+ */
+
+static void Uplink_Transmit(Uplink_Item* Item, uint8_t p)
+{
+    Uplink_Path* Path = &Uplink_Paths[p];
+    uint32_t Start = TimeBase_Ms(), Now, Rtt, Latency;
+    int32_t Delta;
+
+    if (Path->Ops->Send(Item->Data, Item->Len) <= 0)
+    {
+        Path->Failed++;
+
+        if (!Uplink_Failing)
+        {
+            Uplink_Failing = 1;
+            Uplink_FailPath = p;
+            Uplink_FailStart = Start;
+        }
+
+        if (++Path->Fails >= UPLINK_FAILS_DOWN)
+            Uplink_Down(Path, TimeBase_Ms());
+        return;
+    }
+
+    Now = TimeBase_Ms();
+    Rtt = Now - Start;
+    if (Rtt < Uplink_MinRtt[p])
+        Rtt = Uplink_MinRtt[p];
+
+    Delta = (int32_t)(Rtt - Path->SrttMs) / 8;
+    Path->SrttMs += Delta;
+    Path->Fails = 0;
+    Path->Sent++;
+    Path->Bytes += Item->Len;
+    Path->Spent += Path->Cost;
+
+    if (Uplink_Failing)
+    {
+        if (p != Uplink_FailPath)
+        {
+            Uplink_Stats.Failovers++;
+            Uplink_Stats.LastFailoverMs = Now - Uplink_FailStart;
+            if (Uplink_Stats.LastFailoverMs > Uplink_Stats.MaxFailoverMs)
+                Uplink_Stats.MaxFailoverMs = Uplink_Stats.LastFailoverMs;
+        }
+        Uplink_Failing = 0;
+    }
+
+    Latency = Now - Item->Queued;
+    Uplink_Stats.Sent++;
+    Uplink_Stats.TotalLatencyMs += Latency;
+    if (Latency > Uplink_Stats.MaxLatencyMs)
+        Uplink_Stats.MaxLatencyMs = Latency;
+
+    Uplink_Done(Item, UPLINK_SENT, p);
+}
+
+
+/**
+ * @name    Uplink_Probe
+ * @brief   The function probes a down path; it stays down with a longer
+ *              backoff if the probe fails
+ *
+ * @author  Mehdi
+ */
+
+static void Uplink_Probe(Uplink_Path* Path)
+{
+    uint32_t Now;
+
+    if (Path->Ops->Probe != NULL && Path->Ops->Probe() <= 0)
+    {
+        if (Path->Probes < 254)
+            Path->Probes++;
+        Path->NextProbe = TimeBase_Ms() + LinkSup_Backoff(Path->Probes + 1);
+        return;
+    }
+
+    Now = TimeBase_Ms();
+    Path->State = UPLINK_UP;
+    Path->Fails = 0;
+    Path->DownMs += Now - Path->DownSince;
+}
+
+
+/**
+ * @name    Uplink_Poll
+ * @brief   The function drives the router (see the file header). It should
+ *              be called from the main loop.
+ *
+ * @author  Mehdi
+ */
+
+void Uplink_Poll(void)
+{
+    uint32_t Now = TimeBase_Ms();
+    Uplink_Item *Item, *Next = NULL;
+    int32_t Slack, NextSlack = 0;
+    int8_t p, Path = -1;
+    uint8_t i;
+
+    /* One due probe per step; it may take seconds (a join) */
+    for (i = 0; i < UPLINK_PATHS; i++)
+    {
+        if (Uplink_Paths[i].State == UPLINK_DOWN && (int32_t)(Now - Uplink_Paths[i].NextProbe) >= 0)
+        {
+            Uplink_Probe(&Uplink_Paths[i]);
+            Now = TimeBase_Ms();
+            break;
+        }
+    }
+
+    for (i = 0; i < UPLINK_DEPTH; i++)
+    {
+        Item = &Uplink_Items[i];
+        if (Item->Used && Item->Deadline != 0 && (int32_t)(Now - Item->Deadline) >= 0)
+        {
+            Uplink_Stats.Expired++;
+            Uplink_Done(Item, UPLINK_EXPIRED, UPLINK_PATHS);
+        }
+    }
+
+    /* The most urgent message that has a path: priority, then deadline, then age */
+    for (i = 0; i < UPLINK_DEPTH; i++)
+    {
+        Item = &Uplink_Items[i];
+        if (!Item->Used || (p = Uplink_Choose(Item, Now)) < 0)
+            continue;
+
+        Slack = Uplink_Slack(Item, Now);
+
+        if (Next == NULL || Item->Priority > Next->Priority ||
+            (Item->Priority == Next->Priority &&
+             (Slack < NextSlack || (Slack == NextSlack && (int32_t)(Item->Queued - Next->Queued) < 0))))
+        {
+            Next = Item;
+            NextSlack = Slack;
+            Path = p;
+        }
+    }
+
+    if (Next != NULL)
+        Uplink_Transmit(Next, Path);
+}
+
+
+/**
+ * @name    Uplink_Pending
+ * @brief   The function returns the number of messages not yet sent
+ *
+ * @author  Mehdi
+ */
+
+uint8_t Uplink_Pending(void)
+{
+    return Uplink_Count;
+}
+
+
+/**
+ * @name    Uplink_GetPath
+ * @brief   The function returns the health and counters of a path
+ *
+ * @author  Mehdi
+ */
+
+const Uplink_Path* Uplink_GetPath(uint8_t Path)
+{
+    return &Uplink_Paths[Path];
+}
+
+
+/**
+ * @name    Uplink_GetStat
+ * @brief   The function returns the counters of the router
+ *
+ * @author  Mehdi
+ */
+
+const Uplink_Stat* Uplink_GetStat(void)
+{
+    return &Uplink_Stats;
+}
+
+
+/***************************************************
+				P A T H S
+****************************************************/
+
+/**
+ * @name    Uplink_SetWifiTarget
+ * @brief   The function sets the peer of the Wi-Fi path; the probe of the
+ *              path (re)opens the UDP link UPLINK_WIFI_LINK to it
+ *
+ * @author  Mehdi
+ */
+
+void Uplink_SetWifiTarget(const char* Host, uint16_t RemotePort, uint16_t LocalPort)
+{
+    strncpy(Uplink_WifiHost, Host, UPLINK_HOST_LEN);
+    Uplink_WifiHost[UPLINK_HOST_LEN] = '\0';
+    Uplink_WifiRemote = RemotePort;
+    Uplink_WifiLocal = LocalPort;
+}
+
+
+/**
+ * @name    Uplink_SetSmsNumber
+ * @brief   The function sets the number the SMS path sends to
+ *
+ * @author  Mehdi
+ */
+
+void Uplink_SetSmsNumber(const char* Num)
+{
+    strncpy(Uplink_SmsNum, Num, SMSQUEUE_NUM_LEN);
+    Uplink_SmsNum[SMSQUEUE_NUM_LEN] = '\0';
+}
+
+
+static int8_t Uplink_WifiSend(const uint8_t* Data, uint16_t Len)
+{
+    return ESP_UdpSend(UPLINK_WIFI_LINK, Data, Len);
+}
+
+
+/**
+ * @name    Uplink_WifiProbe
+ * @brief   The function checks the station has an IP, with one join
+ *              attempt if not (no blocking recovery loop), then reopens
+ *              the UDP link
+ *
+ * @author  Mehdi
+ */
+
+static int8_t Uplink_WifiProbe(void)
+{
+    if (ESP_GetIP() != ESP8266_OK && (FastJoin_Connect() != ESP8266_OK || ESP_GetIP() != ESP8266_OK))
+        return ESP8266_FAIL;
+
+    if (Uplink_WifiHost[0] == '\0')
+        return ESP8266_OK;
+
+    ESP_Close(UPLINK_WIFI_LINK);
+
+    return ESP_UdpOpen(UPLINK_WIFI_LINK, Uplink_WifiHost, Uplink_WifiRemote, Uplink_WifiLocal, 0);
+}
+
+
+/**
+ * @name    Uplink_SmsSend
+ * @brief   The function posts a message to the SMS queue; the path counts
+ *              it sent once it is queued
+ *
+ * @author  Mehdi
+ */
+
+static int8_t Uplink_SmsSend(const uint8_t* Data, uint16_t Len)
+{
+    char Text[UPLINK_MSG_LEN + 1];
+
+    if (Uplink_SmsNum[0] == '\0')
+        return SIM900_FAIL;
+
+    memcpy(Text, Data, Len);
+    Text[Len] = '\0';
+
+    return (SMSQueue_Post(Uplink_SmsNum, Text, NULL) >= 0) ? SIM900_OK : SIM900_FAIL;
+}
+
+
+static int8_t Uplink_SmsProbe(void)
+{
+    int8_t Stat = SIM900GetNetStat();
+
+    return (Stat == SIM900_NW_REGISTERED_HOME || Stat == SIM900_NW_REGISTED_ROAMING) ? SIM900_OK : SIM900_FAIL;
+}
+
+
+const Uplink_Ops Uplink_WifiOps = { Uplink_WifiSend, Uplink_WifiProbe };
+const Uplink_Ops Uplink_SmsOps  = { Uplink_SmsSend,  Uplink_SmsProbe };
@@ -0,0 +1,136 @@
+/**
+ @file     Uplink.h
+ @brief    Uplink router above the modem drivers. The application hands
+           its messages to one queue with a priority and a deadline; the
+           router sends each one over the cheapest path that is healthy
+           and allowed for it: Wi-Fi (ESP8266), GPRS or SMS (SIM900).
+
+           A path goes down after UPLINK_FAILS_DOWN failed sends in a row,
+           so the traffic fails over within that many send timeouts. A
+           down path is probed with backoff; when it is back, the queued
+           traffic drains over it again.
+
+           The priority of a message is the most expensive path it may
+           take; a message whose deadline is near may take any path.
+           Bulk traffic therefore waits for Wi-Fi while it can.
+
+ @author   Mehdi
+
+*/
+
+#ifndef UPLINK_H_
+#define UPLINK_H_
+
+#include <stdint.h>
+
+// Configuration
+#ifndef UPLINK_DEPTH
+#define UPLINK_DEPTH				8		// Messages waiting for a path
+#endif
+
+#ifndef UPLINK_MSG_LEN
+#define UPLINK_MSG_LEN				160		// Longest message (one SMS)
+#endif
+
+#ifndef UPLINK_FAILS_DOWN
+#define UPLINK_FAILS_DOWN			2		// Failed sends in a row that take a path down
+#endif
+
+#ifndef UPLINK_ESCALATE_MS
+#define UPLINK_ESCALATE_MS			5000	// Time before its deadline a message may take any path
+#endif
+
+#ifndef UPLINK_WIFI_LINK
+#define UPLINK_WIFI_LINK			4		// ESP8266 link of the Wi-Fi path
+#endif
+
+// Paths, cheapest first
+#define UPLINK_WIFI					0
+#define UPLINK_GPRS					1
+#define UPLINK_SMS					2
+#define UPLINK_PATHS				3
+
+// Priorities: the most expensive path allowed before the deadline is near
+#define UPLINK_PRIO_BULK			UPLINK_WIFI
+#define UPLINK_PRIO_NORMAL			UPLINK_GPRS
+#define UPLINK_PRIO_URGENT			UPLINK_SMS
+
+// Path State
+#define UPLINK_UNUSED				0		// No operations set
+#define UPLINK_UP					1
+#define UPLINK_DOWN					2
+
+// Message Status (given to the callback)
+#define UPLINK_SENT					1
+#define UPLINK_EXPIRED				2		// Deadline passed before a path took it
+
+#define UPLINK_FULL					-1
+#define UPLINK_TOO_LONG				-2
+
+// Operations of a path; the results are >0 on success (ESP8266_OK, SIM900_OK)
+typedef struct
+{
+    int8_t (*Send)(const uint8_t* Data, uint16_t Len);	// Hands a message to the path
+    int8_t (*Probe)(void);								// Checks (and restores) a down path
+} Uplink_Ops;
+
+typedef void (*Uplink_Callback)(uint8_t Handle, uint8_t Status, uint8_t Path);
+
+typedef struct
+{
+    const Uplink_Ops* Ops;
+    uint16_t Cost;				// Cost of a message (e.g. in 1/1000 of a currency unit)
+    uint8_t  State;				// UPLINK_xxx
+    uint8_t  Fails;				// Failed sends in a row
+    uint8_t  Probes;			// Failed probes since the path went down
+    uint32_t SrttMs;			// Smoothed time of a send
+    uint32_t NextProbe;			// Time of the next probe of a down path
+    uint32_t DownSince;
+    uint32_t Sent;
+    uint32_t Failed;
+    uint32_t Bytes;
+    uint32_t Spent;				// Cost of the messages sent
+    uint32_t DownMs;			// Time spent down
+} Uplink_Path;
+
+typedef struct
+{
+    uint32_t Queued;
+    uint32_t Sent;
+    uint32_t Expired;
+    uint32_t Full;				// Messages refused, queue full
+    uint32_t Failovers;			// Deliveries on another path after a failure
+    uint32_t LastFailoverMs;	// First failure to the first delivery on another path
+    uint32_t MaxFailoverMs;
+    uint32_t MaxLatencyMs;		// Queued to sent
+    uint32_t TotalLatencyMs;
+} Uplink_Stat;
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void Uplink_Init(Uplink_Callback Callback);
+
+void Uplink_SetPath(uint8_t Path, const Uplink_Ops* Ops, uint16_t Cost, uint32_t RttMs);
+
+void Uplink_SetWifiTarget(const char* Host, uint16_t RemotePort, uint16_t LocalPort);
+
+void Uplink_SetSmsNumber(const char* Num);
+
+int16_t Uplink_Send(const void* Msg, uint16_t Len, uint8_t Priority, uint32_t DeadlineMs);
+
+void Uplink_Poll(void);
+
+uint8_t Uplink_Pending(void);
+
+const Uplink_Path* Uplink_GetPath(uint8_t Path);
+
+const Uplink_Stat* Uplink_GetStat(void);
+
+extern const Uplink_Ops Uplink_WifiOps;
+extern const Uplink_Ops Uplink_SmsOps;
+
+
+#endif /* UPLINK_H_ */
@@ -0,0 +1,827 @@
+/**
+ @file     ATEngineTest.c
+ @brief    Host check of the shared AT engine (ATEngine.h) through the two
+           drivers built on it. A scripted module answers on each USART:
+           the ESP8266 on USART1, the SIM900 on USART2 with its echo on.
+           A script maps each command line to its reply; a reply may end
+           with a prompt, after which the module takes the data (the
+           length of AT+CIPSEND, or up to Ctrl-Z for AT+CMGS) and sends
+           the rest of its reply. Lines can be queued on a USART out of
+           turn, as unsolicited reports, or sent over and over, as by a
+           module that never stops talking.
+
+           Every case runs a driver call against its script and checks
+           the result and what the driver made of the reply. The bench
+           then times a full ATEngine_Run (send, echo, reply, record) for
+           each command set. The clock is simulated, so the timeouts take
+           no real time; the bench reports host time.
+
+           The tool exits with 1 when a case fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o ATEngineTest tools/ATEngineTest.c ESP8266.c SIM900.c \
+                   ATCmd.c ATEngine.c ATResp.c LinkSup.c FastJoin.c \
+                   StatusSink.c SMSPdu.c AuxLib.c BufPool.c
+
+           Usage:
+               ATEngineTest [-n <bench runs>]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f4xx_hal.h"
+#include "tm_stm32_usart.h"
+#include "tm_stm32_delay.h"
+#include "tm_stm32_hd44780.h"
+
+#include "ESP8266.h"
+#include "FastJoin.h"
+#include "SIM900.h"
+#include "ATCmd.h"
+#include "ATEngine.h"
+#include "LinkSup.h"
+#include "Transport.h"
+#include "TimeBase.h"
+
+
+#define SIM_STEP_NS					10000		// Clock step of a poll of the clock
+#define SIM_RX_SIZE					2048
+#define SIM_PORTS					3
+
+typedef struct
+{
+    const char* Cmd;			// The command line; a final '*' matches any rest
+    const char* Reply;			// NULL: no reply
+    const char* After;			// Not NULL: Reply ends with the prompt, After follows the data
+} Test_Step;
+
+typedef struct
+{
+    uint8_t          Echo;
+    const Test_Step* Steps;
+    const Test_Step* Data;		// The step whose data is being taken
+    char             Line[256];
+    uint16_t         LineLen;
+    uint16_t         Need;		// Data bytes left (ESP8266), 0: up to Ctrl-Z
+    uint32_t         Unknown;	// Commands not in the script
+    const char*      Flood;		// Not NULL: sent again each time the driver read it all
+
+    uint8_t          Rx[SIM_RX_SIZE];	// Bytes of the module, to the driver
+    uint16_t         RxHead, RxTail;
+} Test_Module;
+
+USART_TypeDef Host_USART[7] = {{.Port = 0},{.Port = 1},{.Port = 2},{.Port = 3},
+                               {.Port = 4},{.Port = 5},{.Port = 6}};
+uint32_t SystemCoreClock = 168000000;
+uint8_t Host_Flash[HOST_FLASH_SIZE];
+
+extern USART_TypeDef* USART_ESP;
+
+static uint64_t    Sim_Now;				// ns
+static Test_Module Mods[SIM_PORTS];
+static uint32_t    Test_Errors;
+static char        Test_Urc[128];		// The last line the URC handler got
+static uint32_t    Test_Urcs;
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+static Test_Module* Mod_Of(USART_TypeDef* USARTx)
+{
+    return &Mods[USARTx->Port % SIM_PORTS];
+}
+
+
+static void Mod_Print(Test_Module* Mod, const char* Text)
+{
+    for (; *Text; Text++)
+    {
+        Mod->Rx[Mod->RxHead] = *Text;
+        Mod->RxHead = (Mod->RxHead + 1) % SIM_RX_SIZE;
+    }
+}
+
+
+/**
+ * @name    Mod_Line
+ * @brief   The function answers a command line from the script
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Line(Test_Module* Mod)
+{
+    const Test_Step* Step;
+    const char* p;
+    size_t n;
+
+    for (Step = Mod->Steps; Step != NULL && Step->Cmd != NULL; Step++)
+    {
+        n = strlen(Step->Cmd);
+
+        if (Step->Cmd[n - 1] == '*' ? strncmp(Mod->Line, Step->Cmd, n - 1) == 0 : strcmp(Mod->Line, Step->Cmd) == 0)
+            break;
+    }
+
+    if (Step == NULL || Step->Cmd == NULL)
+    {
+        Mod->Unknown++;
+        Mod_Print(Mod, "\r\nERROR\r\n");
+        return;
+    }
+
+    if (Step->Reply != NULL)
+        Mod_Print(Mod, Step->Reply);
+
+    if (Step->After != NULL)
+    {
+        Mod->Data = Step;
+        Mod->Need = ((p = strrchr(Mod->Line, ',')) != NULL && !Mod->Echo) ? atoi(p + 1) : 0;
+    }
+}
+
+
+/**
+ * @name    Mod_Rx
+ * @brief   The function takes one byte from the driver
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Rx(Test_Module* Mod, uint8_t c)
+{
+    char Echo[2] = { c, '\0' };
+
+    if (Mod->Data != NULL)
+    {
+        if (Mod->Echo && c != 0x1A)
+            Mod_Print(Mod, Echo);
+
+        if ((Mod->Need != 0) ? --Mod->Need == 0 : c == 0x1A)
+        {
+            if (Mod->Echo)
+                Mod_Print(Mod, "\r\n");
+            Mod_Print(Mod, Mod->Data->After);
+            Mod->Data = NULL;
+        }
+        return;
+    }
+
+    if (Mod->Echo)
+        Mod_Print(Mod, Echo);
+
+    if (c == '\n')
+        return;
+
+    if (c != '\r')
+    {
+        if (Mod->LineLen < sizeof(Mod->Line) - 1)
+            Mod->Line[Mod->LineLen++] = c;
+        return;
+    }
+
+    Mod->Line[Mod->LineLen] = '\0';
+    Mod->LineLen = 0;
+    Mod_Line(Mod);
+}
+
+
+static uint16_t Mod_Pending(Test_Module* Mod)
+{
+    if (Mod->Flood != NULL && Mod->RxHead == Mod->RxTail)
+        Mod_Print(Mod, Mod->Flood);
+
+    return (Mod->RxHead + SIM_RX_SIZE - Mod->RxTail) % SIM_RX_SIZE;
+}
+
+
+/***************************************************
+		H O S T   L I B R A R I E S
+****************************************************/
+
+void TM_USART_Putc(USART_TypeDef* USARTx, volatile char c)
+{
+    Mod_Rx(Mod_Of(USARTx), c);
+}
+
+
+void TM_USART_Puts(USART_TypeDef* USARTx, char* str)
+{
+    while (*str)
+        Mod_Rx(Mod_Of(USARTx), *str++);
+}
+
+
+void TM_USART_Send(USART_TypeDef* USARTx, uint8_t* DataArray, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+        Mod_Rx(Mod_Of(USARTx), DataArray[i]);
+}
+
+
+uint8_t TM_USART_Getc(USART_TypeDef* USARTx)
+{
+    Test_Module* Mod = Mod_Of(USARTx);
+    uint8_t c;
+
+    if (Mod_Pending(Mod) == 0)
+        return 0;
+
+    c = Mod->Rx[Mod->RxTail];
+    Mod->RxTail = (Mod->RxTail + 1) % SIM_RX_SIZE;
+
+    return c;
+}
+
+
+uint16_t TM_USART_Gets(USART_TypeDef* USARTx, char* buffer, uint16_t bufsize)
+{
+    uint16_t i = 0;
+
+    if (TM_USART_FindCharacter(USARTx, '\n') < 0 && Mod_Pending(Mod_Of(USARTx)) < bufsize - 1)
+        return 0;
+
+    while (i < bufsize - 1 && !TM_USART_BufferEmpty(USARTx))
+    {
+        buffer[i] = TM_USART_Getc(USARTx);
+        if (buffer[i++] == '\n')
+            break;
+    }
+    buffer[i] = 0;
+
+    return i;
+}
+
+
+uint8_t TM_USART_BufferEmpty(USART_TypeDef* USARTx)
+{
+    return Mod_Pending(Mod_Of(USARTx)) == 0;
+}
+
+
+uint16_t TM_USART_BufferCount(USART_TypeDef* USARTx)
+{
+    return Mod_Pending(Mod_Of(USARTx));
+}
+
+
+void TM_USART_ClearBuffer(USART_TypeDef* USARTx)
+{
+    Test_Module* Mod = Mod_Of(USARTx);
+
+    Mod->RxTail = Mod->RxHead;
+}
+
+
+int16_t TM_USART_FindCharacter(USART_TypeDef* USARTx, uint8_t c)
+{
+    Test_Module* Mod = Mod_Of(USARTx);
+
+    for (uint16_t i = 0, n = Mod_Pending(Mod); i < n; i++)
+        if (Mod->Rx[(Mod->RxTail + i) % SIM_RX_SIZE] == c)
+            return i;
+
+    return -1;
+}
+
+
+uint32_t HAL_GetTick(void)
+{
+    Sim_Now += SIM_STEP_NS;
+    return Sim_Now / 1000000;
+}
+
+
+void Delay(uint32_t us)
+{
+    Sim_Now += us * 1000ULL;
+}
+
+
+void Delayms(uint32_t ms)
+{
+    Sim_Now += ms * 1000000ULL;
+}
+
+
+uint32_t TM_DELAY_Time(void)
+{
+    return HAL_GetTick();
+}
+
+
+uint64_t TimeBase_Now(void)
+{
+    Sim_Now += SIM_STEP_NS;
+    return Sim_Now / 1000;
+}
+
+
+void TimeBase_Delay(uint64_t us)
+{
+    Sim_Now += us * 1000;
+}
+
+
+void TM_HD44780_Clear(void)
+{
+}
+
+
+void TM_HD44780_Puts(uint8_t x, uint8_t y, char* str)
+{
+    (void)x;
+    (void)y;
+    (void)str;
+}
+
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    return HAL_OK;
+}
+
+
+/* Programming only clears bits, as on the part */
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data)
+{
+    uint32_t Word;
+
+    (void)TypeProgram;
+    if (Address < (uintptr_t)Host_Flash || Address + 4 > (uintptr_t)Host_Flash + HOST_FLASH_SIZE)
+        return HAL_ERROR;
+
+    memcpy(&Word, (void*)Address, 4);
+    Word &= (uint32_t)Data;
+    memcpy((void*)Address, &Word, 4);
+
+    return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError)
+{
+    (void)pEraseInit;
+    memset(Host_Flash, 0xFF, HOST_FLASH_SIZE);
+    *SectorError = 0xFFFFFFFF;
+
+    return HAL_OK;
+}
+
+
+/***************************************************
+				C A S E S
+****************************************************/
+
+/* Takes the reports it knows only: the lines of a reply must stay in it */
+static uint8_t Test_UrcHandler(const char* Line)
+{
+    if (strncmp(Line, "+CMTI:", 6) != 0 && strncmp(Line, "RING", 4) != 0 && strncmp(Line, "+CLIP:", 6) != 0)
+        return 0;
+
+    snprintf(Test_Urc, sizeof(Test_Urc), "%s", Line);
+    Test_Urcs++;
+
+    return 1;
+}
+
+
+/* Starts a case: the scripts of both modules, the receive queues emptied */
+static void Test_Begin(const Test_Step* Esp, const Test_Step* Sim)
+{
+    for (int i = 0; i < SIM_PORTS; i++)
+    {
+        Mods[i].RxHead = Mods[i].RxTail = 0;
+        Mods[i].LineLen = 0;
+        Mods[i].Data = NULL;
+        Mods[i].Unknown = 0;
+        Mods[i].Flood = NULL;
+    }
+
+    Mods[1].Steps = Esp;
+    Mods[2].Steps = Sim;
+    Mods[2].Echo = 1;
+
+    Test_Urc[0] = '\0';
+    Test_Urcs = 0;
+}
+
+
+static void Test_Check(const char* Name, int Ok)
+{
+    Ok = Ok && Mods[1].Unknown == 0 && Mods[2].Unknown == 0;
+
+    printf("%-34s %s\n", Name, Ok ? "ok" : "FAIL");
+
+    if (!Ok)
+        Test_Errors++;
+}
+
+
+static const Test_Step Esp_Ok[] =
+{
+    { "AT",            "\r\nOK\r\n",                                                         NULL },
+    { "AT+CWMODE?",    "+CWMODE:1\r\n\r\nOK\r\n",                                            NULL },
+    { "AT+CIPSTATUS",  "STATUS:2\r\n\r\nOK\r\n",                                             NULL },
+    { "AT+CWJAP?",     "+CWJAP:\"" ESP_AP_SSID "\",\"a0:b1:c2:d3:e4:f5\",6,-58\r\n\r\nOK\r\n", NULL },
+    { "AT+CIPMUX?",    "+CIPMUX:1\r\n\r\nOK\r\n",                                            NULL },
+    { "AT+CIPSERVER?", "+CIPSERVER:1,80\r\n\r\nOK\r\n",                                      NULL },
+    { "AT+CIFSR",      "+CIFSR:APIP,\"192.168.4.1\"\r\n+CIFSR:STAIP,\"10.0.0.7\"\r\n"
+                       "+CIFSR:STAMAC,\"5c:cf:7f:00:00:01\"\r\n\r\nOK\r\n",                   NULL },
+    { "AT+CIPSTART=0,\"UDP\",\"10.0.0.1\",5000,5001,0", "0,CONNECT\r\n\r\nOK\r\n",            NULL },
+    { "AT+CIPSEND=0,*", "\r\nOK\r\n> ",                      "\r\nRecv 5 bytes\r\n\r\nSEND OK\r\n" },
+    { "AT+CIPCLOSE=0", "0,CLOSED\r\n\r\nOK\r\n",                                             NULL },
+    { "AT+UART_CUR=921600,8,1,0,3", "\r\nOK\r\n",                                            NULL },
+    { NULL, NULL, NULL }
+};
+
+static const Test_Step Esp_Error[] =
+{
+    { "AT",            "\r\nERROR\r\n",                                                      NULL },
+    { "AT+CIPSEND=0,*", "busy s...\r\n",                                                     NULL },
+    { NULL, NULL, NULL }
+};
+
+static const Test_Step Esp_Silent[] =
+{
+    { "AT",            NULL,                                                                 NULL },
+    { "AT+CIPSEND=0,*", "\r\nOK\r\n> ",                      "\r\nRecv 5 bytes\r\n\r\nSEND FAIL\r\n" },
+    { NULL, NULL, NULL }
+};
+
+/* Data of link 4 in the middle of a send on link 0: the second frame would
+   end the send if it were read as lines; then link 4 closes */
+static const Test_Step Esp_Ipd[] =
+{
+    { "AT+CIPSEND=0,*", "\r\nOK\r\n\r\n+IPD,4,7:ok\r\nhi!> ",
+                       "\r\nRecv 5 bytes\r\n\r\n+IPD,4,13:\r\nSEND FAIL\r\n\r\n4,CLOSED\r\n\r\nSEND OK\r\n" },
+    { "AT+CIPCLOSE=4", "4,CLOSED\r\n\r\nOK\r\n",                                             NULL },
+    { NULL, NULL, NULL }
+};
+
+#define TEST_BSSID	"a0:b1:c2:d3:e4:f5"
+
+/* Full join: association and DHCP, then the parameters are learned */
+static const Test_Step Esp_Join[] =
+{
+    { "AT+CWJAP=\"" ESP_AP_SSID "\",\"" ESP_AP_PWD "\"",
+                       "WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n",                         NULL },
+    { "AT+CWJAP_CUR?", "+CWJAP_CUR:\"" ESP_AP_SSID "\",\"" TEST_BSSID "\",6,-58\r\n\r\nOK\r\n", NULL },
+    { "AT+CIPSTA_CUR?", "+CIPSTA_CUR:ip:\"10.0.0.7\"\r\n+CIPSTA_CUR:gateway:\"10.0.0.1\"\r\n"
+                       "+CIPSTA_CUR:netmask:\"255.255.255.0\"\r\n\r\nOK\r\n",                  NULL },
+    { "AT+CWDHCP_CUR=1,1", "\r\nOK\r\n",                                                     NULL },
+    { NULL, NULL, NULL }
+};
+
+/* Fast join: the cached channel is scanned, the cached lease applied */
+#define ESP_FAST_STEPS(Scan, Ping)																\
+    { "AT+CWLAP=\"" ESP_AP_SSID "\",\"" TEST_BSSID "\",6", Scan,                                 NULL },	\
+    { "AT+CIPSTA_CUR=\"10.0.0.7\",\"10.0.0.1\",\"255.255.255.0\"", "\r\nOK\r\n",               NULL },	\
+    { "AT+CWJAP_CUR=\"" ESP_AP_SSID "\",\"" ESP_AP_PWD "\",\"" TEST_BSSID "\"",                  \
+                       "WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n",                         NULL },	\
+    { "AT+PING=\"10.0.0.1\"", Ping,                                                         NULL },
+
+#define TEST_CWLAP	"+CWLAP:(3,\"" ESP_AP_SSID "\",-58,\"" TEST_BSSID "\",6,-12,0)\r\n\r\nOK\r\n"
+
+static const Test_Step Esp_Fast[] =
+{
+    ESP_FAST_STEPS(TEST_CWLAP, "+4\r\n\r\nOK\r\n")
+    { "AT+CWJAP_CUR?", "+CWJAP_CUR:\"" ESP_AP_SSID "\",\"" TEST_BSSID "\",6,-58\r\n\r\nOK\r\n", NULL },
+    { "AT+CIPSTA_CUR?", "+CIPSTA_CUR:ip:\"10.0.0.7\"\r\n+CIPSTA_CUR:gateway:\"10.0.0.1\"\r\n"
+                       "+CIPSTA_CUR:netmask:\"255.255.255.0\"\r\n\r\nOK\r\n",                  NULL },
+    { NULL, NULL, NULL }
+};
+
+/* The gateway of the cached lease does not answer */
+static const Test_Step Esp_FastNoGateway[] =
+{
+    ESP_FAST_STEPS(TEST_CWLAP, "+timeout\r\n\r\nERROR\r\n")
+    { "AT+CWDHCP_CUR=1,1", "\r\nOK\r\n",                                                     NULL },
+    { "AT+CWJAP=\"" ESP_AP_SSID "\",\"" ESP_AP_PWD "\"",
+                       "WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n",                         NULL },
+    { "AT+CWJAP_CUR?", "+CWJAP_CUR:\"" ESP_AP_SSID "\",\"" TEST_BSSID "\",6,-58\r\n\r\nOK\r\n", NULL },
+    { "AT+CIPSTA_CUR?", "+CIPSTA_CUR:ip:\"10.0.0.7\"\r\n+CIPSTA_CUR:gateway:\"10.0.0.1\"\r\n"
+                       "+CIPSTA_CUR:netmask:\"255.255.255.0\"\r\n\r\nOK\r\n",                  NULL },
+    { NULL, NULL, NULL }
+};
+
+/* The AP is not on its cached channel: nothing is applied */
+static const Test_Step Esp_FastMoved[] =
+{
+    ESP_FAST_STEPS("\r\nOK\r\n", NULL)
+    { "AT+CWJAP=\"" ESP_AP_SSID "\",\"" ESP_AP_PWD "\"",
+                       "WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n",                         NULL },
+    { "AT+CWJAP_CUR?", "+CWJAP_CUR:\"" ESP_AP_SSID "\",\"" TEST_BSSID "\",6,-58\r\n\r\nOK\r\n", NULL },
+    { "AT+CIPSTA_CUR?", "+CIPSTA_CUR:ip:\"10.0.0.7\"\r\n+CIPSTA_CUR:gateway:\"10.0.0.1\"\r\n"
+                       "+CIPSTA_CUR:netmask:\"255.255.255.0\"\r\n\r\nOK\r\n",                  NULL },
+    { NULL, NULL, NULL }
+};
+
+/* SMS-DELIVER from +31641600986: "How are you?" */
+#define TEST_PDU	"07911326040000F0040B911346610089F60000208062917314080CC8F71D14969741F977FD07"
+
+static const Test_Step Sim_Ok[] =
+{
+    { "AT",            "\r\nOK\r\n",                                                         NULL },
+    { "AT+CREG=2",     "\r\nOK\r\n",                                                         NULL },
+    { "AT+CGREG=2",    "\r\nOK\r\n",                                                         NULL },
+    { "AT+CREG?",      "\r\n+CREG: 2,1,\"00C3\",\"1A2B\"\r\n\r\nOK\r\n",                     NULL },
+    { "AT+CGREG?",     "\r\n+CGREG: 2,1,\"00C3\",\"1A2B\"\r\n\r\nOK\r\n",                    NULL },
+    { "AT+CMGD=3",     "\r\nOK\r\n",                                                         NULL },
+    { "AT+CMGR=3",     "\r\n+CMTI: \"SM\",4\r\n\r\n+CMGR: 0,,30\r\n" TEST_PDU "\r\n\r\nOK\r\n", NULL },
+    { "AT+CMGR=5",     "\r\nOK\r\n",                                                         NULL },
+    { "AT+CMGS=*",     "\r\n> ",                                   "\r\n+CMGS: 42\r\n\r\nOK\r\n" },
+    { NULL, NULL, NULL }
+};
+
+static const Test_Step Sim_Silent[] =
+{
+    { "AT",            NULL,                                                                 NULL },
+    { NULL, NULL, NULL }
+};
+
+static const Test_Step Sim_Error[] =
+{
+    { "AT+CMGD=3",     "\r\nERROR\r\n",                                                      NULL },
+    { "AT+CMGR=3",     "\r\n+CMS ERROR: 517\r\n",                                            NULL },
+    { "AT+CMGS=*",     "\r\n+CMS ERROR: 304\r\n",                                            NULL },
+    { NULL, NULL, NULL }
+};
+
+
+/**
+ * @name    Test_Esp
+ * @brief   The cases of the ESP8266 command set
+ *
+ * @author  Mehdi
+ */
+
+static void Test_Esp(void)
+{
+    ESP_State State;
+    uint8_t Data[5] = { 'h', 'e', 'l', 'l', 'o' };
+    uint8_t Rx[32], Link;
+    int Ok;
+
+    USART_ESP = USART1;
+
+    Test_Begin(Esp_Ok, NULL);
+    Test_Check("esp probe", ESP_Probe() == ESP8266_OK && ESP_GetLastFault() == LINK_FAULT_NONE);
+
+    Test_Begin(Esp_Error, NULL);
+    Test_Check("esp probe, ERROR", ESP_Probe() == ESP8266_FAIL && ESP_GetLastFault() != LINK_FAULT_NONE);
+
+    Test_Begin(Esp_Silent, NULL);
+    Test_Check("esp probe, no reply", ESP_Probe() == ESP8266_TIMEOUT);
+
+    Test_Begin(Esp_Ok, NULL);
+    Test_Check("esp query state", ESP_QueryState(&State) == ESP8266_OK &&
+               State.Mode == 1 && State.Status == 2 && State.Joined && State.Mux == 1 && State.Server == 1);
+
+    Test_Begin(Esp_Ok, NULL);
+    Test_Check("esp get IP", ESP_GetIP() == ESP8266_OK);
+
+    Test_Begin(Esp_Ok, NULL);
+    Test_Check("esp UDP open", ESP_UdpOpen(0, "10.0.0.1", 5000, 5001, 0) == ESP8266_OK);
+
+    Test_Begin(Esp_Ok, NULL);
+    Test_Check("esp UDP send", ESP_UdpSend(0, Data, sizeof(Data)) == ESP8266_OK);
+
+    Test_Begin(Esp_Error, NULL);
+    Test_Check("esp UDP send, busy", ESP_UdpSend(0, Data, sizeof(Data)) == ESP8266_BUSY);
+
+    Test_Begin(Esp_Silent, NULL);
+    Test_Check("esp UDP send, SEND FAIL", ESP_UdpSend(0, Data, sizeof(Data)) == ESP8266_FAIL);
+
+    Test_Begin(Esp_Ok, NULL);
+    Test_Check("esp UDP close", ESP_Close(0) == ESP8266_OK &&
+               ESP_ReadIPD(&Link, Rx, sizeof(Rx), 10) == ESP8266_TIMEOUT);
+
+    Test_Begin(Esp_Ipd, NULL);
+    Test_Check("esp +IPD and CLOSED during a send", ESP_UdpSend(0, Data, sizeof(Data)) == ESP8266_OK &&
+               ESP_ReadIPD(&Link, Rx, sizeof(Rx), 10) == 7 && Link == 4 && memcmp(Rx, "ok\r\nhi!", 7) == 0 &&
+               ESP_ReadIPD(&Link, Rx, sizeof(Rx), 10) == 13 && memcmp(Rx, "\r\nSEND FAIL\r\n", 13) == 0 &&
+               ESP_ReadIPD(&Link, Rx, sizeof(Rx), 10) == ESP8266_CLOSED && Link == 4 &&
+               ESP_ReadIPD(&Link, Rx, sizeof(Rx), 10) == ESP8266_TIMEOUT);
+
+    /* The frames wait in the driver across the cases */
+    Test_Begin(Esp_Ipd, NULL);
+    Ok = (ESP_UdpSend(0, Data, sizeof(Data)) == ESP8266_OK);
+    Test_Begin(Esp_Ipd, NULL);
+    Test_Check("esp close drops its data", Ok && ESP_Close(4) == ESP8266_OK &&
+               ESP_ReadIPD(&Link, Rx, sizeof(Rx), 10) == ESP8266_TIMEOUT);
+
+    Test_Begin(Esp_Ok, NULL);
+    Mod_Print(&Mods[1], "\r\n+IPD,0,5:hello");
+    Test_Check("esp +IPD before a reply", ESP_Probe() == ESP8266_OK &&
+               ESP_ReadIPD(&Link, Rx, sizeof(Rx), 10) == 5 && Link == 0 && memcmp(Rx, "hello", 5) == 0);
+
+    Test_Begin(Esp_Ok, NULL);
+    USART_ESP->CR3 = 0;
+    Test_Check("esp set UART", ESP_SetUart(921600, ESP_FLOW_RTS_CTS) == ESP8266_OK &&
+               USART_ESP->CR3 == (USART_CR3_RTSE | USART_CR3_CTSE));
+    USART_ESP->CR3 = 0;
+}
+
+
+/**
+ * @name    Test_FastJoin
+ * @brief   The cases of the fast reconnect: the record is learned on a
+ *              full join, then applied after a scan of its channel and
+ *              checked with a ping of its gateway
+ *
+ * @author  Mehdi
+ */
+
+static void Test_FastJoin(void)
+{
+    const FastJoin_Timing* Timing = FastJoin_GetTiming();
+
+    USART_ESP = USART1;
+    memset(Host_Flash, 0xFF, HOST_FLASH_SIZE);
+
+    Test_Begin(Esp_Join, NULL);
+    Test_Check("fastjoin, no record: full join", FastJoin_Connect() == ESP8266_OK &&
+               Timing->Mode == FASTJOIN_MODE_FULL && Timing->Fallback == FASTJOIN_FALLBACK_RECORD);
+
+    Test_Begin(Esp_Fast, NULL);
+    Test_Check("fastjoin, cached channel and lease", FastJoin_Connect() == ESP8266_OK &&
+               Timing->Mode == FASTJOIN_MODE_FAST && Timing->Fallback == FASTJOIN_FALLBACK_NONE);
+
+    Test_Begin(Esp_FastNoGateway, NULL);
+    Test_Check("fastjoin, no gateway: DHCP", FastJoin_Connect() == ESP8266_OK &&
+               Timing->Mode == FASTJOIN_MODE_FULL && Timing->Fallback == FASTJOIN_FALLBACK_GATEWAY);
+
+    Test_Begin(Esp_FastMoved, NULL);
+    Test_Check("fastjoin, AP off its channel", FastJoin_Connect() == ESP8266_OK &&
+               Timing->Mode == FASTJOIN_MODE_FULL && Timing->Fallback == FASTJOIN_FALLBACK_SCAN);
+
+    Sim_Now += (FASTJOIN_LEASE_MS + 1) * 1000000ULL;
+    Test_Begin(Esp_Join, NULL);
+    Test_Check("fastjoin, lease too old: DHCP", FastJoin_Connect() == ESP8266_OK &&
+               Timing->Mode == FASTJOIN_MODE_FULL && Timing->Fallback == FASTJOIN_FALLBACK_LEASE);
+
+    Test_Begin(Esp_Fast, NULL);
+    Test_Check("fastjoin, renewed lease", FastJoin_Connect() == ESP8266_OK &&
+               Timing->Mode == FASTJOIN_MODE_FAST);
+}
+
+
+/**
+ * @name    Test_Sim
+ * @brief   The cases of the SIM900 command set, with the echo on
+ *
+ * @author  Mehdi
+ */
+
+static void Test_Sim(void)
+{
+    const SIM900_NetReg* Reg;
+    char Text[64];
+    uint8_t Id, Ref = 0;
+
+    Test_Begin(NULL, Sim_Ok);
+    Test_Check("sim init", SIM900Init(USART2) == SIM900_OK);
+
+    SIM900SetURCHandler(Test_UrcHandler);
+
+    Test_Begin(NULL, Sim_Ok);
+    Reg = SIM900GetNetReg();
+    Test_Check("sim network registration", SIM900NetRegInit(NULL) == SIM900_OK &&
+               SIM900GetNetStat() == SIM900_NW_REGISTERED_HOME &&
+               Reg->Lac == 0x00C3 && Reg->Ci == 0x1A2B && Test_Urcs == 0);
+
+    Test_Begin(NULL, Sim_Ok);
+    Test_Check("sim delete", SIM900DeleteMsg(3) == SIM900_OK);
+
+    Test_Begin(NULL, Sim_Error);
+    Test_Check("sim delete, ERROR", SIM900DeleteMsg(3) == SIM900_FAIL);
+
+    Test_Begin(NULL, Sim_Ok);
+    Test_Check("sim read, URC before the reply", SIM900ReadMsg(3, Text, sizeof(Text)) == SIM900_OK &&
+               strcmp(Text, "How are you?") == 0 &&
+               Test_Urcs == 1 && strcmp(Test_Urc, "+CMTI: \"SM\",4") == 0);
+
+    Test_Begin(NULL, Sim_Ok);
+    Test_Check("sim read, empty slot", SIM900ReadMsg(5, Text, sizeof(Text)) == SIM900_MSG_EMPTY);
+
+    Test_Begin(NULL, Sim_Error);
+    Test_Check("sim read, SIM not ready", SIM900ReadMsg(3, Text, sizeof(Text)) == SIM900_SIM_NOT_READY);
+
+    Test_Begin(NULL, Sim_Ok);
+    Test_Check("sim send", SIM900SendMsg("+31641600986", "Hello", &Ref) == SIM900_OK && Ref == 42);
+
+    Test_Begin(NULL, Sim_Error);
+    Test_Check("sim send, refused", SIM900SendMsg("+31641600986", "Hello", &Ref) == SIM900_FAIL);
+
+    Test_Begin(NULL, Sim_Ok);
+    Mod_Print(&Mods[2], "\r\n+CMTI: \"SM\",7\r\n");
+    Test_Check("sim wait for message", SIM900WaitForMsg(&Id) == SIM900_OK && Id == 7);
+
+    Test_Begin(NULL, Sim_Ok);
+    Test_Check("sim wait for message, none", SIM900WaitForMsg(&Id) == SIM900_TIMEOUT);
+
+    Test_Begin(NULL, Sim_Ok);
+    Mod_Print(&Mods[2], "\r\n+CREG: 5,\"00C4\",\"0001\"\r\n\r\nRING\r\n\r\n+CLIP: \"+3164");
+    SIM900Poll();
+    Test_Check("sim poll", SIM900GetNetStat() == SIM900_NW_REGISTED_ROAMING &&
+               Test_Urcs == 1 && strcmp(Test_Urc, "RING") == 0 && Mod_Pending(&Mods[2]) != 0);
+
+    /* The rest of the line arrives with the reply of the next command */
+    Mod_Print(&Mods[2], "1600986\",145\r\n");
+    Test_Check("sim poll, line split by a command", SIM900Run(AT_SIM_AT, NULL) == SIM900_OK &&
+               Test_Urcs == 2 && strcmp(Test_Urc, "+CLIP: \"+31641600986\",145") == 0);
+
+    /* The deadline holds while bytes keep coming */
+    Test_Begin(NULL, Sim_Silent);
+    Mods[2].Flood = "\r\nRING\r\n";
+    Test_Check("sim timeout, module never silent", SIM900Run(AT_SIM_AT, NULL) == SIM900_TIMEOUT && Test_Urcs > 100);
+    Test_Begin(NULL, Sim_Ok);
+
+    SIM900SetURCHandler(NULL);
+}
+
+
+static uint64_t Bench_Clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/**
+ * @name    Bench_Run
+ * @brief   The function times Runs commands of each command set
+ *
+ * @author  Mehdi
+ */
+
+static void Bench_Run(uint32_t Runs)
+{
+    uint64_t t0, t1, t2;
+    uint32_t i, Fail = 0;
+
+    Test_Begin(Esp_Ok, Sim_Ok);
+
+    t0 = Bench_Clock();
+    for (i = 0; i < Runs; i++)
+        Fail += (ESP_Probe() != ESP8266_OK);
+    t1 = Bench_Clock();
+    for (i = 0; i < Runs; i++)
+        Fail += (SIM900Run(AT_SIM_CREG_Q, NULL) != SIM900_OK);
+    t2 = Bench_Clock();
+
+    printf("\nbench   %u runs: esp AT %6.0f ns, sim AT+CREG? (echo, report) %6.0f ns per command\n",
+           Runs, (double)(t1 - t0) / Runs, (double)(t2 - t1) / Runs);
+
+    if (Fail != 0)
+    {
+        printf("bench   %u commands failed\n", Fail);
+        Test_Errors++;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    uint32_t Runs = 100000;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            Runs = atoi(argv[i + 1]);
+    }
+
+    if (Runs == 0)
+    {
+        fprintf(stderr, "usage: %s [-n <bench runs>]\n", argv[0]);
+        return 2;
+    }
+
+    Test_Esp();
+    Test_FastJoin();
+    Test_Sim();
+    Bench_Run(Runs);
+
+    return Test_Errors ? 1 : 0;
+}
@@ -0,0 +1,375 @@
+/**
+ @file     AssetBench.c
+ @brief    Host benchmark of the static assets (Assets.h): UART bytes and
+           time of a page load through the ESP8266 driver, on a simulated
+           clock. A page load is the requests of a browser that opens the
+           control page: "/" and the assets it names (every asset of the
+           table, in order).
+
+           An emulated module on USART1 takes the commands and the data
+           of AT+CIPSEND; each byte in either direction costs its time on
+           the wire at the given baud rate, and the module answers each
+           command after a fixed turnaround. Three rows:
+
+             - plain:       the files of the web directory, uncompressed,
+                            through the same path (what the UART carried
+                            when the page went out with ESP_SendHTTPResponse);
+             - gzip:        the table of AssetData.c (Content-Encoding: gzip);
+             - revalidate:  the same requests with If-None-Match, answered
+                            with 304 Not Modified.
+
+           Each response is checked (status, Content-Length, the body is
+           the stored one, no body in a 304); the tool exits with 1 when
+           one is wrong.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o AssetBench tools/AssetBench.c tools/host/HostSim.c \
+                   Assets.c AssetData.c ESP8266.c ATCmd.c ATEngine.c \
+                   ATResp.c LinkSup.c FastJoin.c StatusSink.c AuxLib.c \
+                   BufPool.c
+
+           Usage:
+               AssetBench [-w <web directory>] [-b <baud>] [-t <turnaround ms>]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ESP8266.h"
+#include "Assets.h"
+#include "TimeBase.h"
+#include "HostSim.h"
+
+
+#define SIM_TX_SIZE					16384		// Data taken by the module for one response
+#define BENCH_ASSETS				16
+
+typedef struct
+{
+    char        Line[64];
+    uint16_t    LineLen;
+    uint16_t    Need;			// Data bytes of AT+CIPSEND left
+    uint16_t    SendLen;
+
+    uint8_t     Tx[SIM_TX_SIZE];	// Data of the CIPSENDs of one response
+    uint32_t    TxLen;
+    uint32_t    Sends;
+    uint32_t    Closes;
+    uint32_t    Unknown;
+
+    uint64_t    UartBytes;		// Both directions
+    uint32_t    Commands;
+} Bench_Module;
+
+typedef struct
+{
+    uint64_t UartBytes;
+    uint64_t Ns;
+    uint32_t Sends;
+    uint32_t BodyBytes;
+} Bench_Load;
+
+extern USART_TypeDef* USART_ESP;
+
+static uint64_t     Byte_Ns;			// Time of one byte on the wire (8N1)
+static uint64_t     Turn_Ns;			// Turnaround of the module per command
+static Bench_Module Mod;
+static uint32_t     Bench_Errors;
+
+static Asset        Plain[BENCH_ASSETS];
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+/* The bytes to the driver are charged their wire time when the module sends them */
+static void Mod_Reply(const char* Text)
+{
+    uint32_t Len = strlen(Text);
+
+    Sim_Now += Turn_Ns + Len * Byte_Ns;
+    Mod.UartBytes += Len;
+
+    Mod_Print(Text);
+}
+
+
+void Mod_Tick(void)
+{
+}
+
+
+static void Mod_Line(void)
+{
+    char Reply[96];
+    const char* p;
+
+    Mod.Commands++;
+
+    if (strncmp(Mod.Line,"AT+CIPSEND=",11) == 0 && (p = strchr(Mod.Line,',')) != NULL)
+    {
+        Mod.SendLen = Mod.Need = atoi(p + 1);
+        Mod.Sends++;
+        Mod_Reply("\r\nOK\r\n> ");
+    } else if (strncmp(Mod.Line,"AT+CIPCLOSE=",12) == 0)
+    {
+        snprintf(Reply,sizeof(Reply),"%.8s,CLOSED\r\n\r\nOK\r\n",Mod.Line + 12);
+        Mod_Reply(Reply);
+        Mod.Closes++;
+    } else
+    {
+        Mod.Unknown++;
+        Mod_Reply("\r\nERROR\r\n");
+    }
+}
+
+
+void Mod_Rx(uint8_t c)
+{
+    char Reply[48];
+
+    Sim_Now += Byte_Ns;
+    Mod.UartBytes++;
+
+    if (Mod.Need != 0)
+    {
+        if (Mod.TxLen < SIM_TX_SIZE)
+            Mod.Tx[Mod.TxLen++] = c;
+
+        if (--Mod.Need == 0)
+        {
+            snprintf(Reply,sizeof(Reply),"\r\nRecv %u bytes\r\n\r\nSEND OK\r\n",Mod.SendLen);
+            Mod_Reply(Reply);
+        }
+        return;
+    }
+
+    /* The command ends with "\r\n": the data follows the '\n' */
+    if (c == '\r')
+        return;
+
+    if (c != '\n')
+    {
+        if (Mod.LineLen < sizeof(Mod.Line) - 1)
+            Mod.Line[Mod.LineLen++] = c;
+        return;
+    }
+
+    Mod.Line[Mod.LineLen] = '\0';
+    Mod.LineLen = 0;
+    Mod_Line();
+}
+
+
+/***************************************************
+				B E N C H
+****************************************************/
+
+/**
+ * @name    Bench_Plain
+ * @brief   The function loads the files of the web directory as the
+ *              uncompressed assets, in the order of the table
+ *
+ * @author  Mehdi
+ */
+
+static int Bench_Plain(const char* Dir)
+{
+    char Path[256];
+    FILE* f;
+    uint8_t* Data;
+    long Len;
+
+    if (Asset_Count > BENCH_ASSETS)
+        return 0;
+
+    for (uint8_t i = 0; i < Asset_Count; i++)
+    {
+        snprintf(Path,sizeof(Path),"%s%s",Dir,Asset_Table[i].Path);
+        if ((f = fopen(Path,"rb")) == NULL)
+        {
+            fprintf(stderr,"AssetBench: %s: cannot open\n",Path);
+            return 0;
+        }
+
+        fseek(f,0,SEEK_END);
+        Len = ftell(f);
+        fseek(f,0,SEEK_SET);
+        Data = malloc(Len);
+        if (Data == NULL || fread(Data,1,Len,f) != (size_t)Len)
+        {
+            fclose(f);
+            return 0;
+        }
+        fclose(f);
+
+        Plain[i] = Asset_Table[i];
+        Plain[i].Data = Data;
+        Plain[i].Len = Len;
+        Plain[i].Gzip = 0;
+
+        if ((uint32_t)Len != Asset_Table[i].RawLen)
+            fprintf(stderr,"AssetBench: %s: %ld bytes, the table was built from %lu (run tools/mkassets.py)\n",
+                    Path,Len,(unsigned long)Asset_Table[i].RawLen);
+    }
+
+    return 1;
+}
+
+
+/**
+ * @name    Bench_Get
+ * @brief   The function makes one request and checks the response
+ *
+ * @author  Mehdi
+ *
+ * @param	A: the asset to send (plain), or NULL to serve it from the table
+ * @param	Want: the asset the response must carry
+ * @param	Revalidate: 1 to send If-None-Match with the ETag
+ */
+
+static void Bench_Get(const Asset* A, const Asset* Want, uint8_t Revalidate, Bench_Load* Load)
+{
+    char Req[256], Ipd[320], Hdr[512];
+    uint8_t Data[256];
+    uint8_t Link;
+    int16_t n;
+    int8_t res;
+    uint64_t Start, Bytes;
+    const char *End, *p;
+    uint32_t Body;
+
+    n = snprintf(Req,sizeof(Req),"GET %s HTTP/1.1\r\nHost: node\r\nAccept-Encoding: gzip, deflate\r\n",
+                 strcmp(Want->Path,ASSET_INDEX) == 0 ? "/" : Want->Path);
+    if (Revalidate)
+        n += snprintf(Req + n,sizeof(Req) - n,"If-None-Match: %s\r\n",Want->ETag);
+    snprintf(Req + n,sizeof(Req) - n,"\r\n");
+
+    Mod.TxLen = Mod.Sends = Mod.Closes = Mod.Unknown = 0;
+    Start = Sim_Now;
+    Bytes = Mod.UartBytes;
+
+    snprintf(Ipd,sizeof(Ipd),"\r\n+IPD,0,%u:%s",(unsigned)strlen(Req),Req);
+    Mod_Reply(Ipd);
+
+    n = ESP_ReadIPD(&Link,Data,sizeof(Data),1000);
+    if (n < 0)
+        res = n;
+    else if (A != NULL)
+        res = Asset_Send(Link,A,(const char*)Data,n);
+    else
+        res = Asset_Serve(Link,(const char*)Data,n);
+
+    Load->Ns += Sim_Now - Start;
+    Load->UartBytes += Mod.UartBytes - Bytes;
+    Load->Sends += Mod.Sends;
+
+    /* Status, headers, body */
+    End = (const char*)Mod.Tx + Mod.TxLen;
+    p = NULL;
+    for (const char* q = (const char*)Mod.Tx; q + 4 <= End; q++)
+        if (memcmp(q,"\r\n\r\n",4) == 0)
+        {
+            p = q + 4;
+            break;
+        }
+
+    if (res != ESP8266_OK || p == NULL || Mod.Closes != 1 || Mod.Unknown != 0 || p - (const char*)Mod.Tx >= (long)sizeof(Hdr))
+    {
+        printf("  %-14s no response\n",Want->Path);
+        Bench_Errors++;
+        return;
+    }
+
+    snprintf(Hdr,sizeof(Hdr),"%.*s",(int)(p - (const char*)Mod.Tx),(const char*)Mod.Tx);
+    Body = End - p;
+    Load->BodyBytes += Body;
+
+    if (Revalidate)
+    {
+        if (strncmp(Hdr,"HTTP/1.1 304 ",13) != 0 || Body != 0 || strstr(Hdr,Want->ETag) == NULL)
+        {
+            printf("  %-14s bad 304\n",Want->Path);
+            Bench_Errors++;
+        }
+        return;
+    }
+
+    A = (A != NULL) ? A : Want;
+    snprintf(Req,sizeof(Req),"Content-Length: %lu\r\n",(unsigned long)A->Len);
+    if (strncmp(Hdr,"HTTP/1.1 200 ",13) != 0 || strstr(Hdr,Req) == NULL ||
+        (strstr(Hdr,"Content-Encoding: gzip\r\n") != NULL) != A->Gzip ||
+        Body != A->Len || memcmp(p,A->Data,Body) != 0 ||
+        (A->Gzip && (A->Data[0] != 0x1f || A->Data[1] != 0x8b)))
+    {
+        printf("  %-14s bad 200\n",Want->Path);
+        Bench_Errors++;
+    }
+}
+
+
+static Bench_Load Bench_Row(const char* Name, uint8_t UsePlain, uint8_t Revalidate, const Bench_Load* Base)
+{
+    Bench_Load Load = { 0 };
+
+    for (uint8_t i = 0; i < Asset_Count; i++)
+        Bench_Get(UsePlain ? &Plain[i] : NULL,&Asset_Table[i],Revalidate,&Load);
+
+    printf("%-12s %8lu %10lu %8lu %10.1f",Name,(unsigned long)Load.BodyBytes,(unsigned long)Load.UartBytes,
+           (unsigned long)Load.Sends,Load.Ns / 1e6);
+    if (Base != NULL)
+        printf("   %5.1f%% %5.1f%%",100.0 * Load.UartBytes / Base->UartBytes,100.0 * Load.Ns / Base->Ns);
+    printf("\n");
+
+    return Load;
+}
+
+
+int main(int argc, char** argv)
+{
+    const char* Dir = "web";
+    uint32_t Baud = 115200, TurnMs = 2;
+    Bench_Load Base;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-w") == 0)
+            Dir = argv[i + 1];
+        else if (strcmp(argv[i], "-b") == 0)
+            Baud = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            TurnMs = atoi(argv[i + 1]);
+    }
+
+    if (Baud == 0 || !(argc % 2))
+    {
+        fprintf(stderr, "usage: %s [-w <web directory>] [-b <baud>] [-t <turnaround ms>]\n", argv[0]);
+        return 2;
+    }
+
+    if (!Bench_Plain(Dir))
+        return 2;
+
+    Byte_Ns = 10ULL * 1000000000ULL / Baud;
+    Turn_Ns = TurnMs * 1000000ULL;
+    USART_ESP = USART1;
+
+    printf("page load: %u assets, %lu baud, %lu ms turnaround\n",Asset_Count,(unsigned long)Baud,(unsigned long)TurnMs);
+    printf("%-12s %8s %10s %8s %10s   %s\n","row","body","uart bytes","CIPSENDs","ms","vs plain (bytes, time)");
+
+    Base = Bench_Row("plain",1,0,NULL);
+    Bench_Row("gzip",0,0,&Base);
+    Bench_Row("revalidate",0,1,&Base);
+
+    return Bench_Errors ? 1 : 0;
+}
@@ -0,0 +1,399 @@
+/**
+ @file     EspSetTest.c
+ @brief    Host check of the start of the ESP8266 (ESP_SET, ESP_QueryState)
+           against an emulated module on USART1. The module keeps its
+           state as the part does across a restart of the uC: Wi-Fi mode,
+           association, multiple connections and server. It answers the
+           queries from that state, applies the commands that change it
+           (refusing AT+CIPMUX while the server runs, as the firmware
+           does), and takes the time a join takes.
+
+           Cases:
+             - cold start: a module out of the box is configured with
+               every command, and the parameters of the join are learned;
+             - warm start: a configured module is only queried, its link
+               is kept and the start takes a fraction of a cold one;
+             - warm start with the server on and a single connection: the
+               server is stopped to change the mode, then started;
+             - firmware without AT+CIPSERVER?: the server is started;
+             - a module joined to another AP, or that lost its AP: joined;
+             - a module that does not answer: ESP_SET gives up once the
+               link supervisor does, in bounded time.
+
+           The tool exits with 1 when a case fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o EspSetTest tools/EspSetTest.c tools/host/HostSim.c \
+                   ESP8266.c ATCmd.c ATEngine.c ATResp.c LinkSup.c FastJoin.c \
+                   StatusSink.c AuxLib.c BufPool.c
+
+           Usage:
+               EspSetTest [-v]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ESP8266.h"
+#include "FastJoin.h"
+#include "LinkSup.h"
+#include "TimeBase.h"
+#include "HostSim.h"
+
+
+#define SIM_LOG						32			// Commands kept per case
+
+#define MOD_CMD_MS					5			// A query or a setting
+#define MOD_JOIN_MS					3000		// AT+CWJAP: scan, association, DHCP
+#define MOD_FAST_JOIN_MS			400			// AT+CWJAP_CUR: known BSSID, static address
+
+#define TEST_BSSID					"a0:b1:c2:d3:e4:f5"
+
+typedef struct
+{
+    /* What the module keeps across a restart of the uC */
+    uint8_t   Mode;				// 1 station, 2 access point, 3 both
+    uint8_t   Joined;			// 0, 1 ESP_AP_SSID, 2 another AP
+    uint8_t   Mux;
+    uint8_t   Server;
+    uint8_t   OldFirmware;		// No AT+CIPSERVER?
+    uint8_t   Silent;			// Answers nothing
+
+    char      Line[160];
+    uint16_t  LineLen;
+    char      Log[SIM_LOG][160];	// Commands of the case
+    uint8_t   Logged;
+    uint32_t  Unknown;
+} Test_Module;
+
+static Test_Module Mod;
+static uint32_t    Test_Errors;
+static uint8_t     Test_Verbose;
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+void Mod_Tick(void)
+{
+}
+
+
+/* The module state as AT+CIPSTATUS gives it */
+static uint8_t Mod_Status(void)
+{
+    if (Mod.Joined == 0)
+        return 5;
+
+    return 2;
+}
+
+
+/**
+ * @name    Mod_Line
+ * @brief   The function answers a command line from the module state
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Line(void)
+{
+    char Reply[160];
+    const char* Ok = "\r\nOK\r\n";
+    const char* Error = "\r\nERROR\r\n";
+
+    if (Test_Verbose)
+        printf("    > %s\n",Mod.Line);
+
+    if (Mod.Logged < SIM_LOG)
+        strcpy(Mod.Log[Mod.Logged++],Mod.Line);
+
+    if (Mod.Silent)
+        return;
+
+    if (strcmp(Mod.Line,"AT") == 0)
+    {
+        Mod_Later(MOD_CMD_MS,Ok);
+    } else if (strcmp(Mod.Line,"AT+CWMODE?") == 0)
+    {
+        snprintf(Reply,sizeof(Reply),"+CWMODE:%u\r\n\r\nOK\r\n",Mod.Mode);
+        Mod_Later(MOD_CMD_MS,Reply);
+    } else if (strcmp(Mod.Line,"AT+CWMODE=1") == 0)
+    {
+        Mod.Mode = 1;
+        Mod_Later(MOD_CMD_MS,Ok);
+    } else if (strcmp(Mod.Line,"AT+CIPSTATUS") == 0)
+    {
+        snprintf(Reply,sizeof(Reply),"STATUS:%u\r\n\r\nOK\r\n",Mod_Status());
+        Mod_Later(MOD_CMD_MS,Reply);
+    } else if (strcmp(Mod.Line,"AT+CWJAP?") == 0 || strcmp(Mod.Line,"AT+CWJAP_CUR?") == 0)
+    {
+        if (Mod.Joined == 0)
+            Mod_Later(MOD_CMD_MS,"No AP\r\n\r\nOK\r\n");
+        else
+        {
+            snprintf(Reply,sizeof(Reply),"%s:\"%s\",\"" TEST_BSSID "\",6,-58\r\n\r\nOK\r\n",
+                     Mod.Line[8] == '_' ? "+CWJAP_CUR" : "+CWJAP",(Mod.Joined == 1) ? ESP_AP_SSID : "Neighbour");
+            Mod_Later(MOD_CMD_MS,Reply);
+        }
+    } else if (strcmp(Mod.Line,"AT+CWJAP=\"" ESP_AP_SSID "\",\"" ESP_AP_PWD "\"") == 0)
+    {
+        if (Mod.Mode == 2)
+        {
+            Mod_Later(MOD_CMD_MS,Error);
+            return;
+        }
+        Mod.Joined = 1;
+        Mod_Later(MOD_JOIN_MS,"WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n");
+    } else if (strcmp(Mod.Line,"AT+CIPSTA_CUR?") == 0)
+    {
+        Mod_Later(MOD_CMD_MS,"+CIPSTA_CUR:ip:\"10.0.0.7\"\r\n+CIPSTA_CUR:gateway:\"10.0.0.1\"\r\n"
+                             "+CIPSTA_CUR:netmask:\"255.255.255.0\"\r\n\r\nOK\r\n");
+    } else if (strncmp(Mod.Line,"AT+CWLAP=\"" ESP_AP_SSID "\",\"" TEST_BSSID "\",",
+                     sizeof("AT+CWLAP=\"" ESP_AP_SSID "\",\"" TEST_BSSID "\",") - 1) == 0)
+    {
+        Mod_Later(MOD_CMD_MS * 20,"+CWLAP:(3,\"" ESP_AP_SSID "\",-58,\"" TEST_BSSID "\",6)\r\n\r\nOK\r\n");
+    } else if (strncmp(Mod.Line,"AT+CIPSTA_CUR=",14) == 0 || strcmp(Mod.Line,"AT+CWDHCP_CUR=1,1") == 0)
+    {
+        Mod_Later(MOD_CMD_MS,Ok);
+    } else if (strcmp(Mod.Line,"AT+CWJAP_CUR=\"" ESP_AP_SSID "\",\"" ESP_AP_PWD "\",\"" TEST_BSSID "\"") == 0)
+    {
+        Mod.Joined = 1;
+        Mod_Later(MOD_FAST_JOIN_MS,"WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n");
+    } else if (strcmp(Mod.Line,"AT+PING=\"10.0.0.1\"") == 0)
+    {
+        Mod_Later(MOD_CMD_MS,"+5\r\n\r\nOK\r\n");
+    } else if (strcmp(Mod.Line,"AT+CIFSR") == 0)
+    {
+        snprintf(Reply,sizeof(Reply),"+CIFSR:STAIP,\"%s\"\r\n+CIFSR:STAMAC,\"5c:cf:7f:00:00:01\"\r\n\r\nOK\r\n",
+                 (Mod.Joined != 0) ? "10.0.0.7" : "0.0.0.0");
+        Mod_Later(MOD_CMD_MS,Reply);
+    } else if (strcmp(Mod.Line,"AT+CIPMUX?") == 0)
+    {
+        snprintf(Reply,sizeof(Reply),"+CIPMUX:%u\r\n\r\nOK\r\n",Mod.Mux);
+        Mod_Later(MOD_CMD_MS,Reply);
+    } else if (strcmp(Mod.Line,"AT+CIPMUX=1") == 0)
+    {
+        /* The firmware refuses a change of mode while the server runs */
+        if (Mod.Server)
+            Mod_Later(MOD_CMD_MS,"link is builded\r\n\r\nERROR\r\n");
+        else
+        {
+            Mod.Mux = 1;
+            Mod_Later(MOD_CMD_MS,Ok);
+        }
+    } else if (strcmp(Mod.Line,"AT+CIPSERVER?") == 0 && !Mod.OldFirmware)
+    {
+        snprintf(Reply,sizeof(Reply),"+CIPSERVER:%u%s\r\n\r\nOK\r\n",Mod.Server,Mod.Server ? ",80" : "");
+        Mod_Later(MOD_CMD_MS,Reply);
+    } else if (strcmp(Mod.Line,"AT+CIPSERVER?") == 0)
+    {
+        Mod_Later(MOD_CMD_MS,Error);
+    } else if (strcmp(Mod.Line,"AT+CIPSERVER=1,80") == 0)
+    {
+        if (Mod.Mux != 1)
+            Mod_Later(MOD_CMD_MS,Error);
+        else
+        {
+            Mod.Server = 1;
+            Mod_Later(MOD_CMD_MS,Ok);
+        }
+    } else if (strcmp(Mod.Line,"AT+CIPSERVER=0") == 0)
+    {
+        Mod.Server = 0;
+        Mod_Later(MOD_CMD_MS,Ok);
+    } else
+    {
+        Mod.Unknown++;
+        Mod_Later(MOD_CMD_MS,Error);
+    }
+}
+
+
+void Mod_Rx(uint8_t c)
+{
+    if (c == '\n')
+        return;
+
+    if (c != '\r')
+    {
+        if (Mod.LineLen < sizeof(Mod.Line) - 1)
+            Mod.Line[Mod.LineLen++] = c;
+        return;
+    }
+
+    Mod.Line[Mod.LineLen] = '\0';
+    Mod.LineLen = 0;
+    Mod_Line();
+}
+
+
+/***************************************************
+				C A S E S
+****************************************************/
+
+static void Test_Check(const char* Name, int Ok)
+{
+    Ok = Ok && Mod.Unknown == 0;
+
+    printf("%-44s %s\n", Name, Ok ? "ok" : "FAIL");
+
+    if (!Ok)
+        Test_Errors++;
+}
+
+
+/* A restart of the uC: the module keeps its state, the driver has none */
+static void Test_Begin(uint8_t Mode, uint8_t Joined, uint8_t Mux, uint8_t Server)
+{
+    Mod.Mode = Mode;
+    Mod.Joined = Joined;
+    Mod.Mux = Mux;
+    Mod.Server = Server;
+    Mod.OldFirmware = 0;
+    Mod.Silent = 0;
+    Mod.Logged = 0;
+    Mod.Unknown = 0;
+    Mod.LineLen = 0;
+    Mod_Flush();
+}
+
+
+/* Number of commands of the case that start with Prefix */
+static uint8_t Test_Sent(const char* Prefix)
+{
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < Mod.Logged; i++)
+        if (strncmp(Mod.Log[i], Prefix, strlen(Prefix)) == 0)
+            n++;
+
+    return n;
+}
+
+
+/* Index of the first command of the case that starts with Prefix */
+static int Test_Order(const char* Prefix)
+{
+    for (uint8_t i = 0; i < Mod.Logged; i++)
+        if (strncmp(Mod.Log[i], Prefix, strlen(Prefix)) == 0)
+            return i;
+
+    return SIM_LOG;
+}
+
+
+static int Test_Configured(void)
+{
+    return Mod.Mode == 1 && Mod.Joined == 1 && Mod.Mux == 1 && Mod.Server == 1;
+}
+
+
+static void Test_Query(void)
+{
+    ESP_State State;
+
+    Test_Begin(2, 0, 0, 0);
+    Test_Check("query, module out of the box", ESP_QueryState(&State) == ESP8266_OK &&
+               State.Mode == 2 && !State.Joined && State.Status == 5 && State.Mux == 0 && State.Server == 0);
+
+    Test_Begin(1, 1, 1, 1);
+    Test_Check("query, module configured", ESP_QueryState(&State) == ESP8266_OK &&
+               State.Mode == 1 && State.Joined && State.Status == 2 && State.Mux == 1 && State.Server == 1);
+
+    Test_Begin(1, 2, 1, 1);
+    Test_Check("query, joined to another AP", ESP_QueryState(&State) == ESP8266_OK && !State.Joined);
+
+    Test_Begin(1, 1, 1, 0);
+    Mod.OldFirmware = 1;
+    Test_Check("query, no AT+CIPSERVER?", ESP_QueryState(&State) == ESP8266_OK &&
+               State.Mux == 1 && State.Server == 0);
+
+    Test_Begin(1, 1, 1, 1);
+    Mod.Silent = 1;
+    Test_Check("query, no reply", ESP_QueryState(&State) != ESP8266_OK);
+}
+
+
+static void Test_Set(void)
+{
+    uint32_t Cold, Warm;
+    uint64_t Start;
+
+    memset(Host_Flash, 0xFF, HOST_FLASH_SIZE);
+
+    Test_Begin(2, 0, 0, 0);
+    Test_Check("cold start", ESP_SET(USART1) == ESP8266_OK && Test_Configured());
+    Cold = ESP_GetBootTime();
+    Test_Check("  every setting sent once", Test_Sent("AT+CWMODE=1") == 1 &&
+               Test_Sent("AT+CWJAP=") == 1 && Test_Sent("AT+CIPMUX=1") == 1 &&
+               Test_Sent("AT+CIPSERVER=1,80") == 1 && Test_Sent("AT+CIPSERVER=0") == 0);
+    Test_Check("  join learned", FastJoin_GetTiming()->Mode == FASTJOIN_MODE_FULL &&
+               Test_Sent("AT+CIPSTA_CUR?") == 1);
+
+    Test_Begin(1, 1, 1, 1);
+    Test_Check("warm start", ESP_SET(USART1) == ESP8266_OK && Test_Configured());
+    Warm = ESP_GetBootTime();
+    Test_Check("  queries only, link kept", Test_Sent("AT+CWMODE=") == 0 && Test_Sent("AT+CWJAP=") == 0 &&
+               Test_Sent("AT+CWLAP") == 0 && Test_Sent("AT+CIPMUX=") == 0 && Test_Sent("AT+CIPSERVER=") == 0);
+    Test_Check("  faster than a cold start", Warm * 10 < Cold);
+
+    Test_Begin(1, 1, 0, 1);
+    Test_Check("warm start, server on, one connection", ESP_SET(USART1) == ESP8266_OK && Test_Configured());
+    Test_Check("  server stopped to change the mode",
+               Test_Order("AT+CIPSERVER=0") < Test_Order("AT+CIPMUX=1") &&
+               Test_Order("AT+CIPMUX=1") < Test_Order("AT+CIPSERVER=1,80") && Test_Sent("AT+CWJAP=") == 0);
+
+    Test_Begin(1, 1, 1, 0);
+    Mod.OldFirmware = 1;
+    Test_Check("warm start, no AT+CIPSERVER?", ESP_SET(USART1) == ESP8266_OK && Test_Configured() &&
+               Test_Sent("AT+CIPSERVER=1,80") == 1 && Test_Sent("AT+CIPMUX=1") == 0);
+
+    /* The record of the cold start is not valid for a module on another AP */
+    memset(Host_Flash, 0xFF, HOST_FLASH_SIZE);
+    Test_Begin(1, 2, 1, 1);
+    Test_Check("warm start, joined to another AP", ESP_SET(USART1) == ESP8266_OK && Test_Configured() &&
+               Test_Sent("AT+CWJAP=") == 1 && Test_Sent("AT+CWMODE=") == 0);
+
+    /* The record of the previous case is valid: the fast join is taken */
+    Test_Begin(1, 0, 1, 1);
+    Test_Check("warm start, AP lost", ESP_SET(USART1) == ESP8266_OK && Test_Configured() &&
+               Test_Sent("AT+CWJAP_CUR=") == 1 && Test_Sent("AT+CWJAP=") == 0 &&
+               FastJoin_GetTiming()->Mode == FASTJOIN_MODE_FAST);
+
+    Test_Begin(1, 1, 1, 1);
+    Mod.Silent = 1;
+    Start = Sim_Now;
+    Test_Check("no reply: gives up", ESP_SET(USART1) == ESP8266_FAIL &&
+               LinkSup_GetMetrics()->GiveUps != 0);
+    Test_Check("  in bounded time", Sim_Now - Start < 120ULL * 1000000000ULL);
+
+    if (Test_Verbose)
+        printf("    cold start %lu ms, warm start %lu ms, gave up after %lu ms\n",(unsigned long)Cold,
+               (unsigned long)Warm,(unsigned long)((Sim_Now - Start) / 1000000));
+}
+
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i],"-v") == 0)
+            Test_Verbose++;
+
+    Test_Query();
+    Test_Set();
+
+    printf("\n%s\n",Test_Errors ? "FAILED" : "all ok");
+
+    return Test_Errors ? 1 : 0;
+}
@@ -0,0 +1,636 @@
+/**
+ @file     FlowBench.c
+ @brief    Host check of the AT+CIPSEND flow control of the ESP8266
+           driver against a model of the module, on a simulated clock:
+
+             - the module parses a command for a while before it prints
+               the "> " prompt; bytes that arrive meanwhile are dropped
+               and answered with "busy p...";
+             - the data goes to a small UART FIFO that the module drains
+               at a limited rate into its send buffer; a byte that finds
+               the FIFO full is lost (overrun), unless RTS/CTS is on, in
+               which case the module holds our CTS and the USART waits;
+             - the send buffer empties at the rate of the air link; an
+               AT+CIPSEND that does not fit is refused with "busy s...".
+
+           A packet whose bytes were lost ends with "SEND FAIL" (the real
+           module would wait for the missing bytes, then take the next
+           command as data).
+
+           Each row sends the same packets in one mode: the data right
+           after the command (no prompt, as the driver used to), through
+           ESP_UdpSend at 115200 baud, and at full baud without and with
+           RTS/CTS (ESP_SetUart). The tool exits with 1 when a packet is
+           lost in a row that uses the prompt at 115200 or RTS/CTS.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o FlowBench tools/FlowBench.c ESP8266.c ATCmd.c \
+                   LinkSup.c FastJoin.c StatusSink.c AuxLib.c BufPool.c ATResp.c \
+                   ATEngine.c
+
+           Usage:
+               FlowBench [-n <packets>] [-s <bytes>] [-f <FIFO bytes>]
+                   [-d <FIFO drain, bytes/s>] [-a <air rate, bytes/s>]
+                   [-B <full baud>]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+#include "tm_stm32_usart.h"
+#include "tm_stm32_delay.h"
+#include "tm_stm32_hd44780.h"
+
+#include "ESP8266.h"
+#include "ATCmd.h"
+#include "Transport.h"
+#include "TimeBase.h"
+
+
+#define SIM_STEP_NS					10000		// Clock step of a poll of the clock
+#define SIM_LATENCY_NS				1000000		// Command parsing, before the reply
+#define SIM_SEND_BUF				2920		// Send buffer of the module (two TCP segments)
+#define SIM_RX_SIZE					4096
+#define SIM_OUT_MAX					8
+
+// Module states
+#define MOD_CMD						0
+#define MOD_PARSE					1			// Parsing AT+CIPSEND, no prompt yet
+#define MOD_DATA					2			// Taking the data
+#define MOD_DRAIN					3			// All data received, the FIFO drains
+
+typedef struct
+{
+    uint64_t Time;
+    char     Text[32];
+} Sim_Out;
+
+typedef struct
+{
+    uint8_t  State;
+    uint8_t  Flow;				// ESP_FLOW_xxx set by AT+UART_CUR
+    uint8_t  BusyP;				// "busy p..." printed for this command
+    char     Line[64];
+    uint16_t LineLen;
+    uint16_t Need;				// Data bytes of the current AT+CIPSEND
+    uint16_t Got;				// Data bytes arrived, lost ones included
+    uint16_t Lost;
+    uint64_t ParseEnd;
+
+    uint32_t Fifo;				// Bytes in the UART FIFO
+    uint64_t FifoCredit;		// ns of drain time not used yet
+    uint32_t Sending;			// Bytes in the send buffer
+    uint64_t AirCredit;
+
+    Sim_Out  Out[SIM_OUT_MAX];
+    uint8_t  Outs;
+} Sim_Module;
+
+typedef struct
+{
+    uint32_t Ok;
+    uint32_t Busy;				// ESP8266_BUSY after every retry
+    uint32_t Fail;
+    uint32_t Timeout;
+    uint32_t BusyS;				// "busy s..." printed
+    uint32_t BusyP;				// "busy p..." printed
+    uint32_t Dropped;			// Data bytes sent before the prompt
+    uint32_t Overrun;			// Data bytes lost in the FIFO
+    uint64_t CtsWaitNs;			// USART held by CTS
+} Sim_Stat;
+
+USART_TypeDef Host_USART[7] = {{.Port = 0},{.Port = 1},{.Port = 2},{.Port = 3},
+                               {.Port = 4},{.Port = 5},{.Port = 6}};
+uint32_t SystemCoreClock = 168000000;
+uint8_t Host_Flash[HOST_FLASH_SIZE];
+
+extern USART_TypeDef* USART_ESP;
+
+static uint64_t   Sim_Now;				// ns
+static uint32_t   Sim_Baud;
+static uint32_t   Sim_FifoSize = 128;
+static uint32_t   Sim_DrainRate = 40000;
+static uint32_t   Sim_AirRate = 12000;
+static Sim_Module Mod;
+static Sim_Stat   Stat;
+
+static uint8_t    Sim_Rx[SIM_RX_SIZE];	// Bytes of the module, to the driver
+static uint16_t   Sim_RxHead, Sim_RxTail;
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+static void Mod_Print(uint64_t Delay, const char* Text)
+{
+    if (Mod.Outs == SIM_OUT_MAX)
+        return;
+
+    Mod.Out[Mod.Outs].Time = Sim_Now + Delay;
+    snprintf(Mod.Out[Mod.Outs].Text, sizeof(Mod.Out[0].Text), "%s", Text);
+    Mod.Outs++;
+}
+
+
+static void Mod_Line(void)
+{
+    unsigned Link, Len;
+    unsigned long Baud;
+    unsigned Flow;
+
+    if (sscanf(Mod.Line, "AT+CIPSEND=%u,%u", &Link, &Len) == 2)
+    {
+        if (Mod.Sending + Len > SIM_SEND_BUF)
+        {
+            Stat.BusyS++;
+            Mod_Print(SIM_LATENCY_NS, "busy s...\r\n");
+            return;
+        }
+        Mod.State = MOD_PARSE;
+        Mod.ParseEnd = Sim_Now + SIM_LATENCY_NS;
+        Mod.Need = Len;
+        Mod.Got = Mod.Lost = 0;
+        Mod.BusyP = 0;
+        Mod_Print(SIM_LATENCY_NS, "\r\nOK\r\n> ");
+        return;
+    }
+
+    if (sscanf(Mod.Line, "AT+UART_CUR=%lu,8,1,0,%u", &Baud, &Flow) == 2)
+    {
+        Mod.Flow = Flow;
+        Sim_Baud = Baud;
+    }
+
+    Mod_Print(SIM_LATENCY_NS, "\r\nOK\r\n");
+}
+
+
+/**
+ * @name    Mod_Rx
+ * @brief   The function takes one byte from the driver
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Rx(uint8_t c)
+{
+    switch (Mod.State)
+    {
+    case MOD_CMD:
+        if (Mod.LineLen < sizeof(Mod.Line) - 1)
+            Mod.Line[Mod.LineLen++] = c;
+        if (c == '\n')
+        {
+            Mod.Line[Mod.LineLen] = '\0';
+            Mod.LineLen = 0;
+            Mod_Line();
+        }
+        break;
+
+    case MOD_PARSE:
+    case MOD_DRAIN:
+        Stat.Dropped++;
+        if (!Mod.BusyP)
+        {
+            Stat.BusyP++;
+            Mod.BusyP = 1;
+            Mod_Print(0, "busy p...\r\n");
+        }
+        /* The data will never be complete */
+        if (Mod.State == MOD_PARSE)
+            Mod.Lost++;
+        break;
+
+    case MOD_DATA:
+        if (Mod.Fifo < Sim_FifoSize)
+            Mod.Fifo++;
+        else
+        {
+            Stat.Overrun++;
+            Mod.Lost++;
+        }
+        if (++Mod.Got == Mod.Need)
+            Mod.State = MOD_DRAIN;
+        break;
+    }
+}
+
+
+/**
+ * @name    Sim_Advance
+ * @brief   The function moves the clock: the FIFO drains into the send
+ *              buffer, the send buffer to the air, and the replies that
+ *              are due reach the driver
+ *
+ * @author  Mehdi
+ */
+
+static void Sim_Advance(uint64_t ns)
+{
+    uint64_t Step;
+    uint32_t n;
+
+    while (ns != 0)
+    {
+        Step = (ns < SIM_STEP_NS) ? ns : SIM_STEP_NS;
+        ns -= Step;
+        Sim_Now += Step;
+
+        if (Mod.State == MOD_PARSE && Sim_Now >= Mod.ParseEnd)
+        {
+            Mod.State = MOD_DATA;
+            /* Bytes sent before the prompt count against the packet */
+            Mod.Got = Mod.Lost;
+            if (Mod.Got >= Mod.Need)
+                Mod.State = MOD_DRAIN;
+        }
+
+        Mod.FifoCredit += Step;
+        n = Mod.FifoCredit * Sim_DrainRate / 1000000000;
+        if (n > Mod.Fifo)
+            n = Mod.Fifo;
+        if (n > SIM_SEND_BUF - Mod.Sending)
+            n = SIM_SEND_BUF - Mod.Sending;
+        Mod.Fifo -= n;
+        Mod.Sending += n;
+        Mod.FifoCredit = (Mod.Fifo == 0) ? 0 : Mod.FifoCredit - (uint64_t)n * 1000000000 / Sim_DrainRate;
+
+        Mod.AirCredit += Step;
+        n = Mod.AirCredit * Sim_AirRate / 1000000000;
+        if (n > Mod.Sending)
+            n = Mod.Sending;
+        Mod.Sending -= n;
+        Mod.AirCredit = (Mod.Sending == 0) ? 0 : Mod.AirCredit - (uint64_t)n * 1000000000 / Sim_AirRate;
+
+        if (Mod.State == MOD_DRAIN && Mod.Fifo == 0)
+        {
+            char Text[32];
+
+            Mod.State = MOD_CMD;
+            if (Mod.Lost != 0)
+                Mod_Print(0, "\r\nSEND FAIL\r\n");
+            else
+            {
+                snprintf(Text, sizeof(Text), "\r\nRecv %u bytes\r\n", Mod.Need);
+                Mod_Print(0, Text);
+                Mod_Print(0, "\r\nSEND OK\r\n");
+            }
+        }
+
+        while (Mod.Outs != 0 && Mod.Out[0].Time <= Sim_Now)
+        {
+            for (const char* p = Mod.Out[0].Text; *p; p++)
+            {
+                Sim_Rx[Sim_RxHead] = *p;
+                Sim_RxHead = (Sim_RxHead + 1) % SIM_RX_SIZE;
+            }
+            memmove(&Mod.Out[0], &Mod.Out[1], --Mod.Outs * sizeof(Sim_Out));
+        }
+    }
+}
+
+
+/**
+ * @name    Sim_Tx
+ * @brief   The function sends bytes of the driver at the baud rate. With
+ *              RTS/CTS on both sides the USART waits while the FIFO is full.
+ *
+ * @author  Mehdi
+ */
+
+static void Sim_Tx(const uint8_t* Data, uint16_t Len)
+{
+    uint8_t Cts = (USART_ESP->CR3 & USART_CR3_CTSE) && (Mod.Flow & ESP_FLOW_RTS);
+
+    for (uint16_t i = 0; i < Len; i++)
+    {
+        while (Cts && Mod.State == MOD_DATA && Mod.Fifo >= Sim_FifoSize)
+        {
+            Sim_Advance(SIM_STEP_NS);
+            Stat.CtsWaitNs += SIM_STEP_NS;
+        }
+
+        Sim_Advance(10ULL * 1000000000 / Sim_Baud);
+        Mod_Rx(Data[i]);
+    }
+}
+
+
+static uint16_t Sim_Pending(void)
+{
+    return (Sim_RxHead + SIM_RX_SIZE - Sim_RxTail) % SIM_RX_SIZE;
+}
+
+
+static int16_t Sim_Find(uint8_t c)
+{
+    for (uint16_t i = 0, n = Sim_Pending(); i < n; i++)
+        if (Sim_Rx[(Sim_RxTail + i) % SIM_RX_SIZE] == c)
+            return i;
+
+    return -1;
+}
+
+
+/***************************************************
+		H O S T   L I B R A R I E S
+****************************************************/
+
+void TM_USART_Putc(USART_TypeDef* USARTx, volatile char c)
+{
+    uint8_t b = c;
+
+    (void)USARTx;
+    Sim_Tx(&b, 1);
+}
+
+void TM_USART_Puts(USART_TypeDef* USARTx, char* str)
+{
+    (void)USARTx;
+    Sim_Tx((const uint8_t*)str, strlen(str));
+}
+
+void TM_USART_Send(USART_TypeDef* USARTx, uint8_t* DataArray, uint16_t count)
+{
+    (void)USARTx;
+    Sim_Tx(DataArray, count);
+}
+
+uint8_t TM_USART_Getc(USART_TypeDef* USARTx)
+{
+    uint8_t c;
+
+    (void)USARTx;
+    if (Sim_Pending() == 0)
+        return 0;
+
+    c = Sim_Rx[Sim_RxTail];
+    Sim_RxTail = (Sim_RxTail + 1) % SIM_RX_SIZE;
+    return c;
+}
+
+uint16_t TM_USART_Gets(USART_TypeDef* USARTx, char* buffer, uint16_t bufsize)
+{
+    uint16_t i = 0;
+
+    (void)USARTx;
+    if (Sim_Find('\n') < 0 && Sim_Pending() < bufsize - 1)
+        return 0;
+
+    while (i < bufsize - 1 && Sim_Pending() != 0)
+    {
+        buffer[i] = Sim_Rx[Sim_RxTail];
+        Sim_RxTail = (Sim_RxTail + 1) % SIM_RX_SIZE;
+        if (buffer[i++] == '\n')
+            break;
+    }
+    buffer[i] = 0;
+
+    return i;
+}
+
+uint8_t TM_USART_BufferEmpty(USART_TypeDef* USARTx)
+{
+    (void)USARTx;
+    return Sim_Pending() == 0;
+}
+
+uint16_t TM_USART_BufferCount(USART_TypeDef* USARTx)
+{
+    (void)USARTx;
+    return Sim_Pending();
+}
+
+void TM_USART_ClearBuffer(USART_TypeDef* USARTx)
+{
+    (void)USARTx;
+    Sim_RxTail = Sim_RxHead;
+}
+
+int16_t TM_USART_FindCharacter(USART_TypeDef* USARTx, uint8_t c)
+{
+    (void)USARTx;
+    return Sim_Find(c);
+}
+
+uint32_t HAL_GetTick(void)
+{
+    Sim_Advance(SIM_STEP_NS);
+    return Sim_Now / 1000000;
+}
+
+void Delay(uint32_t us)
+{
+    Sim_Advance(us * 1000ULL);
+}
+
+void Delayms(uint32_t ms)
+{
+    Sim_Advance(ms * 1000000ULL);
+}
+
+uint32_t TM_DELAY_Time(void)
+{
+    return HAL_GetTick();
+}
+
+uint64_t TimeBase_Now(void)
+{
+    Sim_Advance(SIM_STEP_NS);
+    return Sim_Now / 1000;
+}
+
+void TimeBase_Delay(uint64_t us)
+{
+    Sim_Advance(us * 1000);
+}
+
+void TM_HD44780_Clear(void)
+{
+}
+
+void TM_HD44780_Puts(uint8_t x, uint8_t y, char* str)
+{
+    (void)x;
+    (void)y;
+    (void)str;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data)
+{
+    (void)TypeProgram;
+    (void)Address;
+    (void)Data;
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError)
+{
+    (void)pEraseInit;
+    *SectorError = 0xFFFFFFFF;
+    return HAL_ERROR;
+}
+
+
+/***************************************************
+				B E N C H
+****************************************************/
+
+/**
+ * @name    Bench_SendNoPrompt
+ * @brief   The send path the driver used to have: the data right after
+ *              the command, then a wait for the result
+ *
+ * @author  Mehdi
+ */
+
+static int8_t Bench_SendNoPrompt(const uint8_t* Data, uint16_t Len)
+{
+    char Args[12], Line[ESP_LINE_LEN];
+    uint32_t start = HAL_GetTick();
+
+    sprintf(Args, "0,%u", Len);
+    ATCmd_Send(USART_ESP, AT_ESP_CIPSEND, Args);
+    AT_Send(USART_ESP, Data, Len);
+
+    while ((HAL_GetTick() - start) < ATCmd_Timeout(AT_ESP_CIPSEND))
+    {
+        if (AT_Gets(USART_ESP, Line, sizeof(Line)) == 0)
+            continue;
+        if (strncmp(Line, "SEND OK", 7) == 0)
+            return ESP8266_OK;
+        if (strncmp(Line, "SEND FAIL", 9) == 0 || strncmp(Line, "ERROR", 5) == 0)
+            return ESP8266_FAIL;
+    }
+
+    return ESP8266_TIMEOUT;
+}
+
+
+/**
+ * @name    Bench_Row
+ * @brief   The function sends the packets in one mode and prints a row
+ *
+ * @author  Mehdi
+ *
+ * @return	packets lost
+ */
+
+static uint32_t Bench_Row(const char* Name, uint32_t Baud, uint8_t Flow, uint8_t Prompt, uint32_t Packets, uint16_t Size)
+{
+    static uint8_t Data[2048];
+    uint64_t Start;
+    int8_t res;
+
+    memset(&Mod, 0, sizeof(Mod));
+    memset(&Stat, 0, sizeof(Stat));
+    Sim_RxHead = Sim_RxTail = 0;
+    USART_ESP->CR3 = 0;
+    Sim_Baud = 115200;
+
+    if (Baud != 115200 || Flow != ESP_FLOW_NONE)
+    {
+        if (ESP_SetUart(Baud, Flow) != ESP8266_OK)
+        {
+            printf("%-22s AT+UART_CUR failed\n", Name);
+            return Packets;
+        }
+    }
+
+    Start = Sim_Now;
+
+    for (uint32_t i = 0; i < Packets; i++)
+    {
+        memset(Data, 'a' + i % 26, Size);
+
+        res = Prompt ? ESP_UdpSend(0, Data, Size) : Bench_SendNoPrompt(Data, Size);
+
+        /* A refused or broken packet leaves the module idle again */
+        switch (res)
+        {
+        case ESP8266_OK:      Stat.Ok++;      break;
+        case ESP8266_BUSY:    Stat.Busy++;    break;
+        case ESP8266_TIMEOUT: Stat.Timeout++; break;
+        default:              Stat.Fail++;    break;
+        }
+
+        while (Mod.State != MOD_CMD || Mod.Outs != 0)
+            Sim_Advance(SIM_STEP_NS);
+        AT_ClearBuffer(USART_ESP);
+    }
+
+    printf("%-22s %7u | %5u %5u %5u %5u | %6u %6u %7u %7u %6.0f | %9.0f\n",
+           Name, Sim_Baud,
+           Stat.Ok, Stat.Busy, Stat.Fail, Stat.Timeout,
+           Stat.BusyS, Stat.BusyP, Stat.Dropped, Stat.Overrun, Stat.CtsWaitNs / 1e6,
+           (double)Stat.Ok * Size * 1e9 / (double)(Sim_Now - Start));
+
+    return Packets - Stat.Ok;
+}
+
+
+int main(int argc, char** argv)
+{
+    uint32_t Packets = 100, FullBaud = 921600, Lost = 0;
+    uint16_t Size = 512;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            Packets = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            Size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0)
+            Sim_FifoSize = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            Sim_DrainRate = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-a") == 0)
+            Sim_AirRate = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-B") == 0)
+            FullBaud = atoi(argv[i + 1]);
+    }
+
+    if (Packets == 0 || Size == 0 || Size > 2048 || Sim_FifoSize == 0 || Sim_DrainRate == 0 || Sim_AirRate == 0 || FullBaud == 0)
+    {
+        fprintf(stderr, "usage: %s [-n <packets>] [-s <bytes>] [-f <bytes>] [-d <bytes/s>] [-a <bytes/s>] [-B <baud>]\n", argv[0]);
+        return 2;
+    }
+
+    USART_ESP = USART2;
+
+    printf("%u packets of %u bytes; FIFO %u bytes drained at %u B/s, air %u B/s\n\n",
+           Packets, Size, Sim_FifoSize, Sim_DrainRate, Sim_AirRate);
+    printf("mode                      baud |    ok  busy  fail   tmo | busy s busy p dropped overrun  CTS ms | payload B/s\n");
+
+    Bench_Row("no prompt", 115200, ESP_FLOW_NONE, 0, Packets, Size);
+    Lost += Bench_Row("prompt", 115200, ESP_FLOW_NONE, 1, Packets, Size);
+    Bench_Row("prompt, full baud", FullBaud, ESP_FLOW_NONE, 1, Packets, Size);
+    Lost += Bench_Row("prompt, RTS/CTS", FullBaud, ESP_FLOW_RTS_CTS, 1, Packets, Size);
+
+    if (Lost != 0)
+    {
+        printf("\n%u packets lost with flow control: FAIL\n", Lost);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,623 @@
+/**
+ @file     HttpProxyTest.c
+ @brief    Host check of the SIM900 HTTP client (SIM900Http.h) against a
+           real HTTP server. A small server is forked on the loopback
+           interface; an emulated SIM900 on USART2 (echo on) answers the
+           bearer and HTTP commands and, on AT+HTTPACTION, makes the request
+           to that server over a socket, as the module would over GPRS.
+           The response is then read back through AT+HTTPREAD windows.
+
+           The served body holds the bytes a line reader would trip on
+           ("\r\nOK\r\n", "+HTTPREAD:", NUL), so a body handled as lines
+           shows up as a wrong length or checksum.
+
+           Cases: bearer opened once, streamed GET (length, checksum,
+           windows), streamed POST (the server checks what it got), a 404,
+           a sink that stops early, a session left open by an earlier
+           exchange.
+
+           The tool exits with 1 when a case fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o HttpProxyTest tools/HttpProxyTest.c tools/host/HostSim.c \
+                   SIM900Http.c SIM900.c ATCmd.c ATEngine.c ATResp.c SMSPdu.c \
+                   StatusSink.c AuxLib.c BufPool.c
+
+           Usage:
+               HttpProxyTest [-v]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "SIM900.h"
+#include "SIM900Http.h"
+#include "ATCmd.h"
+#include "BufPool.h"
+#include "TimeBase.h"
+#include "HostSim.h"
+
+
+#define SIM_BODY_SIZE				65536		// Largest body the module holds here
+
+#define TEST_CONFIG_LEN				5000		// Body of GET /config
+#define TEST_REPORT_LEN				6000		// Body of POST /report
+
+typedef struct
+{
+    char        Line[160];
+    uint16_t    LineLen;
+    uint8_t     Bearer;			// <status> of +SAPBR: 1 connected, 3 closed
+    uint8_t     Session;		// AT+HTTPINIT done
+    char        Url[128];
+    char        Type[48];
+
+    uint8_t     Post[SIM_BODY_SIZE];	// Data of AT+HTTPDATA
+    uint32_t    PostLen;
+    uint32_t    Need;			// Bytes of AT+HTTPDATA left
+    uint64_t    NeedEnd;		// ns: end of <time> of AT+HTTPDATA
+
+    uint8_t     Body[SIM_BODY_SIZE];	// Response of the last AT+HTTPACTION
+    uint32_t    BodyLen;
+
+    uint16_t    Sapbr;			// Commands seen
+    uint16_t    Reads;
+    uint16_t    Terms;
+    uint16_t    Unknown;
+} Test_Module;
+
+static Test_Module Mod;
+static uint16_t    Test_Port;
+static uint32_t    Test_Errors;
+static uint8_t     Test_Verbose;
+
+
+/***************************************************
+				S E R V E R
+****************************************************/
+
+static uint8_t Test_Byte(uint32_t i)
+{
+    static const char Trap[] = "\r\nOK\r\n+HTTPREAD: 9\r\n\0ERROR\r\n";
+
+    /* The traps every 700 bytes, a pattern elsewhere */
+    if (i % 700 < sizeof(Trap))
+        return Trap[i % 700];
+
+    return (uint8_t)(i * 7 + (i >> 8));
+}
+
+
+static uint32_t Test_Sum(const uint8_t* Data, uint32_t Len, uint32_t Sum)
+{
+    while (Len--)
+        Sum = Sum * 31 + *Data++;
+
+    return Sum;
+}
+
+
+/**
+ * @name    Server_Answer
+ * @brief   The function answers one request on a connection:
+ *              GET /config (the test body), POST /report (the length and
+ *              the checksum of what it got), 404 otherwise
+ *
+ * @author  Mehdi
+ */
+
+static void Server_Answer(int Fd)
+{
+    static uint8_t Req[SIM_BODY_SIZE];
+    static uint8_t Body[SIM_BODY_SIZE];
+    char Head[128];
+    uint32_t Len = 0, Need = 0, BodyLen, i;
+    const char* p;
+    char* End = NULL;
+    ssize_t n;
+
+    /* The header, then the body of Content-Length */
+    while (Len < sizeof(Req) - 1)
+    {
+        if ((n = read(Fd,Req + Len,sizeof(Req) - 1 - Len)) <= 0)
+            break;
+        Len += n;
+        Req[Len] = '\0';
+
+        if (End == NULL && (End = strstr((char*)Req,"\r\n\r\n")) != NULL)
+        {
+            if ((p = strstr((char*)Req,"Content-Length: ")) != NULL && p < End)
+                Need = atoi(p + 16);
+        }
+        if (End != NULL && Len >= (uint32_t)(End + 4 - (char*)Req) + Need)
+            break;
+    }
+
+    if (End == NULL)
+        return;
+
+    if (strncmp((char*)Req,"GET /config ",12) == 0)
+    {
+        for (BodyLen = 0; BodyLen < TEST_CONFIG_LEN; BodyLen++)
+            Body[BodyLen] = Test_Byte(BodyLen);
+        n = snprintf(Head,sizeof(Head),"HTTP/1.0 200 OK\r\nContent-Length: %u\r\n\r\n",(unsigned)BodyLen);
+    } else if (strncmp((char*)Req,"POST /report ",13) == 0)
+    {
+        BodyLen = snprintf((char*)Body,sizeof(Body),"len=%u sum=%08x type=%s",(unsigned)Need,
+                           (unsigned)Test_Sum((uint8_t*)End + 4,Need,0),
+                           strstr((char*)Req,"Content-Type: application/octet-stream\r\n") ? "ok" : "bad");
+        n = snprintf(Head,sizeof(Head),"HTTP/1.0 201 Created\r\nContent-Length: %u\r\n\r\n",(unsigned)BodyLen);
+    } else
+    {
+        BodyLen = snprintf((char*)Body,sizeof(Body),"not found");
+        n = snprintf(Head,sizeof(Head),"HTTP/1.0 404 Not Found\r\nContent-Length: %u\r\n\r\n",(unsigned)BodyLen);
+    }
+
+    if (write(Fd,Head,n) != n)
+        return;
+    for (i = 0; i < BodyLen; i += n)
+        if ((n = write(Fd,Body + i,BodyLen - i)) <= 0)
+            return;
+}
+
+
+/**
+ * @name    Server_Start
+ * @brief   The function forks the server on 127.0.0.1, on a port of the system
+ *
+ * @author  Mehdi
+ * @return  The pid of the server, or -1
+ */
+
+static pid_t Server_Start(void)
+{
+    struct sockaddr_in Addr;
+    socklen_t Size = sizeof(Addr);
+    int Fd, Conn, On = 1;
+    pid_t Pid;
+
+    if ((Fd = socket(AF_INET,SOCK_STREAM,0)) < 0)
+        return -1;
+
+    setsockopt(Fd,SOL_SOCKET,SO_REUSEADDR,&On,sizeof(On));
+    memset(&Addr,0,sizeof(Addr));
+    Addr.sin_family = AF_INET;
+    Addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(Fd,(struct sockaddr*)&Addr,sizeof(Addr)) < 0 || listen(Fd,4) < 0 ||
+        getsockname(Fd,(struct sockaddr*)&Addr,&Size) < 0)
+    {
+        close(Fd);
+        return -1;
+    }
+
+    Test_Port = ntohs(Addr.sin_port);
+
+    if ((Pid = fork()) == 0)
+    {
+        while ((Conn = accept(Fd,NULL,NULL)) >= 0)
+        {
+            Server_Answer(Conn);
+            close(Conn);
+        }
+        _exit(0);
+    }
+
+    close(Fd);
+
+    return Pid;
+}
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+void Mod_Tick(void)
+{
+    /* AT+HTTPDATA ends with "OK" when <time> is over, all data or not */
+    if (Mod.Need != 0 && Sim_Now >= Mod.NeedEnd)
+    {
+        Mod.Need = 0;
+        Mod_Print("\r\nOK\r\n");
+    }
+}
+
+
+/**
+ * @name    Mod_Request
+ * @brief   The function makes the request of AT+HTTPACTION to the server
+ *              of the URL and keeps the body of the response
+ *
+ * @author  Mehdi
+ * @return  The HTTP status, or 601 (network error) as the module reports it
+ */
+
+static uint16_t Mod_Request(uint8_t Method)
+{
+    static uint8_t Resp[SIM_BODY_SIZE + 256];
+    struct sockaddr_in Addr;
+    char Head[256];
+    const char *Host, *Path, *Sep;
+    uint32_t Len = 0;
+    int Fd, n;
+
+    Mod.BodyLen = 0;
+
+    /* http://127.0.0.1:<port>/<path> */
+    if (strncmp(Mod.Url,"http://",7) != 0 || (Path = strchr(Host = Mod.Url + 7,'/')) == NULL ||
+        (Sep = strchr(Host,':')) == NULL || Sep > Path)
+        return 601;
+
+    memset(&Addr,0,sizeof(Addr));
+    Addr.sin_family = AF_INET;
+    Addr.sin_port = htons(atoi(Sep + 1));
+    Addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((Fd = socket(AF_INET,SOCK_STREAM,0)) < 0)
+        return 601;
+    if (connect(Fd,(struct sockaddr*)&Addr,sizeof(Addr)) < 0)
+    {
+        close(Fd);
+        return 601;
+    }
+
+    if (Method == SIM900_HTTP_POST)
+        n = snprintf(Head,sizeof(Head),"POST %s HTTP/1.0\r\nHost: %.*s\r\nContent-Type: %s\r\nContent-Length: %u\r\n\r\n",
+                     Path,(int)(Path - Host),Host,Mod.Type,(unsigned)Mod.PostLen);
+    else
+        n = snprintf(Head,sizeof(Head),"GET %s HTTP/1.0\r\nHost: %.*s\r\n\r\n",Path,(int)(Path - Host),Host);
+
+    if (write(Fd,Head,n) != n || (Method == SIM900_HTTP_POST && write(Fd,Mod.Post,Mod.PostLen) != (ssize_t)Mod.PostLen))
+    {
+        close(Fd);
+        return 601;
+    }
+
+    while (Len < sizeof(Resp) - 1 && (n = read(Fd,Resp + Len,sizeof(Resp) - 1 - Len)) > 0)
+        Len += n;
+    close(Fd);
+    Resp[Len] = '\0';
+
+    if (strncmp((char*)Resp,"HTTP/1.",7) != 0 || (Sep = strstr((char*)Resp,"\r\n\r\n")) == NULL)
+        return 601;
+
+    Mod.BodyLen = Len - (Sep + 4 - (char*)Resp);
+    memcpy(Mod.Body,Sep + 4,Mod.BodyLen);
+
+    return atoi((char*)Resp + 9);
+}
+
+
+/**
+ * @name    Mod_Line
+ * @brief   The function answers a command line
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Line(void)
+{
+    char Reply[96];
+    uint32_t Off, Len;
+    const char* p;
+    uint16_t Status;
+
+    if (Test_Verbose > 1)
+        printf("  > %s\n",Mod.Line);
+
+    if (strcmp(Mod.Line,"AT") == 0)
+    {
+        Mod_Print("\r\nOK\r\n");
+    } else if (strncmp(Mod.Line,"AT+SAPBR=",9) == 0)
+    {
+        Mod.Sapbr++;
+        if (strcmp(Mod.Line + 9,"2,1") == 0)
+        {
+            snprintf(Reply,sizeof(Reply),"\r\n+SAPBR: 1,%u,\"%s\"\r\n\r\nOK\r\n",Mod.Bearer,
+                     Mod.Bearer == 1 ? "10.64.12.7" : "0.0.0.0");
+            Mod_Print(Reply);
+        } else
+        {
+            if (strcmp(Mod.Line + 9,"1,1") == 0)
+                Mod.Bearer = 1;
+            Mod_Print("\r\nOK\r\n");
+        }
+    } else if (strcmp(Mod.Line,"AT+HTTPINIT") == 0)
+    {
+        Mod_Print(Mod.Session ? "\r\nERROR\r\n" : "\r\nOK\r\n");
+        Mod.Session = 1;
+    } else if (strcmp(Mod.Line,"AT+HTTPTERM") == 0)
+    {
+        Mod.Terms++;
+        Mod_Print(Mod.Session ? "\r\nOK\r\n" : "\r\nERROR\r\n");
+        Mod.Session = 0;
+    } else if (strncmp(Mod.Line,"AT+HTTPPARA=\"URL\",\"",19) == 0 && Mod.Session)
+    {
+        snprintf(Mod.Url,sizeof(Mod.Url),"%.*s",(int)strlen(Mod.Line + 19) - 1,Mod.Line + 19);
+        Mod_Print("\r\nOK\r\n");
+    } else if (strncmp(Mod.Line,"AT+HTTPPARA=\"CONTENT\",\"",23) == 0 && Mod.Session)
+    {
+        snprintf(Mod.Type,sizeof(Mod.Type),"%.*s",(int)strlen(Mod.Line + 23) - 1,Mod.Line + 23);
+        Mod_Print("\r\nOK\r\n");
+    } else if (strcmp(Mod.Line,"AT+HTTPPARA=\"CID\",1") == 0 && Mod.Session)
+    {
+        Mod_Print("\r\nOK\r\n");
+    } else if (strncmp(Mod.Line,"AT+HTTPDATA=",12) == 0 && Mod.Session &&
+               (Mod.Need = strtoul(Mod.Line + 12,NULL,10)) <= SIM_BODY_SIZE)
+    {
+        Mod.PostLen = 0;
+        Mod.NeedEnd = Sim_Now + strtoul(strchr(Mod.Line,',') + 1,NULL,10) * 1000000ULL;
+        Mod_Print("\r\nDOWNLOAD\r\n");
+    } else if (strncmp(Mod.Line,"AT+HTTPACTION=",14) == 0 && Mod.Session && Mod.Bearer == 1)
+    {
+        Mod_Print("\r\nOK\r\n");
+        Status = Mod_Request(atoi(Mod.Line + 14));
+        snprintf(Reply,sizeof(Reply),"\r\n+HTTPACTION: %.4s,%u,%u\r\n",Mod.Line + 14,Status,(unsigned)Mod.BodyLen);
+        Mod_Print(Reply);
+    } else if (strncmp(Mod.Line,"AT+HTTPREAD=",12) == 0 && Mod.Session && (p = strchr(Mod.Line,',')) != NULL)
+    {
+        Mod.Reads++;
+        Off = strtoul(Mod.Line + 12,NULL,10);
+        Len = strtoul(p + 1,NULL,10);
+        if (Off > Mod.BodyLen)
+            Off = Mod.BodyLen;
+        if (Len > Mod.BodyLen - Off)
+            Len = Mod.BodyLen - Off;
+        snprintf(Reply,sizeof(Reply),"\r\n+HTTPREAD: %u\r\n",(unsigned)Len);
+        Mod_Print(Reply);
+        Mod_Write(Mod.Body + Off,Len);
+        Mod_Print("\r\nOK\r\n");
+    } else
+    {
+        Mod.Unknown++;
+        Mod_Print("\r\nERROR\r\n");
+    }
+}
+
+
+/**
+ * @name    Mod_Rx
+ * @brief   The function takes one byte from the driver. The data of
+ *              AT+HTTPDATA is not echoed.
+ *
+ * @author  Mehdi
+ */
+
+void Mod_Rx(uint8_t c)
+{
+    char Echo[2] = { c, '\0' };
+
+    if (Mod.Need != 0)
+    {
+        Mod.Post[Mod.PostLen++] = c;
+        if (--Mod.Need == 0)
+            Mod_Print("\r\nOK\r\n");
+        return;
+    }
+
+    Mod_Print(Echo);
+
+    if (c == '\n')
+        return;
+
+    if (c != '\r')
+    {
+        if (Mod.LineLen < sizeof(Mod.Line) - 1)
+            Mod.Line[Mod.LineLen++] = c;
+        return;
+    }
+
+    Mod.Line[Mod.LineLen] = '\0';
+    Mod.LineLen = 0;
+    Mod_Line();
+}
+
+
+/***************************************************
+				T E S T S
+****************************************************/
+
+typedef struct
+{
+    uint8_t  Data[SIM_BODY_SIZE];
+    uint32_t Len;
+    uint32_t Pieces;
+    uint32_t Limit;			// The sink refuses more after this many bytes (0: no limit)
+} Test_Sink;
+
+typedef struct
+{
+    uint32_t Off;
+    uint32_t Len;
+} Test_Source;
+
+
+static int8_t Test_Take(void* ctx, const uint8_t* data, uint16_t len)
+{
+    Test_Sink* s = ctx;
+
+    if (s->Len + len <= sizeof(s->Data))
+        memcpy(s->Data + s->Len,data,len);
+    s->Len += len;
+    s->Pieces++;
+
+    return (s->Limit != 0 && s->Len >= s->Limit) ? SIM900_FAIL : SIM900_OK;
+}
+
+
+static uint16_t Test_Fill(void* ctx, uint8_t* buf, uint16_t size)
+{
+    Test_Source* s = ctx;
+    uint16_t n;
+
+    for (n = 0; n < size && s->Off < s->Len; n++, s->Off++)
+        buf[n] = Test_Byte(s->Off * 3);
+
+    return n;
+}
+
+
+static void Test_Check(const char* Name, int Ok)
+{
+    if (!Ok)
+        Test_Errors++;
+
+    if (!Ok || Test_Verbose)
+        printf("%-44s %s\n",Name,Ok ? "ok" : "FAILED");
+}
+
+
+static void Test_Url(char* Url, const char* Path)
+{
+    sprintf(Url,"http://127.0.0.1:%u%s",Test_Port,Path);
+}
+
+
+static void Test_Get(void)
+{
+    static Test_Sink Sink;
+    SIM900_HttpResult Res;
+    char Url[64];
+    uint32_t i, Sum = 0;
+    int8_t r;
+
+    memset(&Sink,0,sizeof(Sink));
+    Mod.Reads = 0;
+    Test_Url(Url,"/config");
+
+    r = SIM900HttpGet(Url,Test_Take,&Sink,&Res);
+
+    for (i = 0; i < TEST_CONFIG_LEN; i++)
+        Sum = Sum * 31 + Test_Byte(i);
+
+    Test_Check("get: result",r == SIM900_OK);
+    Test_Check("get: status 200",Res.Status == 200);
+    Test_Check("get: length",Res.Len == TEST_CONFIG_LEN && Res.Read == TEST_CONFIG_LEN && Sink.Len == TEST_CONFIG_LEN);
+    Test_Check("get: checksum",Test_Sum(Sink.Data,Sink.Len,0) == Sum);
+    Test_Check("get: windows",Mod.Reads == (TEST_CONFIG_LEN + SIM900_HTTP_WINDOW - 1) / SIM900_HTTP_WINDOW);
+    Test_Check("get: pieces fit SIM900_HTTP_CHUNK",Sink.Pieces >= TEST_CONFIG_LEN / SIM900_HTTP_CHUNK);
+    Test_Check("get: session closed",Mod.Session == 0);
+}
+
+
+static void Test_Post(void)
+{
+    static Test_Sink Sink;
+    Test_Source Src = { 0, TEST_REPORT_LEN };
+    SIM900_HttpResult Res;
+    uint8_t Piece[1];
+    char Url[64], Expect[64];
+    uint32_t i, Sum = 0;
+    int8_t r;
+
+    memset(&Sink,0,sizeof(Sink));
+    Test_Url(Url,"/report");
+
+    r = SIM900HttpPost(Url,"application/octet-stream",TEST_REPORT_LEN,Test_Fill,&Src,Test_Take,&Sink,&Res);
+
+    for (i = 0; i < TEST_REPORT_LEN; i++)
+    {
+        Piece[0] = Test_Byte(i * 3);
+        Sum = Test_Sum(Piece,1,Sum);
+    }
+    snprintf(Expect,sizeof(Expect),"len=%u sum=%08x type=ok",TEST_REPORT_LEN,(unsigned)Sum);
+
+    Test_Check("post: result",r == SIM900_OK);
+    Test_Check("post: status 201",Res.Status == 201);
+    Test_Check("post: upload taken by the module",Mod.PostLen == TEST_REPORT_LEN);
+    Test_Check("post: server got the body",Sink.Len == strlen(Expect) && memcmp(Sink.Data,Expect,Sink.Len) == 0);
+    if (Test_Verbose)
+        printf("  server: %.*s\n",(int)Sink.Len,Sink.Data);
+
+    /* A source that runs dry */
+    Src.Off = 0;
+    Src.Len = 100;
+    r = SIM900HttpPost(Url,"application/octet-stream",TEST_REPORT_LEN,Test_Fill,&Src,NULL,NULL,&Res);
+    Test_Check("post: short source fails",r == SIM900_FAIL && Mod.Session == 0);
+}
+
+
+static void Test_Failures(void)
+{
+    static Test_Sink Sink;
+    SIM900_HttpResult Res;
+    char Url[64];
+    int8_t r;
+
+    memset(&Sink,0,sizeof(Sink));
+    Test_Url(Url,"/missing");
+    r = SIM900HttpGet(Url,Test_Take,&Sink,&Res);
+    Test_Check("404: result and status",r == SIM900_OK && Res.Status == 404);
+    Test_Check("404: body",Sink.Len == 9 && memcmp(Sink.Data,"not found",9) == 0);
+
+    /* The sink stops in the second window: that one is read to its end */
+    memset(&Sink,0,sizeof(Sink));
+    Sink.Limit = 700;
+    Test_Url(Url,"/config");
+    r = SIM900HttpGet(Url,Test_Take,&Sink,&Res);
+    Test_Check("abort: result",r == SIM900_FAIL);
+    Test_Check("abort: stops at the end of the window",Res.Read == 2 * SIM900_HTTP_WINDOW && Sink.Len < Res.Read);
+    Test_Check("abort: session closed",Mod.Session == 0);
+
+    /* A session left open by an earlier exchange */
+    memset(&Sink,0,sizeof(Sink));
+    Mod.Session = 1;
+    r = SIM900HttpGet(Url,Test_Take,&Sink,&Res);
+    Test_Check("stale session: recovered",r == SIM900_OK && Res.Read == TEST_CONFIG_LEN);
+}
+
+
+int main(int argc, char* argv[])
+{
+    const ATCmd_Stat* Stat;
+    pid_t Server;
+    int i;
+
+    for (i = 1; i < argc; i++)
+        if (strcmp(argv[i],"-v") == 0)
+            Test_Verbose++;
+
+    if ((Server = Server_Start()) < 0)
+    {
+        fprintf(stderr,"HttpProxyTest: no loopback server\n");
+        return 1;
+    }
+
+    Mod.Bearer = 3;
+
+    Test_Check("sim init",SIM900Init(USART2) == SIM900_OK);
+    Test_Check("bearer: opened",SIM900HttpBearer("internet") == SIM900_OK && Mod.Bearer == 1 && Mod.Sapbr == 4);
+    Test_Check("bearer: already up, query only",SIM900HttpBearer("internet") == SIM900_OK && Mod.Sapbr == 5);
+
+    Test_Get();
+    Test_Post();
+    Test_Failures();
+
+    Test_Check("no unknown commands",Mod.Unknown == 0);
+    Test_Check("buffer pool returned",BufPool_GetStat(BUFPOOL_SMALL)->InUse == 0 && BufPool_GetStat(BUFPOOL_LARGE)->InUse == 0);
+
+    kill(Server,SIGTERM);
+    waitpid(Server,NULL,0);
+
+    Stat = ATCmd_GetStat(AT_SIM_HTTPREAD);
+    printf("\nAT+HTTPREAD: %lu windows, %lu failed, max %lu ms; %s\n",(unsigned long)Stat->Count,
+           (unsigned long)Stat->Fail,(unsigned long)Stat->MaxMs,Test_Errors ? "FAILED" : "all ok");
+
+    return Test_Errors ? 1 : 0;
+}
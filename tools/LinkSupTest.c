@@ -0,0 +1,379 @@
+/**
+ @file     LinkSupTest.c
+ @brief    Host check of the link supervisor (LinkSup.h). The supervisor
+           runs against scripted operations (LinkSup_SetOps) on a
+           simulated clock: each step fails a given number of times with
+           a given fault class, and the tool records the steps and the
+           waits LinkSup_Recover makes. The checks cover the
+           classification of the replies, the backoff sequence and its
+           bounds, the steps run for each fault class, the steps added by
+           a new fault and by escalation, and the give-up after
+           LINKSUP_MAX_ATTEMPTS with its metrics.
+
+           The tool exits with 1 when a check fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o LinkSupTest tools/LinkSupTest.c LinkSup.c StatusSink.c
+
+           Usage:
+               LinkSupTest [-v]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ESP8266.h"
+#include "FastJoin.h"
+#include "LinkSup.h"
+#include "TimeBase.h"
+
+
+#define TEST_STEPS					4			// Probe, Join, Mux, Server
+#define TEST_LOG_SIZE				256
+
+typedef struct
+{
+    uint16_t Fails;				// Failures left before the step passes
+    uint8_t  Fault;				// Fault class reported by a failure
+} Test_Step;
+
+static Test_Step Test_Script[TEST_STEPS];
+static uint8_t   Test_Fault;			// Fault of the last failed step
+static char      Test_Log[TEST_LOG_SIZE];	// "P", "J", "M", "S" per step run, "." per wait
+static uint16_t  Test_LogLen;
+static uint32_t  Test_Waits[LINKSUP_MAX_ATTEMPTS + 8];
+static uint16_t  Test_WaitCount;
+static uint32_t  Test_Now;				// ms
+static uint32_t  Test_DriverCalls;		// Calls of the default operations
+static int       Test_Errors;
+static int       Test_Verbose;
+
+
+/***************************************************
+		H O S T   L I B R A R I E S
+****************************************************/
+
+uint64_t TimeBase_Now(void)
+{
+    return (uint64_t)Test_Now * 1000;
+}
+
+
+void TimeBase_Delay(uint64_t us)
+{
+    Test_Now += us / 1000;
+}
+
+
+int8_t ESP_Probe(void)
+{
+    Test_DriverCalls++;
+    return ESP8266_OK;
+}
+
+
+int8_t FastJoin_Connect(void)
+{
+    Test_DriverCalls++;
+    return ESP8266_OK;
+}
+
+
+int8_t ESP_EnableMux(void)
+{
+    Test_DriverCalls++;
+    return ESP8266_OK;
+}
+
+
+int8_t ESP_EnableServer(void)
+{
+    Test_DriverCalls++;
+    return ESP8266_OK;
+}
+
+
+uint8_t ESP_GetLastFault(void)
+{
+    return LINK_FAULT_NONE;
+}
+
+
+/***************************************************
+		S C R I P T E D   O P E R A T I O N S
+****************************************************/
+
+static void Test_Log_Add(char c)
+{
+    if (Test_LogLen < TEST_LOG_SIZE - 1)
+        Test_Log[Test_LogLen++] = c;
+}
+
+
+static int8_t Test_Step_Run(uint8_t Step, char Name)
+{
+    Test_Log_Add(Name);
+    Test_Now += 10;
+
+    if (Test_Script[Step].Fails == 0)
+        return ESP8266_OK;
+
+    if (Test_Script[Step].Fails != UINT16_MAX)
+        Test_Script[Step].Fails--;
+    Test_Fault = Test_Script[Step].Fault;
+
+    return ESP8266_FAIL;
+}
+
+static int8_t Test_Probe(void)			{ return Test_Step_Run(0,'P'); }
+static int8_t Test_Join(void)			{ return Test_Step_Run(1,'J'); }
+static int8_t Test_Mux(void)			{ return Test_Step_Run(2,'M'); }
+static int8_t Test_Server(void)			{ return Test_Step_Run(3,'S'); }
+static uint8_t Test_LastFault(void)		{ return Test_Fault; }
+static uint32_t Test_Time(void)			{ return Test_Now; }
+
+static void Test_Wait(uint32_t ms)
+{
+    Test_Log_Add('.');
+    if (Test_WaitCount < sizeof(Test_Waits) / sizeof(Test_Waits[0]))
+        Test_Waits[Test_WaitCount++] = ms;
+    Test_Now += ms;
+}
+
+static const LinkSup_Ops Test_Ops =
+{
+    Test_Probe,
+    Test_Join,
+    Test_Mux,
+    Test_Server,
+    Test_LastFault,
+    Test_Wait,
+    Test_Time
+};
+
+
+/***************************************************
+				C H E C K S
+****************************************************/
+
+static void Test_Check(const char* Name, int Ok)
+{
+    printf("%-44s %s\n", Name, Ok ? "ok" : "FAIL");
+
+    if (!Ok)
+        Test_Errors++;
+}
+
+
+/* Bounds of the wait before an attempt */
+static uint32_t Test_BackoffMax(uint8_t Attempt)
+{
+    if (Attempt == 0)
+        return 0;
+    if (Attempt > 16 || ((uint32_t)LINKSUP_BACKOFF_BASE_MS << (Attempt - 1)) >= LINKSUP_BACKOFF_MAX_MS)
+        return LINKSUP_BACKOFF_MAX_MS;
+
+    return (uint32_t)LINKSUP_BACKOFF_BASE_MS << (Attempt - 1);
+}
+
+
+/* The script: the fails and fault of Probe, Join, Mux and Server */
+static int8_t Test_Run(uint8_t Fault, uint16_t Probe, uint16_t Join, uint16_t Mux, uint8_t StepFault)
+{
+    int8_t Res;
+
+    memset(Test_Script, 0, sizeof(Test_Script));
+    Test_Script[0].Fails = Probe;
+    Test_Script[1].Fails = Join;
+    Test_Script[2].Fails = Mux;
+    for (uint8_t i = 0; i < TEST_STEPS; i++)
+        Test_Script[i].Fault = StepFault;
+
+    Test_Fault = LINK_FAULT_NONE;
+    Test_LogLen = 0;
+    Test_WaitCount = 0;
+
+    Res = LinkSup_Recover(Fault);
+    Test_Log[Test_LogLen] = '\0';
+
+    if (Test_Verbose)
+        printf("    fault %u: %-36s -> %d\n", Fault, Test_Log, Res);
+
+    return Res;
+}
+
+
+/* The waits made were those of attempts 1, 2, ... */
+static int Test_WaitsOk(void)
+{
+    for (uint16_t i = 0; i < Test_WaitCount; i++)
+    {
+        uint32_t Max = Test_BackoffMax(i + 1);
+
+        if (Test_Waits[i] < Max / 2 || Test_Waits[i] > Max)
+            return 0;
+    }
+
+    return 1;
+}
+
+
+static void Test_Classify(void)
+{
+    Test_Check("no reply: timeout",
+               LinkSup_Classify(NULL) == LINK_FAULT_TIMEOUT && LinkSup_Classify("") == LINK_FAULT_TIMEOUT);
+    Test_Check("boot banner: module reset",
+               LinkSup_Classify("\r\nready\r\n") == LINK_FAULT_MODULE_RESET &&
+               LinkSup_Classify(" ets Jan  8 2013,rst cause:2, boot mode:(3,7)") == LINK_FAULT_MODULE_RESET);
+    Test_Check("AP lost: Wi-Fi drop",
+               LinkSup_Classify("WIFI DISCONNECT") == LINK_FAULT_WIFI_DROP &&
+               LinkSup_Classify("No AP\r\n\r\nOK") == LINK_FAULT_WIFI_DROP &&
+               LinkSup_Classify("+CWJAP:3\r\n\r\nFAIL") == LINK_FAULT_WIFI_DROP);
+    Test_Check("anything else: error",
+               LinkSup_Classify("ERROR") == LINK_FAULT_ERROR &&
+               LinkSup_Classify("busy p...") == LINK_FAULT_ERROR);
+}
+
+
+static void Test_Backoff(void)
+{
+    uint32_t Seen[17][2];
+    int Ok = (LinkSup_Backoff(0) == 0);
+
+    for (uint8_t n = 1; n <= 16; n++)
+    {
+        Seen[n][0] = UINT32_MAX;
+        Seen[n][1] = 0;
+        for (int i = 0; i < 2000; i++)
+        {
+            uint32_t d = LinkSup_Backoff(n);
+
+            if (d < Seen[n][0])
+                Seen[n][0] = d;
+            if (d > Seen[n][1])
+                Seen[n][1] = d;
+        }
+        Ok &= (Seen[n][0] >= Test_BackoffMax(n) / 2 && Seen[n][1] <= Test_BackoffMax(n));
+        if (Test_Verbose)
+            printf("    attempt %2u: %5lu..%5lu ms\n", n, (unsigned long)Seen[n][0], (unsigned long)Seen[n][1]);
+    }
+    Test_Check("backoff in [d/2, d], d = base * 2^(n-1)", Ok);
+
+    Test_Check("backoff doubles up to the cap",
+               Test_BackoffMax(1) == LINKSUP_BACKOFF_BASE_MS && Seen[2][1] > Seen[1][1] &&
+               Seen[4][1] > Seen[3][1] && Seen[16][1] <= LINKSUP_BACKOFF_MAX_MS);
+    Test_Check("backoff capped for any attempt",
+               LinkSup_Backoff(17) <= LINKSUP_BACKOFF_MAX_MS && LinkSup_Backoff(255) <= LINKSUP_BACKOFF_MAX_MS &&
+               LinkSup_Backoff(255) >= LINKSUP_BACKOFF_MAX_MS / 2);
+    Test_Check("backoff jittered",
+               Seen[8][1] - Seen[8][0] > LINKSUP_BACKOFF_MAX_MS / 4);
+}
+
+
+static void Test_Steps(void)
+{
+    const LinkSup_Metrics* Stat = LinkSup_GetMetrics();
+    uint32_t Recoveries = Stat->Recoveries;
+    int8_t Res;
+
+    Test_Check("no fault: nothing run",
+               Test_Run(LINK_FAULT_NONE, 0, 0, 0, 0) == ESP8266_OK && Test_Log[0] == '\0');
+
+    Res = Test_Run(LINK_FAULT_TIMEOUT, 0, 0, 0, 0);
+    Test_Check("timeout: probe only", Res == ESP8266_OK && strcmp(Test_Log, "P") == 0);
+
+    Res = Test_Run(LINK_FAULT_ERROR, 0, 0, 0, 0);
+    Test_Check("error: probe only", Res == ESP8266_OK && strcmp(Test_Log, "P") == 0);
+
+    Res = Test_Run(LINK_FAULT_WIFI_DROP, 0, 0, 0, 0);
+    Test_Check("Wi-Fi drop: probe, join", Res == ESP8266_OK && strcmp(Test_Log, "PJ") == 0);
+
+    Res = Test_Run(LINK_FAULT_MODULE_RESET, 0, 0, 0, 0);
+    Test_Check("module reset: full sequence", Res == ESP8266_OK && strcmp(Test_Log, "PJMS") == 0);
+
+    Test_Check("recoveries counted", Stat->Recoveries == Recoveries + 4);
+
+    Res = Test_Run(LINK_FAULT_TIMEOUT, 2, 0, 0, LINK_FAULT_TIMEOUT);
+    Test_Check("retried after a backoff", Res == ESP8266_OK &&
+               strcmp(Test_Log, "P.P.P") == 0 && Test_WaitCount == 2 && Test_WaitsOk());
+
+    Res = Test_Run(LINK_FAULT_ERROR, 1, 0, 0, LINK_FAULT_WIFI_DROP);
+    Test_Check("new fault adds its steps", Res == ESP8266_OK && strcmp(Test_Log, "P.PJ") == 0);
+
+    Res = Test_Run(LINK_FAULT_WIFI_DROP, 0, LINKSUP_ESCALATE_AFTER, 0, LINK_FAULT_WIFI_DROP);
+    Test_Check("escalates to the full sequence", Res == ESP8266_OK &&
+               strcmp(Test_Log, "PJ.PJ.PJ.PJMS") == 0);
+
+    Res = Test_Run(LINK_FAULT_TIMEOUT, 1, 0, 0, 0);
+    Test_Check("step without a fault: error", Res == ESP8266_OK && strcmp(Test_Log, "P.P") == 0);
+}
+
+
+static void Test_GiveUp(void)
+{
+    const LinkSup_Metrics* Stat = LinkSup_GetMetrics();
+    uint32_t GiveUps = Stat->GiveUps, Retries = Stat->Retries, Start, Bound = 0;
+    int8_t Res;
+
+    for (uint8_t n = 1; n < LINKSUP_MAX_ATTEMPTS; n++)
+        Bound += Test_BackoffMax(n);
+
+    Start = Test_Now;
+    Res = Test_Run(LINK_FAULT_TIMEOUT, UINT16_MAX, 0, 0, LINK_FAULT_TIMEOUT);
+    if (Test_Verbose)
+        printf("    gave up after %lu ms (bound %lu ms)\n",
+               (unsigned long)(Test_Now - Start), (unsigned long)Bound);
+
+    Test_Check("gives up after LINKSUP_MAX_ATTEMPTS", Res == ESP8266_FAIL &&
+               Test_WaitCount == LINKSUP_MAX_ATTEMPTS - 1 && Test_WaitsOk());
+    Test_Check("give-up counted", Stat->GiveUps == GiveUps + 1 &&
+               Stat->Retries == Retries + LINKSUP_MAX_ATTEMPTS);
+    Test_Check("give-up time bounded", Test_Now - Start <= Bound + 100 * LINKSUP_MAX_ATTEMPTS);
+
+    Res = Test_Run(LINK_FAULT_TIMEOUT, LINKSUP_MAX_ATTEMPTS - 1, 0, 0, LINK_FAULT_TIMEOUT);
+    Test_Check("recovers on the last attempt", Res == ESP8266_OK);
+
+    Res = Test_Run(LINK_FAULT_MODULE_RESET, 0, 0, UINT16_MAX, LINK_FAULT_ERROR);
+    Test_Check("gives up on a later step", Res == ESP8266_FAIL &&
+               Test_WaitCount == LINKSUP_MAX_ATTEMPTS - 1);
+}
+
+
+static void Test_Defaults(void)
+{
+    LinkSup_SetOps(NULL);
+    Test_DriverCalls = 0;
+
+    Test_Check("default operations: the driver",
+               LinkSup_Recover(LINK_FAULT_MODULE_RESET) == ESP8266_OK && Test_DriverCalls == 4);
+
+    LinkSup_SetOps(&Test_Ops);
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-v") == 0)
+        Test_Verbose = 1;
+
+    LinkSup_SetOps(&Test_Ops);
+
+    Test_Classify();
+    Test_Backoff();
+    Test_Steps();
+    Test_GiveUp();
+    Test_Defaults();
+
+    printf("\n%d check(s) failed\n", Test_Errors);
+
+    return Test_Errors ? 1 : 0;
+}
@@ -0,0 +1,453 @@
+/**
+ @file     MetricsTest.c
+ @brief    Host check of the /metrics and /status endpoints (Metrics.h).
+           An emulated ESP8266 on USART1 answers AT+CWJAP? with an RSSI,
+           takes the data of each AT+CIPSEND after its prompt and answers
+           AT+CIPCLOSE. A request is queued as +IPD data, read with
+           ESP_ReadIPD and served with Metrics_Serve, as the server loop
+           of the application does; the data the module took is then
+           scraped as a client would: status line, headers, chunked body.
+
+           Every case checks the framing (each CIPSEND fits
+           METRICS_CHUNK_LEN, the chunks add up to the body, the body ends
+           with the zero chunk), the lines expected in the body and the
+           shape of the others, and that the link was closed.
+
+           The tool exits with 1 when a case fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o MetricsTest tools/MetricsTest.c tools/host/HostSim.c \
+                   Metrics.c ESP8266.c ATCmd.c ATEngine.c ATResp.c LinkSup.c \
+                   FastJoin.c StatusSink.c AuxLib.c BufPool.c
+
+           Usage:
+               MetricsTest [-v]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ESP8266.h"
+#include "ATCmd.h"
+#include "BufPool.h"
+#include "Metrics.h"
+#include "TimeBase.h"
+#include "HostSim.h"
+
+
+#define SIM_TX_SIZE					8192		// Data taken by the module in one case
+
+typedef struct
+{
+    const char* Cwjap;			// Reply to AT+CWJAP?
+    char        Line[64];
+    uint16_t    LineLen;
+    uint16_t    Need;			// Data bytes of AT+CIPSEND left
+    uint16_t    SendLen;		// Length of the data being taken
+
+    char        Tx[SIM_TX_SIZE];	// Data of all the CIPSENDs, in order
+    uint16_t    TxLen;
+    uint16_t    Sends;
+    uint16_t    MaxSend;
+    uint16_t    Closes;
+    uint16_t    Unknown;		// Commands not emulated
+} Test_Module;
+
+extern USART_TypeDef* USART_ESP;
+
+static Test_Module Mod;
+static uint32_t    Test_Errors;
+static uint8_t     Test_Verbose;
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+void Mod_Tick(void)
+{
+}
+
+
+/**
+ * @name    Mod_Line
+ * @brief   The function answers a command line
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Line(void)
+{
+    char Reply[96];
+    const char* p;
+
+    if (strcmp(Mod.Line,"AT+CWJAP?") == 0)
+    {
+        Mod_Print(Mod.Cwjap);
+    } else if (strncmp(Mod.Line,"AT+CIPSEND=",11) == 0 && (p = strchr(Mod.Line,',')) != NULL)
+    {
+        Mod.SendLen = Mod.Need = atoi(p + 1);
+        Mod.Sends++;
+        if (Mod.SendLen > Mod.MaxSend)
+            Mod.MaxSend = Mod.SendLen;
+        Mod_Print("\r\nOK\r\n> ");
+    } else if (strncmp(Mod.Line,"AT+CIPCLOSE=",12) == 0)
+    {
+        snprintf(Reply,sizeof(Reply),"%.8s,CLOSED\r\n\r\nOK\r\n",Mod.Line + 12);
+        Mod_Print(Reply);
+        Mod.Closes++;
+    } else
+    {
+        Mod.Unknown++;
+        Mod_Print("\r\nERROR\r\n");
+    }
+}
+
+
+/**
+ * @name    Mod_Rx
+ * @brief   The function takes one byte from the driver
+ *
+ * @author  Mehdi
+ */
+
+void Mod_Rx(uint8_t c)
+{
+    char Reply[48];
+
+    if (Mod.Need != 0)
+    {
+        if (Mod.TxLen < SIM_TX_SIZE - 1)
+            Mod.Tx[Mod.TxLen++] = c;
+
+        if (--Mod.Need == 0)
+        {
+            snprintf(Reply,sizeof(Reply),"\r\nRecv %u bytes\r\n\r\nSEND OK\r\n",Mod.SendLen);
+            Mod_Print(Reply);
+        }
+        return;
+    }
+
+    /* The command ends with "\r\n": the data follows the '\n' */
+    if (c == '\r')
+        return;
+
+    if (c != '\n')
+    {
+        if (Mod.LineLen < sizeof(Mod.Line) - 1)
+            Mod.Line[Mod.LineLen++] = c;
+        return;
+    }
+
+    Mod.Line[Mod.LineLen] = '\0';
+    Mod.LineLen = 0;
+    Mod_Line();
+}
+
+
+/***************************************************
+				S C R A P E
+****************************************************/
+
+typedef struct
+{
+    int     Served;				// Result of Metrics_Serve
+    char    Header[256];
+    char    Body[SIM_TX_SIZE];
+    size_t  BodyLen;
+    int     Framed;				// The chunks add up and end with the zero chunk
+} Test_Scrape;
+
+static const char Cwjap_Joined[] = "\r\n+CWJAP:\"HomeAP\",\"a4:2b:b0:11:22:33\",6,-61\r\n\r\nOK\r\n";
+static const char Cwjap_NoAp[]   = "\r\nNo AP\r\n\r\nOK\r\n";
+
+
+/**
+ * @name    Test_Get
+ * @brief   The function sends a request to the server loop and decodes
+ *              what the module was given
+ *
+ * @author  Mehdi
+ *
+ * @param	Request: the request line and headers
+ * @param	Size: buffer the server reads the request into
+ */
+
+static void Test_Get(const char* Request, uint16_t Size, Test_Scrape* Out)
+{
+    char Ipd[512];
+    uint8_t Data[512];
+    uint8_t Link;
+    int16_t n;
+    const char *p, *End;
+    char* q;
+    unsigned long Chunk;
+
+    memset(Out,0,sizeof(*Out));
+    Mod.TxLen = Mod.Sends = Mod.MaxSend = Mod.Closes = Mod.Unknown = 0;
+
+    snprintf(Ipd,sizeof(Ipd),"\r\n+IPD,0,%u:%s",(unsigned)strlen(Request),Request);
+    Mod_Print(Ipd);
+
+    n = ESP_ReadIPD(&Link,Data,Size,1000);
+    if (n < 0)
+    {
+        Out->Served = n;
+        return;
+    }
+    Out->Served = Metrics_Serve(Link,(const char*)Data,n);
+
+    /* Status line and headers */
+    Mod.Tx[Mod.TxLen] = '\0';
+    if ((p = strstr(Mod.Tx,"\r\n\r\n")) == NULL)
+        return;
+    snprintf(Out->Header,sizeof(Out->Header),"%.*s",(int)(p - Mod.Tx + 2),Mod.Tx);
+
+    /* Chunks: <hex>\r\n<data>\r\n ... 0\r\n\r\n */
+    p += 4;
+    End = Mod.Tx + Mod.TxLen;
+    while (p < End)
+    {
+        Chunk = strtoul(p,&q,16);
+        if (q == p || q + 2 > End || memcmp(q,"\r\n",2) != 0)
+            return;
+        p = q + 2;
+
+        if (Chunk == 0)
+        {
+            Out->Framed = (p + 2 == End && memcmp(p,"\r\n",2) == 0);
+            break;
+        }
+
+        if (p + Chunk + 2 > End || memcmp(p + Chunk,"\r\n",2) != 0 || Out->BodyLen + Chunk >= sizeof(Out->Body))
+            return;
+        memcpy(Out->Body + Out->BodyLen,p,Chunk);
+        Out->BodyLen += Chunk;
+        p += Chunk + 2;
+    }
+    Out->Body[Out->BodyLen] = '\0';
+
+    if (Test_Verbose)
+        printf("%s%s\n",Out->Header,Out->Body);
+}
+
+
+static void Test_Check(const char* Name, int Ok)
+{
+    Ok = Ok && Mod.Unknown == 0;
+
+    printf("%-40s %s\n", Name, Ok ? "ok" : "FAIL");
+
+    if (!Ok)
+        Test_Errors++;
+}
+
+
+/* A line of the body, whole */
+static int Test_Line(const Test_Scrape* S, const char* Line)
+{
+    size_t n = strlen(Line);
+    const char* p = S->Body;
+
+    while ((p = strstr(p,Line)) != NULL)
+    {
+        if ((p == S->Body || p[-1] == '\n') && p[n] == '\n')
+            return 1;
+        p++;
+    }
+
+    return 0;
+}
+
+
+/* Every line is a comment or "<name>[{<labels>}] <integer>" */
+static int Test_PromShape(const Test_Scrape* S)
+{
+    const char *p = S->Body, *q, *Sp;
+    char* e;
+
+    while (*p)
+    {
+        if ((q = strchr(p,'\n')) == NULL)
+            return 0;
+
+        if (*p != '#')
+        {
+            Sp = p + strcspn(p," ");
+            if (Sp >= q || Sp == p || (memchr(p,'{',Sp - p) != NULL && Sp[-1] != '}'))
+                return 0;
+            strtol(Sp + 1,&e,10);
+            if (e != q || e == Sp + 1)
+                return 0;
+        }
+        p = q + 1;
+    }
+
+    return 1;
+}
+
+
+/* The buckets of a command never decrease and the +Inf one is its count */
+static int Test_Histogram(const Test_Scrape* S, const char* Cmd, unsigned long Count)
+{
+    char Key[96];
+    const char* p = S->Body;
+    unsigned long Last = 0, v;
+    int Buckets = 0;
+
+    snprintf(Key,sizeof(Key),"at_command_latency_ms_bucket{cmd=\"%s\",le=\"",Cmd);
+    while ((p = strstr(p,Key)) != NULL)
+    {
+        p = strchr(p,' ');
+        v = strtoul(p + 1,NULL,10);
+        if (v < Last)
+            return 0;
+        Last = v;
+        Buckets++;
+    }
+
+    return Buckets == ATCMD_HIST_BINS && Last == Count;
+}
+
+
+/***************************************************
+				C A S E S
+****************************************************/
+
+static void Test_Metrics(void)
+{
+    Test_Scrape S;
+    unsigned long Before, Sends;
+    const char* p;
+
+    /* Traffic of a running node: latencies across the bins, a timeout, a failure */
+    ATCmd_Record(AT_ESP_CWMODE_Q,ATCMD_OK,8);
+    ATCmd_Record(AT_ESP_CWMODE_Q,ATCMD_OK,40);
+    ATCmd_Record(AT_ESP_CWMODE_Q,ATCMD_TIMEOUT,1000);
+    ATCmd_Record(AT_ESP_CIFSR,ATCMD_OK,350);
+    ATCmd_Record(AT_ESP_CIFSR,ATCMD_FAIL,2200);
+    ATCmd_Record(AT_ESP_CWJAP,ATCMD_OK,6400);
+    ATCmd_Record(AT_ESP_CIPSTART,ATCMD_OK,15001);
+
+    Mod.Cwjap = Cwjap_Joined;
+    Test_Get("GET /metrics HTTP/1.1\r\nHost: node\r\n\r\n",512,&S);
+
+    Test_Check("metrics: served, link closed",S.Served == ESP8266_OK && Mod.Closes == 1);
+    Test_Check("metrics: status line and headers",
+               strncmp(S.Header,"HTTP/1.1 200 OK\r\n",17) == 0 &&
+               strstr(S.Header,"Transfer-Encoding: chunked\r\n") != NULL &&
+               strstr(S.Header,"Content-Type: text/plain; version=0.0.4\r\n") != NULL);
+    Test_Check("metrics: chunked framing",S.Framed);
+    Test_Check("metrics: sends fit the chunk block",Mod.Sends > 1 && Mod.MaxSend <= METRICS_CHUNK_LEN - 1);
+    Test_Check("metrics: body larger than the block",S.BodyLen > METRICS_CHUNK_LEN);
+    Test_Check("metrics: line shape",Test_PromShape(&S));
+    Test_Check("metrics: uptime",Test_Line(&S,"uptime_seconds 3723"));
+    Test_Check("metrics: rssi",Test_Line(&S,"wifi_rssi_dbm -61"));
+    Test_Check("metrics: command counters",
+               Test_Line(&S,"at_commands_total{cmd=\"ESP_CWMODE_Q\"} 3") &&
+               Test_Line(&S,"at_command_timeouts_total{cmd=\"ESP_CWMODE_Q\"} 1") &&
+               Test_Line(&S,"at_command_failures_total{cmd=\"ESP_CIFSR\"} 1") &&
+               Test_Line(&S,"at_command_latency_max_ms{cmd=\"ESP_CIPSTART\"} 15001"));
+    Test_Check("metrics: unused commands left out",strstr(S.Body,"ESP_UART_CUR") == NULL);
+    Test_Check("metrics: histogram buckets",
+               Test_Line(&S,"at_command_latency_ms_bucket{cmd=\"ESP_CWMODE_Q\",le=\"20\"} 1") &&
+               Test_Line(&S,"at_command_latency_ms_bucket{cmd=\"ESP_CWMODE_Q\",le=\"100\"} 2") &&
+               Test_Line(&S,"at_command_latency_ms_bucket{cmd=\"ESP_CWMODE_Q\",le=\"1000\"} 3") &&
+               Test_Line(&S,"at_command_latency_ms_sum{cmd=\"ESP_CWMODE_Q\"} 1048") &&
+               Test_Histogram(&S,"ESP_CWMODE_Q",3) && Test_Histogram(&S,"ESP_CIFSR",2) &&
+               Test_Histogram(&S,"ESP_CIPSTART",1));
+    Test_Check("metrics: supervisor and pool",
+               strstr(S.Body,"link_faults_total{class=\"wifi_drop\"} ") != NULL &&
+               strstr(S.Body,"link_recoveries_total ") != NULL &&
+               strstr(S.Body,"bufpool_peak{class=\"large\"} ") != NULL &&
+               Test_Line(&S,"rx_overflows_total 0"));
+
+    /* The scrape shows up in the next one: AT+CWJAP? and the CIPSENDs were
+       recorded (a counter is read when its line is rendered, after the
+       chunks sent before it) */
+    Before = ATCmd_GetStat(AT_ESP_CIPSEND)->Count;
+    Test_Get("GET /metrics HTTP/1.1\r\n\r\n",512,&S);
+    p = strstr(S.Body,"at_commands_total{cmd=\"ESP_CIPSEND\"} ");
+    Sends = (p != NULL) ? strtoul(strchr(p,' ') + 1,NULL,10) : 0;
+    Test_Check("metrics: the scrape is counted",Sends >= Before && Sends <= Before + Mod.Sends &&
+               Test_Line(&S,"at_commands_total{cmd=\"ESP_CWJAP_Q\"} 2"));
+
+    printf("  /metrics: %u bytes in %u CIPSENDs of %u bytes at most, block of %u bytes\n",
+           (unsigned)S.BodyLen,Mod.Sends,Mod.MaxSend,(unsigned)METRICS_CHUNK_LEN);
+}
+
+
+static void Test_Status(void)
+{
+    Test_Scrape S;
+
+    Mod.Cwjap = Cwjap_Joined;
+    Test_Get("GET /status HTTP/1.1\r\n\r\n",512,&S);
+
+    Test_Check("status: served, link closed",S.Served == ESP8266_OK && Mod.Closes == 1);
+    Test_Check("status: json",strstr(S.Header,"Content-Type: application/json\r\n") != NULL && S.Framed &&
+               S.Body[0] == '{' && strcmp(S.Body + S.BodyLen - 2,"}\n") == 0 &&
+               strstr(S.Body,",,") == NULL && strstr(S.Body,"{,") == NULL);
+    Test_Check("status: members",
+               strstr(S.Body,"\"uptime_s\":3723") != NULL && strstr(S.Body,"\"rssi_dbm\":-61") != NULL &&
+               strstr(S.Body,"\"timeouts\":1") != NULL && strstr(S.Body,"\"rx_overflows\":0") != NULL);
+
+    /* Not joined: no RSSI */
+    Mod.Cwjap = Cwjap_NoAp;
+    Test_Get("GET /status?x=1 HTTP/1.1\r\n\r\n",512,&S);
+    Test_Check("status: not joined",S.Served == ESP8266_OK && S.Framed && strstr(S.Body,"rssi") == NULL &&
+               strstr(S.Body,"{\"uptime_s\":") == S.Body);
+}
+
+
+static void Test_Other(void)
+{
+    Test_Scrape S;
+
+    Test_Get("GET /metricsx HTTP/1.1\r\n\r\n",512,&S);
+    Test_Check("other path: left to the application",S.Served == 0 && Mod.TxLen == 0 && Mod.Closes == 0);
+
+    Test_Get("POST /metrics HTTP/1.1\r\n\r\n",512,&S);
+    Test_Check("other method: left to the application",S.Served == 0 && Mod.TxLen == 0);
+
+    /* A request longer than the buffer of the server loop: an RX overflow */
+    Mod.Cwjap = Cwjap_Joined;
+    Test_Get("GET /metrics HTTP/1.1\r\nUser-Agent: a-client-with-a-long-name/1.0\r\n\r\n",24,&S);
+    Test_Check("rx overflow counted",S.Served == ESP8266_OK && Test_Line(&S,"rx_overflows_total 1"));
+
+    Test_Check("pool blocks returned",BufPool_GetStat(BUFPOOL_SMALL)->InUse == 0 &&
+               BufPool_GetStat(BUFPOOL_LARGE)->InUse == 0);
+}
+
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+            Test_Verbose = 1;
+        else
+        {
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    USART_ESP = USART1;
+    Sim_Now = 3723000000000ULL;		// 1 h 2 min 3 s of uptime
+
+    Test_Metrics();
+    Test_Status();
+    Test_Other();
+
+    return Test_Errors ? 1 : 0;
+}
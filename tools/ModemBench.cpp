@@ -0,0 +1,563 @@
+/**
+ @file     ModemBench.cpp
+ @brief    Host check and benchmark of the C++ front-end (Modem.hpp)
+           against the C engine (ATEngine.h). A scripted ESP8266 answers
+           on USART1, a SIM900 with its echo on on USART2; each maps a
+           command line to its reply, and AT+CIPSEND takes its data after
+           the prompt. The module is reached through the host TM USART
+           library (kept out of line, as the library is on the target)
+           or through MockTransport, the inline transport of the checks.
+
+           The checks run the same commands through ATEngine and through
+           a Modem and compare the results and the lines: final line,
+           collected reply, failure, timeout, prompt and data, echo,
+           unsolicited lines, a line longer than the buffer. The bench
+           then times a connect/send/close sequence of six commands
+           through ATEngine, a Modem on the USART library and a Modem on
+           MockTransport. The clock is simulated, so the timeouts take no
+           real time; the bench reports host time.
+
+           A command of the wrong modem must not compile: build with
+           -DBENCH_WRONG_MODEM to see the error. Built with BENCH_SIZE,
+           the tool runs one sequence only (see tools/modemsize.sh).
+
+           The tool exits with 1 when a check fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -c ATCmd.c ATEngine.c ATResp.c
+               g++ -std=c++17 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o ModemBench tools/ModemBench.cpp ATCmd.o ATEngine.o ATResp.o
+
+           Usage:
+               ModemBench [-n <bench runs>]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Modem.hpp"
+
+
+#define SIM_STEP_NS					10000		// Clock step of a poll of the clock
+#define SIM_RX_SIZE					1024
+#define SIM_PORTS					3
+
+typedef struct
+{
+    const char* Cmd;
+    const char* Reply;			// NULL: no reply
+    const char* After;			// Not NULL: Reply ends with the prompt, After follows the data
+} Bench_Step;
+
+typedef struct
+{
+    uint8_t           Echo;
+    const Bench_Step* Steps;
+    const Bench_Step* Data;		// The step whose data is being taken
+    uint16_t          Need;
+    char              Line[128];
+    uint16_t          LineLen;
+    uint8_t           Cr;			// The last byte ended a command line
+    uint32_t          Unknown;
+
+    char              Rx[SIM_RX_SIZE];
+    uint16_t          RxHead, RxTail;
+} Bench_Module;
+
+static const Bench_Step Esp_Steps[] =
+{
+    { "AT",										"\r\nOK\r\n",								NULL },
+    { "AT+CWMODE?",								"\r\n+CWMODE:1\r\n\r\nOK\r\n",				NULL },
+    { "AT+CIPMUX=1",							"\r\nOK\r\n",								NULL },
+    { "AT+CIPSTART=0,\"TCP\",\"10.0.0.2\",80",	"0,CONNECT\r\n\r\nOK\r\n",					NULL },
+    { "AT+CIPSEND=0,5",							"\r\nOK\r\n> ",
+                                                "\r\nRecv 5 bytes\r\n\r\nSEND OK\r\n" },
+    { "AT+CIPCLOSE=0",							"0,CLOSED\r\n\r\nOK\r\n",					NULL },
+    { "AT+CIFSR",								NULL,										NULL },
+    { "AT+CIPSTATUS",							"\r\nSTATUS:2\r\n+CIPSTATUS:0,\"TCP\",\"10.0.0.2\",80,1024,0\r\n"
+                                                "+CIPSTATUS:1,\"TCP\",\"10.0.0.3\",80,1025,0\r\n\r\nOK\r\n",	NULL },
+    { "AT+CIPSERVER=1,80",						"\r\nERROR\r\n",							NULL },
+    { NULL, NULL, NULL }
+};
+
+static const Bench_Step Sim_Steps[] =
+{
+    { "AT",										"\r\nOK\r\n",								NULL },
+    { "AT+CREG?",								"\r\n+CREG: 2,1,\"00C1\",\"1A2B\"\r\n\r\nOK\r\n", NULL },
+    { "AT+CMGD=1",								"\r\n+CMS ERROR: 321\r\n",					NULL },
+    { NULL, NULL, NULL }
+};
+
+USART_TypeDef Host_USART[7] = {{0, 0},{1, 0},{2, 0},{3, 0},{4, 0},{5, 0},{6, 0}};	// Port, CR3
+uint32_t SystemCoreClock = 168000000;
+
+static uint64_t     Sim_Now;			// ns
+static Bench_Module Mods[SIM_PORTS];
+static uint32_t     Bench_Errors;
+static char         Bench_Urc[128];		// The last line a URC handler got
+static uint32_t     Bench_Urcs;
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+static void Mod_Print(Bench_Module* Mod, const char* Text)
+{
+    for (; *Text; Text++)
+    {
+        Mod->Rx[Mod->RxHead] = *Text;
+        Mod->RxHead = (Mod->RxHead + 1) % SIM_RX_SIZE;
+    }
+}
+
+
+static void Mod_Line(Bench_Module* Mod)
+{
+    const Bench_Step* Step;
+    const char* p;
+
+    for (Step = Mod->Steps; Step->Cmd != NULL && strcmp(Mod->Line, Step->Cmd) != 0; Step++)
+        ;
+
+    if (Step->Cmd == NULL)
+    {
+        Mod->Unknown++;
+        Mod_Print(Mod, "\r\nERROR\r\n");
+        return;
+    }
+
+    if (Step->Reply != NULL)
+        Mod_Print(Mod, Step->Reply);
+
+    if (Step->After != NULL)
+    {
+        Mod->Data = Step;
+        Mod->Need = ((p = strrchr(Mod->Line, ',')) != NULL) ? atoi(p + 1) : 1;
+    }
+}
+
+
+static inline void Mod_Rx(Bench_Module* Mod, char c)
+{
+    char Echo[2] = { c, '\0' };
+
+    /* The LF of a CR LF terminator is not data */
+    if (Mod->Cr)
+    {
+        Mod->Cr = 0;
+        if (c == '\n')
+            return;
+    }
+
+    if (Mod->Data != NULL)
+    {
+        if (--Mod->Need == 0)
+        {
+            Mod_Print(Mod, Mod->Data->After);
+            Mod->Data = NULL;
+        }
+        return;
+    }
+
+    if (Mod->Echo)
+        Mod_Print(Mod, Echo);
+
+    if (c == '\n')
+        return;
+
+    if (c != '\r')
+    {
+        if (Mod->LineLen < sizeof(Mod->Line) - 1)
+            Mod->Line[Mod->LineLen++] = c;
+        return;
+    }
+
+    Mod->Line[Mod->LineLen] = '\0';
+    Mod->LineLen = 0;
+    Mod->Cr = 1;
+    Mod_Line(Mod);
+}
+
+
+static inline uint16_t Mod_Pending(const Bench_Module* Mod)
+{
+    return (Mod->RxHead + SIM_RX_SIZE - Mod->RxTail) % SIM_RX_SIZE;
+}
+
+
+static inline char Mod_Getc(Bench_Module* Mod)
+{
+    char c;
+
+    if (Mod_Pending(Mod) == 0)
+        return 0;
+
+    c = Mod->Rx[Mod->RxTail];
+    Mod->RxTail = (Mod->RxTail + 1) % SIM_RX_SIZE;
+
+    return c;
+}
+
+
+static inline int16_t Mod_Find(const Bench_Module* Mod, char c)
+{
+    for (uint16_t i = 0, n = Mod_Pending(Mod); i < n; i++)
+        if (Mod->Rx[(Mod->RxTail + i) % SIM_RX_SIZE] == c)
+            return i;
+
+    return -1;
+}
+
+
+static void Mod_Reset(void)
+{
+    memset(Mods, 0, sizeof(Mods));
+
+    Mods[1].Steps = Esp_Steps;
+    Mods[2].Steps = Sim_Steps;
+    Mods[2].Echo = 1;
+}
+
+
+// The inline transport of the checks: the module itself
+template <uint8_t Port>
+struct MockTransport
+{
+    static void Send(const char* Data, uint16_t Len)
+    {
+        for (uint16_t i = 0; i < Len; i++)
+            Mod_Rx(&Mods[Port], Data[i]);
+    }
+
+    static void    Puts(const char* s) { while (*s) Mod_Rx(&Mods[Port], *s++); }
+    static char    Getc()              { return Mod_Getc(&Mods[Port]); }
+    static uint8_t Empty()             { return Mod_Pending(&Mods[Port]) == 0; }
+    static int16_t Find(char c)        { return Mod_Find(&Mods[Port], c); }
+};
+
+
+/***************************************************
+		H O S T   L I B R A R I E S
+****************************************************/
+
+// Out of line, as the TM library is on the target
+#define HOST_LIB					extern "C" __attribute__((noinline))
+
+HOST_LIB void TM_USART_Putc(USART_TypeDef* USARTx, volatile char c)
+{
+    Mod_Rx(&Mods[USARTx->Port % SIM_PORTS], c);
+}
+
+
+HOST_LIB void TM_USART_Puts(USART_TypeDef* USARTx, char* str)
+{
+    while (*str)
+        Mod_Rx(&Mods[USARTx->Port % SIM_PORTS], *str++);
+}
+
+
+HOST_LIB void TM_USART_Send(USART_TypeDef* USARTx, uint8_t* DataArray, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+        Mod_Rx(&Mods[USARTx->Port % SIM_PORTS], DataArray[i]);
+}
+
+
+HOST_LIB uint8_t TM_USART_Getc(USART_TypeDef* USARTx)
+{
+    return Mod_Getc(&Mods[USARTx->Port % SIM_PORTS]);
+}
+
+
+HOST_LIB uint8_t TM_USART_BufferEmpty(USART_TypeDef* USARTx)
+{
+    return Mod_Pending(&Mods[USARTx->Port % SIM_PORTS]) == 0;
+}
+
+
+HOST_LIB void TM_USART_ClearBuffer(USART_TypeDef* USARTx)
+{
+    Bench_Module* Mod = &Mods[USARTx->Port % SIM_PORTS];
+
+    Mod->RxTail = Mod->RxHead;
+}
+
+
+HOST_LIB int16_t TM_USART_FindCharacter(USART_TypeDef* USARTx, uint8_t c)
+{
+    return Mod_Find(&Mods[USARTx->Port % SIM_PORTS], c);
+}
+
+
+extern "C" uint32_t HAL_GetTick(void)
+{
+    Sim_Now += SIM_STEP_NS;
+    return Sim_Now / 1000000;
+}
+
+
+extern "C" uint64_t TimeBase_Now(void)
+{
+    Sim_Now += SIM_STEP_NS;
+    return Sim_Now / 1000;
+}
+
+
+/***************************************************
+				C H E C K S
+****************************************************/
+
+static uint8_t Bench_Report(const char* Line)
+{
+    snprintf(Bench_Urc, sizeof(Bench_Urc), "%s", Line);
+    Bench_Urcs++;
+
+    return strncmp(Line, "0,", 2) == 0;
+}
+
+struct EspTraits : Esp8266Traits
+{
+    static uint8_t Urc(const char* Line) { return Bench_Report(Line); }
+};
+
+struct SimTraits : Sim900Traits
+{
+    static uint8_t Urc(const char* Line) { return Bench_Report(Line); }
+};
+
+MODEM_PORT(EspPort, USART1);
+MODEM_PORT(SimPort, USART2);
+
+static Modem<EspTraits, MockTransport<1>, 128>         Esp;
+static Modem<EspTraits, UsartTransport<EspPort>, 128>  EspUsart;
+static Modem<SimTraits, MockTransport<2>, 128>         Sim;
+static Modem<EspTraits, MockTransport<1>, 16>          EspSmall;
+
+static ATEngine Eng_Esp, Eng_Sim;
+static char     Eng_EspLine[128], Eng_SimLine[128];
+
+#ifdef BENCH_WRONG_MODEM
+static void Bench_Wrong(void)
+{
+    Esp.Run<AT_SIM_CREG_Q>();		// error: command of another modem
+}
+#endif
+
+
+static void Bench_Check(const char* Name, int Ok)
+{
+    Ok = Ok && Mods[1].Unknown == 0 && Mods[2].Unknown == 0;
+
+    printf("%-48s %s\n", Name, Ok ? "ok" : "FAIL");
+
+    if (!Ok)
+        Bench_Errors++;
+}
+
+
+static void Bench_Checks(void)
+{
+    char CBuf[256], PBuf[256];
+    ATResp CResp, PResp;
+    int8_t CRes, PRes;
+    uint8_t i;
+    int Ok;
+
+    Mod_Reset();
+
+    CRes = ATEngine_Run(&Eng_Esp, AT_ESP_CWMODE_Q, NULL, NULL);
+    PRes = Esp.Run<AT_ESP_CWMODE_Q>();
+    Bench_Check("final line", CRes == ATENGINE_OK && PRes == CRes && strcmp(Eng_EspLine, Esp.Line) == 0 &&
+                strcmp(Esp.Line, "OK") == 0);
+
+    ATResp_Init(&CResp, CBuf, sizeof(CBuf));
+    ATResp_Init(&PResp, PBuf, sizeof(PBuf));
+    CRes = ATEngine_Run(&Eng_Esp, AT_ESP_CIPSTATUS, NULL, &CResp);
+    PRes = Esp.Run<AT_ESP_CIPSTATUS>(nullptr, &PResp);
+    Ok = CRes == ATENGINE_OK && PRes == CRes && CResp.Lines == PResp.Lines && PResp.Lines == 4;
+    for (i = 0; Ok && i < PResp.Lines; i++)
+        Ok = strcmp(ATResp_GetLine(&CResp, i), ATResp_GetLine(&PResp, i)) == 0;
+    Bench_Check("collected reply", Ok && ATResp_Find(&PResp, "+CIPSTATUS:", 0) == 1);
+
+    ATResp_Init(&CResp, CBuf, 48);
+    ATResp_Init(&PResp, PBuf, 48);
+    CRes = ATEngine_Run(&Eng_Esp, AT_ESP_CIPSTATUS, NULL, &CResp);
+    PRes = Esp.Run<AT_ESP_CIPSTATUS>(nullptr, &PResp);
+    Bench_Check("collector too small", PRes == CRes && PResp.Overflow && PResp.Lines == CResp.Lines);
+
+    CRes = ATEngine_Run(&Eng_Esp, AT_ESP_CIPSERVER_ON, NULL, NULL);
+    PRes = Esp.Run<AT_ESP_CIPSERVER_ON>();
+    Bench_Check("failure", CRes == ATENGINE_FAIL && PRes == CRes);
+
+    CRes = ATEngine_Run(&Eng_Esp, AT_ESP_CIFSR, NULL, NULL);
+    PRes = Esp.Run<AT_ESP_CIFSR>();
+    Bench_Check("timeout", CRes == ATENGINE_TIMEOUT && PRes == CRes &&
+                ATCmd_GetStat(AT_ESP_CIFSR)->Timeout == 2);
+
+    Bench_Urcs = 0;
+    PRes = Esp.Run<AT_ESP_CIPSTART>("0,\"TCP\",\"10.0.0.2\",80");
+    Bench_Check("unsolicited line", PRes == ATENGINE_OK && Bench_Urcs == 1 && strcmp(Bench_Urc, "0,CONNECT") == 0);
+
+    Esp.Send<AT_ESP_CIPSEND>("0,5");
+    Ok = Esp.Prompt(1000) == ATENGINE_OK;
+    Esp.Data("hello", 5);
+    Bench_Check("prompt and data", Ok && Esp.Wait("SEND OK", 1000) == ATENGINE_OK);
+
+    Bench_Urcs = 0;
+    Mod_Print(&Mods[1], "1,CLOSED\r\n");
+    Esp.Poll();
+    Bench_Check("poll", Bench_Urcs == 1 && strcmp(Bench_Urc, "1,CLOSED") == 0 && Mod_Pending(&Mods[1]) == 0);
+
+    CRes = ATEngine_Run(&Eng_Sim, AT_SIM_CREG_Q, NULL, NULL);
+    PRes = Sim.Run<AT_SIM_CREG_Q>();
+    Bench_Check("echo dropped", CRes == ATENGINE_OK && PRes == CRes && strcmp(Eng_SimLine, Sim.Line) == 0);
+
+    CRes = ATEngine_Run(&Eng_Sim, AT_SIM_CMGD, "1", NULL);
+    PRes = Sim.Run<AT_SIM_CMGD>("1");
+    Bench_Check("+CMS ERROR", CRes == ATENGINE_FAIL && PRes == CRes && strcmp(Sim.Line, "+CMS ERROR: 321") == 0);
+
+    PRes = EspSmall.Run<AT_ESP_CIPSTART>("0,\"TCP\",\"10.0.0.2\",80");
+    Bench_Check("line longer than the buffer", PRes == ATENGINE_OK && EspSmall.Overflows == 0);
+    PRes = EspSmall.Run<AT_ESP_CIPSTATUS>();
+    Bench_Check("  counted, reply still ends", PRes == ATENGINE_OK && EspSmall.Overflows == 2);
+
+    PRes = EspUsart.Run<AT_ESP_AT>();
+    Bench_Check("USART transport", PRes == ATENGINE_OK && strcmp(EspUsart.Line, "OK") == 0);
+}
+
+
+/***************************************************
+				B E N C H M A R K
+****************************************************/
+
+static uint64_t Bench_Clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/* Connect, send, close: six commands */
+__attribute__((noinline)) static int Seq_C(ATEngine* Eng)
+{
+    int Ok;
+
+    Ok = ATEngine_Run(Eng, AT_ESP_AT, NULL, NULL) == ATENGINE_OK;
+    Ok &= ATEngine_Run(Eng, AT_ESP_CWMODE_Q, NULL, NULL) == ATENGINE_OK;
+    Ok &= ATEngine_Run(Eng, AT_ESP_CIPMUX_ON, NULL, NULL) == ATENGINE_OK;
+    Ok &= ATEngine_Run(Eng, AT_ESP_CIPSTART, "0,\"TCP\",\"10.0.0.2\",80", NULL) == ATENGINE_OK;
+
+    ATEngine_Send(Eng, AT_ESP_CIPSEND, "0,5");
+    Ok &= ATEngine_Prompt(Eng, 1000) == ATENGINE_OK;
+    AT_Send(Eng->USARTx, "hello", 5);
+    Ok &= ATEngine_Wait(Eng, "SEND OK", NULL, 1000) == ATENGINE_OK;
+
+    Ok &= ATEngine_Run(Eng, AT_ESP_CIPCLOSE, "0", NULL) == ATENGINE_OK;
+
+    return Ok;
+}
+
+
+template <class M>
+__attribute__((noinline)) static int Seq_Cpp(M& Mdm)
+{
+    int Ok;
+
+    Ok = Mdm.template Run<AT_ESP_AT>() == ATENGINE_OK;
+    Ok &= Mdm.template Run<AT_ESP_CWMODE_Q>() == ATENGINE_OK;
+    Ok &= Mdm.template Run<AT_ESP_CIPMUX_ON>() == ATENGINE_OK;
+    Ok &= Mdm.template Run<AT_ESP_CIPSTART>("0,\"TCP\",\"10.0.0.2\",80") == ATENGINE_OK;
+
+    Mdm.template Send<AT_ESP_CIPSEND>("0,5");
+    Ok &= Mdm.Prompt(1000) == ATENGINE_OK;
+    Mdm.Data("hello", 5);
+    Ok &= Mdm.Wait("SEND OK", 1000) == ATENGINE_OK;
+
+    Ok &= Mdm.template Run<AT_ESP_CIPCLOSE>("0") == ATENGINE_OK;
+
+    return Ok;
+}
+
+
+static void Bench_Run(uint32_t Runs)
+{
+    uint64_t t0, t1, t2, t3;
+    int Ok = 1;
+
+    Mod_Reset();
+
+    t0 = Bench_Clock();
+    for (uint32_t i = 0; i < Runs; i++)
+        Ok &= Seq_C(&Eng_Esp);
+    t1 = Bench_Clock();
+    for (uint32_t i = 0; i < Runs; i++)
+        Ok &= Seq_Cpp(EspUsart);
+    t2 = Bench_Clock();
+    for (uint32_t i = 0; i < Runs; i++)
+        Ok &= Seq_Cpp(Esp);
+    t3 = Bench_Clock();
+
+    printf("\n%-32s %12s %12s\n", "6-command sequence", "ns/sequence", "ns/command");
+    printf("%-32s %12.0f %12.0f\n", "ATEngine (C)", (double)(t1 - t0) / Runs, (double)(t1 - t0) / Runs / 6);
+    printf("%-32s %12.0f %12.0f\n", "Modem, UsartTransport", (double)(t2 - t1) / Runs, (double)(t2 - t1) / Runs / 6);
+    printf("%-32s %12.0f %12.0f\n", "Modem, MockTransport (inline)", (double)(t3 - t2) / Runs, (double)(t3 - t2) / Runs / 6);
+
+    Bench_Check("bench sequences", Ok);
+}
+
+
+#ifdef BENCH_SIZE
+
+/* One sequence only, linked with --gc-sections by tools/modemsize.sh:
+   1 through ATEngine, 2 through a Modem on the USART library */
+int main(void)
+{
+    Mod_Reset();
+
+#if BENCH_SIZE == 1
+    ATEngine_Init(&Eng_Esp, USART1, Eng_EspLine, sizeof(Eng_EspLine), Bench_Report);
+    return !Seq_C(&Eng_Esp);
+#else
+    return !Seq_Cpp(EspUsart);
+#endif
+}
+
+#else
+
+int main(int argc, char** argv)
+{
+    uint32_t Runs = 200000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            Runs = strtoul(argv[++i], NULL, 0);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n <bench runs>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    ATEngine_Init(&Eng_Esp, USART1, Eng_EspLine, sizeof(Eng_EspLine), Bench_Report);
+    ATEngine_Init(&Eng_Sim, USART2, Eng_SimLine, sizeof(Eng_SimLine), Bench_Report);
+
+    Bench_Checks();
+    Bench_Run(Runs);
+
+    return Bench_Errors ? 1 : 0;
+}
+
+#endif
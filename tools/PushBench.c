@@ -0,0 +1,731 @@
+/**
+ @file     PushBench.c
+ @brief    Host benchmark of the upstream HTTP client (HttpPush.h) on the
+           ESP8266 driver, against a real HTTP server. The server is
+           forked on the loopback interface: HTTP/1.1 with keep-alive and
+           pipelining, it counts the sample lines of the requests it
+           answers with 200 (it closes after each response on /close, and
+           stops answering a link for good every BENCH_STALL_EVERY
+           requests on /stall, as a half-open TCP connection would).
+
+           The client runs on the unmodified driver (ESP8266.c and the AT
+           engine); an emulated module on USART1 takes its commands on a
+           simulated clock. AT+CIPSTART connects a socket to the server
+           and answers after the AT exchange and a round trip;
+           AT+CIPSEND prompts after a fixed overhead and writes the data
+           to the socket; AT+CIPCLOSE closes it. Each byte costs its time
+           at the UART baud rate, both ways. A response is sent to the
+           driver as "+IPD,<link>,<len>:" one round trip after its request,
+           whatever the driver is doing: with pipelining it often lands in
+           the middle of the next AT+CIPSEND. The close of the server
+           becomes "<link>,CLOSED". The bench reads them with ESP_ReadIPD,
+           as the server loop of the application does.
+
+           Samples of about 40 bytes (one JSON object per line) are made at
+           a fixed rate. For each setting the table shows the requests and
+           connections it took, the links closed on a late response, the
+           share of time the UART is busy (the link calls and the responses
+           read), the samples per second the UART could carry at that cost
+           (the samples acknowledged over the busy time) and the latency of
+           a sample from its due time to its 2xx. A setting that cannot keep
+           up fills the ring and drops samples. The samples the server
+           counted must match the ones acknowledged, and the module must
+           know every command; the tool exits with 1 otherwise.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o PushBench tools/PushBench.c tools/host/HostSim.c \
+                   HttpPush.c ESP8266.c ATCmd.c ATEngine.c ATResp.c LinkSup.c \
+                   FastJoin.c StatusSink.c AuxLib.c BufPool.c
+
+           Usage:
+               PushBench [-r <samples/s>] [-t <seconds>] [-R <round trip, ms>]
+                   [-o <CIPSEND overhead, us>] [-b <baud>]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ESP8266.h"
+#include "HttpPush.h"
+#include "TimeBase.h"
+#include "HostSim.h"
+
+
+#define BENCH_AT_US					20000		// AT+CIPSTART / AT+CIPCLOSE exchange, without the network
+#define BENCH_DRAIN_US				30000000	// Time given to the last samples after the run
+#define BENCH_DUE_MAX				16
+#define BENCH_WAIT_MS				200			// Real time a response is waited for before it is taken as lost
+#define BENCH_STALL_EVERY			40			// Requests on /stall between two links stalled
+
+typedef struct
+{
+    const char* Name;
+    const char* Path;
+    uint16_t    MaxBytes;
+    uint16_t    MaxAgeMs;
+} Bench_Setting;
+
+typedef struct
+{
+    char     Line[128];
+    uint16_t LineLen;
+    uint16_t Need;				// Data bytes of AT+CIPSEND left
+    uint16_t SendLen;
+    uint8_t  Tx[ESP_SEND_MAX];	// The data being taken
+    uint32_t Unknown;			// Commands not emulated
+
+    uint8_t  Link;
+    int      Fd;				// The socket of the link, -1: closed
+    uint64_t Due[BENCH_DUE_MAX];	// Arrival of the responses, in order (ns)
+    uint8_t  DueCount;
+    char     Sock[8192];		// Bytes of the server not sent yet
+    uint16_t SockLen;
+} Bench_Module;
+
+extern USART_TypeDef* USART_ESP;
+
+static int8_t Bench_Open(uint8_t Link, const char* Host, uint16_t Port);
+static int8_t Bench_Send(uint8_t Link, const uint8_t* const* Data, const uint16_t* Len, uint8_t Count);
+static int8_t Bench_Close(uint8_t Link);
+
+static const Bench_Setting Settings[] =
+{
+    { "connection per sample",  "/close", 0,   0    },
+    { "persistent, per sample", "/push",  0,   0    },
+    { "batch 128 B / 1 s",      "/push",  128, 1000 },
+    { "batch 256 B / 1 s",      "/push",  256, 1000 },
+    { "batch 256 B / 200 ms",   "/push",  256, 200  },
+    { "batch 256 B / 1 s, stall", "/stall", 256, 1000 },
+};
+
+static const HttpPush_Ops Bench_Ops = { Bench_Open, Bench_Send, Bench_Close };
+
+static Bench_Module Mod;
+static uint64_t     Bench_Busy;			// ns the UART carried a link call or a response
+static uint8_t      Bench_InCall;		// A link call runs
+static uint32_t     Bench_Rtt = 60000;	// us
+static uint32_t     Bench_Overhead = 4000;
+static uint32_t     Bench_Baud = 115200;
+static uint16_t     Bench_Port;
+
+
+/***************************************************
+				S E R V E R
+****************************************************/
+
+/**
+ * @name    Server_Connection
+ * @brief   The function serves one connection: pipelined requests, each
+ *              answered in order. POST counts the lines of its body;
+ *              GET /count answers the counts since the last one.
+ *
+ * @author  Mehdi
+ * @return  0 if the connection is stalled: it must be left open
+ */
+
+static int Server_Connection(int Fd, uint32_t* Lines, uint32_t* Bytes)
+{
+    static char Buf[16384];
+    static uint32_t Stall;
+    char Resp[128];
+    uint32_t Len = 0, Need, Head, i;
+    const char *End, *p;
+    ssize_t n;
+    int Close;
+
+    while ((n = read(Fd,Buf + Len,sizeof(Buf) - 1 - Len)) > 0)
+    {
+        Len += n;
+        Buf[Len] = '\0';
+
+        while ((End = strstr(Buf,"\r\n\r\n")) != NULL)
+        {
+            Head = End + 4 - Buf;
+            Need = ((p = strstr(Buf,"Content-Length: ")) != NULL && p < End) ? atoi(p + 16) : 0;
+            if (Len < Head + Need)
+                break;
+
+            /* Neither answered nor read any more, nor closed */
+            if (strncmp(Buf,"POST /stall ",12) == 0 && ++Stall % BENCH_STALL_EVERY == 0)
+                return 0;
+
+            for (i = 0; i < Need; i++)
+                if (Buf[Head + i] == '\n')
+                    (*Lines)++;
+            *Bytes += Need;
+
+            Close = (strncmp(Buf,"POST /close ",12) == 0);
+
+            if (strncmp(Buf,"GET /count ",11) == 0)
+            {
+                char Body[32];
+
+                snprintf(Body,sizeof(Body),"%u %u",(unsigned)*Lines,(unsigned)*Bytes);
+                n = snprintf(Resp,sizeof(Resp),"HTTP/1.1 200 OK\r\nContent-Length: %u\r\n\r\n%s",
+                             (unsigned)strlen(Body),Body);
+                *Lines = *Bytes = 0;
+            } else
+                n = snprintf(Resp,sizeof(Resp),"HTTP/1.1 200 OK\r\nContent-Length: 2\r\n%s\r\nok",
+                             Close ? "Connection: close\r\n" : "");
+
+            if (write(Fd,Resp,n) != n || Close)
+                return 1;
+
+            memmove(Buf,Buf + Head + Need,Len - Head - Need + 1);
+            Len -= Head + Need;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * @name    Server_Start
+ * @brief   The function forks the server on 127.0.0.1, on a port of the system
+ *
+ * @author  Mehdi
+ * @return  The pid of the server, or -1
+ */
+
+static pid_t Server_Start(void)
+{
+    struct sockaddr_in Addr;
+    socklen_t Size = sizeof(Addr);
+    uint32_t Lines = 0, Bytes = 0;
+    int Fd, Conn, On = 1;
+    pid_t Pid;
+
+    if ((Fd = socket(AF_INET,SOCK_STREAM,0)) < 0)
+        return -1;
+
+    setsockopt(Fd,SOL_SOCKET,SO_REUSEADDR,&On,sizeof(On));
+    memset(&Addr,0,sizeof(Addr));
+    Addr.sin_family = AF_INET;
+    Addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(Fd,(struct sockaddr*)&Addr,sizeof(Addr)) < 0 || listen(Fd,8) < 0 ||
+        getsockname(Fd,(struct sockaddr*)&Addr,&Size) < 0)
+    {
+        close(Fd);
+        return -1;
+    }
+
+    Bench_Port = ntohs(Addr.sin_port);
+
+    if ((Pid = fork()) == 0)
+    {
+        while ((Conn = accept(Fd,NULL,NULL)) >= 0)
+        {
+            if (Server_Connection(Conn,&Lines,&Bytes))
+                close(Conn);
+        }
+        _exit(0);
+    }
+
+    close(Fd);
+
+    return Pid;
+}
+
+
+/**
+ * @name    Server_Count
+ * @brief   The function asks the server for the lines it got since the
+ *              last call (GET /count on a connection of its own)
+ *
+ * @author  Mehdi
+ */
+
+static uint32_t Server_Count(void)
+{
+    struct sockaddr_in Addr;
+    char Buf[256];
+    const char* p;
+    int Fd, n, Len = 0;
+
+    memset(&Addr,0,sizeof(Addr));
+    Addr.sin_family = AF_INET;
+    Addr.sin_port = htons(Bench_Port);
+    Addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((Fd = socket(AF_INET,SOCK_STREAM,0)) < 0 || connect(Fd,(struct sockaddr*)&Addr,sizeof(Addr)) < 0 ||
+        write(Fd,"GET /count HTTP/1.1\r\n\r\n",23) != 23)
+        return 0;
+
+    while (Len < (int)sizeof(Buf) - 1 && (n = read(Fd,Buf + Len,sizeof(Buf) - 1 - Len)) > 0)
+    {
+        Len += n;
+        Buf[Len] = '\0';
+        if ((p = strstr(Buf,"\r\n\r\n")) != NULL && strchr(p + 4,' ') != NULL)
+            break;
+    }
+    close(Fd);
+
+    Buf[Len] = '\0';
+
+    return ((p = strstr(Buf,"\r\n\r\n")) != NULL) ? strtoul(p + 4,NULL,10) : 0;
+}
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+static uint64_t Mod_ByteNs(void)
+{
+    return 10ULL * 1000000000 / Bench_Baud;
+}
+
+
+static void Mod_Printf(uint64_t At, const char* Format, ...)
+{
+    char Text[64];
+    va_list Args;
+
+    va_start(Args,Format);
+    Mod_WriteAt(Text,vsnprintf(Text,sizeof(Text),Format,Args),At);
+    va_end(Args);
+}
+
+
+/* The server closed the link, or the driver did */
+static void Mod_Disconnect(void)
+{
+    if (Mod.Fd >= 0)
+        close(Mod.Fd);
+    Mod.Fd = -1;
+    Mod.DueCount = 0;
+    Mod.SockLen = 0;
+}
+
+
+/**
+ * @name    Mod_Complete
+ * @brief   The function tells the length of the first response the server
+ *              sent, if it arrived in full
+ *
+ * @author  Mehdi
+ * @return  The length, 0 if it is not complete
+ */
+
+static uint16_t Mod_Complete(void)
+{
+    const char *End, *p;
+    uint32_t Len;
+
+    Mod.Sock[Mod.SockLen] = '\0';
+
+    if ((End = strstr(Mod.Sock,"\r\n\r\n")) == NULL)
+        return 0;
+
+    Len = End + 4 - Mod.Sock;
+    if ((p = strstr(Mod.Sock,"Content-Length: ")) != NULL && p < End)
+        Len += atoi(p + 16);
+
+    return (Len <= Mod.SockLen) ? Len : 0;
+}
+
+
+/**
+ * @name    Mod_Respond
+ * @brief   The function sends the response of the oldest request as +IPD
+ *              data, its round trip being over. The socket is read until
+ *              the response is complete; the server closing it (or
+ *              answering "Connection: close") becomes "<link>,CLOSED".
+ *              A stalled link sends nothing.
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Respond(void)
+{
+    struct pollfd Poll = { .fd = Mod.Fd, .events = POLLIN };
+    const char* p;
+    uint16_t Len;
+    ssize_t n;
+    int Close;
+
+    memmove(Mod.Due,Mod.Due + 1,--Mod.DueCount * sizeof(Mod.Due[0]));
+
+    while ((Len = Mod_Complete()) == 0)
+    {
+        if (poll(&Poll,1,BENCH_WAIT_MS) <= 0)
+            return;
+
+        if ((n = read(Mod.Fd,Mod.Sock + Mod.SockLen,sizeof(Mod.Sock) - 1 - Mod.SockLen)) <= 0)
+        {
+            Mod_Disconnect();
+            Mod_Printf(Sim_Now,"%u,CLOSED\r\n",Mod.Link);
+            return;
+        }
+        Mod.SockLen += n;
+    }
+
+    Mod_Printf(Sim_Now,"\r\n+IPD,%u,%u:",Mod.Link,Len);
+    Mod_WriteAt(Mod.Sock,Len,Sim_Now);
+
+    /* Read by the server loop, unless it lands in a link call */
+    if (!Bench_InCall)
+        Bench_Busy += (Len + 14) * Mod_ByteNs();
+
+    Close = ((p = strstr(Mod.Sock,"Connection: close")) != NULL && p < Mod.Sock + Len);
+
+    memmove(Mod.Sock,Mod.Sock + Len,Mod.SockLen - Len);
+    Mod.SockLen -= Len;
+
+    if (Close)
+    {
+        Mod_Disconnect();
+        Mod_Printf(Sim_Now,"%u,CLOSED\r\n",Mod.Link);
+    }
+}
+
+
+/**
+ * @name    Mod_Tick
+ * @brief   The function moves the module to the current time: the
+ *              responses due by now are sent
+ *
+ * @author  Mehdi
+ */
+
+void Mod_Tick(void)
+{
+    if (Mod.DueCount != 0 && Mod.Due[0] <= Sim_Now)
+        Mod_Respond();
+}
+
+
+/**
+ * @name    Mod_Connect
+ * @brief   The function connects the socket of the link to the server
+ *
+ * @author  Mehdi
+ * @return  1, or 0 if the server cannot be reached
+ */
+
+static int Mod_Connect(void)
+{
+    struct sockaddr_in Addr;
+
+    memset(&Addr,0,sizeof(Addr));
+    Addr.sin_family = AF_INET;
+    Addr.sin_port = htons(Bench_Port);
+    Addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((Mod.Fd = socket(AF_INET,SOCK_STREAM,0)) < 0)
+        return 0;
+
+    if (connect(Mod.Fd,(struct sockaddr*)&Addr,sizeof(Addr)) < 0)
+    {
+        Mod_Disconnect();
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/**
+ * @name    Mod_Line
+ * @brief   The function answers a command line
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Line(void)
+{
+    const char* p;
+
+    if (strncmp(Mod.Line,"AT+CIPSTART=",12) == 0 && strstr(Mod.Line,",\"TCP\",") != NULL)
+    {
+        /* The host is always the loopback server */
+        Mod.Link = atoi(Mod.Line + 12);
+
+        if (Mod.Fd >= 0)
+            Mod_Printf(Sim_Now + BENCH_AT_US * 1000ULL,"ALREADY CONNECTED\r\n\r\nERROR\r\n");
+        else if (Mod_Connect())
+            Mod_Printf(Sim_Now + (BENCH_AT_US + Bench_Rtt) * 1000ULL,"%u,CONNECT\r\n\r\nOK\r\n",Mod.Link);
+        else
+            Mod_Printf(Sim_Now + (BENCH_AT_US + Bench_Rtt) * 1000ULL,"\r\nERROR\r\nCLOSED\r\n");
+    } else if (strncmp(Mod.Line,"AT+CIPSEND=",11) == 0 && (p = strchr(Mod.Line,',')) != NULL)
+    {
+        if (Mod.Fd < 0 || atoi(Mod.Line + 11) != Mod.Link)
+        {
+            Mod_Printf(Sim_Now,"\r\nlink is not valid\r\n\r\nERROR\r\n");
+            return;
+        }
+        Mod.SendLen = Mod.Need = atoi(p + 1);
+        Mod_Printf(Sim_Now + Bench_Overhead * 1000ULL,"\r\nOK\r\n> ");
+    } else if (strncmp(Mod.Line,"AT+CIPCLOSE=",12) == 0)
+    {
+        if (Mod.Fd < 0 || atoi(Mod.Line + 12) != Mod.Link)
+        {
+            Mod_Printf(Sim_Now + BENCH_AT_US * 1000ULL,"\r\nUNLINK\r\n\r\nERROR\r\n");
+            return;
+        }
+        Mod_Disconnect();
+        Mod_Printf(Sim_Now + BENCH_AT_US * 1000ULL,"%u,CLOSED\r\n\r\nOK\r\n",Mod.Link);
+    } else
+    {
+        Mod.Unknown++;
+        Mod_Printf(Sim_Now,"\r\nERROR\r\n");
+    }
+}
+
+
+/**
+ * @name    Mod_Rx
+ * @brief   The function takes one byte from the driver, which waits for
+ *              it to leave
+ *
+ * @author  Mehdi
+ */
+
+void Mod_Rx(uint8_t c)
+{
+    Sim_Now += Mod_ByteNs();
+
+    if (Mod.Need != 0)
+    {
+        Mod.Tx[Mod.SendLen - Mod.Need] = c;
+
+        if (--Mod.Need == 0)
+        {
+            if (Mod.Fd >= 0 && Mod.DueCount < BENCH_DUE_MAX && write(Mod.Fd,Mod.Tx,Mod.SendLen) == Mod.SendLen)
+            {
+                Mod.Due[Mod.DueCount++] = Sim_Now + Bench_Rtt * 1000ULL;
+                Mod_Printf(Sim_Now,"\r\nRecv %u bytes\r\n\r\nSEND OK\r\n",Mod.SendLen);
+            } else
+                Mod_Printf(Sim_Now,"\r\nRecv %u bytes\r\n\r\nSEND FAIL\r\n",Mod.SendLen);
+        }
+        return;
+    }
+
+    /* The command ends with "\r\n": the data follows the '\n' */
+    if (c == '\r')
+        return;
+
+    if (c != '\n')
+    {
+        if (Mod.LineLen < sizeof(Mod.Line) - 1)
+            Mod.Line[Mod.LineLen++] = c;
+        return;
+    }
+
+    Mod.Line[Mod.LineLen] = '\0';
+    Mod.LineLen = 0;
+    Mod_Line();
+}
+
+
+/* Empties the module between two settings */
+static void Mod_Reset(void)
+{
+    Mod_Disconnect();
+    Mod.LineLen = Mod.Need = 0;
+    Mod.Unknown = 0;
+    Mod_Flush();
+}
+
+
+/***************************************************
+				B E N C H
+****************************************************/
+
+/* The link calls of the client: the driver, timed */
+static int8_t Bench_Open(uint8_t Link, const char* Host, uint16_t Port)
+{
+    uint64_t Start = Sim_Now;
+    int8_t res;
+
+    Bench_InCall = 1;
+    res = ESP_TcpOpen(Link,Host,Port);
+    Bench_InCall = 0;
+    Bench_Busy += Sim_Now - Start;
+
+    return res;
+}
+
+
+static int8_t Bench_Send(uint8_t Link, const uint8_t* const* Data, const uint16_t* Len, uint8_t Count)
+{
+    uint64_t Start = Sim_Now;
+    int8_t res;
+
+    Bench_InCall = 1;
+    res = ESP_SendParts(Link,Data,Len,Count);
+    Bench_InCall = 0;
+    Bench_Busy += Sim_Now - Start;
+
+    return res;
+}
+
+
+static int8_t Bench_Close(uint8_t Link)
+{
+    uint64_t Start = Sim_Now;
+    int8_t res;
+
+    Bench_InCall = 1;
+    res = ESP_Close(Link);
+    Bench_InCall = 0;
+    Bench_Busy += Sim_Now - Start;
+
+    return res;
+}
+
+
+/**
+ * @name    Bench_Run
+ * @brief   The function runs one setting and prints its row
+ *
+ * @author  Mehdi
+ * @return  1 if the server did not get the samples acknowledged (the
+ *              samples dropped on a full ring are not counted) or the
+ *              module got a command it does not know
+ */
+
+static int Bench_Run(const Bench_Setting* Set, uint32_t Rate, uint32_t Seconds)
+{
+    static HttpPush Push;
+    char Sample[64];
+    uint8_t Rx[256], Link;
+    uint64_t Start, Period = 1000000000ULL / Rate, Next, End, Stop, Elapsed;
+    uint64_t* Due = calloc(Rate * Seconds + 1,sizeof(uint64_t));
+    uint64_t LatSum = 0, LatMax = 0, Lat;
+    uint32_t Made = 0, Kept = 0, Seen = 0, Counted;
+    int8_t res;
+    int n;
+
+    Mod_Reset();
+    Bench_Busy = 0;
+    Start = Next = Sim_Now;
+    End = Start + Seconds * 1000000000ULL;
+    Stop = End + BENCH_DRAIN_US * 1000ULL;
+
+    HttpPush_Init(&Push,&Bench_Ops,"127.0.0.1",Bench_Port,Set->Path,Set->MaxBytes,Set->MaxAgeMs);
+
+    while (Sim_Now < Stop && (Next < End || Push.Stat.Acked < Kept))
+    {
+        /* The samples due by now */
+        while (Next < End && Next <= Sim_Now)
+        {
+            n = snprintf(Sample,sizeof(Sample),"{\"seq\":%u,\"t\":%u,\"v\":%d}\n",
+                         (unsigned)Made,(unsigned)((Next - Start) / 1000000),(int)(Made * 37 % 1000) - 500);
+            Made++;
+
+            res = HttpPush_Put(&Push,Sample,n);
+            if (res != HTTPPUSH_FULL && res != HTTPPUSH_TOO_LONG)
+                Due[Kept++] = Next;
+            Next += Period;
+        }
+
+        /* The server loop of the application, until the module is silent for 1 ms */
+        while ((n = ESP_ReadIPD(&Link,Rx,sizeof(Rx),1)) != ESP8266_TIMEOUT)
+        {
+            if (Link == HTTPPUSH_LINK && n > 0)
+                HttpPush_Input(&Push,Rx,n);
+            else if (Link == HTTPPUSH_LINK && n == ESP8266_CLOSED)
+                HttpPush_Closed(&Push);
+        }
+
+        HttpPush_Poll(&Push);
+        if (Next >= End)
+            HttpPush_Flush(&Push);
+
+        for (; Seen < Push.Stat.Acked && Seen < Kept; Seen++)
+        {
+            Lat = Sim_Now - Due[Seen];
+            LatSum += Lat;
+            if (Lat > LatMax)
+                LatMax = Lat;
+        }
+    }
+
+    if (Push.Up)
+        Bench_Close(HTTPPUSH_LINK);
+
+    Counted = Server_Count();
+    Elapsed = Sim_Now - Start;
+
+    printf("%-24s %6u %6u %5u %5u %5u %5u %4u %6.1f%% %8.0f %7.0f %7.0f%s%s\n",
+           Set->Name,(unsigned)Made,(unsigned)Push.Stat.Acked,(unsigned)Push.Stat.Dropped,(unsigned)Push.Stat.Requests,
+           (unsigned)Push.Stat.Connects,(unsigned)Push.Stat.Resent,(unsigned)Push.Stat.Timeouts,
+           100.0 * Bench_Busy / (Elapsed ? Elapsed : 1),
+           Bench_Busy ? Push.Stat.Acked * 1e9 / Bench_Busy : 0.0,
+           Seen ? LatSum / 1e6 / Seen : 0.0,LatMax / 1e6,
+           (Counted != Push.Stat.Acked) ? "  server count differs" : "",
+           (Mod.Unknown != 0) ? "  unknown command" : "");
+
+    free(Due);
+
+    return Counted != Push.Stat.Acked || Mod.Unknown != 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    uint32_t Rate = 10, Seconds = 60;
+    pid_t Server;
+    int i, Failed = 0;
+
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i],"-r") == 0)
+            Rate = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-t") == 0)
+            Seconds = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-R") == 0)
+            Bench_Rtt = atoi(argv[i + 1]) * 1000;
+        else if (strcmp(argv[i],"-o") == 0)
+            Bench_Overhead = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-b") == 0)
+            Bench_Baud = atoi(argv[i + 1]);
+    }
+
+    if (Rate == 0 || Seconds == 0 || Bench_Baud == 0)
+        return 1;
+
+    if ((Server = Server_Start()) < 0)
+    {
+        fprintf(stderr,"PushBench: no loopback server\n");
+        return 1;
+    }
+
+    USART_ESP = USART1;
+    Sim_ByteNs = Mod_ByteNs();
+    Mod.Fd = -1;
+
+    printf("%u samples/s for %u s, round trip %u ms, CIPSEND overhead %u us, %u baud, pipeline %u\n\n",
+           (unsigned)Rate,(unsigned)Seconds,(unsigned)(Bench_Rtt / 1000),(unsigned)Bench_Overhead,
+           (unsigned)Bench_Baud,HTTPPUSH_PIPELINE);
+    printf("%-24s %6s %6s %5s %5s %5s %5s %4s %7s %8s %7s %7s\n","setting","made","acked","drop","reqs","conns","resnt",
+           "tmo","uart","ceiling/s","lat ms","max ms");
+
+    for (i = 0; i < (int)(sizeof(Settings) / sizeof(Settings[0])); i++)
+        Failed |= Bench_Run(&Settings[i],Rate,Seconds);
+
+    kill(Server,SIGTERM);
+    waitpid(Server,NULL,0);
+
+    return Failed;
+}
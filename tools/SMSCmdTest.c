@@ -0,0 +1,451 @@
+/**
+ @file     SMSCmdTest.c
+ @brief    Host check and benchmark of the SMS command dispatcher
+           (SMSCmd.h). The checks run SMSCmd_Dispatch on bodies as they
+           come from SIM900ReadMsg: every verb of the table is found, in
+           any case; unknown verbs, wrong argument counts and malformed
+           bodies are refused; wrong PINs lock the dispatcher until
+           SMSCMD_LOCK_MS has passed; the handlers get their arguments
+           and fill the reply.
+
+           The benchmark times a lookup through the generated hash
+           (SMSCmdHash.c) against a chain of string compares over the
+           same table, then over synthetic tables of 8 to 120 verbs
+           placed by the same search as tools/mkcmdhash.py: the hash
+           stays flat while the chain grows with the table.
+
+           The tool exits with 1 when a check fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -I. -o SMSCmdTest tools/SMSCmdTest.c \
+                   SMSCmd.c SMSCmdHash.c
+
+           Usage:
+               SMSCmdTest [-v]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "SMSCmd.h"
+
+
+#define BENCH_ROUNDS				2000000
+#define BENCH_MAX					120
+
+typedef struct
+{
+    uint8_t Argc;
+    char    Argv[SMSCMD_MAX_ARGS][16];
+    uint8_t Calls;
+} Test_Call;
+
+static Test_Call Test_Last[SMSCMD_COUNT];
+static int       Test_Errors;
+static int       Test_Verbose;
+
+
+static int8_t Test_Handler(uint8_t Id, uint8_t Argc, char** Argv, char* Reply, uint16_t Size)
+{
+    Test_Call* Call = &Test_Last[Id];
+    uint8_t i;
+
+    Call->Argc = Argc;
+    for (i = 0; i < Argc; i++)
+        snprintf(Call->Argv[i], sizeof(Call->Argv[i]), "%s", Argv[i]);
+    Call->Calls++;
+
+    snprintf(Reply, Size, "%s done", SMSCmd_Table[Id].Verb);
+
+    /* INTERVAL takes seconds; anything else fails */
+    if (Id == SMSCMD_INTERVAL && atoi(Argv[0]) <= 0)
+        return SMSCMD_FAIL;
+
+    return SMSCMD_OK;
+}
+
+#define TEST_HANDLER(Id, Verb, Min, Max)									\
+    static int8_t Test_##Id(uint8_t Argc, char** Argv, char* Reply, uint16_t Size)	\
+    {																		\
+        return Test_Handler(SMSCMD_##Id, Argc, Argv, Reply, Size);			\
+    }
+SMSCMD_TABLE(TEST_HANDLER)
+#undef TEST_HANDLER
+
+
+static void Test_Check(const char* Name, int Ok)
+{
+    printf("%-44s %s\n", Name, Ok ? "ok" : "FAIL");
+
+    if (!Ok)
+        Test_Errors++;
+}
+
+
+static int8_t Test_Run(const char* Body, char* Reply, uint32_t Now)
+{
+    char Msg[161];
+    int8_t Res;
+
+    snprintf(Msg, sizeof(Msg), "%s", Body);
+    Res = SMSCmd_Dispatch(Msg, Reply, 64, Now);
+
+    if (Test_Verbose)
+        printf("  \"%s\" -> %d \"%s\"\n", Body, Res, Reply);
+
+    return Res;
+}
+
+
+static void Test_Lookup(void)
+{
+    char Lower[32];
+    int Ok = 1;
+    uint8_t Id, i;
+
+    for (Id = 0; Id < SMSCMD_COUNT; Id++)
+    {
+        Ok &= SMSCmd_Find(SMSCmd_Table[Id].Verb, SMSCmd_Table[Id].Len) == Id;
+
+        for (i = 0; i <= SMSCmd_Table[Id].Len; i++)
+            Lower[i] = (SMSCmd_Table[Id].Verb[i] >= 'A' && SMSCmd_Table[Id].Verb[i] <= 'Z') ?
+                       SMSCmd_Table[Id].Verb[i] + 'a' - 'A' : SMSCmd_Table[Id].Verb[i];
+        Ok &= SMSCmd_Find(Lower, SMSCmd_Table[Id].Len) == Id;
+    }
+    Test_Check("every verb found, any case (hash is current)", Ok);
+
+    Test_Check("unknown verbs refused",
+               SMSCmd_Find("LIGHT5", 6) < 0 && SMSCmd_Find("LIGHT", 5) < 0 &&
+               SMSCmd_Find("LIGHT11", 7) < 0 && SMSCmd_Find("", 0) < 0 &&
+               SMSCmd_Find("STATU5", 6) < 0 && SMSCmd_Find("\xC3\x89TAT", 5) < 0);
+}
+
+
+static void Test_Dispatch(void)
+{
+    char Reply[64];
+    int8_t Res;
+
+    Res = Test_Run("PIN 1234 LIGHT1 ON", Reply, 0);
+    Test_Check("command run", Res == SMSCMD_OK && Test_Last[SMSCMD_LIGHT1].Calls == 1 &&
+               Test_Last[SMSCMD_LIGHT1].Argc == 1 && strcmp(Test_Last[SMSCMD_LIGHT1].Argv[0], "ON") == 0 &&
+               strcmp(Reply, "LIGHT1 done") == 0);
+
+    Res = Test_Run("  pin\t1234  report\r\n+33612345678 \r\n", Reply, 0);
+    Test_Check("any case, any blanks", Res == SMSCMD_OK && Test_Last[SMSCMD_REPORT].Argc == 1 &&
+               strcmp(Test_Last[SMSCMD_REPORT].Argv[0], "+33612345678") == 0);
+
+    Res = Test_Run("PIN 1234 REPORT", Reply, 0);
+    Test_Check("optional argument left out", Res == SMSCMD_OK && Test_Last[SMSCMD_REPORT].Argc == 0);
+
+    Test_Check("too few arguments", Test_Run("PIN 1234 LIGHT2", Reply, 0) == SMSCMD_INVALID &&
+               Test_Last[SMSCMD_LIGHT2].Calls == 0);
+    Test_Check("too many arguments", Test_Run("PIN 1234 STATUS NOW", Reply, 0) == SMSCMD_INVALID &&
+               Test_Run("PIN 1234 LIGHT2 ON OFF ON OFF ON", Reply, 0) == SMSCMD_INVALID);
+    Test_Check("unknown verb", Test_Run("PIN 1234 LIGHT9 ON", Reply, 0) == SMSCMD_UNKNOWN);
+    Test_Check("not a command", Test_Run("Hello, see you at 8", Reply, 0) == SMSCMD_INVALID &&
+               Test_Run("PIN 1234", Reply, 0) == SMSCMD_INVALID && Test_Run("", Reply, 0) == SMSCMD_INVALID &&
+               Test_Run("PINS 1234 STATUS", Reply, 0) == SMSCMD_INVALID);
+    Test_Check("handler failure", Test_Run("PIN 1234 INTERVAL -5", Reply, 0) == SMSCMD_FAIL &&
+               Test_Run("PIN 1234 INTERVAL 300", Reply, 0) == SMSCMD_OK);
+
+    SMSCmd_Register(SMSCMD_REBOOT, NULL);
+    Test_Check("no handler: unknown", Test_Run("PIN 1234 REBOOT", Reply, 0) == SMSCMD_UNKNOWN);
+    SMSCmd_Register(SMSCMD_REBOOT, Test_REBOOT);
+}
+
+
+static void Test_Pin(void)
+{
+    char Reply[64];
+    uint32_t Locked;
+    int Ok = 1;
+    uint8_t i;
+
+    Locked = SMSCmd_GetStat()->Locked;
+
+    Test_Check("wrong PIN", Test_Run("PIN 1235 STATUS", Reply, 1000) == SMSCMD_DENIED &&
+               Test_Run("PIN 123 STATUS", Reply, 1000) == SMSCMD_DENIED &&
+               Test_Run("PIN 12345 STATUS", Reply, 1000) == SMSCMD_DENIED &&
+               Test_Run("PIN 1234\xFF STATUS", Reply, 1000) == SMSCMD_DENIED &&
+               Test_Last[SMSCMD_STATUS].Calls == 0);
+
+    /* The right PIN resets the count */
+    Test_Check("right PIN resets the tries", Test_Run("PIN 1234 STATUS", Reply, 1000) == SMSCMD_OK);
+
+    for (i = 0; i < SMSCMD_PIN_TRIES; i++)
+        Ok &= Test_Run("PIN 0000 STATUS", Reply, 2000) == SMSCMD_DENIED;
+    Test_Check("locked after the tries", Ok && Test_Run("PIN 1234 STATUS", Reply, 2000) == SMSCMD_DENIED &&
+               Test_Run("PIN 1234 STATUS", Reply, 2000 + SMSCMD_LOCK_MS - 1) == SMSCMD_DENIED &&
+               SMSCmd_GetStat()->Locked == Locked + 2);
+    Test_Check("unlocked after the lock time",
+               Test_Run("PIN 1234 STATUS", Reply, 2000 + SMSCMD_LOCK_MS) == SMSCMD_OK);
+
+    Test_Check("PIN changed", SMSCmd_SetPin("87654321") == SMSCMD_OK &&
+               Test_Run("PIN 1234 STATUS", Reply, 0) == SMSCMD_DENIED &&
+               Test_Run("PIN 87654321 STATUS", Reply, 0) == SMSCMD_OK);
+    Test_Check("bad PINs refused", SMSCmd_SetPin("123") == SMSCMD_INVALID &&
+               SMSCmd_SetPin("123456789") == SMSCMD_INVALID && SMSCmd_SetPin("12a4") == SMSCMD_INVALID &&
+               SMSCmd_SetPin("") == SMSCMD_INVALID && Test_Run("PIN 87654321 STATUS", Reply, 0) == SMSCMD_OK);
+}
+
+
+/***************************************************
+				B E N C H M A R K
+****************************************************/
+
+typedef struct
+{
+    char     Verb[BENCH_MAX][12];
+    uint8_t  Len[BENCH_MAX];
+    uint32_t Hash[BENCH_MAX];
+    uint16_t Disp[BENCH_MAX];
+    uint8_t  Slot[BENCH_MAX];
+    uint8_t  Count;
+    uint8_t  Buckets;
+} Bench_Table;
+
+static Bench_Table   Bench;
+static volatile long Bench_Sink;
+
+
+static uint64_t Bench_Clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static uint32_t Bench_Fnv(const char* s, uint8_t Len)
+{
+    uint32_t h = 2166136261UL;
+
+    while (Len--)
+        h = (h ^ (uint8_t)*s++) * 16777619UL;
+
+    return h;
+}
+
+
+static uint32_t Bench_Mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x85EBCA6BUL;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35UL;
+    x ^= x >> 16;
+
+    return x;
+}
+
+
+/* The search of tools/mkcmdhash.py, over synthetic verbs */
+static int Bench_Build(uint8_t Count)
+{
+    uint8_t Taken[BENCH_MAX], Order[BENCH_MAX], Size[BENCH_MAX];
+    uint8_t i, j, k, b;
+    uint32_t d;
+
+    Bench.Count = Count;
+    Bench.Buckets = (Count + 1) / 2;
+
+    memset(Size, 0, sizeof(Size));
+    for (i = 0; i < Count; i++)
+    {
+        Bench.Len[i] = snprintf(Bench.Verb[i], sizeof(Bench.Verb[i]), "CMD%03u%c", i * 7, 'A' + i % 26);
+        Bench.Hash[i] = Bench_Fnv(Bench.Verb[i], Bench.Len[i]);
+        Size[Bench.Hash[i] % Bench.Buckets]++;
+        Bench.Slot[i] = 0xFF;
+    }
+
+    /* Largest buckets first */
+    for (i = 0; i < Bench.Buckets; i++)
+        Order[i] = i;
+    for (i = 0; i < Bench.Buckets; i++)
+        for (j = i + 1; j < Bench.Buckets; j++)
+            if (Size[Order[j]] > Size[Order[i]])
+            {
+                k = Order[i];
+                Order[i] = Order[j];
+                Order[j] = k;
+            }
+
+    for (b = 0; b < Bench.Buckets && Size[Order[b]] != 0; b++)
+    {
+        for (d = 0; d < 65536; d++)
+        {
+            uint8_t n = 0, Ok = 1;
+
+            for (i = 0; i < Count && Ok; i++)
+            {
+                if (Bench.Hash[i] % Bench.Buckets != Order[b])
+                    continue;
+
+                Taken[n] = Bench_Mix(Bench.Hash[i] ^ d) % Count;
+                Ok = Bench.Slot[Taken[n]] == 0xFF;
+                for (j = 0; j < n && Ok; j++)
+                    Ok = Taken[j] != Taken[n];
+                n++;
+            }
+
+            if (Ok)
+                break;
+        }
+
+        if (d == 65536)
+            return 0;
+
+        Bench.Disp[Order[b]] = d;
+        for (i = 0; i < Count; i++)
+            if (Bench.Hash[i] % Bench.Buckets == Order[b])
+                Bench.Slot[Bench_Mix(Bench.Hash[i] ^ d) % Count] = i;
+    }
+
+    return 1;
+}
+
+
+static int Bench_Hash(const char* Verb, uint8_t Len)
+{
+    uint32_t h = Bench_Fnv(Verb, Len);
+    uint8_t Id = Bench.Slot[Bench_Mix(h ^ Bench.Disp[h % Bench.Buckets]) % Bench.Count];
+
+    return (Bench.Len[Id] == Len && memcmp(Bench.Verb[Id], Verb, Len) == 0) ? Id : -1;
+}
+
+
+static int Bench_Chain(const char* Verb, uint8_t Len)
+{
+    uint8_t i;
+
+    for (i = 0; i < Bench.Count; i++)
+        if (Bench.Len[i] == Len && strncasecmp(Bench.Verb[i], Verb, Len) == 0)
+            return i;
+
+    return -1;
+}
+
+
+static int Bench_TableChain(const char* Verb, uint8_t Len)
+{
+    uint8_t i;
+
+    for (i = 0; i < SMSCMD_COUNT; i++)
+        if (SMSCmd_Table[i].Len == Len && strncasecmp(SMSCmd_Table[i].Verb, Verb, Len) == 0)
+            return i;
+
+    return -1;
+}
+
+
+/* ns per lookup, cycling over the verbs */
+static double Bench_Time(int (*Find)(const char*, uint8_t), const char* const* Verbs, const uint8_t* Lens,
+                         uint8_t Count)
+{
+    uint64_t t0;
+    long Sum = 0;
+    uint32_t i;
+
+    t0 = Bench_Clock();
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        Sum += Find(Verbs[i % Count], Lens[i % Count]);
+    Bench_Sink = Sum;
+
+    return (double)(Bench_Clock() - t0) / BENCH_ROUNDS;
+}
+
+
+static int Bench_Find(const char* Verb, uint8_t Len)
+{
+    return SMSCmd_Find(Verb, Len);
+}
+
+
+static void Bench_Run(void)
+{
+    static const uint8_t Sizes[] = { 8, 16, 32, 64, 120 };
+    const char* Verbs[BENCH_MAX + 1];
+    uint8_t Lens[BENCH_MAX + 1];
+    uint8_t i, s;
+    int Ok = 1;
+
+    printf("\n%-22s %10s %10s\n", "lookup", "hash ns", "chain ns");
+
+    for (i = 0; i < SMSCMD_COUNT; i++)
+    {
+        Verbs[i] = SMSCmd_Table[i].Verb;
+        Lens[i] = SMSCmd_Table[i].Len;
+    }
+    printf("%-22s %10.1f %10.1f\n", "SMSCMD_TABLE, hits",
+           Bench_Time(Bench_Find, Verbs, Lens, SMSCMD_COUNT),
+           Bench_Time(Bench_TableChain, Verbs, Lens, SMSCMD_COUNT));
+
+    Verbs[0] = "LIGHT9";
+    Lens[0] = 6;
+    printf("%-22s %10.1f %10.1f\n", "SMSCMD_TABLE, miss",
+           Bench_Time(Bench_Find, Verbs, Lens, 1), Bench_Time(Bench_TableChain, Verbs, Lens, 1));
+
+    for (s = 0; s < sizeof(Sizes); s++)
+    {
+        char Name[32];
+
+        if (!Bench_Build(Sizes[s]))
+        {
+            printf("%u verbs: no displacement found\n", Sizes[s]);
+            Ok = 0;
+            continue;
+        }
+
+        for (i = 0; i < Bench.Count; i++)
+        {
+            Verbs[i] = Bench.Verb[i];
+            Lens[i] = Bench.Len[i];
+            Ok &= Bench_Hash(Verbs[i], Lens[i]) == i;
+        }
+
+        snprintf(Name, sizeof(Name), "%u verbs, hits", Sizes[s]);
+        printf("%-22s %10.1f %10.1f\n", Name, Bench_Time(Bench_Hash, Verbs, Lens, Bench.Count),
+               Bench_Time(Bench_Chain, Verbs, Lens, Bench.Count));
+    }
+
+    Test_Check("synthetic tables placed", Ok);
+}
+
+
+int main(int argc, char** argv)
+{
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+            Test_Verbose = 1;
+        else
+        {
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+#define TEST_REGISTER(Id, Verb, Min, Max)	SMSCmd_Register(SMSCMD_##Id, Test_##Id);
+    SMSCMD_TABLE(TEST_REGISTER)
+#undef TEST_REGISTER
+
+    Test_Lookup();
+    Test_Dispatch();
+    Test_Pin();
+    Bench_Run();
+
+    return Test_Errors ? 1 : 0;
+}
@@ -0,0 +1,567 @@
+/**
+ @file     SMSPduTest.c
+ @brief    Host check and benchmark of the SMS PDU codec (SMSPdu.h). The
+           checks run the codec on known PDUs and on round trips: every
+           character of the GSM 03.38 default alphabet and of its
+           extension table, septet packing behind 0 to 6 fill bits, UCS-2
+           with surrogate pairs, the 160 / 70 character limits of one
+           message, segments that never split an escape or a surrogate
+           pair, and texts sent as SMS-SUBMIT and read back as the
+           SMS-DELIVER the recipient gets. The reassembly table of the
+           received segments (SMSConcat.h) is checked with segments out of
+           order and repeated, 8 and 16-bit references, two senders using
+           the same reference, eviction by age and for room, and the
+           SMSCONCAT_PARTS limit.
+
+           The benchmark times the encode (SMSPdu_BuildText + SMSPdu_ToHex)
+           and decode (SMSPdu_FromHex + SMSPdu_ParseDeliver + SMSPdu_Text)
+           of full messages in both alphabets.
+
+           The tool exits with 1 when a check fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -I. -o SMSPduTest tools/SMSPduTest.c SMSPdu.c \
+                   SMSConcat.c
+
+           Usage:
+               SMSPduTest [-v]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SMSPdu.h"
+#include "SMSConcat.h"
+
+
+#define BENCH_ROUNDS				200000
+
+#define TEST_NUMBER					"+46708251358"
+#define TEST_OTHER					"+46708251359"
+
+static int Test_Errors;
+static int Test_Verbose;
+
+static char Test_From[SMSPDU_NUM_LEN + 2];		// Last message of SMSConcat
+static char Test_Text[SMSCONCAT_TEXT_LEN];
+static int  Test_Complete;
+
+
+static void Test_Check(const char* Name, int Ok)
+{
+    printf("%-44s %s\n", Name, Ok ? "ok" : "FAIL");
+
+    if (!Ok)
+        Test_Errors++;
+}
+
+
+/* The text repeated Count times */
+static char* Test_Repeat(char* Out, const char* Text, uint16_t Count)
+{
+    uint16_t i, n = strlen(Text);
+
+    for (i = 0; i < Count; i++)
+        memcpy(Out + i * n, Text, n);
+    Out[Count * n] = '\0';
+
+    return Out;
+}
+
+
+/**
+ * @name    Test_Deliver
+ * @brief   The function turns an SMS-SUBMIT of SMSPdu_Build into the
+ *              SMS-DELIVER the recipient gets: same address, alphabet and
+ *              user data, a service centre time stamp in place of TP-MR
+ *              and TP-VP
+ *
+ * @author  Mehdi
+ *
+ * @return	the length of the SMS-DELIVER
+ */
+
+static uint16_t Test_Deliver(const uint8_t* Submit, uint16_t Len, uint8_t* Deliver)
+{
+    static const uint8_t Scts[7] = { 0x62, 0x01, 0x91, 0x41, 0x03, 0x52, 0x88 };	// 26-10-19 14:30:25 -02:00
+    uint16_t Da = 2 + (Submit[3] + 1) / 2;
+    uint16_t n = 0;
+
+    Deliver[n++] = 0x00;									// SCA
+    Deliver[n++] = 0x04 | (Submit[1] & 0x40);				// SMS-DELIVER, TP-MMS, TP-UDHI
+    memcpy(Deliver + n, Submit + 3, Da);					// TP-OA
+    n += Da;
+    Deliver[n++] = Submit[3 + Da];							// TP-PID
+    Deliver[n++] = Submit[3 + Da + 1];						// TP-DCS
+    memcpy(Deliver + n, Scts, sizeof(Scts));
+    n += sizeof(Scts);
+    memcpy(Deliver + n, Submit + 3 + Da + 3, Len - (3 + Da + 3));	// TP-UDL, TP-UD
+    n += Len - (3 + Da + 3);
+
+    return n;
+}
+
+
+/* Text -> SMS-SUBMIT -> SMS-DELIVER -> text */
+static int Test_RoundTrip(const char* Text, uint8_t Dcs)
+{
+    uint8_t Pdu[SMSPDU_MAX_LEN], Rx[SMSPDU_MAX_LEN];
+    char Hex[2 * SMSPDU_MAX_LEN + 1], Back[SMSPDU_TEXT_LEN + 64];
+    static SMSPdu_Deliver Msg;
+    int16_t Len;
+
+    if ((Len = SMSPdu_BuildText(TEST_NUMBER, Text, 0, Pdu, sizeof(Pdu))) < 0)
+        return 0;
+
+    SMSPdu_ToHex(Rx, Test_Deliver(Pdu, Len, Rx), Hex);
+    if ((Len = SMSPdu_FromHex(Hex, Rx, sizeof(Rx))) < 0 ||
+        SMSPdu_ParseDeliver(Rx, Len, &Msg) != SMSPDU_OK ||
+        SMSPdu_Text(&Msg, Back, sizeof(Back)) < 0)
+        return 0;
+
+    if (Test_Verbose)
+        printf("  %s\n  -> \"%s\"\n", Hex, Back);
+
+    return Msg.Dcs == Dcs && strcmp(Msg.Number, TEST_NUMBER) == 0 && strcmp(Back, Text) == 0;
+}
+
+
+static void Test_Known(void)
+{
+    uint8_t Pdu[SMSPDU_SUBMIT_LEN], Rx[SMSPDU_MAX_LEN];
+    char Hex[2 * SMSPDU_MAX_LEN + 1], Text[SMSPDU_TEXT_LEN];
+    SMSPdu_Deliver Msg;
+    SMSPdu_Report Report;
+    int16_t Len;
+
+    /* The example of the 23.040 tutorials, TP-VP 24 h */
+    Len = SMSPdu_BuildText("+46708251358", "hellohello", 0, Pdu, sizeof(Pdu));
+    SMSPdu_ToHex(Pdu, Len > 0 ? Len : 0, Hex);
+    Test_Check("SMS-SUBMIT, hellohello",
+               strcmp(Hex, "0011000B916407281553F80000A70AE8329BFD4697D9EC37") == 0);
+
+    Len = SMSPdu_BuildText("0612345678", "Hi", 1, Pdu, sizeof(Pdu));
+    SMSPdu_ToHex(Pdu, Len > 0 ? Len : 0, Hex);
+    Test_Check("SMS-SUBMIT, national, status report",
+               strcmp(Hex, "0031000A8160214365870000A702C834") == 0);
+
+    /* An SMS-DELIVER from an alphanumeric sender ("Orange"), -02:00 */
+    Len = SMSPdu_FromHex("07913396050066F0040BD04F79D87D2E03000062019141035288" "05E8329BFD06\r\n", Rx, sizeof(Rx));
+    Test_Check("SMS-DELIVER, alphanumeric sender",
+               Len > 0 && SMSPdu_ParseDeliver(Rx, Len, &Msg) == SMSPDU_OK &&
+               strcmp(Msg.Number, "Orange") == 0 && Msg.Scts[0] == 26 && Msg.Scts[1] == 10 &&
+               Msg.Scts[2] == 19 && Msg.Scts[5] == 25 && Msg.Tz == -8 &&
+               SMSPdu_Text(&Msg, Text, sizeof(Text)) == 5 && strcmp(Text, "hello") == 0);
+
+    Len = SMSPdu_FromHex("0006230B916407281553F862019141035200620191410362000000", Rx, sizeof(Rx));
+    Test_Check("SMS-STATUS-REPORT", Len > 0 && SMSPdu_ParseReport(Rx, Len, &Report) == SMSPDU_OK &&
+               Report.MsgRef == 0x23 && Report.Status == 0 && strcmp(Report.Number, "+46708251358") == 0);
+
+    Test_Check("malformed PDUs refused",
+               SMSPdu_FromHex("0011", Rx, sizeof(Rx)) == 2 && SMSPdu_ParseDeliver(Rx, 2, &Msg) == SMSPDU_INVALID &&
+               SMSPdu_FromHex("000", Rx, sizeof(Rx)) == SMSPDU_INVALID &&
+               SMSPdu_FromHex("0004", Rx, 1) == SMSPDU_TOO_LONG &&
+               SMSPdu_ParseDeliver(Rx, 0, &Msg) == SMSPDU_INVALID &&
+               SMSPdu_BuildText("+33 6", "x", 0, Pdu, sizeof(Pdu)) == SMSPDU_INVALID &&
+               SMSPdu_BuildText("", "x", 0, Pdu, sizeof(Pdu)) == SMSPDU_INVALID);
+}
+
+
+static void Test_Alphabet(void)
+{
+    static const char* const Ext[] = { "\f", "^", "{", "}", "\\", "[", "~", "]", "|", "\xE2\x82\xAC" };
+    uint8_t Septet, Back[16];
+    char Text[8];
+    int Ok = 1;
+    uint8_t i;
+
+    /* Every septet but the escape decodes to a character that encodes back to it */
+    for (Septet = 0; Septet < 128; Septet++)
+    {
+        if (Septet == 0x1B)
+            continue;
+        Ok &= SMSPdu_GsmDecode(&Septet, 1, Text, sizeof(Text)) > 0 &&
+              SMSPdu_GsmEncode(Text, Back, sizeof(Back)) == 1 && Back[0] == Septet;
+    }
+    Test_Check("default alphabet, 127 characters", Ok);
+
+    for (i = 0, Ok = 1; i < sizeof(Ext) / sizeof(Ext[0]); i++)
+        Ok &= SMSPdu_GsmEncode(Ext[i], Back, sizeof(Back)) == 2 && Back[0] == 0x1B &&
+              SMSPdu_GsmDecode(Back, 2, Text, sizeof(Text)) > 0 && strcmp(Text, Ext[i]) == 0;
+    Test_Check("extension table, 10 characters", Ok);
+
+    Back[0] = 0x1B;
+    Back[1] = 0x41;
+    Test_Check("unknown extension shown as the default",
+               SMSPdu_GsmDecode(Back, 2, Text, sizeof(Text)) == 1 && strcmp(Text, "A") == 0);
+
+    Test_Check("characters out of the alphabet refused",
+               SMSPdu_GsmEncode("caf\xC3\xA9 \xC3\xA2", Back, sizeof(Back)) == SMSPDU_INVALID &&
+               SMSPdu_GsmEncode("`", Back, sizeof(Back)) == SMSPDU_INVALID);
+
+    Test_Check("round trip, default and extension",
+               Test_RoundTrip("@\xC2\xA3$\xC2\xA5\xC3\xA8\xC3\xA9 \xCE\x94_\xCE\xA6 \xC3\x85\xC3\xA5 "
+                              "\xC2\xA1\xC2\xBF \xC3\x84\xC3\x96\xC3\x91\xC3\x9C\xC2\xA7 "
+                              "[x] {y} ~z~ a|b c\\d 5\xE2\x82\xAC ^", SMSPDU_DCS_7BIT));
+}
+
+
+static void Test_Packing(void)
+{
+    uint8_t Septets[SMSPDU_UD_SEPTETS], Back[SMSPDU_UD_SEPTETS], Octets[SMSPDU_UD_OCTETS + 1];
+    uint16_t Count, n;
+    uint8_t Fill;
+    int Ok = 1;
+
+    srand(1);
+    for (Count = 0; Count < SMSPDU_UD_SEPTETS; Count++)
+        Septets[Count] = rand() & 0x7F;
+
+    for (Fill = 0; Fill < 7; Fill++)
+    {
+        for (Count = 1; Count <= SMSPDU_UD_SEPTETS - 1; Count++)
+        {
+            memset(Octets, 0xFF, sizeof(Octets));
+            n = SMSPdu_Pack7(Septets, Count, Fill, Octets);
+            SMSPdu_Unpack7(Octets, Count, Fill, Back);
+
+            Ok &= n == (Fill + Count * 7 + 7) / 8 && (Octets[0] & ((1 << Fill) - 1)) == 0 &&
+                  memcmp(Septets, Back, Count) == 0;
+        }
+    }
+    Test_Check("septets packed behind 0..6 fill bits", Ok);
+
+    n = SMSPdu_Pack7(Septets, SMSPDU_UD_SEPTETS, 0, Octets);
+    SMSPdu_Unpack7(Octets, SMSPDU_UD_SEPTETS, 0, Back);
+    Test_Check("160 septets in 140 octets", n == SMSPDU_UD_OCTETS && memcmp(Septets, Back, n) == 0);
+}
+
+
+static void Test_Ucs2(void)
+{
+    uint8_t Ucs2[16];
+    char Text[16];
+
+    /* U+1F600: D83D DE00 */
+    Test_Check("surrogate pair encoded",
+               SMSPdu_Ucs2Encode("a\xF0\x9F\x98\x80", Ucs2, sizeof(Ucs2)) == 6 &&
+               memcmp(Ucs2, "\x00" "a" "\xD8\x3D\xDE\x00", 6) == 0);
+    Test_Check("surrogate pair decoded",
+               SMSPdu_Ucs2Decode(Ucs2, 6, Text, sizeof(Text)) == 5 && strcmp(Text, "a\xF0\x9F\x98\x80") == 0);
+    Test_Check("no room for the pair",
+               SMSPdu_Ucs2Encode("a\xF0\x9F\x98\x80", Ucs2, 5) == SMSPDU_TOO_LONG &&
+               SMSPdu_Ucs2Decode(Ucs2, 6, Text, 4) == SMSPDU_TOO_LONG && strcmp(Text, "a") == 0);
+
+    Test_Check("round trip, UCS-2",
+               Test_RoundTrip("\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xE4\xBD\xA0\xE5\xA5\xBD "
+                              "caf\xC3\xA9 \xF0\x9F\x98\x80\xF0\x9F\x8C\x8D!", SMSPDU_DCS_UCS2));
+}
+
+
+static void Test_Limits(void)
+{
+    uint8_t Pdu[SMSPDU_MAX_LEN], Ud[SMSPDU_UD_SEPTETS + 2];
+    char Text[4 * SMSPDU_UD_SEPTETS + 8];
+    int16_t Len;
+
+    Test_Check("160 GSM characters", Test_RoundTrip(Test_Repeat(Text, "a", 160), SMSPDU_DCS_7BIT));
+    Test_Check("161 GSM characters refused",
+               SMSPdu_BuildText(TEST_NUMBER, Test_Repeat(Text, "a", 161), 0, Pdu, sizeof(Pdu)) == SMSPDU_TOO_LONG);
+
+    /* The euro sign takes two septets */
+    Test_Check("158 characters and a euro sign",
+               Test_RoundTrip(strcat(Test_Repeat(Text, "a", 158), "\xE2\x82\xAC"), SMSPDU_DCS_7BIT));
+    Test_Check("159 characters and a euro sign refused",
+               SMSPdu_BuildText(TEST_NUMBER, strcat(Test_Repeat(Text, "a", 159), "\xE2\x82\xAC"), 0,
+                                Pdu, sizeof(Pdu)) == SMSPDU_TOO_LONG);
+
+    Test_Check("70 UCS-2 characters", Test_RoundTrip(Test_Repeat(Text, "\xD0\x96", 70), SMSPDU_DCS_UCS2));
+    Test_Check("71 UCS-2 characters refused",
+               SMSPdu_BuildText(TEST_NUMBER, Test_Repeat(Text, "\xD0\x96", 71), 0, Pdu, sizeof(Pdu)) == SMSPDU_TOO_LONG);
+    Test_Check("35 characters out of the BMP",
+               Test_RoundTrip(Test_Repeat(Text, "\xF0\x9F\x98\x80", 35), SMSPDU_DCS_UCS2) &&
+               SMSPdu_BuildText(TEST_NUMBER, Test_Repeat(Text, "\xF0\x9F\x98\x80", 36), 0,
+                                Pdu, sizeof(Pdu)) == SMSPDU_TOO_LONG);
+
+    /* Segments: an escape and its septet, or a surrogate pair, stay together */
+    Len = SMSPdu_GsmEncode(strcat(Test_Repeat(Text, "a", SMSPDU_CONCAT_SEPTETS - 1), "\xE2\x82\xAC"),
+                           Ud, sizeof(Ud));
+    Test_Check("segment keeps the escape with its septet",
+               Len == SMSPDU_CONCAT_SEPTETS + 1 &&
+               SMSPdu_Segment(Ud, Len, SMSPDU_DCS_7BIT, SMSPDU_CONCAT_SEPTETS) == SMSPDU_CONCAT_SEPTETS - 1 &&
+               SMSPdu_Segment(Ud + 1, Len - 1, SMSPDU_DCS_7BIT, SMSPDU_CONCAT_SEPTETS) == SMSPDU_CONCAT_SEPTETS);
+
+    Len = SMSPdu_Ucs2Encode(strcat(Test_Repeat(Text, "\xD0\x96", SMSPDU_CONCAT_OCTETS / 2 - 1),
+                                   "\xF0\x9F\x98\x80"), Ud, sizeof(Ud));
+    Test_Check("segment keeps the surrogate pair",
+               Len == SMSPDU_CONCAT_OCTETS + 2 &&
+               SMSPdu_Segment(Ud, Len, SMSPDU_DCS_UCS2, SMSPDU_CONCAT_OCTETS) == SMSPDU_CONCAT_OCTETS - 2);
+}
+
+
+static void Test_Concat(void)
+{
+    uint8_t Septets[2 * SMSPDU_UD_SEPTETS], Pdu[SMSPDU_MAX_LEN], Rx[SMSPDU_MAX_LEN], Udh[SMSPDU_CONCAT_UDH_LEN];
+    char Text[SMSPDU_TEXT_LEN], Back[SMSPDU_TEXT_LEN];
+    SMSPdu_Submit Msg;
+    SMSPdu_Deliver In;
+    uint16_t Ref;
+    uint8_t Total, Seq;
+    int16_t Len;
+
+    /* A full segment: 6-octet header padded with one fill bit, 153 septets
+       (the escapes fall so that none is split at the end) */
+    Msg.Number = TEST_NUMBER;
+    Msg.Dcs = SMSPDU_DCS_7BIT;
+    Msg.Report = 1;
+    Msg.Validity = SMSPDU_VP_24H;
+    Msg.UdhLen = SMSPdu_ConcatUdh(Udh, 0x42, 3, 2);
+    Msg.Udh = Udh;
+    Msg.Ud = Septets;
+    Text[0] = 'x';
+    Test_Repeat(Text + 1, "0123456789{}", 12);
+    Msg.UdLen = SMSPdu_GsmEncode(Text, Septets, sizeof(Septets));
+    Msg.UdLen = SMSPdu_Segment(Septets, Msg.UdLen, SMSPDU_DCS_7BIT, SMSPDU_CONCAT_SEPTETS);
+
+    Len = SMSPdu_Build(&Msg, Pdu, sizeof(Pdu));
+    Test_Check("segment, 7-bit, one fill bit",
+               Len > 0 && Pdu[1] == 0x71 && Pdu[3 + 8 + 3] == 160 &&
+               SMSPdu_ParseDeliver(Rx, Test_Deliver(Pdu, Len, Rx), &In) == SMSPDU_OK &&
+               SMSPdu_GetConcat(&In, &Ref, &Total, &Seq) && Ref == 0x42 && Total == 3 && Seq == 2 &&
+               In.UdLen == Msg.UdLen && memcmp(In.Ud, Septets, In.UdLen) == 0 &&
+               SMSPdu_Text(&In, Back, sizeof(Back)) > 0 && strncmp(Back, Text, strlen(Back)) == 0);
+
+    /* UCS-2 segment: the header needs no fill */
+    Msg.Dcs = SMSPDU_DCS_UCS2;
+    Msg.UdLen = SMSPdu_Ucs2Encode(Test_Repeat(Text, "\xD0\x96", SMSPDU_CONCAT_OCTETS / 2), Septets,
+                                  SMSPDU_CONCAT_OCTETS);
+    Len = SMSPdu_Build(&Msg, Pdu, sizeof(Pdu));
+    Test_Check("segment, UCS-2",
+               Len > 0 && Pdu[3 + 8 + 3] == SMSPDU_UD_OCTETS &&
+               SMSPdu_ParseDeliver(Rx, Test_Deliver(Pdu, Len, Rx), &In) == SMSPDU_OK &&
+               SMSPdu_GetConcat(&In, &Ref, &Total, &Seq) && Seq == 2 &&
+               SMSPdu_Text(&In, Back, sizeof(Back)) > 0 && strcmp(Back, Text) == 0);
+
+    Msg.UdLen++;
+    Test_Check("segment too long refused", SMSPdu_Build(&Msg, Pdu, sizeof(Pdu)) == SMSPDU_TOO_LONG);
+}
+
+
+static void Test_Reassembled(const char* Number, const char* Text)
+{
+    strcpy(Test_From, Number);
+    strcpy(Test_Text, Text);
+    Test_Complete++;
+}
+
+
+/* A received 7-bit segment, 8-bit reference (Wide 0) or 16-bit */
+static const SMSPdu_Deliver* Test_Segment(const char* Number, uint16_t Ref, uint8_t Wide,
+                                          uint8_t Total, uint8_t Seq, const char* Text)
+{
+    static SMSPdu_Deliver Msg;
+    uint8_t n = 0;
+
+    memset(&Msg, 0, sizeof(Msg));
+    strcpy(Msg.Number, Number);
+    Msg.Dcs = SMSPDU_DCS_7BIT;
+
+    Msg.Udh[n++] = Wide ? 0x08 : 0x00;
+    Msg.Udh[n++] = Wide ? 4 : 3;
+    if (Wide)
+        Msg.Udh[n++] = Ref >> 8;
+    Msg.Udh[n++] = Ref & 0xFF;
+    Msg.Udh[n++] = Total;
+    Msg.Udh[n++] = Seq;
+    Msg.UdhLen = n;
+
+    Msg.UdLen = SMSPdu_GsmEncode(Text, Msg.Ud, SMSPDU_CONCAT_SEPTETS);
+
+    return &Msg;
+}
+
+
+/* The last message reassembled is this one, from this sender */
+static int Test_Got(int Complete, const char* Number, const char* Text)
+{
+    return Test_Complete == Complete && strcmp(Test_From, Number) == 0 && strcmp(Test_Text, Text) == 0;
+}
+
+
+static void Test_Reassembly(void)
+{
+    const SMSConcat_Stat* Stat = SMSConcat_GetStat();
+    static SMSPdu_Deliver Single;
+    uint32_t Evicted, Duplicates, Dropped;
+    uint8_t i, Ok;
+    char Part[4];
+
+    SMSConcat_Init(Test_Reassembled);
+
+    memset(&Single, 0, sizeof(Single));
+    strcpy(Single.Number, TEST_NUMBER);
+    Single.UdLen = SMSPdu_GsmEncode("alone", Single.Ud, sizeof(Single.Ud));
+    Test_Check("concat: single message at once",
+               SMSConcat_Add(&Single, 0) == SMSCONCAT_COMPLETE && Test_Got(1, TEST_NUMBER, "alone"));
+
+    /* 3, 1, 1 again, 2 */
+    Duplicates = Stat->Duplicates;
+    Ok = SMSConcat_Add(Test_Segment(TEST_NUMBER, 0x42, 0, 3, 3, "cc"), 0) == SMSCONCAT_STORED &&
+         SMSConcat_Add(Test_Segment(TEST_NUMBER, 0x42, 0, 3, 1, "aa"), 0) == SMSCONCAT_STORED &&
+         SMSConcat_Add(Test_Segment(TEST_NUMBER, 0x42, 0, 3, 1, "xx"), 0) == SMSCONCAT_STORED &&
+         Test_Complete == 1 &&
+         SMSConcat_Add(Test_Segment(TEST_NUMBER, 0x42, 0, 3, 2, "bb"), 0) == SMSCONCAT_COMPLETE;
+    Test_Check("concat: out of order, duplicate kept once",
+               Ok && Test_Got(2, TEST_NUMBER, "aabbcc") && Stat->Duplicates == Duplicates + 1);
+
+    /* 0x1234 and the 8-bit 0x34 are two messages */
+    Ok = SMSConcat_Add(Test_Segment(TEST_NUMBER, 0x1234, 1, 2, 1, "wide"), 0) == SMSCONCAT_STORED &&
+         SMSConcat_Add(Test_Segment(TEST_NUMBER, 0x34, 0, 2, 2, "narrow"), 0) == SMSCONCAT_STORED &&
+         SMSConcat_Add(Test_Segment(TEST_NUMBER, 0x1234, 1, 2, 2, "-ref"), 0) == SMSCONCAT_COMPLETE;
+    Test_Check("concat: 16-bit reference", Ok && Test_Got(3, TEST_NUMBER, "wide-ref"));
+
+    /* Two senders, same reference */
+    SMSConcat_Init(Test_Reassembled);
+    Ok = SMSConcat_Add(Test_Segment(TEST_NUMBER, 7, 0, 2, 1, "a1"), 0) == SMSCONCAT_STORED &&
+         SMSConcat_Add(Test_Segment(TEST_OTHER, 7, 0, 2, 1, "b1"), 0) == SMSCONCAT_STORED &&
+         SMSConcat_Add(Test_Segment(TEST_NUMBER, 7, 0, 2, 2, "a2"), 0) == SMSCONCAT_COMPLETE &&
+         Test_Got(4, TEST_NUMBER, "a1a2") &&
+         SMSConcat_Add(Test_Segment(TEST_OTHER, 7, 0, 2, 2, "b2"), 0) == SMSCONCAT_COMPLETE;
+    Test_Check("concat: two senders, same reference", Ok && Test_Got(5, TEST_OTHER, "b1b2"));
+
+    /* A partial message is kept SMSCONCAT_MAX_AGE, not longer */
+    SMSConcat_Init(Test_Reassembled);
+    Evicted = Stat->Evicted;
+    SMSConcat_Add(Test_Segment(TEST_NUMBER, 8, 0, 2, 1, "old"), 1000);
+    SMSConcat_Poll(1000 + SMSCONCAT_MAX_AGE);
+    Ok = (Stat->Evicted == Evicted);
+    SMSConcat_Poll(1000 + SMSCONCAT_MAX_AGE + 1);
+    Test_Check("concat: evicted by age",
+               Ok && Stat->Evicted == Evicted + 1 &&
+               SMSConcat_Add(Test_Segment(TEST_NUMBER, 8, 0, 2, 2, "new"), 2000) == SMSCONCAT_STORED);
+
+    /* One message more than the slots: the oldest goes */
+    SMSConcat_Init(Test_Reassembled);
+    Evicted = Stat->Evicted;
+    for (i = 0; i <= SMSCONCAT_SLOTS; i++)
+        SMSConcat_Add(Test_Segment(TEST_NUMBER, 10 + i, 0, 2, 1, "p"), 100 * (i + 1));
+    Test_Check("concat: oldest evicted for room",
+               Stat->Evicted == Evicted + 1 &&
+               SMSConcat_Add(Test_Segment(TEST_NUMBER, 10, 0, 2, 2, "q"), 1000) == SMSCONCAT_STORED &&
+               SMSConcat_Add(Test_Segment(TEST_NUMBER, 10 + SMSCONCAT_SLOTS, 0, 2, 2, "q"), 1000) == SMSCONCAT_COMPLETE &&
+               Test_Got(6, TEST_NUMBER, "pq"));
+
+    /* SMSCONCAT_PARTS segments, not one more */
+    SMSConcat_Init(Test_Reassembled);
+    Dropped = Stat->Dropped;
+    Test_Check("concat: more than SMSCONCAT_PARTS dropped",
+               SMSConcat_Add(Test_Segment(TEST_NUMBER, 20, 0, SMSCONCAT_PARTS + 1, 1, "z"), 0) == SMSCONCAT_DROPPED &&
+               Stat->Dropped == Dropped + 1);
+
+    for (i = 1, Ok = 1; i <= SMSCONCAT_PARTS; i++)
+    {
+        sprintf(Part, "%u", i);
+        Ok &= SMSConcat_Add(Test_Segment(TEST_NUMBER, 21, 0, SMSCONCAT_PARTS, i, Part), 0) ==
+              ((i == SMSCONCAT_PARTS) ? SMSCONCAT_COMPLETE : SMSCONCAT_STORED);
+    }
+    Test_Check("concat: SMSCONCAT_PARTS segments", Ok && Test_Complete == 7 && strlen(Test_Text) == SMSCONCAT_PARTS);
+}
+
+
+/***************************************************
+				B E N C H M A R K
+****************************************************/
+
+static volatile long Bench_Sink;
+
+
+static uint64_t Bench_Clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/* ns to build a message and to read it back as the recipient does */
+static void Bench_Message(const char* Name, const char* Text)
+{
+    uint8_t Pdu[SMSPDU_MAX_LEN], Rx[SMSPDU_MAX_LEN];
+    char Hex[2 * SMSPDU_MAX_LEN + 1], Back[SMSPDU_TEXT_LEN + 64];
+    static SMSPdu_Deliver Msg;
+    uint64_t t0, t1;
+    long Sum = 0;
+    int16_t Len;
+    uint32_t i;
+
+    t0 = Bench_Clock();
+    for (i = 0; i < BENCH_ROUNDS; i++)
+    {
+        Len = SMSPdu_BuildText(TEST_NUMBER, Text, 0, Pdu, sizeof(Pdu));
+        Sum += SMSPdu_ToHex(Pdu, Len, Hex);
+    }
+    t1 = Bench_Clock();
+
+    SMSPdu_ToHex(Rx, Test_Deliver(Pdu, Len, Rx), Hex);
+    for (i = 0; i < BENCH_ROUNDS; i++)
+    {
+        Len = SMSPdu_FromHex(Hex, Rx, sizeof(Rx));
+        SMSPdu_ParseDeliver(Rx, Len, &Msg);
+        Sum += SMSPdu_Text(&Msg, Back, sizeof(Back));
+    }
+    Bench_Sink = Sum;
+
+    printf("%-26s %10.1f %10.1f\n", Name, (double)(t1 - t0) / BENCH_ROUNDS,
+           (double)(Bench_Clock() - t1) / BENCH_ROUNDS);
+}
+
+
+static void Bench_Run(void)
+{
+    char Text[4 * SMSPDU_UD_SEPTETS + 8];
+
+    printf("\n%-26s %10s %10s\n", "message", "encode ns", "decode ns");
+
+    Bench_Message("7-bit, 10 chars", "hellohello");
+    Bench_Message("7-bit, 160 chars", Test_Repeat(Text, "Temp 21.5C ok", 12));
+    Bench_Message("7-bit, 80 extension chars", Test_Repeat(Text, "{}", 40));
+    Bench_Message("UCS-2, 70 chars", Test_Repeat(Text, "\xD0\x96", 70));
+    Bench_Message("UCS-2, 35 surrogate pairs", Test_Repeat(Text, "\xF0\x9F\x98\x80", 35));
+}
+
+
+int main(int argc, char** argv)
+{
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+            Test_Verbose = 1;
+        else
+        {
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Test_Known();
+    Test_Alphabet();
+    Test_Packing();
+    Test_Ucs2();
+    Test_Limits();
+    Test_Concat();
+    Test_Reassembly();
+    Bench_Run();
+
+    return Test_Errors ? 1 : 0;
+}
@@ -0,0 +1,453 @@
+/**
+ @file     SMSQueueBench.c
+ @brief    Host benchmark of the outbound SMS queue (SMSQueue.h) against
+           an emulated SIM900 on USART2 (echo on). The module answers
+           AT+CMGS=<length> with the "> " prompt, takes the PDU up to
+           Ctrl-Z (ESC cancels it), and returns "+CMGS: <mr>" after the
+           time the network takes to accept a message; the status report
+           ("+CDS:") follows later. The clock is simulated.
+
+           Each run keeps the queue full for a number of messages and
+           reports the messages and segments submitted per minute:
+
+             - single messages, then messages of 3 segments;
+             - the prompt lost on every 4th AT+CMGS;
+             - the PDU buffers held by another user for 5 s;
+             - the prompt never given: the messages must fail once the
+               retries are spent, not before;
+             - a message read (AT+CMGR) while a submission is in
+               progress: the module answers it after "+CMGS: <mr>" and
+               its "OK", which must not be taken as the reply.
+
+           The throughput of the clean runs is checked against the time
+           of the network per segment, and no message may fail while a
+           retry can still get it through.
+
+           The tool exits with 1 when a check fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o SMSQueueBench tools/SMSQueueBench.c tools/host/HostSim.c \
+                   SMSQueue.c SIM900.c ATCmd.c ATEngine.c ATResp.c SMSPdu.c \
+                   StatusSink.c AuxLib.c BufPool.c
+
+           Usage:
+               SMSQueueBench [-n <messages>] [-v]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "SIM900.h"
+#include "SMSQueue.h"
+#include "BufPool.h"
+#include "TimeBase.h"
+#include "HostSim.h"
+
+
+#define SIM_LOOP_MS					1			// Main loop period
+
+#define MOD_PROMPT_MS				40			// AT+CMGS to "> "
+#define MOD_SUBMIT_MS				2500		// Ctrl-Z to "+CMGS: <mr>"
+#define MOD_REPORT_MS				6000		// "+CMGS" to "+CDS"
+#define MOD_READ_MS					20			// AT+CMGR to its reply, the module free
+
+#define BENCH_MESSAGES				40
+#define BENCH_NUMBER				"+15551234567"
+#define BENCH_HANDLES				256
+#define BENCH_PDU					"07911326040000F0040B911346610089F60000208062917314080CC8F71D14969741F977FD07"
+
+typedef struct
+{
+    char      Line[64];
+    uint16_t  LineLen;
+    uint8_t   Pdu;				// Taking the PDU (after the prompt)
+    uint16_t  PduLen;			// Octets announced by AT+CMGS
+    uint16_t  HexLen;			// Hex digits taken
+    uint8_t   NextRef;
+    uint64_t  BusyUntil;		// The submission in progress is over (ns)
+
+    uint32_t  Cmgs;				// AT+CMGS seen
+    uint32_t  LoseEvery;		// Prompt not given on every n-th AT+CMGS (1: never given)
+    uint32_t  Cancelled;		// ESC
+    uint32_t  BadPdu;			// Length not the one announced
+    uint32_t  Unknown;
+} Test_Module;
+
+typedef struct
+{
+    const char* Name;
+    uint8_t     Parts;			// Segments per message
+    uint32_t    LoseEvery;
+    uint32_t    HoldMs;			// The PDU buffers are taken for that long
+    uint8_t     Failing;		// The messages are expected to fail
+} Bench_Case;
+
+static Test_Module Mod;
+static uint8_t     Bench_Status[BENCH_HANDLES];
+static uint32_t    Bench_Count[SMSQUEUE_EXPIRED + 1];
+static uint64_t    Bench_LastSubmit;	// ns
+static uint32_t    Test_Errors;
+static uint8_t     Test_Verbose;
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+void Mod_Tick(void)
+{
+}
+
+
+/**
+ * @name    Mod_Report
+ * @brief   The function gives the "+CDS:" lines of a delivered message:
+ *              SCA, SMS-STATUS-REPORT, <mr>, the recipient, SCTS, DT, ST
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Report(char* Text, uint16_t Size, uint8_t MsgRef)
+{
+    static const char Scts[] = "62107191000040";
+
+    snprintf(Text,Size,"\r\n+CDS: 25\r\n0006%02X0B915155214365F7%s%s00\r\n",MsgRef,Scts,Scts);
+}
+
+
+/**
+ * @name    Mod_Line
+ * @brief   The function answers a command line
+ *
+ * @author  Mehdi
+ */
+
+static void Mod_Line(void)
+{
+    if (Test_Verbose > 1)
+        printf("  > %s\n",Mod.Line);
+
+    if (strcmp(Mod.Line,"AT") == 0 || strcmp(Mod.Line,"AT+CMGF=0") == 0 ||
+        strncmp(Mod.Line,"AT+CNMI=",8) == 0 || strncmp(Mod.Line,"AT+CMGD=",8) == 0)
+    {
+        Mod_Print("\r\nOK\r\n");
+    } else if (strncmp(Mod.Line,"AT+CMGS=",8) == 0)
+    {
+        Mod.Cmgs++;
+        if (Mod.LoseEvery != 0 && Mod.Cmgs % Mod.LoseEvery == 0)
+            return;			// Busy with the network, no prompt
+
+        Mod.Pdu = 1;
+        Mod.PduLen = atoi(Mod.Line + 8);
+        Mod.HexLen = 0;
+        Mod_Later(MOD_PROMPT_MS,"\r\n> ");
+    } else if (strncmp(Mod.Line,"AT+CMGR=",8) == 0)
+    {
+        /* The commands are answered in order: after the submission */
+        uint32_t Ms = MOD_READ_MS;
+
+        if (Mod.BusyUntil > Sim_Now)
+            Ms += (Mod.BusyUntil - Sim_Now) / 1000000;
+        Mod_Later(Ms,"\r\n+CMGR: 0,,30\r\n" BENCH_PDU "\r\n\r\nOK\r\n");
+    } else
+    {
+        Mod.Unknown++;
+        Mod_Print("\r\nERROR\r\n");
+    }
+}
+
+
+/**
+ * @name    Mod_Rx
+ * @brief   The function takes one byte from the driver. The PDU is not
+ *              echoed.
+ *
+ * @author  Mehdi
+ */
+
+void Mod_Rx(uint8_t c)
+{
+    char Echo[2] = { c, '\0' };
+    char Reply[96];
+
+    if (c == 0x1B)
+    {
+        Mod.Cancelled++;
+        Mod.Pdu = 0;
+        Mod.LineLen = 0;
+        return;
+    }
+
+    if (Mod.Pdu)
+    {
+        if (c != 0x1A)
+        {
+            Mod.HexLen++;
+            return;
+        }
+
+        /* The length announced excludes the SCA octet (1 octet here) */
+        Mod.Pdu = 0;
+        if (Mod.HexLen != 2 * (Mod.PduLen + 1))
+        {
+            Mod.BadPdu++;
+            Mod_Later(MOD_SUBMIT_MS,"\r\n+CMS ERROR: 304\r\n");
+            return;
+        }
+
+        snprintf(Reply,sizeof(Reply),"\r\n+CMGS: %u\r\n\r\nOK\r\n",Mod.NextRef);
+        Mod_Later(MOD_SUBMIT_MS,Reply);
+        Mod.BusyUntil = Sim_Now + MOD_SUBMIT_MS * 1000000ULL;
+        Mod_Report(Reply,sizeof(Reply),Mod.NextRef++);
+        Mod_Later(MOD_SUBMIT_MS + MOD_REPORT_MS,Reply);
+        return;
+    }
+
+    Mod_Print(Echo);
+
+    if (c == '\n')
+        return;
+
+    if (c != '\r')
+    {
+        if (Mod.LineLen < sizeof(Mod.Line) - 1)
+            Mod.Line[Mod.LineLen++] = c;
+        return;
+    }
+
+    Mod.Line[Mod.LineLen] = '\0';
+    Mod.LineLen = 0;
+    Mod_Line();
+}
+
+
+/***************************************************
+				B E N C H
+****************************************************/
+
+static void Test_Check(const char* Name, int Ok)
+{
+    printf("%-44s %s\n", Name, Ok ? "ok" : "FAIL");
+
+    if (!Ok)
+        Test_Errors++;
+}
+
+
+static void Bench_Callback(uint8_t Handle, uint8_t Status, uint8_t MsgRef)
+{
+    (void)MsgRef;
+
+    Bench_Status[Handle] = Status;
+    Bench_Count[Status]++;
+    if (Status == SMSQUEUE_SUBMITTED)
+        Bench_LastSubmit = Sim_Now;
+}
+
+
+/* A text of the given number of segments (153 septets each) */
+static void Bench_Text(char* Text, uint8_t Parts, uint32_t n)
+{
+    uint16_t Len = (Parts == 1) ? 120 : 153 * (Parts - 1) + 100;
+
+    for (uint16_t i = 0; i < Len; i++)
+        Text[i] = 'a' + (i + n) % 26;
+    Text[Len] = '\0';
+}
+
+
+/**
+ * @name    Bench_Run
+ * @brief   The function keeps the queue full until the messages are all
+ *              posted, then runs it until every message has its final
+ *              status
+ *
+ * @author  Mehdi
+ *
+ * @return  The messages submitted per minute
+ */
+
+static double Bench_Run(const Bench_Case* Case, uint32_t Messages)
+{
+    static char Text[SMSQUEUE_MAX_PARTS * 153 + 1];
+    const SMSQueue_Stat* Stat = SMSQueue_GetStat();
+    SMSQueue_Stat Start = *Stat;
+    void* Held[BUFPOOL_LARGE_COUNT] = { NULL };
+    uint64_t Begin, Release, Limit;
+    uint32_t Posted = 0, Done, Segments, Retries, Failed;
+    double Minutes;
+
+    Mod_Flush();
+    Mod.LoseEvery = Case->LoseEvery;
+    Mod.Cmgs = Mod.Cancelled = Mod.BadPdu = 0;
+    memset(Bench_Count,0,sizeof(Bench_Count));
+
+    Begin = Sim_Now;
+    Release = Begin + Case->HoldMs * 1000000ULL;
+    Limit = Begin + 3600ULL * 1000000000ULL;
+
+    if (Case->HoldMs != 0)
+        for (uint8_t i = 0; i < BUFPOOL_LARGE_COUNT; i++)
+            Held[i] = BufPool_Get(BUFPOOL_LARGE_SIZE,BUFPOOL_APP);
+
+    do
+    {
+        if (Held[0] != NULL && Sim_Now >= Release)
+            for (uint8_t i = 0; i < BUFPOOL_LARGE_COUNT; i++)
+            {
+                BufPool_Put(Held[i]);
+                Held[i] = NULL;
+            }
+
+        while (Posted < Messages)
+        {
+            int16_t Handle;
+
+            Bench_Text(Text,Case->Parts,Posted);
+            if ((Handle = SMSQueue_Post(BENCH_NUMBER,Text,Bench_Callback)) < 0)
+                break;
+            Bench_Status[Handle] = 0;
+            Posted++;
+        }
+
+        SMSQueue_Poll();
+        Delayms(SIM_LOOP_MS);
+
+        Done = Bench_Count[SMSQUEUE_DELIVERED] + Bench_Count[SMSQUEUE_FAILED] + Bench_Count[SMSQUEUE_EXPIRED];
+    } while ((Posted < Messages || Done < Messages) && Sim_Now < Limit);
+
+    Segments = Stat->Segments - Start.Segments;
+    Retries = Stat->Retries - Start.Retries;
+    Failed = Stat->Failed - Start.Failed;
+    Minutes = (Bench_LastSubmit > Begin) ? (Bench_LastSubmit - Begin) / 60e9 : 0;
+
+    printf("%-24s %3u msgs %4u segs in %7.1f s: %5.1f msgs/min %5.1f segs/min, "
+           "%u retries, %u failed, %u cancelled\n",
+           Case->Name,(unsigned)Messages,(unsigned)Segments,(Sim_Now - Begin) / 1e9,
+           Minutes > 0 ? Bench_Count[SMSQUEUE_SUBMITTED] / Minutes : 0.0,
+           Minutes > 0 ? Segments / Minutes : 0.0,(unsigned)Retries,(unsigned)Failed,(unsigned)Mod.Cancelled);
+
+    if (Case->Failing)
+    {
+        /* No prompt at all: every message fails after its retries */
+        Test_Check("no prompt: failed after the retries",
+                   Failed == Messages && Retries == Messages * SMSQUEUE_RETRIES &&
+                   Mod.Cmgs == Messages * (SMSQUEUE_RETRIES + 1) && Mod.Cancelled == Mod.Cmgs);
+        return 0;
+    }
+
+    Test_Check(Case->Name,Failed == 0 && Bench_Count[SMSQUEUE_DELIVERED] == Messages &&
+               Segments == Messages * Case->Parts && Mod.BadPdu == 0);
+
+    if (Case->LoseEvery != 0)
+        Test_Check("  lost prompts retried",Retries == Mod.Cmgs / Case->LoseEvery && Mod.Cancelled == Retries);
+    if (Case->HoldMs != 0)
+        Test_Check("  empty pool retried",Retries != 0 && Mod.Cmgs == Segments);
+
+    return (Minutes > 0) ? Bench_Count[SMSQUEUE_SUBMITTED] / Minutes : 0;
+}
+
+
+/**
+ * @name    Bench_Read
+ * @brief   The function reads a message while the queue waits for the
+ *              result of a submission, then runs the queue until the
+ *              message is delivered
+ *
+ * @author  Mehdi
+ */
+
+static void Bench_Read(void)
+{
+    static SMSPdu_Deliver Deliver;
+    uint64_t Limit = Sim_Now + 60ULL * 1000000000ULL;
+    int16_t Handle;
+    int8_t res;
+
+    memset(Bench_Count,0,sizeof(Bench_Count));
+    Mod.LoseEvery = 0;
+
+    Handle = SMSQueue_Post(BENCH_NUMBER,"read in between",Bench_Callback);
+    Bench_Status[Handle] = 0;
+
+    while (Mod.BusyUntil <= Sim_Now && Sim_Now < Limit)
+    {
+        SMSQueue_Poll();
+        Delayms(SIM_LOOP_MS);
+    }
+
+    res = SIM900ReadDeliver(1,&Deliver);
+    Test_Check("read during a submission",res == SIM900_OK && strcmp(Deliver.Number,"+31641600986") == 0 &&
+               Deliver.UdLen == 12);
+
+    while (Bench_Status[Handle] != SMSQUEUE_DELIVERED && Bench_Status[Handle] != SMSQUEUE_FAILED && Sim_Now < Limit)
+    {
+        SMSQueue_Poll();
+        Delayms(SIM_LOOP_MS);
+    }
+    Test_Check("  message delivered",Bench_Status[Handle] == SMSQUEUE_DELIVERED);
+
+    res = SIM900DeleteMsg(1);
+    Test_Check("  next command has its own reply",res == SIM900_OK);
+}
+
+
+int main(int argc, char* argv[])
+{
+    static const Bench_Case Cases[] =
+    {
+        { "single segment",      1, 0, 0,    0 },
+        { "3 segments",          3, 0, 0,    0 },
+        { "prompt lost 1 in 4",  1, 4, 0,    0 },
+        { "pool held 5 s",       1, 0, 5000, 0 },
+        { "no prompt",           1, 1, 0,    1 },
+    };
+    uint32_t Messages = BENCH_MESSAGES;
+    double Rate, Bound;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i],"-n") == 0 && i + 1 < argc)
+            Messages = strtoul(argv[++i],NULL,10);
+        else if (strcmp(argv[i],"-v") == 0)
+            Test_Verbose++;
+    }
+    if (Messages == 0 || Messages > BENCH_HANDLES)
+        Messages = BENCH_MESSAGES;
+
+    Test_Check("sim init",SIM900Init(USART2) == SIM900_OK);
+    Test_Check("queue init",SMSQueue_Init() == SIM900_OK);
+
+    /* A segment takes the prompt and the network time, nothing more */
+    Rate = Bench_Run(&Cases[0],Messages);
+    Bound = 60000.0 / (MOD_PROMPT_MS + MOD_SUBMIT_MS + 2 * SIM_LOOP_MS);
+    Test_Check("  back to back submissions",Rate >= 0.95 * Bound);
+
+    Rate = Bench_Run(&Cases[1],Messages);
+    Test_Check("  back to back segments",Rate * Cases[1].Parts >= 0.95 * Bound);
+
+    for (i = 2; i < (int)(sizeof(Cases) / sizeof(Cases[0])); i++)
+        Bench_Run(&Cases[i],(Cases[i].Failing) ? 3 : Messages);
+
+    Bench_Read();
+
+    Test_Check("number too long",SMSQueue_Post("+1234567890123456789012345678901",
+                                               "x",NULL) == SMSQUEUE_INVALID);
+
+    Test_Check("no unknown commands",Mod.Unknown == 0);
+    Test_Check("buffer pool returned",BufPool_GetStat(BUFPOOL_SMALL)->InUse == 0 && BufPool_GetStat(BUFPOOL_LARGE)->InUse == 0);
+
+    printf("\n%s\n",Test_Errors ? "FAILED" : "all ok");
+
+    return Test_Errors ? 1 : 0;
+}
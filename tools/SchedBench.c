@@ -0,0 +1,284 @@
+/**
+ @file     SchedBench.c
+ @brief    Host check and benchmark of the timer wheel (Scheduler.h). The
+           tool supplies TimeBase_Now from a virtual clock, so the runs are
+           exact and repeatable:
+
+             - order: timers with random delays, some periodic, some
+               stopped from a job, the clock moved in random steps; every
+               job must run in deadline order, no earlier than its
+               deadline, no later than the step that passed the next tick
+               boundary, and a stopped timer never again;
+             - bench: the cost of Scheduler_Start, Scheduler_Stop and
+               Scheduler_Poll with n timers pending.
+
+           The tool exits with 1 when the order check fails.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -Itools/host -I. \
+                   -o SchedBench tools/SchedBench.c Scheduler.c
+
+           Usage:
+               SchedBench [-n <timers>] [-s <seed>]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "TimeBase.h"
+#include "Scheduler.h"
+
+
+typedef struct
+{
+    Scheduler_Timer Timer;
+    uint64_t Due;				// Deadline of the next run, as the bench sees it
+    uint32_t Period;
+    uint32_t Runs;
+    uint8_t  Stopped;
+} Bench_Job;
+
+static uint64_t   Bench_Now;
+static uint64_t   Bench_Last;	// Deadline of the last job run
+static uint64_t   Bench_Step;	// Clock before the last step
+static uint32_t   Bench_Errors;
+static Bench_Job* Bench_Jobs;
+static uint32_t   Bench_Count;
+
+
+uint64_t TimeBase_Now(void)
+{
+    return Bench_Now;
+}
+
+
+static uint64_t Bench_Clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/* The tick boundary at or after a deadline, when the wheel runs the job */
+static uint64_t Bench_Tick(uint64_t us)
+{
+    return (us + SCHEDULER_TICK_US - 1) / SCHEDULER_TICK_US * SCHEDULER_TICK_US;
+}
+
+
+static void Bench_Error(const char* What, uint32_t Id)
+{
+    if (Bench_Errors++ < 10)
+        printf("  job %u: %s (now %llu)\n", Id, What, (unsigned long long)Bench_Now);
+}
+
+
+/**
+ * @name    Bench_Run
+ * @brief   The job of the order check: checks its deadline against the
+ *              clock and the previous job, then stops a random other timer
+ *              now and then
+ *
+ * @author  Mehdi
+ */
+
+static void Bench_Run(void* Arg)
+{
+    Bench_Job* Job = Arg;
+    uint32_t Id = Job - Bench_Jobs;
+
+    if (Job->Stopped)
+        Bench_Error("ran after it was stopped", Id);
+    if (Job->Due > Bench_Now)
+        Bench_Error("ran early", Id);
+    if (Bench_Tick(Job->Due) <= Bench_Step)
+        Bench_Error("ran a step late", Id);
+    if (Job->Due < Bench_Last)
+        Bench_Error("ran out of order", Id);
+
+    Bench_Last = Job->Due;
+    Job->Runs++;
+
+    if (Job->Period != 0)
+    {
+        Job->Due += Job->Period;
+        while (Job->Due <= Bench_Now)
+            Job->Due += Job->Period;
+    }
+
+    if (rand() % 8 == 0)
+    {
+        Bench_Job* Other = &Bench_Jobs[rand() % Bench_Count];
+
+        Scheduler_Stop(&Other->Timer);
+        Other->Stopped = 1;
+    }
+}
+
+
+static void Bench_Nop(void* Arg)
+{
+    (void)Arg;
+}
+
+
+/**
+ * @name    Bench_Order
+ * @brief   The function runs the order check
+ *
+ * @author  Mehdi
+ *
+ * @return	number of errors
+ */
+
+static uint32_t Bench_Order(uint32_t Count)
+{
+    uint32_t i, Runs = 0;
+
+    Bench_Now = 123456;
+    Bench_Last = Bench_Step = 0;
+    Bench_Count = Count;
+    Scheduler_Init();
+
+    for (i = 0; i < Count; i++)
+    {
+        Bench_Job* Job = &Bench_Jobs[i];
+        uint32_t Delay = rand() % 500000;
+
+        memset(Job, 0, sizeof(Bench_Job));
+        Job->Period = (i % 4 == 0) ? 1000 + rand() % 100000 : 0;
+        Job->Due = Bench_Now + Delay;
+        if (Job->Period != 0 && Job->Period < SCHEDULER_TICK_US)
+            Job->Period = SCHEDULER_TICK_US;
+
+        Scheduler_Start(&Job->Timer, Delay, Job->Period, Bench_Run, Job);
+    }
+
+    /* Steps from a fraction of a tick to several turns of the wheel */
+    while (Bench_Now < 2000000)
+    {
+        uint32_t r = rand() % 16;
+
+        Bench_Step = Bench_Now;
+        Bench_Now += (r < 12) ? rand() % (2 * SCHEDULER_TICK_US) : rand() % (SCHEDULER_SLOTS * SCHEDULER_TICK_US * 3);
+        Bench_Last = 0;
+        Scheduler_Poll();
+    }
+
+    for (i = 0; i < Count; i++)
+    {
+        Bench_Job* Job = &Bench_Jobs[i];
+
+        Runs += Job->Runs;
+
+        /* A live job whose deadline passed must have run, a one-shot once */
+        if (Job->Stopped)
+            continue;
+        if (Bench_Tick(Job->Due) <= Bench_Now && (Job->Period != 0 || Job->Runs == 0))
+            Bench_Error("missed", i);
+        if (Job->Period == 0 && Job->Runs > 1)
+            Bench_Error("one-shot ran twice", i);
+    }
+
+    printf("order   %u timers, %u runs, %u overruns, max late %u us: %s\n",
+           Count, Runs, Scheduler_GetStat()->Overruns, Scheduler_GetStat()->MaxLateUs,
+           Bench_Errors ? "FAIL" : "ok");
+
+    for (i = 0; i < Count; i++)
+        Scheduler_Stop(&Bench_Jobs[i].Timer);
+
+    return Bench_Errors;
+}
+
+
+/**
+ * @name    Bench_Speed
+ * @brief   The function times Start, Stop and Poll with Count timers
+ *              pending, spread over 10 turns of the wheel
+ *
+ * @author  Mehdi
+ */
+
+static void Bench_Speed(uint32_t Count)
+{
+    uint64_t t0, t1, t2, t3;
+    uint32_t i, Polls = 0;
+    uint64_t Span = 10ULL * SCHEDULER_SLOTS * SCHEDULER_TICK_US;
+
+    Bench_Now = 0;
+    Scheduler_Init();
+
+    t0 = Bench_Clock();
+    for (i = 0; i < Count; i++)
+        Scheduler_Start(&Bench_Jobs[i].Timer, 1 + rand() % Span, 0, Bench_Nop, NULL);
+    t1 = Bench_Clock();
+
+    for (i = 0; i < Count; i += 2)
+        Scheduler_Stop(&Bench_Jobs[i].Timer);
+    t2 = Bench_Clock();
+
+    /* The other half fires, one tick per poll */
+    while (Bench_Now <= Span)
+    {
+        Bench_Now += SCHEDULER_TICK_US;
+        Scheduler_Poll();
+        Polls++;
+    }
+    t3 = Bench_Clock();
+
+    printf("bench   %6u timers: start %6.0f ns, stop %6.0f ns, poll %6.0f ns\n",
+           Count,
+           (double)(t1 - t0) / Count,
+           (double)(t2 - t1) / ((Count + 1) / 2),
+           (double)(t3 - t2) / Polls);
+}
+
+
+int main(int argc, char** argv)
+{
+    uint32_t Count = 1000, Seed = 1;
+    uint32_t Errors;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            Count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            Seed = atoi(argv[i + 1]);
+    }
+
+    if (Count == 0)
+    {
+        fprintf(stderr, "usage: %s [-n <timers>] [-s <seed>]\n", argv[0]);
+        return 2;
+    }
+
+    Bench_Jobs = calloc(Count * 10, sizeof(Bench_Job));
+    if (Bench_Jobs == NULL)
+        return 1;
+
+    srand(Seed);
+    printf("wheel of %u slots, tick %u us\n\n", SCHEDULER_SLOTS, SCHEDULER_TICK_US);
+
+    Errors = Bench_Order(Count);
+
+    Bench_Speed(Count / 10 ? Count / 10 : 1);
+    Bench_Speed(Count);
+    Bench_Speed(Count * 10);
+
+    free(Bench_Jobs);
+
+    return Errors ? 1 : 0;
+}
@@ -0,0 +1,695 @@
+/**
+ @file     TraceReplay.c
+ @brief    Host replay of a wire trace captured with Trace_Dump (Trace.h).
+           The unmodified drivers are linked against host versions of the
+           TM USART/delay libraries, HAL_GetTick and TimeBase_Now; the RX records of
+           the capture are fed to the driver with their recorded timing
+           and every byte the driver sends is compared with the captured
+           TX records. A session that misbehaved on the bench can then be
+           run again, deterministically, in a debugger.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -Itools/host -I. \
+                   -o TraceReplay tools/TraceReplay.c ESP8266.c SIM900.c \
+                   ATCmd.c LinkSup.c FastJoin.c StatusSink.c SMSPdu.c AuxLib.c \
+                   BufPool.c ATResp.c ATEngine.c
+
+           Usage:
+               TraceReplay <capture> <scenario> [--fast] [-n <runs>] [-v]
+                   [scenario arguments]
+
+               scenarios: esp_set, esp_init, sim_init, sim_netstat,
+                          sim_netreg, sim_read <slot>, sim_send <number> <text>
+
+               --fast   jump the clock to the next RX record whenever the
+                        driver is starved, instead of waiting in real time
+               -n       replay the capture <runs> times and report the mean
+                        host time of one run (benchmark of the driver code)
+               -v       print the status events of the drivers
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stm32f4xx_hal.h"
+#include "tm_stm32_usart.h"
+#include "tm_stm32_delay.h"
+#include "tm_stm32_hd44780.h"
+
+#include "Trace.h"
+#include "ESP8266.h"
+#include "SIM900.h"
+#include "StatusSink.h"
+#include "BufPool.h"
+#include "TimeBase.h"
+
+
+#define REPLAY_PORTS				7
+#define REPLAY_RX_SIZE				4096
+#define REPLAY_TICK_US				10			// Clock step of a HAL_GetTick call in --fast mode
+
+typedef struct
+{
+    uint8_t        Flags;
+    uint64_t       Time;			// us since the start of the capture
+    uint16_t       Len;
+    const uint8_t* Data;
+} Replay_Rec;
+
+typedef struct
+{
+    uint8_t  Buf[REPLAY_RX_SIZE];
+    uint16_t Head;
+    uint16_t Tail;
+} Replay_Port;
+
+typedef struct
+{
+    uint32_t TxBytes;
+    uint32_t RxBytes;
+    uint32_t Mismatch;
+    uint32_t FirstMismatch;			// Index of the TX record, valid if Mismatch != 0
+    uint32_t Extra;					// TX bytes sent after the end of the capture
+} Replay_Stat;
+
+USART_TypeDef Host_USART[7] = {{.Port = 0},{.Port = 1},{.Port = 2},{.Port = 3},
+                               {.Port = 4},{.Port = 5},{.Port = 6}};
+uint32_t SystemCoreClock = 168000000;
+uint8_t Host_Flash[HOST_FLASH_SIZE];
+
+extern USART_TypeDef* USART_ESP;
+
+static uint8_t*    Replay_File;
+static Replay_Rec* Replay_Recs;
+static uint32_t    Replay_Count;
+
+static Replay_Port Replay_Ports[REPLAY_PORTS];
+static uint32_t    Replay_Cursor;			// Next record to deliver (RX) or to match (TX)
+static uint16_t    Replay_TxOff;			// Bytes of the current TX record already matched
+static int64_t     Replay_Offset;			// Replay clock - capture clock
+static uint64_t    Replay_Now;				// Replay clock (us)
+static uint64_t    Replay_Start;
+static uint8_t     Replay_Fast;
+static Replay_Stat Replay_Stats;
+
+
+/***************************************************
+			C A P T U R E
+****************************************************/
+
+static uint32_t Replay_U32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static uint32_t Replay_Varint(const uint8_t** p, const uint8_t* End)
+{
+    uint32_t v = 0;
+    uint8_t shift = 0, b;
+
+    do
+    {
+        if (*p >= End)
+            return 0;
+        b = *(*p)++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    return v;
+}
+
+
+/**
+ * @name    Replay_Load
+ * @brief   The function reads a capture and indexes its records
+ *
+ * @author  Mehdi
+ *
+ * @param	Path: the file written from a Trace_Dump
+ * @return	0 on success, -1 otherwise
+ */
+
+static int Replay_Load(const char* Path)
+{
+    FILE* f = fopen(Path, "rb");
+    const uint8_t *p, *End;
+    uint64_t t = 0;
+    long Size;
+
+    if (f == NULL)
+    {
+        perror(Path);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    Size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    Replay_File = malloc(Size);
+    if (Replay_File == NULL || fread(Replay_File, 1, Size, f) != (size_t)Size)
+    {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    if (Size < 13 || memcmp(Replay_File, TRACE_MAGIC, 4) != 0 || Replay_File[4] != TRACE_VERSION)
+    {
+        fprintf(stderr, "%s: not a version %d trace\n", Path, TRACE_VERSION);
+        return -1;
+    }
+
+    if (Replay_U32(Replay_File + 5) != 0)
+        fprintf(stderr, "warning: %u records were dropped on the target, "
+                "the start of the session is missing\n", Replay_U32(Replay_File + 5));
+
+    p = Replay_File + 13;
+    End = p + Replay_U32(Replay_File + 9);
+    if (End > Replay_File + Size)
+        End = Replay_File + Size;
+
+    // Every record takes at least 3 bytes
+    Replay_Recs = malloc(sizeof(Replay_Rec) * ((End - p) / 3 + 1));
+
+    while (p < End)
+    {
+        Replay_Rec* r = &Replay_Recs[Replay_Count];
+
+        r->Flags = *p++;
+        t += Replay_Varint(&p, End);
+        r->Time = t;
+        r->Len = Replay_Varint(&p, End);
+        r->Data = p;
+        p += r->Len;
+
+        if (p > End)
+        {
+            fprintf(stderr, "warning: truncated record %u\n", Replay_Count);
+            break;
+        }
+        Replay_Count++;
+    }
+
+    return 0;
+}
+
+
+/***************************************************
+			R E P L A Y   C L O C K
+****************************************************/
+
+static uint64_t Replay_Wall(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static void Replay_Advance(uint32_t us)
+{
+    if (Replay_Fast)
+        Replay_Now += us;
+    else
+    {
+        if (us != 0)
+            usleep(us);
+        Replay_Now = Replay_Wall() - Replay_Start;
+    }
+}
+
+
+/**
+ * @name    Replay_Deliver
+ * @brief   The function copies the current RX record into its port buffer
+ *
+ * @author  Mehdi
+ */
+
+static void Replay_Deliver(void)
+{
+    const Replay_Rec* r = &Replay_Recs[Replay_Cursor++];
+    Replay_Port* Port = &Replay_Ports[TRACE_PORT(r->Flags) % REPLAY_PORTS];
+
+    for (uint16_t i = 0; i < r->Len; i++)
+    {
+        Port->Buf[Port->Head] = r->Data[i];
+        Port->Head = (Port->Head + 1) % REPLAY_RX_SIZE;
+    }
+    Replay_Stats.RxBytes += r->Len;
+}
+
+
+static uint8_t Replay_RxNext(void)
+{
+    return Replay_Cursor < Replay_Count && (Replay_Recs[Replay_Cursor].Flags & TRACE_RX);
+}
+
+
+/**
+ * @name    Replay_Pump
+ * @brief   The function delivers the RX records that are due
+ *
+ * @author  Mehdi
+ *
+ * @param	Starved: 1 if the driver is waiting for data; in --fast mode the
+ * 			clock then jumps to the next RX record
+ */
+
+static void Replay_Pump(uint8_t Starved)
+{
+    Replay_Advance(0);
+
+    while (Replay_RxNext())
+    {
+        uint64_t Due = Replay_Recs[Replay_Cursor].Time + Replay_Offset;
+
+        if (Replay_Now < Due)
+        {
+            if (!(Replay_Fast && Starved))
+                break;
+            Replay_Now = Due;
+            Starved = 0;
+        }
+        Replay_Deliver();
+    }
+}
+
+
+/**
+ * @name    Replay_Tx
+ * @brief   The function compares the bytes sent by the driver with the
+ * 			next TX record of the capture
+ *
+ * @author  Mehdi
+ */
+
+static void Replay_Tx(const uint8_t* Data, uint16_t Len)
+{
+    Replay_Stats.TxBytes += Len;
+
+    while (Len--)
+    {
+        const Replay_Rec* r;
+
+        // The module answered before this command in the capture
+        while (Replay_RxNext())
+            Replay_Deliver();
+
+        if (Replay_Cursor >= Replay_Count)
+        {
+            Replay_Stats.Extra++;
+            Data++;
+            continue;
+        }
+
+        r = &Replay_Recs[Replay_Cursor];
+
+        // Align the capture clock on the start of every command
+        if (Replay_TxOff == 0)
+            Replay_Offset = (int64_t)Replay_Now - (int64_t)r->Time;
+
+        if (r->Data[Replay_TxOff] != *Data++)
+        {
+            if (Replay_Stats.Mismatch++ == 0)
+                Replay_Stats.FirstMismatch = Replay_Cursor;
+        }
+
+        if (++Replay_TxOff == r->Len)
+        {
+            Replay_TxOff = 0;
+            Replay_Cursor++;
+        }
+    }
+}
+
+
+static Replay_Port* Replay_PortOf(USART_TypeDef* USARTx)
+{
+    return &Replay_Ports[USARTx->Port % REPLAY_PORTS];
+}
+
+
+static uint16_t Replay_Pending(const Replay_Port* Port)
+{
+    return (Port->Head + REPLAY_RX_SIZE - Port->Tail) % REPLAY_RX_SIZE;
+}
+
+
+static int16_t Replay_Find(const Replay_Port* Port, uint8_t c)
+{
+    uint16_t n = Replay_Pending(Port);
+
+    for (uint16_t i = 0; i < n; i++)
+        if (Port->Buf[(Port->Tail + i) % REPLAY_RX_SIZE] == c)
+            return i;
+
+    return -1;
+}
+
+
+/***************************************************
+		H O S T   L I B R A R I E S
+****************************************************/
+
+void TM_USART_Putc(USART_TypeDef* USARTx, volatile char c)
+{
+    uint8_t b = c;
+
+    (void)USARTx;
+    Replay_Tx(&b, 1);
+}
+
+void TM_USART_Puts(USART_TypeDef* USARTx, char* str)
+{
+    (void)USARTx;
+    Replay_Tx((const uint8_t*)str, strlen(str));
+}
+
+void TM_USART_Send(USART_TypeDef* USARTx, uint8_t* DataArray, uint16_t count)
+{
+    (void)USARTx;
+    Replay_Tx(DataArray, count);
+}
+
+uint8_t TM_USART_Getc(USART_TypeDef* USARTx)
+{
+    Replay_Port* Port = Replay_PortOf(USARTx);
+    uint8_t c;
+
+    Replay_Pump(Replay_Pending(Port) == 0);
+
+    if (Replay_Pending(Port) == 0)
+        return 0;
+
+    c = Port->Buf[Port->Tail];
+    Port->Tail = (Port->Tail + 1) % REPLAY_RX_SIZE;
+    return c;
+}
+
+uint16_t TM_USART_Gets(USART_TypeDef* USARTx, char* buffer, uint16_t bufsize)
+{
+    Replay_Port* Port = Replay_PortOf(USARTx);
+    uint16_t i = 0;
+
+    Replay_Pump(Replay_Find(Port, '\n') < 0);
+
+    // Same rule as the TM library: a whole line, or a full buffer
+    if (Replay_Find(Port, '\n') < 0 && Replay_Pending(Port) < bufsize - 1)
+        return 0;
+
+    while (i < bufsize - 1 && Replay_Pending(Port) != 0)
+    {
+        buffer[i] = Port->Buf[Port->Tail];
+        Port->Tail = (Port->Tail + 1) % REPLAY_RX_SIZE;
+        if (buffer[i++] == '\n')
+            break;
+    }
+    buffer[i] = 0;
+
+    return i;
+}
+
+uint8_t TM_USART_BufferEmpty(USART_TypeDef* USARTx)
+{
+    Replay_Port* Port = Replay_PortOf(USARTx);
+
+    Replay_Pump(Replay_Pending(Port) == 0);
+    return Replay_Pending(Port) == 0;
+}
+
+uint16_t TM_USART_BufferCount(USART_TypeDef* USARTx)
+{
+    Replay_Pump(0);
+    return Replay_Pending(Replay_PortOf(USARTx));
+}
+
+void TM_USART_ClearBuffer(USART_TypeDef* USARTx)
+{
+    Replay_Port* Port = Replay_PortOf(USARTx);
+
+    Replay_Pump(0);
+    Port->Tail = Port->Head;
+}
+
+int16_t TM_USART_FindCharacter(USART_TypeDef* USARTx, uint8_t c)
+{
+    Replay_Port* Port = Replay_PortOf(USARTx);
+
+    Replay_Pump(Replay_Find(Port, c) < 0);
+    return Replay_Find(Port, c);
+}
+
+uint32_t HAL_GetTick(void)
+{
+    Replay_Advance(Replay_Fast ? REPLAY_TICK_US : 0);
+    return Replay_Now / 1000;
+}
+
+void Delay(uint32_t us)
+{
+    Replay_Advance(us);
+}
+
+void Delayms(uint32_t ms)
+{
+    Replay_Advance(ms * 1000);
+}
+
+uint32_t TM_DELAY_Time(void)
+{
+    return HAL_GetTick();
+}
+
+uint64_t TimeBase_Now(void)
+{
+    Replay_Advance(Replay_Fast ? REPLAY_TICK_US : 0);
+    return Replay_Now;
+}
+
+void TimeBase_Delay(uint64_t us)
+{
+    Replay_Advance(us);
+}
+
+void TM_HD44780_Clear(void)
+{
+}
+
+void TM_HD44780_Puts(uint8_t x, uint8_t y, char* str)
+{
+    printf("[lcd %u,%u] %s\n", x, y, str);
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data)
+{
+    uint32_t Word = Data;
+
+    (void)TypeProgram;
+    if (Address < (uintptr_t)Host_Flash || Address + 4 > (uintptr_t)Host_Flash + HOST_FLASH_SIZE)
+        return HAL_ERROR;
+
+    memcpy((void*)Address, &Word, 4);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError)
+{
+    (void)pEraseInit;
+    *SectorError = 0xFFFFFFFF;
+    memset(Host_Flash, 0xFF, HOST_FLASH_SIZE);
+    return HAL_OK;
+}
+
+
+/***************************************************
+			S C E N A R I O S
+****************************************************/
+
+static void Replay_NetReg(const SIM900_NetReg* Reg)
+{
+    printf("%10u ms  creg %u  cgreg %u  lac %04X  ci %04X\n",
+           (unsigned)Reg->Updated, Reg->Stat, Reg->GprsStat, Reg->Lac, Reg->Ci);
+}
+
+
+/**
+ * @name    Replay_Run
+ * @brief   The function resets the replay state and runs a scenario
+ *
+ * @author  Mehdi
+ *
+ * @return	The result of the driver call
+ */
+
+static int Replay_Run(const char* Scenario, USART_TypeDef* USARTx, char** Args, int ArgCount)
+{
+    uint8_t Ref = 0;
+
+    memset(Replay_Ports, 0, sizeof(Replay_Ports));
+    memset(&Replay_Stats, 0, sizeof(Replay_Stats));
+    memset(Host_Flash, 0xFF, HOST_FLASH_SIZE);
+    Replay_Cursor = Replay_TxOff = 0;
+    Replay_Offset = 0;
+    Replay_Now = 0;
+    Replay_Start = Replay_Wall();
+
+    if (strcmp(Scenario, "esp_set") == 0)
+    {
+        ESP_SET(USARTx);
+        return ESP8266_OK;
+    }
+    if (strcmp(Scenario, "esp_init") == 0)
+    {
+        USART_ESP = USARTx;
+        return ESP_Init();
+    }
+    if (strcmp(Scenario, "sim_init") == 0)
+        return SIM900Init(USARTx);
+    if (strcmp(Scenario, "sim_netstat") == 0)
+    {
+        SIM900Init(USARTx);
+        return SIM900GetNetStat();
+    }
+    if (strcmp(Scenario, "sim_netreg") == 0)
+    {
+        int8_t res;
+
+        SIM900Init(USARTx);
+        if ((res = SIM900NetRegInit(Replay_NetReg)) != SIM900_OK)
+            return res;
+
+        /* Follow the reports until the end of the capture */
+        while (Replay_RxNext())
+        {
+            SIM900Poll();
+            HAL_GetTick();
+        }
+        SIM900Poll();
+
+        return SIM900GetNetStat();
+    }
+    if (strcmp(Scenario, "sim_read") == 0 && ArgCount >= 1)
+    {
+        static char Text[SMSPDU_TEXT_LEN];
+        int8_t res;
+
+        SIM900Init(USARTx);
+        if ((res = SIM900ReadMsg(atoi(Args[0]), Text, sizeof(Text))) == SIM900_OK)
+            printf("message      \"%s\"\n", Text);
+        return res;
+    }
+    if (strcmp(Scenario, "sim_send") == 0 && ArgCount >= 2)
+    {
+        SIM900Init(USARTx);
+        return SIM900SendMsg(Args[0], Args[1], &Ref);
+    }
+
+    fprintf(stderr, "unknown scenario or missing arguments: %s\n", Scenario);
+    exit(2);
+}
+
+
+int main(int argc, char** argv)
+{
+    const char *Path = NULL, *Scenario = NULL;
+    char* Args[2];
+    int ArgCount = 0, Runs = 1, Result = 0;
+    uint8_t Port = 0;
+    uint64_t Host;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--fast") == 0)
+            Replay_Fast = 1;
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            Runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0)
+            Status_SetSink(&StatusSink_Stdout);
+        else if (Path == NULL)
+            Path = argv[i];
+        else if (Scenario == NULL)
+            Scenario = argv[i];
+        else if (ArgCount < 2)
+            Args[ArgCount++] = argv[i];
+    }
+
+    if (Scenario == NULL || Runs < 1)
+    {
+        fprintf(stderr, "usage: %s <capture> <scenario> [--fast] [-n <runs>] [-v] [args]\n", argv[0]);
+        return 2;
+    }
+
+    if (Replay_Load(Path) != 0)
+        return 1;
+
+    // The modem port is the one of the first TX record
+    for (uint32_t i = 0; i < Replay_Count && Port == 0; i++)
+        if (!(Replay_Recs[i].Flags & TRACE_RX))
+            Port = TRACE_PORT(Replay_Recs[i].Flags) % REPLAY_PORTS;
+
+    if (Port == 0)
+        Port = 1;
+
+    if (Runs > 1 && !Replay_Fast)
+        fprintf(stderr, "warning: -n without --fast measures the capture, not the driver\n");
+
+    Host = Replay_Wall();
+    for (int i = 0; i < Runs; i++)
+        Result = Replay_Run(Scenario, &Host_USART[Port], Args, ArgCount);
+    Host = Replay_Wall() - Host;
+
+    printf("records      %u (USART%u)\n", Replay_Count, Port);
+    printf("result       %d\n", Result);
+    printf("tx bytes     %u (%u after the end of the capture)\n", Replay_Stats.TxBytes, Replay_Stats.Extra);
+    printf("rx bytes     %u\n", Replay_Stats.RxBytes);
+    printf("unconsumed   %u of %u records\n", Replay_Count - Replay_Cursor, Replay_Count);
+    printf("session      %llu us (replay clock)\n", (unsigned long long)Replay_Now);
+    printf("host         %llu us per run (%d runs)\n", (unsigned long long)(Host / Runs), Runs);
+
+    if (Replay_Stats.Mismatch != 0)
+    {
+        const Replay_Rec* r = &Replay_Recs[Replay_Stats.FirstMismatch];
+
+        printf("MISMATCH     %u bytes, first in record %u: \"%.*s\"\n",
+               Replay_Stats.Mismatch, Replay_Stats.FirstMismatch, (int)r->Len, (const char*)r->Data);
+        return 1;
+    }
+
+    // Every block taken from the buffer pool must be back
+    const BufPool_Stat* Small = BufPool_GetStat(BUFPOOL_SMALL);
+    const BufPool_Stat* Large = BufPool_GetStat(BUFPOOL_LARGE);
+
+    printf("pool         peak %u/%u small, %u/%u large, %u failed\n",
+           Small->Peak, BUFPOOL_SMALL_COUNT, Large->Peak, BUFPOOL_LARGE_COUNT, Small->Failed + Large->Failed);
+
+    if (Small->InUse != 0 || Large->InUse != 0)
+    {
+        printf("LEAK         %u small, %u large blocks not released\n", Small->InUse, Large->InUse);
+        return 1;
+    }
+
+    return Replay_Stats.Extra != 0;
+}
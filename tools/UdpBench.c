@@ -0,0 +1,207 @@
+/**
+ @file     UdpBench.c
+ @brief    Host benchmark of the telemetry batcher (UdpBatch.h). Samples
+           are produced at a fixed rate on a simulated clock; each datagram
+           costs the time of one AT+CIPSEND exchange (a fixed round trip
+           plus the bytes at the UART baud rate) and is sent for real on a
+           loopback UDP socket, where a receiver counts what arrives. The
+           table shows, for several MaxBytes / MaxAgeMs settings, the
+           datagrams per second, the share of time the UART is busy
+           sending and the worst added latency of a sample.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -Itools/host -I. \
+                   -o UdpBench tools/UdpBench.c UdpBatch.c
+
+           Usage:
+               UdpBench [-r <samples/s>] [-s <sample bytes>] [-t <seconds>]
+                   [-o <CIPSEND round trip, us>] [-b <baud>]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "TimeBase.h"
+#include "UdpBatch.h"
+
+
+static uint64_t Bench_Now;			// us
+static uint64_t Bench_Busy;			// us spent in Bench_Send
+static uint32_t Bench_Overhead = 4000;
+static uint32_t Bench_Baud = 115200;
+static int      Bench_Tx = -1, Bench_Rx = -1;
+static struct sockaddr_in Bench_Addr;
+
+
+uint64_t TimeBase_Now(void)
+{
+    return Bench_Now;
+}
+
+
+/**
+ * @name    Bench_Send
+ * @brief   The UdpBatch_Send of the benchmark: charges the time of the
+ *              AT+CIPSEND exchange and sends the datagram on loopback
+ *
+ * @author  Mehdi
+ */
+
+static int8_t Bench_Send(uint8_t Link, const uint8_t* Data, uint16_t Len)
+{
+    uint64_t Cost;
+
+    (void)Link;
+
+    /* "AT+CIPSEND=0,<len>\r\n" + data, 10 bits per byte */
+    Cost = Bench_Overhead + (uint64_t)(20 + Len) * 10 * 1000000 / Bench_Baud;
+    Bench_Now += Cost;
+    Bench_Busy += Cost;
+
+    if (sendto(Bench_Tx, Data, Len, 0, (struct sockaddr*)&Bench_Addr, sizeof(Bench_Addr)) != Len)
+        return -2;
+
+    return 1;
+}
+
+
+static void Bench_Drain(uint32_t* Datagrams, uint32_t* Bytes)
+{
+    uint8_t Buf[UDPBATCH_BUF_SIZE];
+    ssize_t n;
+
+    while ((n = recv(Bench_Rx, Buf, sizeof(Buf), 0)) > 0)
+    {
+        (*Datagrams)++;
+        *Bytes += (uint32_t)n;
+    }
+}
+
+
+static void Bench_Run(uint16_t MaxBytes, uint16_t MaxAgeMs, uint32_t Rate, uint16_t Size, uint32_t Seconds)
+{
+    static UdpBatch Batch;
+    uint8_t Sample[UDPBATCH_BUF_SIZE];
+    uint64_t Period = 1000000 / Rate, Next = 0, End = (uint64_t)Seconds * 1000000;
+    uint32_t Late = 0, RxDatagrams = 0, RxBytes = 0;
+
+    Bench_Now = Bench_Busy = 0;
+    UdpBatch_Init(&Batch, Bench_Send, 0, MaxBytes, MaxAgeMs);
+
+    while (Next < End)
+    {
+        /* The producer is late when a send outlasted the sample period */
+        if (Bench_Now < Next)
+            Bench_Now = Next;
+        else if (Bench_Now - Next >= Period)
+            Late++;
+
+        memset(Sample, (uint8_t)Batch.Stat.Samples, Size);
+        UdpBatch_Put(&Batch, Sample, Size);
+        Next += Period;
+
+        /* The main loop polls until the next sample is due */
+        if (Bench_Now < Next)
+        {
+            uint64_t Due = Batch.First * 1000ULL + MaxAgeMs * 1000ULL;
+
+            if (Batch.Len != 0 && Due < Next)
+            {
+                Bench_Now = (Due > Bench_Now) ? Due : Bench_Now;
+                UdpBatch_Poll(&Batch);
+            }
+        }
+
+        Bench_Drain(&RxDatagrams, &RxBytes);
+    }
+
+    UdpBatch_Flush(&Batch);
+    usleep(10000);
+    Bench_Drain(&RxDatagrams, &RxBytes);
+
+    printf("%8u %8u | %9.1f %7.1f%% %8u %6u | %8u %6u %6u\n",
+           MaxBytes, MaxAgeMs,
+           Batch.Stat.Datagrams * 1e6 / (double)Bench_Now,
+           100.0 * Bench_Busy / (double)Bench_Now,
+           Batch.Stat.MaxAgeMs, Late,
+           RxDatagrams, Batch.Stat.Failed,
+           (RxBytes == Batch.Stat.Bytes) ? 0 : Batch.Stat.Bytes - RxBytes);
+}
+
+
+int main(int argc, char** argv)
+{
+    static const uint16_t Settings[][2] =
+    {
+        {   0,   0 },		// One datagram per sample
+        {  64,  20 },
+        { 128,  50 },
+        { 256, 100 },
+        { 512, 100 },
+        { 512, 500 },
+    };
+    uint32_t Rate = 200, Seconds = 10;
+    uint16_t Size = 16;
+    socklen_t AddrLen = sizeof(Bench_Addr);
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-r") == 0)
+            Rate = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            Size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            Seconds = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-o") == 0)
+            Bench_Overhead = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-b") == 0)
+            Bench_Baud = atoi(argv[i + 1]);
+    }
+
+    if (Rate == 0 || Rate > 1000000 || Size == 0 || Size > UDPBATCH_BUF_SIZE || Bench_Baud == 0)
+    {
+        fprintf(stderr, "usage: %s [-r <samples/s>] [-s <bytes>] [-t <s>] [-o <us>] [-b <baud>]\n", argv[0]);
+        return 2;
+    }
+
+    /* Loopback receiver on a port chosen by the system */
+    Bench_Rx = socket(AF_INET, SOCK_DGRAM, 0);
+    Bench_Tx = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&Bench_Addr, 0, sizeof(Bench_Addr));
+    Bench_Addr.sin_family = AF_INET;
+    Bench_Addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (Bench_Rx < 0 || Bench_Tx < 0
+        || bind(Bench_Rx, (struct sockaddr*)&Bench_Addr, sizeof(Bench_Addr)) != 0
+        || getsockname(Bench_Rx, (struct sockaddr*)&Bench_Addr, &AddrLen) != 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    fcntl(Bench_Rx, F_SETFL, O_NONBLOCK);
+
+    printf("%u samples/s of %u bytes, %u s, CIPSEND %u us + %u baud\n\n",
+           Rate, Size, Seconds, Bench_Overhead, Bench_Baud);
+    printf("MaxBytes MaxAgeMs | dgrams/s   UART  MaxAge   Late | received failed   lost\n");
+
+    for (unsigned i = 0; i < sizeof(Settings) / sizeof(Settings[0]); i++)
+        Bench_Run(Settings[i][0] ? Settings[i][0] : Size, Settings[i][1], Rate, Size, Seconds);
+
+    close(Bench_Rx);
+    close(Bench_Tx);
+
+    return 0;
+}
@@ -0,0 +1,475 @@
+/**
+ @file     UplinkSim.c
+ @brief    Host simulation of the uplink router (Uplink.h) on a simulated
+           clock. The tool stands in for the two modems at the driver
+           calls the router makes: the ESP8266 (ESP_UdpSend, ESP_GetIP,
+           FastJoin_Connect, ...) and the SIM900 (SMSQueue_Post,
+           SIM900GetNetStat, and a GPRS path given as Uplink_Ops). Each
+           call takes the time the module would; a call during an outage
+           takes its timeout and fails.
+
+           The node sends telemetry every second (bulk, 300 s deadline),
+           an event every 10 s (normal, 30 s) and an alarm every minute
+           (urgent, 10 s) for 15 minutes, through these outages:
+
+             - Wi-Fi lost for 150 s: events and alarms fail over to GPRS,
+               telemetry waits and drains over Wi-Fi when it is back;
+             - Wi-Fi and GPRS lost for 70 s: an alarm goes by SMS once
+               both paths are found down;
+             - a short Wi-Fi loss of 20 s;
+             - Wi-Fi lost for 60 s while a stream of events (one every
+               600 ms, more than GPRS carries) keeps the queue busy from
+               before the outage to well after it: Wi-Fi has to be probed
+               back while the traffic flows over GPRS.
+
+           For each outage the tool prints the failover time (outage to
+           the first delivery over another path) against its bound: the
+           dead sends that take the lost paths down, after the first
+           message allowed on the surviving path, the time from the end
+           of a Wi-Fi outage to the first delivery over Wi-Fi against its
+           bound (the longest probe backoff, a join and the send in
+           flight), and the time to drain the queue after it. It also
+           prints the delivery latency per
+           priority (SMS delivery counted) and the cost per path. It
+           exits with 1 when an alarm expires or a failover or a return
+           to Wi-Fi exceeds its bound.
+
+           Build (from the repository root):
+               gcc -std=gnu99 -O2 -DSTATUS_HOST -DUPLINK_DEPTH=192 \
+                   -Itools/host -I. -o UplinkSim tools/UplinkSim.c \
+                   Uplink.c LinkSup.c StatusSink.c
+
+           The queue is deepened to hold the telemetry of a long outage.
+
+           Usage:
+               UplinkSim [-s <seed>]
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+#include "ESP8266.h"
+#include "FastJoin.h"
+#include "LinkSup.h"
+#include "SIM900.h"
+#include "SMSQueue.h"
+#include "TimeBase.h"
+#include "Uplink.h"
+
+
+#define SIM_END_MS					900000
+#define SIM_IDLE_MS					10			// Main loop period when nothing is sent
+
+#define WIFI_RTT_MS					40			// AT+CIPSEND to "SEND OK"
+#define WIFI_TIMEOUT_MS				1000		// Prompt and "SEND OK" of a lost link
+#define WIFI_JOIN_MS				4000		// A join attempt
+#define GPRS_RTT_MS					700
+#define GPRS_TIMEOUT_MS				5000
+#define SMS_SUBMIT_MS				20			// SMSQueue_Post
+#define SMS_DELIVERY_MS				5000		// Submission to the phone
+
+// Time of the dead sends that take a path down
+#define WIFI_DOWN_MS				(UPLINK_FAILS_DOWN * WIFI_TIMEOUT_MS)
+#define GPRS_DOWN_MS				(UPLINK_FAILS_DOWN * GPRS_TIMEOUT_MS)
+
+// Outage end to the first delivery over Wi-Fi: backoff, join, send in flight
+#define WIFI_BACK_MS				(LINKSUP_BACKOFF_MAX_MS + WIFI_JOIN_MS + 1000 + 2 * GPRS_RTT_MS)
+
+#define STREAM_BEFORE_MS			10000		// The event stream starts before the outage
+#define STREAM_AFTER_MS				90000		// and ends after it
+
+#define WIFI						1
+#define GPRS						2
+
+typedef struct
+{
+    uint32_t Start;
+    uint32_t End;
+    uint8_t  Lost;				// WIFI | GPRS
+    uint32_t Bound;				// Failover bound (ms)
+    uint32_t StreamMs;			// Period of the event stream around the outage, 0 if none
+} Sim_Outage;
+
+typedef struct
+{
+    uint32_t Count;
+    uint32_t Expired;
+    uint64_t TotalMs;
+    uint32_t MaxMs;
+} Sim_Lat;
+
+USART_TypeDef Host_USART[7] = {{.Port = 0},{.Port = 1},{.Port = 2},{.Port = 3},
+                               {.Port = 4},{.Port = 5},{.Port = 6}};
+uint32_t SystemCoreClock = 168000000;
+uint8_t Host_Flash[HOST_FLASH_SIZE];
+
+static const Sim_Outage Outages[] =
+{
+    // Events and alarms fail over to GPRS
+    { 100000, 250000, WIFI,        WIFI_DOWN_MS + 2 * GPRS_RTT_MS, 0 },
+    // The alarm of 450 s goes by SMS
+    { 445000, 515000, WIFI | GPRS, 5000 + WIFI_DOWN_MS + GPRS_DOWN_MS + 1000, 0 },
+    { 650000, 670000, WIFI,        WIFI_DOWN_MS + 2 * GPRS_RTT_MS, 0 },
+    // Wi-Fi is probed back while the stream keeps GPRS busy
+    { 720000, 780000, WIFI,        WIFI_DOWN_MS + 2 * GPRS_RTT_MS, 600 },
+};
+
+#define SIM_OUTAGES		(sizeof(Outages) / sizeof(Outages[0]))
+
+static uint32_t Sim_Now;				// ms
+static uint8_t  Sim_LinkOpen;			// UDP link of the Wi-Fi path
+static uint8_t  Sim_Prio[256];			// Priority of each handle
+static Sim_Lat  Sim_Lats[UPLINK_PATHS];	// Per priority
+static uint32_t Sim_Failover[SIM_OUTAGES];
+static uint32_t Sim_Drain[SIM_OUTAGES];
+static uint32_t Sim_Back[SIM_OUTAGES];	// Outage end to the first delivery over Wi-Fi
+static uint32_t Sim_Refused;
+
+
+static uint8_t Sim_Lost(void)
+{
+    uint8_t Lost = 0;
+
+    for (uint32_t i = 0; i < SIM_OUTAGES; i++)
+        if (Sim_Now >= Outages[i].Start && Sim_Now < Outages[i].End)
+            Lost |= Outages[i].Lost;
+
+    return Lost;
+}
+
+
+static void Sim_Wait(uint32_t ms)
+{
+    Sim_Now += ms;
+}
+
+
+/* The period of the event stream at the current time, 0 if none */
+static uint32_t Sim_Stream(void)
+{
+    for (uint32_t i = 0; i < SIM_OUTAGES; i++)
+        if (Outages[i].StreamMs != 0 && Sim_Now + STREAM_BEFORE_MS >= Outages[i].Start &&
+            Sim_Now < Outages[i].End + STREAM_AFTER_MS)
+            return Outages[i].StreamMs;
+
+    return 0;
+}
+
+
+/* The outage a time falls in, or the last one before it */
+static int Sim_OutageAt(uint32_t Time)
+{
+    int Last = -1;
+
+    for (uint32_t i = 0; i < SIM_OUTAGES; i++)
+        if (Time >= Outages[i].Start)
+            Last = i;
+
+    return Last;
+}
+
+
+/***************************************************
+		H O S T   L I B R A R I E S
+****************************************************/
+
+uint64_t TimeBase_Now(void)
+{
+    return (uint64_t)Sim_Now * 1000;
+}
+
+
+void TimeBase_Delay(uint64_t us)
+{
+    Sim_Wait(us / 1000);
+}
+
+
+/***************************************************
+				M O D E M S
+****************************************************/
+
+int8_t ESP_UdpSend(uint8_t Link, const uint8_t* Data, uint16_t Len)
+{
+    (void)Link;
+    (void)Data;
+    (void)Len;
+
+    if ((Sim_Lost() & WIFI) || !Sim_LinkOpen)
+    {
+        Sim_LinkOpen = 0;
+        Sim_Wait(WIFI_TIMEOUT_MS);
+        return ESP8266_TIMEOUT;
+    }
+
+    Sim_Wait(WIFI_RTT_MS / 2 + rand() % WIFI_RTT_MS);
+    return ESP8266_OK;
+}
+
+
+int8_t ESP_UdpOpen(uint8_t Link, const char* Host, uint16_t RemotePort, uint16_t LocalPort, uint8_t Mode)
+{
+    (void)Link;
+    (void)Host;
+    (void)RemotePort;
+    (void)LocalPort;
+    (void)Mode;
+
+    Sim_Wait(50);
+    Sim_LinkOpen = !(Sim_Lost() & WIFI);
+
+    return Sim_LinkOpen ? ESP8266_OK : ESP8266_FAIL;
+}
+
+
+int8_t ESP_Close(uint8_t Link)
+{
+    (void)Link;
+
+    Sim_Wait(20);
+    Sim_LinkOpen = 0;
+
+    return ESP8266_OK;
+}
+
+
+int8_t ESP_GetIP(void)
+{
+    Sim_Wait(30);
+    return (Sim_Lost() & WIFI) ? ESP8266_FAIL : ESP8266_OK;
+}
+
+
+int8_t FastJoin_Connect(void)
+{
+    Sim_Wait(WIFI_JOIN_MS);
+    return (Sim_Lost() & WIFI) ? ESP8266_FAIL : ESP8266_OK;
+}
+
+
+int8_t ESP_Probe(void)
+{
+    Sim_Wait(10);
+    return ESP8266_OK;
+}
+
+
+int8_t ESP_EnableMux(void)
+{
+    return ESP8266_OK;
+}
+
+
+int8_t ESP_EnableServer(void)
+{
+    return ESP8266_OK;
+}
+
+
+uint8_t ESP_GetLastFault(void)
+{
+    return 0;
+}
+
+
+int16_t SMSQueue_Post(const char* Num, const char* Msg, SMSQueue_Callback Callback)
+{
+    (void)Num;
+    (void)Msg;
+    (void)Callback;
+
+    Sim_Wait(SMS_SUBMIT_MS);
+    return 0;
+}
+
+
+int8_t SIM900GetNetStat(void)
+{
+    Sim_Wait(20);
+    return SIM900_NW_REGISTERED_HOME;
+}
+
+
+static int8_t Sim_GprsSend(const uint8_t* Data, uint16_t Len)
+{
+    (void)Data;
+    (void)Len;
+
+    if (Sim_Lost() & GPRS)
+    {
+        Sim_Wait(GPRS_TIMEOUT_MS);
+        return SIM900_TIMEOUT;
+    }
+
+    Sim_Wait(GPRS_RTT_MS / 2 + rand() % GPRS_RTT_MS);
+    return SIM900_OK;
+}
+
+
+static int8_t Sim_GprsProbe(void)
+{
+    Sim_Wait(200);
+    return (Sim_Lost() & GPRS) ? SIM900_FAIL : SIM900_OK;
+}
+
+
+static const Uplink_Ops Sim_GprsOps = { Sim_GprsSend, Sim_GprsProbe };
+
+
+/***************************************************
+				R U N
+****************************************************/
+
+/**
+ * @name    Sim_Delivered
+ * @brief   The callback of the router: latency per priority, and the
+ *              first delivery over another path after an outage started
+ *
+ * @author  Mehdi
+ */
+
+static uint32_t Sim_Queued[256];
+
+static void Sim_Delivered(uint8_t Handle, uint8_t Status, uint8_t Path)
+{
+    Sim_Lat* Lat = &Sim_Lats[Sim_Prio[Handle]];
+    uint32_t Ms;
+    int o;
+
+    if (Status == UPLINK_EXPIRED)
+    {
+        Lat->Expired++;
+        return;
+    }
+
+    Ms = Sim_Now - Sim_Queued[Handle] + (Path == UPLINK_SMS ? SMS_DELIVERY_MS : 0);
+    Lat->Count++;
+    Lat->TotalMs += Ms;
+    if (Ms > Lat->MaxMs)
+        Lat->MaxMs = Ms;
+
+    o = Sim_OutageAt(Sim_Now);
+    if (o >= 0 && Path != UPLINK_WIFI && Sim_Now < Outages[o].End && Sim_Failover[o] == 0)
+        Sim_Failover[o] = Sim_Now - Outages[o].Start;
+    if (o >= 0 && Path == UPLINK_WIFI && Sim_Now >= Outages[o].End && Sim_Back[o] == 0)
+        Sim_Back[o] = Sim_Now - Outages[o].End + 1;
+}
+
+
+static void Sim_Post(const char* Text, uint8_t Priority, uint32_t DeadlineMs)
+{
+    int16_t h = Uplink_Send(Text, strlen(Text), Priority, DeadlineMs);
+
+    if (h < 0)
+    {
+        Sim_Refused++;
+        return;
+    }
+
+    Sim_Prio[h] = Priority;
+    Sim_Queued[h] = Sim_Now;
+}
+
+
+int main(int argc, char** argv)
+{
+    static const char* Names[UPLINK_PATHS] = { "wifi", "gprs", "sms" };
+    static const char* Prios[UPLINK_PATHS] = { "bulk", "normal", "urgent" };
+    uint32_t Seed = 1, Next = 0, NextEvent = 0, n = 0, Errors = 0;
+    char Text[64];
+    int o;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-s") == 0)
+            Seed = atoi(argv[i + 1]);
+    }
+
+    srand(Seed);
+
+    Uplink_Init(Sim_Delivered);
+    Uplink_SetWifiTarget("10.0.0.1", 5000, 5001);
+    Uplink_SetSmsNumber("+31641600986");
+    Uplink_SetPath(UPLINK_WIFI, &Uplink_WifiOps, 0, 0);
+    Uplink_SetPath(UPLINK_GPRS, &Sim_GprsOps, 2, GPRS_RTT_MS);
+    Uplink_SetPath(UPLINK_SMS, &Uplink_SmsOps, 50, SMS_DELIVERY_MS);
+
+    while (Sim_Now < SIM_END_MS)
+    {
+        uint32_t Before = Sim_Now;
+
+        /* Traffic due */
+        while (Next <= Sim_Now)
+        {
+            snprintf(Text, sizeof(Text), "t=%u temp=21.%u", Next / 1000, n % 10);
+            Sim_Post(Text, UPLINK_PRIO_BULK, 300000);
+            if (n % 10 == 0)
+                Sim_Post("event door=open", UPLINK_PRIO_NORMAL, 30000);
+            if (n % 60 == 30)
+                Sim_Post("ALARM smoke", UPLINK_PRIO_URGENT, 10000);
+            n++;
+            Next += 1000;
+        }
+
+        /* Event stream around an outage */
+        if (Sim_Stream() == 0)
+            NextEvent = Sim_Now;
+        while (Sim_Stream() != 0 && NextEvent <= Sim_Now)
+        {
+            Sim_Post("event valve=2", UPLINK_PRIO_NORMAL, 30000);
+            NextEvent += Sim_Stream();
+        }
+
+        Uplink_Poll();
+
+        /* Queue drained after an outage */
+        o = Sim_OutageAt(Sim_Now);
+        if (o >= 0 && Sim_Now >= Outages[o].End && Sim_Drain[o] == 0 && Uplink_Pending() == 0)
+            Sim_Drain[o] = Sim_Now - Outages[o].End;
+
+        if (Sim_Now == Before)
+            Sim_Wait(SIM_IDLE_MS);
+    }
+
+    printf("outage                     failover ms   bound ms    back ms   bound ms   drain ms\n");
+    for (uint32_t i = 0; i < SIM_OUTAGES; i++)
+    {
+        printf("%3u-%3u s %-14s %12u %10u %10u %10u %10u\n",
+               Outages[i].Start / 1000, Outages[i].End / 1000,
+               Outages[i].Lost == WIFI ? (Outages[i].StreamMs ? "wifi, busy" : "wifi") : "wifi+gprs",
+               Sim_Failover[i], Outages[i].Bound, Sim_Back[i], WIFI_BACK_MS, Sim_Drain[i]);
+        if (Sim_Failover[i] == 0 || Sim_Failover[i] > Outages[i].Bound)
+            Errors++;
+        if (Sim_Back[i] == 0 || Sim_Back[i] > WIFI_BACK_MS)
+            Errors++;
+    }
+    printf("router: %u failovers, first failure to delivery max %u ms\n\n",
+           Uplink_GetStat()->Failovers, Uplink_GetStat()->MaxFailoverMs);
+
+    printf("priority      sent  expired   avg ms   max ms\n");
+    for (int p = 0; p < UPLINK_PATHS; p++)
+        printf("%-10s %7u %8u %8.0f %8u\n", Prios[p], Sim_Lats[p].Count, Sim_Lats[p].Expired,
+               Sim_Lats[p].Count ? (double)Sim_Lats[p].TotalMs / Sim_Lats[p].Count : 0.0, Sim_Lats[p].MaxMs);
+    printf("refused (queue full) %u\n\n", Sim_Refused);
+
+    printf("path        sent  failed    bytes     cost  srtt ms  down s\n");
+    for (int p = 0; p < UPLINK_PATHS; p++)
+    {
+        const Uplink_Path* Path = Uplink_GetPath(p);
+        printf("%-8s %7u %7u %8u %8u %8u %7u\n", Names[p], Path->Sent, Path->Failed, Path->Bytes,
+               Path->Spent, Path->SrttMs, Path->DownMs / 1000);
+    }
+
+    if (Sim_Lats[UPLINK_PRIO_URGENT].Expired != 0)
+        Errors++;
+
+    return Errors ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+#!/bin/sh
+#
+# @file     footprint.sh
+# @brief    RAM/flash footprint of the modules. Every module is compiled
+#           with -fstack-usage; the table lists the code, the constant
+#           tables, .data, .bss and the largest stack frame of each one.
+#           The sections are read one by one (objdump -h): read-only data
+#           and .data.rel.ro (the const tables of pointers the host
+#           compiler keeps writable for relocation) stay in flash, .data
+#           costs flash and RAM, .bss RAM only. The RAM total is the
+#           static data plus a stack bound (the largest frame of every
+#           module added up, as if one call chain went through all of
+#           them). The script fails when the total exceeds the budget, or
+#           when a module does not build (the totals would leave it out).
+#
+#           Usage (from the repository root):
+#               tools/footprint.sh [budget bytes]
+#
+#           The target build is measured with the cross compiler, e.g.
+#               CC=arm-none-eabi-gcc OBJDUMP=arm-none-eabi-objdump \
+#               CFLAGS="-mcpu=cortex-m4 -mthumb -Os -I<HAL> -I<TM libs>" \
+#               tools/footprint.sh 16384
+#           Without CC the host compiler and the host shims of
+#           tools/host give an estimate.
+#
+# @author   Mehdi
+#
+
+BUDGET=${1:-16384}
+CC=${CC:-gcc}
+OBJDUMP=${OBJDUMP:-objdump}
+CFLAGS=${CFLAGS:--Os -DSTATUS_HOST -DTIMEBASE_HOST -Itools/host}
+MODULES=${MODULES:-"AssetData Assets ATCmd ATEngine ATResp AuxLib BufPool ESP8266 FastJoin HttpPush LinkSup Metrics SIM900 SIM900Http Scheduler SMSCmd SMSCmdHash SMSConcat SMSPdu SMSQueue StatusSink TimeBase UdpBatch Uplink"}
+
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+printf "%-12s %8s %8s %8s %8s %8s\n" module text const data bss stack
+
+TOTAL_TEXT=0
+TOTAL_STATIC=0
+TOTAL_STACK=0
+FAILED=""
+
+for m in $MODULES
+do
+    if ! $CC -std=gnu99 $CFLAGS -I. -fstack-usage -c -o "$OUT/$m.o" "$m.c" 2>"$OUT/$m.err"
+    then
+        printf "%-12s does not build with %s (see below)\n" "$m" "$CC"
+        sed 's/^/    /' "$OUT/$m.err" | head -5
+        FAILED="$FAILED $m"
+        continue
+    fi
+
+    # <idx> <name> <size> <vma> <lma> <offset> <align>, then the flags
+    set -- $($OBJDUMP -h "$OUT/$m.o" | awk '
+        function hex(s,   i, v) { v = 0; for (i = 1; i <= length(s); i++) v = v * 16 + index("0123456789abcdef", tolower(substr(s, i, 1))) - 1; return v }
+        $1 ~ /^[0-9]+$/ { name = $2; size = hex($3); next }
+        name != "" && /ALLOC/ {
+            if (/CODE/) text += size
+            else if (/READONLY/ || name ~ /^\.data\.rel\.ro/) rodata += size
+            else if (/CONTENTS/) data += size
+            else bss += size
+        }
+        { name = "" }
+        END { print text + 0, rodata + 0, data + 0, bss + 0 }')
+    TEXT=$1; CONST=$2; DATA=$3; BSS=$4
+
+    # <file>:<line>:<col>:<function>	<bytes>	<static|dynamic>
+    STACK=$(awk -F'\t' 'BEGIN { m = 0 } { if ($2 + 0 > m) m = $2 + 0 } END { print m }' "$OUT/$m.su" 2>/dev/null)
+    STACK=${STACK:-0}
+
+    printf "%-12s %8u %8u %8u %8u %8u\n" "$m" "$TEXT" "$CONST" "$DATA" "$BSS" "$STACK"
+
+    TOTAL_TEXT=$((TOTAL_TEXT + TEXT + CONST + DATA))
+    TOTAL_STATIC=$((TOTAL_STATIC + DATA + BSS))
+    TOTAL_STACK=$((TOTAL_STACK + STACK))
+done
+
+TOTAL=$((TOTAL_STATIC + TOTAL_STACK))
+
+echo
+printf "flash        %8u\n" "$TOTAL_TEXT"
+printf "ram          %8u  (%u static + %u stack bound)\n" "$TOTAL" "$TOTAL_STATIC" "$TOTAL_STACK"
+printf "budget       %8u\n" "$BUDGET"
+
+STATUS=0
+
+if [ -n "$FAILED" ]
+then
+    echo "NOT BUILT:$FAILED (left out of the totals)"
+    STATUS=1
+fi
+
+if [ "$TOTAL" -gt "$BUDGET" ]
+then
+    echo "OVER BUDGET by $((TOTAL - BUDGET)) bytes"
+    STATUS=1
+fi
+
+exit $STATUS
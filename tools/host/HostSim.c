@@ -0,0 +1,346 @@
+/**
+ @file     HostSim.c
+ @brief    This file contains the simulated clock and module line of the
+           host tools (see HostSim.h), and the host libraries over them.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+#include "tm_stm32_usart.h"
+#include "tm_stm32_delay.h"
+#include "tm_stm32_hd44780.h"
+
+#include "TimeBase.h"
+#include "HostSim.h"
+
+
+typedef struct
+{
+    uint64_t At;				// ns, 0: free
+    char     Text[SIM_EVENT_LEN];
+} Sim_Event;
+
+USART_TypeDef Host_USART[7] = {{.Port = 0},{.Port = 1},{.Port = 2},{.Port = 3},
+                               {.Port = 4},{.Port = 5},{.Port = 6}};
+uint32_t SystemCoreClock = 168000000;
+uint8_t Host_Flash[HOST_FLASH_SIZE];
+
+uint64_t Sim_Now;
+uint64_t Sim_ByteNs;
+
+static uint8_t   Sim_Rx[SIM_RX_SIZE];		// Bytes of the module, to the driver
+static uint64_t  Sim_RxAt[SIM_RX_SIZE];		// Their arrival (ns)
+static uint16_t  Sim_RxHead, Sim_RxTail;
+static uint16_t  Sim_RxShown;				// First byte not arrived yet
+static uint64_t  Sim_RxLast;				// Arrival of the last byte queued
+static Sim_Event Sim_Events[SIM_EVENTS];
+
+
+/***************************************************
+				M O D U L E
+****************************************************/
+
+/**
+ * @name    Mod_WriteAt
+ * @brief   The function queues bytes to the driver: they arrive one after
+ *              the other (Sim_ByteNs apart), from a given time on and
+ *              after the bytes queued before
+ *
+ * @author  Mehdi
+ *
+ * @param	At: time (ns) the module sends the first byte
+ */
+
+void Mod_WriteAt(const void* Data, uint32_t Len, uint64_t At)
+{
+    const uint8_t* p = Data;
+
+    if (At < Sim_RxLast)
+        At = Sim_RxLast;
+
+    for (; Len != 0; Len--)
+    {
+        At += Sim_ByteNs;
+        Sim_Rx[Sim_RxHead] = *p++;
+        Sim_RxAt[Sim_RxHead] = At;
+        Sim_RxHead = (Sim_RxHead + 1) % SIM_RX_SIZE;
+    }
+
+    Sim_RxLast = At;
+}
+
+
+void Mod_Write(const void* Data, uint32_t Len)
+{
+    Mod_WriteAt(Data,Len,Sim_Now);
+}
+
+
+void Mod_Print(const char* Text)
+{
+    Mod_Write(Text,strlen(Text));
+}
+
+
+/**
+ * @name    Mod_Later
+ * @brief   The function queues a reply of the module due in some time
+ *
+ * @author  Mehdi
+ */
+
+void Mod_Later(uint32_t Ms, const char* Text)
+{
+    for (uint8_t i = 0; i < SIM_EVENTS; i++)
+    {
+        if (Sim_Events[i].At == 0)
+        {
+            Sim_Events[i].At = Sim_Now + Ms * 1000000ULL;
+            snprintf(Sim_Events[i].Text,sizeof(Sim_Events[i].Text),"%s",Text);
+            return;
+        }
+    }
+
+    fprintf(stderr,"HostSim: too many replies due\n");
+    exit(1);
+}
+
+
+/**
+ * @name    Mod_Pending
+ * @brief   The function moves the module to Sim_Now and counts the bytes
+ *              arrived and not read
+ *
+ * @author  Mehdi
+ */
+
+uint16_t Mod_Pending(void)
+{
+    int8_t First;
+
+    Mod_Tick();
+
+    /* The replies that are due, oldest first */
+    do
+    {
+        First = -1;
+        for (uint8_t i = 0; i < SIM_EVENTS; i++)
+            if (Sim_Events[i].At != 0 && Sim_Events[i].At <= Sim_Now &&
+                (First < 0 || Sim_Events[i].At < Sim_Events[First].At))
+                First = i;
+
+        if (First >= 0)
+        {
+            Mod_Print(Sim_Events[First].Text);
+            Sim_Events[First].At = 0;
+        }
+    } while (First >= 0);
+
+    while (Sim_RxShown != Sim_RxHead && Sim_RxAt[Sim_RxShown] <= Sim_Now)
+        Sim_RxShown = (Sim_RxShown + 1) % SIM_RX_SIZE;
+
+    return (Sim_RxShown + SIM_RX_SIZE - Sim_RxTail) % SIM_RX_SIZE;
+}
+
+
+/* Drops the bytes queued and the replies due, between two cases */
+void Mod_Flush(void)
+{
+    Sim_RxHead = Sim_RxTail = Sim_RxShown = 0;
+    Sim_RxLast = 0;
+    memset(Sim_Events,0,sizeof(Sim_Events));
+}
+
+
+/***************************************************
+		H O S T   L I B R A R I E S
+****************************************************/
+
+void TM_USART_Putc(USART_TypeDef* USARTx, volatile char c)
+{
+    (void)USARTx;
+    Mod_Rx(c);
+}
+
+
+void TM_USART_Puts(USART_TypeDef* USARTx, char* str)
+{
+    (void)USARTx;
+    while (*str)
+        Mod_Rx(*str++);
+}
+
+
+void TM_USART_Send(USART_TypeDef* USARTx, uint8_t* DataArray, uint16_t count)
+{
+    (void)USARTx;
+    for (uint16_t i = 0; i < count; i++)
+        Mod_Rx(DataArray[i]);
+}
+
+
+uint8_t TM_USART_Getc(USART_TypeDef* USARTx)
+{
+    uint8_t c;
+
+    (void)USARTx;
+    if (Mod_Pending() == 0)
+        return 0;
+
+    c = Sim_Rx[Sim_RxTail];
+    Sim_RxTail = (Sim_RxTail + 1) % SIM_RX_SIZE;
+
+    return c;
+}
+
+
+uint16_t TM_USART_Gets(USART_TypeDef* USARTx, char* buffer, uint16_t bufsize)
+{
+    uint16_t i = 0;
+
+    if (TM_USART_FindCharacter(USARTx, '\n') < 0 && Mod_Pending() < bufsize - 1)
+        return 0;
+
+    while (i < bufsize - 1 && !TM_USART_BufferEmpty(USARTx))
+    {
+        buffer[i] = TM_USART_Getc(USARTx);
+        if (buffer[i++] == '\n')
+            break;
+    }
+    buffer[i] = 0;
+
+    return i;
+}
+
+
+uint8_t TM_USART_BufferEmpty(USART_TypeDef* USARTx)
+{
+    (void)USARTx;
+    return Mod_Pending() == 0;
+}
+
+
+uint16_t TM_USART_BufferCount(USART_TypeDef* USARTx)
+{
+    (void)USARTx;
+    return Mod_Pending();
+}
+
+
+void TM_USART_ClearBuffer(USART_TypeDef* USARTx)
+{
+    (void)USARTx;
+    Mod_Pending();
+    Sim_RxTail = Sim_RxShown;
+}
+
+
+int16_t TM_USART_FindCharacter(USART_TypeDef* USARTx, uint8_t c)
+{
+    (void)USARTx;
+    for (uint16_t i = 0, n = Mod_Pending(); i < n; i++)
+        if (Sim_Rx[(Sim_RxTail + i) % SIM_RX_SIZE] == c)
+            return i;
+
+    return -1;
+}
+
+
+uint32_t HAL_GetTick(void)
+{
+    Sim_Now += SIM_STEP_NS;
+    Mod_Tick();
+    return Sim_Now / 1000000;
+}
+
+
+void Delay(uint32_t us)
+{
+    Sim_Now += us * 1000ULL;
+}
+
+
+void Delayms(uint32_t ms)
+{
+    Sim_Now += ms * 1000000ULL;
+}
+
+
+uint32_t TM_DELAY_Time(void)
+{
+    return HAL_GetTick();
+}
+
+
+uint64_t TimeBase_Now(void)
+{
+    Sim_Now += SIM_STEP_NS;
+    Mod_Tick();
+    return Sim_Now / 1000;
+}
+
+
+void TimeBase_Delay(uint64_t us)
+{
+    Sim_Now += us * 1000;
+}
+
+
+void TM_HD44780_Clear(void)
+{
+}
+
+
+void TM_HD44780_Puts(uint8_t x, uint8_t y, char* str)
+{
+    (void)x;
+    (void)y;
+    (void)str;
+}
+
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    return HAL_OK;
+}
+
+
+/* Programming only clears bits, as on the part */
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data)
+{
+    uint32_t Word;
+
+    (void)TypeProgram;
+    if (Address < (uintptr_t)Host_Flash || Address + 4 > (uintptr_t)Host_Flash + HOST_FLASH_SIZE)
+        return HAL_ERROR;
+
+    memcpy(&Word, (void*)Address, 4);
+    Word &= (uint32_t)Data;
+    memcpy((void*)Address, &Word, 4);
+
+    return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError)
+{
+    (void)pEraseInit;
+    memset(Host_Flash, 0xFF, HOST_FLASH_SIZE);
+    *SectorError = 0xFFFFFFFF;
+
+    return HAL_OK;
+}
@@ -0,0 +1,58 @@
+/**
+ @file     HostSim.h
+ @brief    Simulated clock and module line shared by the host tools that
+           drive the drivers against an emulated module: the TM USART,
+           TM delay, HD44780 and flash libraries, HAL_GetTick and
+           TimeBase_Now.
+
+           The clock (Sim_Now, ns) moves SIM_STEP_NS on every poll and by
+           the full time of a delay. The bytes of the module are queued
+           with an arrival time; the driver reads the ones arrived.
+
+           The tool provides the module itself:
+               Mod_Rx     takes each byte the driver sends
+               Mod_Tick   moves the module to Sim_Now (called on every
+                          poll of the clock and of the line)
+
+           Build: add tools/host/HostSim.c to the sources of the tool.
+
+ @author   Mehdi
+
+*/
+
+#ifndef HOST_SIM_H_
+#define HOST_SIM_H_
+
+#include <stdint.h>
+
+#define SIM_STEP_NS					10000		// Clock step of a poll of the clock
+#define SIM_RX_SIZE					4096		// Bytes of the module not read yet
+#define SIM_EVENTS					64			// Replies due later
+#define SIM_EVENT_LEN				160
+
+extern uint64_t Sim_Now;			// ns
+extern uint64_t Sim_ByteNs;			// Time of a byte of the module on the wire, 0: at once
+
+
+/***************************************************
+			F U N C T I O N S
+****************************************************/
+
+void Mod_WriteAt(const void* Data, uint32_t Len, uint64_t At);
+
+void Mod_Write(const void* Data, uint32_t Len);
+
+void Mod_Print(const char* Text);
+
+void Mod_Later(uint32_t Ms, const char* Text);
+
+uint16_t Mod_Pending(void);
+
+void Mod_Flush(void);
+
+// Provided by the tool
+void Mod_Rx(uint8_t c);
+void Mod_Tick(void);
+
+
+#endif /* HOST_SIM_H_ */
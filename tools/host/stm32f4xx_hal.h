@@ -0,0 +1,69 @@
+/**
+ @file     stm32f4xx_hal.h
+ @brief    Host stand-in of the few HAL definitions the modem drivers use,
+           so the unmodified drivers can be linked with tools/TraceReplay.c.
+
+ @author   Mehdi
+
+*/
+
+#ifndef HOST_STM32F4XX_HAL_H_
+#define HOST_STM32F4XX_HAL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct
+{
+    uint8_t  Port;
+    uint32_t CR3;
+} USART_TypeDef;
+
+#define USART_CR3_RTSE				(1U << 8)
+#define USART_CR3_CTSE				(1U << 9)
+
+extern USART_TypeDef Host_USART[7];
+
+#define USART1						(&Host_USART[1])
+#define USART2						(&Host_USART[2])
+#define USART3						(&Host_USART[3])
+#define USART6						(&Host_USART[6])
+
+extern uint32_t SystemCoreClock;
+
+uint32_t HAL_GetTick(void);
+
+#define __WFI()						((void)0)
+
+// Flash: the FastJoin record lives in a host array
+typedef enum
+{
+    HAL_OK = 0,
+    HAL_ERROR
+} HAL_StatusTypeDef;
+
+typedef struct
+{
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Sector;
+    uint32_t NbSectors;
+    uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEERASE_SECTORS		0U
+#define FLASH_VOLTAGE_RANGE_3		2U
+#define FLASH_TYPEPROGRAM_WORD		2U
+#define FLASH_SECTOR_11				11U
+
+#define HOST_FLASH_SIZE				1024
+extern uint8_t Host_Flash[HOST_FLASH_SIZE];
+
+#define FASTJOIN_FLASH_ADDR			((uintptr_t)Host_Flash)
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError);
+
+#endif /* HOST_STM32F4XX_HAL_H_ */
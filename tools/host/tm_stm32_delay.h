@@ -0,0 +1,18 @@
+/**
+ @file     tm_stm32_delay.h
+ @brief    Host stand-in of the TM delay library; implemented by the replay tool.
+
+ @author   Mehdi
+
+*/
+
+#ifndef HOST_TM_STM32_DELAY_H_
+#define HOST_TM_STM32_DELAY_H_
+
+#include <stdint.h>
+
+void     Delay(uint32_t us);
+void     Delayms(uint32_t ms);
+uint32_t TM_DELAY_Time(void);
+
+#endif /* HOST_TM_STM32_DELAY_H_ */
@@ -0,0 +1,17 @@
+/**
+ @file     tm_stm32_hd44780.h
+ @brief    Host stand-in of the TM HD44780 library; implemented by the replay tool.
+
+ @author   Mehdi
+
+*/
+
+#ifndef HOST_TM_STM32_HD44780_H_
+#define HOST_TM_STM32_HD44780_H_
+
+#include <stdint.h>
+
+void TM_HD44780_Clear(void);
+void TM_HD44780_Puts(uint8_t x, uint8_t y, char* str);
+
+#endif /* HOST_TM_STM32_HD44780_H_ */
@@ -0,0 +1,24 @@
+/**
+ @file     tm_stm32_usart.h
+ @brief    Host stand-in of the TM USART library; implemented by the replay tool.
+
+ @author   Mehdi
+
+*/
+
+#ifndef HOST_TM_STM32_USART_H_
+#define HOST_TM_STM32_USART_H_
+
+#include "stm32f4xx_hal.h"
+
+void     TM_USART_Putc(USART_TypeDef* USARTx, volatile char c);
+void     TM_USART_Puts(USART_TypeDef* USARTx, char* str);
+void     TM_USART_Send(USART_TypeDef* USARTx, uint8_t* DataArray, uint16_t count);
+uint8_t  TM_USART_Getc(USART_TypeDef* USARTx);
+uint16_t TM_USART_Gets(USART_TypeDef* USARTx, char* buffer, uint16_t bufsize);
+uint8_t  TM_USART_BufferEmpty(USART_TypeDef* USARTx);
+uint16_t TM_USART_BufferCount(USART_TypeDef* USARTx);
+void     TM_USART_ClearBuffer(USART_TypeDef* USARTx);
+int16_t  TM_USART_FindCharacter(USART_TypeDef* USARTx, uint8_t c);
+
+#endif /* HOST_TM_STM32_USART_H_ */
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+#
+# @file     mkassets.py
+# @brief    Build step of the static assets (Assets.h). Every file of the
+#           web directory is gzipped (level 9, no timestamp, so the output
+#           only changes with the content) and written to a const table
+#           with its length, its length before compression and an ETag
+#           (the first 12 hex digits of its SHA-1). A file that does not
+#           shrink is stored as is.
+#
+#           Usage (from the repository root):
+#               tools/mkassets.py [web directory] [output]
+#           The defaults are web and AssetData.c; run it again after a
+#           change of the pages and commit the output with them.
+#
+# @author   Mehdi
+#
+
+import gzip
+import hashlib
+import os
+import sys
+
+TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".htm":  "text/html; charset=utf-8",
+    ".js":   "application/javascript",
+    ".css":  "text/css",
+    ".json": "application/json",
+    ".svg":  "image/svg+xml",
+    ".png":  "image/png",
+    ".ico":  "image/x-icon",
+    ".txt":  "text/plain; charset=utf-8",
+}
+
+HEADER = """/**
+ @file     AssetData.c
+ @brief    Static assets of the HTTP server (see Assets.h), generated by
+           tools/mkassets.py from {src}/. Do not edit: change the pages
+           and run the script again.
+
+           {count} assets, {raw} bytes, {stored} bytes stored.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+
+#include "Assets.h"
+
+"""
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("    " + ",".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def main(argv):
+    src = argv[1] if len(argv) > 1 else "web"
+    out = argv[2] if len(argv) > 2 else "AssetData.c"
+
+    files = []
+    for root, dirs, names in os.walk(src):
+        dirs.sort()
+        for name in sorted(names):
+            files.append(os.path.join(root, name))
+
+    assets = []
+    for path in files:
+        ext = os.path.splitext(path)[1].lower()
+        if ext not in TYPES:
+            sys.stderr.write("mkassets: %s: unknown type, skipped\n" % path)
+            continue
+
+        with open(path, "rb") as f:
+            raw = f.read()
+
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        gz = len(packed) < len(raw)
+        url = "/" + os.path.relpath(path, src).replace(os.sep, "/")
+        etag = '"%s"' % hashlib.sha1(raw).hexdigest()[:12]
+
+        assets.append((url, TYPES[ext], etag, packed if gz else raw, len(raw), gz))
+
+    if not assets:
+        sys.stderr.write("mkassets: no assets in %s\n" % src)
+        return 1
+
+    if len(assets) > 255:
+        sys.stderr.write("mkassets: too many assets (Asset_Count is 8 bits)\n")
+        return 1
+
+    text = HEADER.format(src=src.rstrip("/"), count=len(assets),
+                         raw=sum(a[4] for a in assets), stored=sum(len(a[3]) for a in assets))
+
+    for i, (url, ctype, etag, data, raw, gz) in enumerate(assets):
+        text += "// %s: %u bytes%s\n" % (url, raw, ", gzip %u" % len(data) if gz else "")
+        text += "static const uint8_t Asset_%u[%u] =\n{\n%s\n};\n\n" % (i, len(data), c_bytes(data))
+
+    text += "const Asset Asset_Table[] =\n{\n"
+    for i, (url, ctype, etag, data, raw, gz) in enumerate(assets):
+        text += "    { %s, %s, %s, Asset_%u, %u, %u, %u },\n" % (
+            c_string(url), c_string(ctype), c_string(etag), i, len(data), raw, 1 if gz else 0)
+    text += "};\n\nconst uint8_t Asset_Count = sizeof(Asset_Table) / sizeof(Asset_Table[0]);\n"
+
+    with open(out, "w", newline="\n") as f:
+        f.write(text)
+
+    for url, ctype, etag, data, raw, gz in assets:
+        print("%-24s %6u -> %6u  %s" % (url, raw, len(data), etag))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
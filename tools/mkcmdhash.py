@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# @file     mkcmdhash.py
+# @brief    Build step of the SMS command dispatcher (SMSCmd.h). The verbs
+#           of SMSCMD_TABLE are placed with a minimal perfect hash (hash
+#           and displace): the FNV-1a hash of a verb picks one of N/2
+#           buckets, and the displacement of the bucket, mixed with the
+#           hash, picks one of N slots. The displacements are searched
+#           bucket by bucket, the largest first, until every verb has a
+#           slot of its own; SMSCmd.c computes the same functions.
+#
+#           Usage (from the repository root):
+#               tools/mkcmdhash.py [SMSCmd.h] [output]
+#           The defaults are SMSCmd.h and SMSCmdHash.c; run it again after
+#           a change of the table and commit the output with it.
+#
+# @author   Mehdi
+#
+
+import re
+import sys
+
+FNV_BASIS = 2166136261
+FNV_PRIME = 16777619
+MASK = 0xFFFFFFFF
+
+HEADER = """/**
+ @file     SMSCmdHash.c
+ @brief    Minimal perfect hash of the SMS command verbs (SMSCMD_TABLE in
+           SMSCmd.h), generated by tools/mkcmdhash.py. Do not edit: change
+           the table and run the script again.
+
+           {count} verbs, {buckets} buckets.
+
+ @author   Mehdi
+
+*/
+
+
+#include <stdint.h>
+
+#include "SMSCmd.h"
+
+
+// The table the hash was made for
+typedef char SMSCmd_HashIsCurrent[(SMSCMD_COUNT == {count}) ? 1 : -1];
+
+"""
+
+
+def fnv1a(verb):
+    h = FNV_BASIS
+    for b in verb.upper().encode("ascii"):
+        h = ((h ^ b) * FNV_PRIME) & MASK
+    return h
+
+
+def mix(x):
+    x ^= x >> 16
+    x = (x * 0x85EBCA6B) & MASK
+    x ^= x >> 13
+    x = (x * 0xC2B2AE35) & MASK
+    x ^= x >> 16
+    return x
+
+
+def read_table(path):
+    with open(path) as f:
+        text = f.read()
+
+    start = text.find("#define SMSCMD_TABLE(X)")
+    if start < 0:
+        raise SystemExit("mkcmdhash: no SMSCMD_TABLE in %s" % path)
+
+    # The macro ends at the first line without a continuation
+    lines = []
+    for line in text[start:].split("\n"):
+        lines.append(line)
+        if not line.rstrip().endswith("\\"):
+            break
+
+    return re.findall(r'X\(\s*(\w+)\s*,\s*"([^"]+)"\s*,\s*(\d+)\s*,\s*(\d+)\s*\)', "\n".join(lines))
+
+
+def build(verbs):
+    n = len(verbs)
+    buckets = max(1, (n + 1) // 2)
+    hashes = [fnv1a(v) for v in verbs]
+
+    if len(set(hashes)) != n:
+        raise SystemExit("mkcmdhash: two verbs have the same hash")
+
+    groups = [[] for _ in range(buckets)]
+    for i, h in enumerate(hashes):
+        groups[h % buckets].append(i)
+
+    disp = [0] * buckets
+    slot = [None] * n
+
+    for b in sorted(range(buckets), key=lambda b: -len(groups[b])):
+        if not groups[b]:
+            continue
+        for d in range(65536):
+            taken = [mix(hashes[i] ^ d) % n for i in groups[b]]
+            if len(set(taken)) == len(taken) and all(slot[s] is None for s in taken):
+                for i, s in zip(groups[b], taken):
+                    slot[s] = i
+                disp[b] = d
+                break
+        else:
+            raise SystemExit("mkcmdhash: no displacement for bucket %u" % b)
+
+    return buckets, disp, slot
+
+
+def main(argv):
+    src = argv[1] if len(argv) > 1 else "SMSCmd.h"
+    out = argv[2] if len(argv) > 2 else "SMSCmdHash.c"
+
+    table = read_table(src)
+    if not table:
+        raise SystemExit("mkcmdhash: SMSCMD_TABLE is empty")
+    if len(table) > 127:
+        raise SystemExit("mkcmdhash: too many verbs (the ids are int8_t)")
+
+    verbs = [verb for _, verb, _, _ in table]
+    for verb in verbs:
+        if verb != verb.upper() or not re.match(r"^[A-Z0-9_]+$", verb):
+            raise SystemExit("mkcmdhash: verb %s: upper case letters and digits only" % verb)
+    if len(set(verbs)) != len(verbs):
+        raise SystemExit("mkcmdhash: a verb is declared twice")
+
+    buckets, disp, slot = build(verbs)
+
+    text = HEADER.format(count=len(table), buckets=buckets)
+    text += "const uint8_t SMSCmd_Buckets = %u;\n\n" % buckets
+    text += "// Displacement of each bucket\n"
+    text += "const uint16_t SMSCmd_Disp[%u] =\n{\n    %s\n};\n\n" % (
+        buckets, ", ".join("%u" % d for d in disp))
+    text += "// Command of each slot\n"
+    text += "const uint8_t SMSCmd_Slot[SMSCMD_COUNT] =\n{\n"
+    for i in slot:
+        text += "    %-24s// %s\n" % ("SMSCMD_%s," % table[i][0], table[i][1])
+    text += "};\n"
+
+    with open(out, "w", newline="\n") as f:
+        f.write(text)
+
+    for s, i in enumerate(slot):
+        print("slot %2u  %-12s bucket %2u  disp %u" % (s, table[i][1], fnv1a(table[i][1]) % buckets,
+                                                       disp[fnv1a(table[i][1]) % buckets]))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# @file     modemsize.sh
+# @brief    Code size of the C++ front-end (Modem.hpp) against the C
+#           engine. tools/ModemBench.cpp is linked twice with BENCH_SIZE
+#           and --gc-sections: once running its connect/send/close
+#           sequence through ATEngine, once through a Modem on the USART
+#           library. Everything else in the two images is the same, so
+#           the difference is what each API costs the application: the
+#           engine, the collector and the whole command table for the C
+#           one; the inlined calls and the texts of the six commands used
+#           for the template.
+#
+#           Usage (from the repository root):
+#               tools/modemsize.sh
+#
+#           The target build is measured with the cross compilers, e.g.
+#               CC=arm-none-eabi-gcc CXX=arm-none-eabi-g++ \
+#               SIZE=arm-none-eabi-size \
+#               CFLAGS="-mcpu=cortex-m4 -mthumb -Os -I<HAL> -I<TM libs>" \
+#               LDFLAGS="--specs=nosys.specs" tools/modemsize.sh
+#           Without CC the host compilers and the host shims of
+#           tools/host give an estimate.
+#
+# @author   Mehdi
+#
+
+CC=${CC:-gcc}
+CXX=${CXX:-g++}
+SIZE=${SIZE:-size}
+CFLAGS=${CFLAGS:--Os -DSTATUS_HOST -Itools/host}
+LDFLAGS=${LDFLAGS:-}
+
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+for m in ATCmd ATEngine ATResp
+do
+    $CC -std=gnu99 $CFLAGS -I. -ffunction-sections -fdata-sections -c -o "$OUT/$m.o" "$m.c" 2>/dev/null || exit 1
+done
+
+printf "%-24s %8s %8s %8s\n" image text data bss
+
+for side in 1 2
+do
+    $CXX -std=c++17 $CFLAGS -I. -ffunction-sections -fdata-sections -DBENCH_SIZE=$side \
+        -o "$OUT/size$side" tools/ModemBench.cpp "$OUT/ATCmd.o" "$OUT/ATEngine.o" "$OUT/ATResp.o" \
+        -Wl,--gc-sections $LDFLAGS || exit 1
+
+    set -- $($SIZE "$OUT/size$side" | tail -1)
+    eval TEXT$side=$1 DATA$side=$2 BSS$side=$3
+done
+
+printf "%-24s %8u %8u %8u\n" "ATEngine (C)" "$TEXT1" "$DATA1" "$BSS1"
+printf "%-24s %8u %8u %8u\n" "Modem<> (C++)" "$TEXT2" "$DATA2" "$BSS2"
+echo
+printf "flash saved by Modem<>   %8d\n" $((TEXT1 + DATA1 - TEXT2 - DATA2))
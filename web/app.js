@@ -0,0 +1,65 @@
+// Polls /status and fills the table of the control page.
+(function () {
+  "use strict";
+
+  var PERIOD_MS = 5000;
+
+  var LABELS = [
+    ["uptime_s", "Uptime", uptime],
+    ["rssi_dbm", "Wi-Fi signal", function (v) { return v + " dBm"; }],
+    ["commands", "AT commands", String],
+    ["failures", "Failed commands", String, true],
+    ["timeouts", "Timed out commands", String, true],
+    ["rx_overflows", "RX overflows", String, true],
+    ["recoveries", "Link recoveries", String],
+    ["retries", "Recovery retries", String, true],
+    ["giveups", "Recoveries given up", String, true],
+    ["pool_peak", "Buffer pool peak", String],
+    ["pool_failed", "Buffer pool failures", String, true]
+  ];
+
+  function uptime(s) {
+    var d = Math.floor(s / 86400), h = Math.floor(s / 3600) % 24, m = Math.floor(s / 60) % 60;
+    return (d ? d + " d " : "") + h + " h " + m + " min";
+  }
+
+  function render(status) {
+    var table = document.getElementById("status");
+    table.textContent = "";
+
+    LABELS.forEach(function (l) {
+      if (!(l[0] in status))
+        return;
+      var row = table.insertRow(), value = row.insertCell(1);
+      row.insertCell(0).textContent = l[1];
+      value.textContent = l[2](status[l[0]]);
+      if (l[3] && status[l[0]] > 0)
+        value.className = "bad";
+    });
+  }
+
+  function poll() {
+    var state = document.getElementById("state");
+    var xhr = new XMLHttpRequest();
+
+    xhr.open("GET", "/status");
+    xhr.timeout = PERIOD_MS;
+    xhr.onload = function () {
+      try {
+        render(JSON.parse(xhr.responseText));
+        state.textContent = "Updated " + new Date().toLocaleTimeString();
+      } catch (e) {
+        state.textContent = "Bad reply from the node";
+      }
+    };
+    xhr.onerror = xhr.ontimeout = function () {
+      state.textContent = "Node not reachable";
+    };
+    xhr.onloadend = function () {
+      setTimeout(poll, PERIOD_MS);
+    };
+    xhr.send();
+  }
+
+  poll();
+})();